@@ -51,6 +51,14 @@
 #include <unistd.h>
 #endif
 
+// batched socket io via recvmmsg/sendmmsg (linux only)
+
+#if PLATFORM == PLATFORM_UNIX && defined(__linux__) && defined(MSG_WAITFORONE) && !defined(NET_NO_MMSG)
+#define NET_MMSG 1
+#else
+#define NET_MMSG 0
+#endif
+
 namespace net
 {
 	// platform independent wait for n seconds
@@ -168,6 +176,17 @@ namespace net
 		#endif
 	}
 
+	// one datagram in a batched send or receive
+	//  + on send: address is the destination, size is the number of bytes in data
+	//  + on receive: data must point to at least "maxSize" bytes, address and size are filled in
+
+	struct SocketPacket
+	{
+		Address address;
+		unsigned char * data;
+		int size;
+	};
+
 	class Socket
 	{
 	public:
@@ -177,6 +196,8 @@ namespace net
 			NonBlocking = 1,
 			Broadcast = 2
 		};
+
+		enum { MaxBatchSize = 64 };
 	
 		Socket( int options = NonBlocking )
 		{
@@ -327,6 +348,138 @@ namespace net
 
 			return received_bytes;
 		}
+
+		// send a batch of packets, returns the number of packets sent
+		//  + with recvmmsg/sendmmsg this is one syscall per "MaxBatchSize" packets, otherwise one per packet
+
+		int SendBatch( const SocketPacket packets[], int count )
+		{
+			assert( packets );
+			assert( count >= 0 );
+
+			if ( socket == 0 )
+				return 0;
+
+			#if NET_MMSG
+
+				int sent = 0;
+				while ( sent < count )
+				{
+					const int batchSize = std::min( count - sent, (int) MaxBatchSize );
+					mmsghdr messages[MaxBatchSize];
+					iovec buffers[MaxBatchSize];
+					sockaddr_in addresses[MaxBatchSize];
+					for ( int i = 0; i < batchSize; ++i )
+					{
+						const SocketPacket & packet = packets[sent+i];
+						assert( packet.data );
+						assert( packet.size > 0 );
+						assert( packet.address.GetAddress() != 0 );
+						assert( packet.address.GetPort() != 0 );
+						addresses[i].sin_family = AF_INET;
+						addresses[i].sin_addr.s_addr = htonl( packet.address.GetAddress() );
+						addresses[i].sin_port = htons( packet.address.GetPort() );
+						buffers[i].iov_base = packet.data;
+						buffers[i].iov_len = packet.size;
+						memset( &messages[i], 0, sizeof( mmsghdr ) );
+						messages[i].msg_hdr.msg_name = &addresses[i];
+						messages[i].msg_hdr.msg_namelen = sizeof( sockaddr_in );
+						messages[i].msg_hdr.msg_iov = &buffers[i];
+						messages[i].msg_hdr.msg_iovlen = 1;
+					}
+					int result = sendmmsg( socket, messages, batchSize, 0 );
+					if ( result <= 0 )
+						break;
+					sent += result;
+					if ( result < batchSize )
+						break;
+				}
+				return sent;
+
+			#else
+
+				int sent = 0;
+				for ( int i = 0; i < count; ++i )
+				{
+					if ( Send( packets[i].address, packets[i].data, packets[i].size ) )
+						sent++;
+				}
+				return sent;
+
+			#endif
+		}
+
+		// receive up to "count" packets, each into a buffer of "maxSize" bytes
+		//  + returns the number of packets received, zero if there are none waiting
+		//  + if fewer than "count" packets are returned the socket has been drained
+
+		int ReceiveBatch( SocketPacket packets[], int count, int maxSize )
+		{
+			assert( packets );
+			assert( count >= 0 );
+			assert( maxSize > 0 );
+
+			if ( socket == 0 )
+				return 0;
+
+			#if NET_MMSG
+
+				int received = 0;
+				while ( received < count )
+				{
+					const int batchSize = std::min( count - received, (int) MaxBatchSize );
+					mmsghdr messages[MaxBatchSize];
+					iovec buffers[MaxBatchSize];
+					sockaddr_in addresses[MaxBatchSize];
+					for ( int i = 0; i < batchSize; ++i )
+					{
+						assert( packets[received+i].data );
+						buffers[i].iov_base = packets[received+i].data;
+						buffers[i].iov_len = maxSize;
+						memset( &messages[i], 0, sizeof( mmsghdr ) );
+						messages[i].msg_hdr.msg_name = &addresses[i];
+						messages[i].msg_hdr.msg_namelen = sizeof( sockaddr_in );
+						messages[i].msg_hdr.msg_iov = &buffers[i];
+						messages[i].msg_hdr.msg_iovlen = 1;
+					}
+					const int flags = received > 0 ? MSG_DONTWAIT : MSG_WAITFORONE;
+					int result = recvmmsg( socket, messages, batchSize, flags, NULL );
+					if ( result <= 0 )
+						break;
+					int valid = 0;
+					for ( int i = 0; i < result; ++i )
+					{
+						if ( messages[i].msg_len == 0 )
+							continue;
+						SocketPacket & packet = packets[received+valid];
+						if ( valid != i )
+							memmove( packet.data, buffers[i].iov_base, messages[i].msg_len );
+						packet.address = Address( ntohl( addresses[i].sin_addr.s_addr ), ntohs( addresses[i].sin_port ) );
+						packet.size = (int) messages[i].msg_len;
+						valid++;
+					}
+					received += valid;
+					if ( result < batchSize )
+						break;
+				}
+				return received;
+
+			#else
+
+				int received = 0;
+				while ( received < count )
+				{
+					SocketPacket & packet = packets[received];
+					int size = Receive( packet.address, packet.data, maxSize );
+					if ( size == 0 )
+						break;
+					packet.size = size;
+					received++;
+				}
+				return received;
+
+			#endif
+		}
 		
 	private:
 	
@@ -353,6 +506,9 @@ namespace net
 			this->timeout = timeout;
 			mode = None;
 			running = false;
+			batchPacketSize = 0;
+			batchIndex = 0;
+			batchCount = 0;
 			ClearData();
 		}
 		
@@ -369,6 +525,8 @@ namespace net
 			if ( !socket.Open( port ) )
 				return false;
 			running = true;
+			batchIndex = 0;
+			batchCount = 0;
 			OnStart();
 			return true;
 		}
@@ -380,6 +538,8 @@ namespace net
 			bool connected = IsConnected();
 			ClearData();
 			socket.Close();
+			batchIndex = 0;
+			batchCount = 0;
 			running = false;
 			if ( connected )
 				OnDisconnect();
@@ -481,11 +641,25 @@ namespace net
 		virtual int ReceivePacket( unsigned char data[], int size )
 		{
 			assert( running );
-			unsigned char packet[size+4];
-			Address sender;
-			int bytes_read = socket.Receive( sender, packet, size + 4 );
-			if ( bytes_read == 0 )
+			// drain the socket a batch at a time, then hand out packets from the batch
+			if ( batchIndex == batchCount )
+			{
+				if ( size + 4 > batchPacketSize )
+				{
+					batchPacketSize = size + 4;
+					batchBuffer.resize( ReceiveBatchSize * batchPacketSize );
+					for ( int i = 0; i < ReceiveBatchSize; ++i )
+						batch[i].data = &batchBuffer[i*batchPacketSize];
+				}
+				batchIndex = 0;
+				batchCount = socket.ReceiveBatch( batch, ReceiveBatchSize, batchPacketSize );
+			}
+			if ( batchIndex == batchCount )
 				return 0;
+			const SocketPacket & received = batch[batchIndex++];
+			const Address & sender = received.address;
+			const unsigned char * packet = received.data;
+			int bytes_read = std::min( received.size, size + 4 );
 			if ( bytes_read <= 4 )
 				return 0;
 			if ( packet[0] != (unsigned char) ( protocolId >> 24 ) || 
@@ -555,6 +729,13 @@ namespace net
 		Socket socket;
 		float timeoutAccumulator;
 		Address address;
+
+		enum { ReceiveBatchSize = 32 };
+		std::vector<unsigned char> batchBuffer;
+		SocketPacket batch[ReceiveBatchSize];
+		int batchPacketSize;
+		int batchIndex;
+		int batchCount;
 	};
 	
 	// packet queue to store information about sent and received packets sorted in sequence order
@@ -1212,6 +1393,8 @@ namespace net
 			}
 		};
 		
+		enum { ReceiveBatchSize = 32 };
+
 		unsigned int protocolId;
 		float sendRate;
 		float timeout;
@@ -1312,14 +1495,18 @@ namespace net
 		
 		void ReceivePackets()
 		{
+			const int MaxPacketSize = 256;
+			unsigned char buffer[ReceiveBatchSize][MaxPacketSize];
+			SocketPacket packets[ReceiveBatchSize];
+			for ( int i = 0; i < ReceiveBatchSize; ++i )
+				packets[i].data = buffer[i];
 			while ( true )
 			{
-				Address sender;
-				unsigned char data[256];
-				int size = socket.Receive( sender, data, sizeof(data) );
-				if ( !size )
+				int count = socket.ReceiveBatch( packets, ReceiveBatchSize, MaxPacketSize );
+				for ( int i = 0; i < count; ++i )
+					ProcessPacket( packets[i].address, packets[i].data, packets[i].size );
+				if ( count < ReceiveBatchSize )
 					break;
-				ProcessPacket( sender, data, size );
 			}
 		}
 
@@ -1489,6 +1676,10 @@ namespace net
 		typedef std::stack<BufferedPacket*> PacketBuffer;
 		PacketBuffer receivedPackets;
 
+		enum { ReceiveBatchSize = 32 };
+		std::vector<unsigned char> receiveBuffer;
+		SocketPacket receiveBatch[ReceiveBatchSize];
+
 		unsigned int protocolId;
 		float sendRate;
 		float timeout;
@@ -1521,6 +1712,9 @@ namespace net
 			this->sendRate = sendRate;
 			this->timeout = timeout;
 			this->maxPacketSize = maxPacketSize;
+			receiveBuffer.resize( ReceiveBatchSize * maxPacketSize );
+			for ( int i = 0; i < ReceiveBatchSize; ++i )
+				receiveBatch[i].data = &receiveBuffer[i*maxPacketSize];
 			state = Disconnected;
 			running = false;
 			ClearData();
@@ -1655,12 +1849,11 @@ namespace net
 		{
 			while ( true )
 			{
-				Address sender;
-				unsigned char data[maxPacketSize];
-				int size = socket.Receive( sender, data, sizeof(data) );
-				if ( !size )
+				int count = socket.ReceiveBatch( receiveBatch, ReceiveBatchSize, maxPacketSize );
+				for ( int i = 0; i < count; ++i )
+					ProcessPacket( receiveBatch[i].address, receiveBatch[i].data, receiveBatch[i].size );
+				if ( count < ReceiveBatchSize )
 					break;
-				ProcessPacket( sender, data, size );
 			}
 		}
 
@@ -0,0 +1,887 @@
+/*
+	Benchmarks for Networking Library
+	From "Networking for Game Programmers" - http://www.gaffer.org/networking-for-game-programmers
+	Author: Glenn Fiedler <gaffer@gaffer.org>
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include <deque>
+#include <map>
+
+#include "NetPlatform.h"
+#include "lan/NetSockets.h"
+#include "lan/NetNodeMesh.h"
+#include "NetReliability.h"
+#include "NetFlowControl.h"
+#include "NetTransport.h"
+#include "loopback/NetLoopback.h"
+
+using namespace net;
+
+// simple wall clock timer for benchmarks
+
+class Timer
+{
+public:
+
+	Timer()
+	{
+		Reset();
+	}
+
+	void Reset()
+	{
+		gettimeofday( &start, NULL );
+	}
+
+	double GetSeconds() const
+	{
+		timeval now;
+		gettimeofday( &now, NULL );
+		return ( now.tv_sec - start.tv_sec ) + ( now.tv_usec - start.tv_usec ) / 1000000.0;
+	}
+
+private:
+
+	timeval start;
+};
+
+// -------------------------------------------------------------------------------
+// socket send and receive over loopback: one syscall per packet vs. batched
+// -------------------------------------------------------------------------------
+
+void bench_socket( bool batched )
+{
+	const int SenderPort = 30000;
+	const int ReceiverPort = 30001;
+	const int PacketSize = 64;
+	const int BurstSize = Socket::MaxBatchSize;
+	const int Bursts = 20000;
+
+	Socket sender;
+	Socket receiver;
+	if ( !sender.Open( SenderPort ) || !receiver.Open( ReceiverPort ) )
+	{
+		printf( "failed to open sockets\n" );
+		return;
+	}
+
+	static unsigned char sendBuffer[BurstSize][PacketSize];
+	static unsigned char receiveBuffer[BurstSize][PacketSize];
+	SocketPacket sendPackets[BurstSize];
+	SocketPacket receivePackets[BurstSize];
+	for ( int i = 0; i < BurstSize; ++i )
+	{
+		memset( sendBuffer[i], i, PacketSize );
+		sendPackets[i].address = Address(127,0,0,1,ReceiverPort);
+		sendPackets[i].data = sendBuffer[i];
+		sendPackets[i].size = PacketSize;
+		receivePackets[i].data = receiveBuffer[i];
+	}
+
+	int sent = 0;
+	int received = 0;
+	Timer timer;
+
+	for ( int burst = 0; burst < Bursts; ++burst )
+	{
+		if ( batched )
+		{
+			sent += sender.SendBatch( sendPackets, BurstSize );
+			while ( true )
+			{
+				int count = receiver.ReceiveBatch( receivePackets, BurstSize, PacketSize );
+				received += count;
+				if ( count < BurstSize )
+					break;
+			}
+		}
+		else
+		{
+			for ( int i = 0; i < BurstSize; ++i )
+				sent += sender.Send( sendPackets[i].address, sendPackets[i].data, PacketSize ) ? 1 : 0;
+			while ( true )
+			{
+				Address address;
+				int size = receiver.Receive( address, receiveBuffer[0], PacketSize );
+				if ( !size )
+					break;
+				received++;
+			}
+		}
+	}
+
+	const double seconds = timer.GetSeconds();
+
+	printf( "%-12s sent %d, received %d in %.3f seconds: %.0f packets/sec\n",
+		batched ? "batched" : "per-packet", sent, received, seconds, ( sent + received ) / seconds );
+}
+
+// -------------------------------------------------------------------------------
+// reliability system update cost over many connections as the sent window grows
+// -------------------------------------------------------------------------------
+
+void bench_reliability( int packetsPerSecond )
+{
+	const int Connections = 1000;
+	const int Frames = 600;
+	const float DeltaTime = 1.0f / 60.0f;
+	const int PacketSize = 100;
+	const int AckDelayFrames = 6;
+
+	std::vector<ReliabilitySystem*> connections( Connections );
+	for ( int i = 0; i < Connections; ++i )
+		connections[i] = new ReliabilitySystem();
+
+	double updateSeconds = 0.0;
+	float sendAccumulator = 0.0f;
+	Timer timer;
+
+	for ( int frame = 0; frame < Frames; ++frame )
+	{
+		// send this frame's packets and ack everything sent before the simulated round trip
+
+		sendAccumulator += packetsPerSecond * DeltaTime;
+		const int packetsThisFrame = (int) sendAccumulator;
+		sendAccumulator -= packetsThisFrame;
+
+		const int ackable = ( frame - AckDelayFrames ) * packetsPerSecond / 60;
+
+		for ( int i = 0; i < Connections; ++i )
+		{
+			ReliabilitySystem & reliabilitySystem = *connections[i];
+			for ( int j = 0; j < packetsThisFrame; ++j )
+			{
+				reliabilitySystem.PacketReceived( reliabilitySystem.GetLocalSequence(), PacketSize );
+				reliabilitySystem.PacketSent( PacketSize );
+			}
+			if ( ackable > 0 )
+				reliabilitySystem.ProcessAck( ackable - 1, 0xFFFFFFFF );
+		}
+
+		// time the per-frame update on its own
+
+		Timer updateTimer;
+		for ( int i = 0; i < Connections; ++i )
+			connections[i]->Update( DeltaTime );
+		updateSeconds += updateTimer.GetSeconds();
+	}
+
+	const double seconds = timer.GetSeconds();
+
+	const ReliabilitySystem & reliabilitySystem = *connections[0];
+	printf( "%4d packets/sec: update %.3f us per connection, total %.3f seconds (%.1f kbps sent, %.1f kbps acked, rtt %.0fms)\n",
+		packetsPerSecond, updateSeconds * 1000000.0 / ( Connections * Frames ), seconds,
+		reliabilitySystem.GetSentBandwidth(), reliabilitySystem.GetAckedBandwidth(), reliabilitySystem.GetRoundTripTime() * 1000.0f );
+
+	for ( int i = 0; i < Connections; ++i )
+		delete connections[i];
+}
+
+// -------------------------------------------------------------------------------
+// mesh address lookup and join: hashed address table + free list vs. map + scan
+// -------------------------------------------------------------------------------
+
+/*
+	Packets are fed straight into Mesh::ProcessPacket from made up
+	addresses, so no sockets are involved and node counts can go past
+	what fits in one machine's port range. MapMesh mirrors the old
+	std::map lookup and linear free slot scan as a reference.
+*/
+
+const unsigned int MeshProtocolId = 0x12345678;
+
+class BenchMesh : public Mesh
+{
+public:
+
+	BenchMesh( int maxNodes ) : Mesh( MeshProtocolId, maxNodes, 1.0f, 1.0f, GetMeshUpdatePacketSize( maxNodes ) ) {}
+
+	void Receive( const Address & sender, unsigned char data[], int size )
+	{
+		ProcessPacket( sender, data, size );
+	}
+
+	void TimeOutAll()
+	{
+		CheckForTimeouts( 2.0f );
+	}
+};
+
+class MapMesh
+{
+public:
+
+	MapMesh( int maxNodes ) : nodes( maxNodes ) {}
+
+	void Receive( const Address & sender, unsigned char data[], int size )
+	{
+		std::map<Address,int>::iterator itor = addresses.find( sender );
+		if ( data[4] == 0 )
+		{
+			if ( itor != addresses.end() )
+				return;
+			for ( int i = 0; i < (int) nodes.size(); ++i )
+			{
+				if ( nodes[i].address == Address() )
+				{
+					nodes[i].address = sender;
+					nodes[i].connected = false;
+					addresses.insert( std::make_pair( sender, i ) );
+					printf( "mesh accepts %d.%d.%d.%d:%d as node %d\n", 
+						sender.GetA(), sender.GetB(), sender.GetC(), sender.GetD(), sender.GetPort(), i );
+					return;
+				}
+			}
+		}
+		else if ( itor != addresses.end() )
+		{
+			nodes[itor->second].connected = true;
+		}
+	}
+
+	void TimeOutAll()
+	{
+		for ( int i = 0; i < (int) nodes.size(); ++i )
+			nodes[i] = NodeState();
+		addresses.clear();
+	}
+
+private:
+
+	struct NodeState
+	{
+		NodeState() : connected( false ) {}
+		Address address;
+		bool connected;
+	};
+
+	std::vector<NodeState> nodes;
+	std::map<Address,int> addresses;
+};
+
+// mesh prints a line per join and timeout, keep that out of the timings
+
+class QuietStdout
+{
+public:
+
+	QuietStdout()
+	{
+		fflush( stdout );
+		saved = dup( STDOUT_FILENO );
+		int null = open( "/dev/null", O_WRONLY );
+		dup2( null, STDOUT_FILENO );
+		close( null );
+	}
+
+	~QuietStdout()
+	{
+		fflush( stdout );
+		dup2( saved, STDOUT_FILENO );
+		close( saved );
+	}
+
+private:
+
+	int saved;
+};
+
+template <typename MeshType> void run_mesh( MeshType & mesh, const std::vector<Address> & addresses, int keepAliveRounds, double & joinSeconds, double & keepAliveSeconds )
+{
+	unsigned char joinRequest[5] = { 0x12, 0x34, 0x56, 0x78, 0 };
+	unsigned char keepAlive[5] = { 0x12, 0x34, 0x56, 0x78, 1 };
+	const int count = (int) addresses.size();
+
+	QuietStdout quiet;
+
+	// join everybody, time everybody out, then join again so the second round of joins reuses freed slots
+
+	for ( int i = 0; i < count; ++i )
+		mesh.Receive( addresses[i], joinRequest, sizeof( joinRequest ) );
+	mesh.TimeOutAll();
+
+	Timer timer;
+	for ( int i = 0; i < count; ++i )
+		mesh.Receive( addresses[count-1-i], joinRequest, sizeof( joinRequest ) );
+	joinSeconds = timer.GetSeconds();
+
+	timer.Reset();
+	for ( int j = 0; j < keepAliveRounds; ++j )
+		for ( int i = 0; i < count; ++i )
+			mesh.Receive( addresses[i], keepAlive, sizeof( keepAlive ) );
+	keepAliveSeconds = timer.GetSeconds();
+}
+
+void bench_mesh( int maxNodes )
+{
+	const int KeepAliveRounds = 100;
+
+	std::vector<Address> addresses( maxNodes );
+	for ( int i = 0; i < maxNodes; ++i )
+		addresses[i] = Address( 10, (unsigned char) ( i >> 16 ), (unsigned char) ( i >> 8 ), (unsigned char) i, (unsigned short) ( 40000 + i % 1000 ) );
+
+	double hashJoin, hashKeepAlive;
+	double mapJoin, mapKeepAlive;
+
+	{
+		BenchMesh mesh( maxNodes );
+		run_mesh( mesh, addresses, KeepAliveRounds, hashJoin, hashKeepAlive );
+		if ( mesh.GetNodeCount() != maxNodes )
+			printf( "mesh only joined %d of %d nodes!\n", mesh.GetNodeCount(), maxNodes );
+	}
+
+	{
+		MapMesh mesh( maxNodes );
+		run_mesh( mesh, addresses, KeepAliveRounds, mapJoin, mapKeepAlive );
+	}
+
+	printf( "%5d nodes: join %7.1fns (map + scan %7.1fns), keep alive %5.1fns (map %5.1fns)\n",
+		maxNodes, hashJoin * 1000000000.0 / maxNodes, mapJoin * 1000000000.0 / maxNodes,
+		hashKeepAlive * 1000000000.0 / ( maxNodes * KeepAliveRounds ), mapKeepAlive * 1000000000.0 / ( maxNodes * KeepAliveRounds ) );
+}
+
+// -------------------------------------------------------------------------------
+// flow control over a simulated link: binary vs. adaptive controller
+// -------------------------------------------------------------------------------
+
+/*
+	One direction of a link with a bottleneck. Packets queue behind
+	the bottleneck, are dropped once the queue holds more than the
+	queue limit, lose a fixed fraction at random and arrive latency
+	seconds after they leave the bottleneck. Loss comes from a seeded
+	generator, so runs are repeatable.
+*/
+
+struct LinkPacket
+{
+	double time;
+	int size;
+	unsigned int sequence;
+	unsigned int ack;
+	unsigned int ack_bits;
+};
+
+class SimulatedLink
+{
+public:
+
+	SimulatedLink( float latency, float loss, float bandwidth, float queueTime, unsigned int seed )
+	{
+		this->latency = latency;
+		this->loss = loss;
+		this->bandwidth = bandwidth;
+		this->queueTime = queueTime;
+		this->seed = seed;
+		freeTime = 0.0;
+		dropped = 0;
+	}
+
+	void Send( double time, const LinkPacket & packet )
+	{
+		// note: bandwidth is in kbps, zero means no bottleneck
+
+		double departure = time;
+		if ( bandwidth > 0.0f )
+		{
+			const double start = std::max( time, freeTime );
+			if ( start - time > queueTime )
+			{
+				dropped++;
+				return;
+			}
+			departure = start + packet.size * 8 / ( bandwidth * 1000.0 );
+			freeTime = departure;
+		}
+		if ( Random() < loss )
+		{
+			dropped++;
+			return;
+		}
+		packets.push_back( packet );
+		packets.back().time = departure + latency;
+	}
+
+	bool Receive( double time, LinkPacket & packet )
+	{
+		if ( packets.empty() || packets.front().time > time )
+			return false;
+		packet = packets.front();
+		packets.pop_front();
+		return true;
+	}
+
+	unsigned int GetDropped() const
+	{
+		return dropped;
+	}
+
+private:
+
+	float Random()
+	{
+		seed = seed * 1664525 + 1013904223;
+		return ( seed >> 8 ) / 16777216.0f;
+	}
+
+	float latency;
+	float loss;
+	float bandwidth;
+	float queueTime;
+	unsigned int seed;
+	double freeTime;
+	unsigned int dropped;
+	std::deque<LinkPacket> packets;
+};
+
+void bench_flow_control( FlowControl::Controller controller, float latency, float loss, float bandwidth )
+{
+	const float DeltaTime = 0.01f;
+	const float Duration = 60.0f;
+	const float QueueTime = 0.25f;
+	const int PacketSize = 256;
+	const int AckSize = 16;
+
+	ReliabilitySystem sender;
+	ReliabilitySystem receiver;
+	SimulatedLink forward( latency * 0.5f, loss, bandwidth, QueueTime, 1 );
+	SimulatedLink backward( latency * 0.5f, loss, 0.0f, 0.0f, 2 );
+
+	double delivered = 0.0;
+	double rttTotal = 0.0;
+	int rttSamples = 0;
+	double time = 0.0;
+
+	float finalRate = 0.0f;
+
+	{
+		// flow control prints on mode changes
+
+		QuietStdout quiet;
+		FlowControl flowControl( controller, PacketSize );
+
+		const int Frames = (int) ( Duration / DeltaTime );
+		for ( int frame = 0; frame < Frames; ++frame )
+		{
+			flowControl.Update( DeltaTime, sender );
+
+			while ( flowControl.GetByteBudget() >= PacketSize )
+			{
+				LinkPacket packet;
+				packet.size = PacketSize;
+				packet.sequence = sender.GetLocalSequence();
+				packet.ack = 0;
+				packet.ack_bits = 0;
+				forward.Send( time, packet );
+				sender.PacketSent( PacketSize );
+				flowControl.PacketSent( PacketSize );
+			}
+
+			LinkPacket packet;
+			bool received = false;
+			while ( forward.Receive( time, packet ) )
+			{
+				receiver.PacketReceived( packet.sequence, packet.size );
+				delivered += packet.size;
+				received = true;
+			}
+
+			if ( received )
+			{
+				LinkPacket ack;
+				ack.size = AckSize;
+				ack.sequence = 0;
+				ack.ack = receiver.GetRemoteSequence();
+				ack.ack_bits = receiver.GenerateAckBits();
+				backward.Send( time, ack );
+			}
+
+			while ( backward.Receive( time, packet ) )
+				sender.ProcessAck( packet.ack, packet.ack_bits );
+
+			sender.Update( DeltaTime );
+			receiver.Update( DeltaTime );
+			time += DeltaTime;
+
+			if ( time > Duration * 0.5f && sender.GetRoundTripTime() > 0.0f )
+			{
+				rttTotal += sender.GetRoundTripTime();
+				rttSamples++;
+			}
+		}
+
+		finalRate = flowControl.GetSendRate();
+	}
+
+	const unsigned int sent = sender.GetSentPackets();
+
+	printf( "%-8s latency %3.0fms, loss %2.0f%%, bottleneck %4.0f kbps: sent %6.1f kbps, delivered %6.1f kbps, dropped %5.1f%%, rtt %4.0fms, final rate %5.1f packets/sec\n",
+		controller == FlowControl::Binary ? "binary" : "adaptive", latency * 1000.0f, loss * 100.0f, bandwidth,
+		sent * PacketSize * 8 / ( Duration * 1000.0f ), delivered * 8 / ( Duration * 1000.0 ), 
+		sent ? forward.GetDropped() * 100.0f / sent : 0.0f, rttSamples ? rttTotal / rttSamples * 1000.0 : 0.0, finalRate );
+}
+
+// -------------------------------------------------------------------------------
+// loopback transport: mesh throughput with no sockets, and the inbox ring with several senders
+// -------------------------------------------------------------------------------
+
+/*
+	Each node sends to its next few neighbours every frame and all of
+	it is received, so the time per packet covers the reliability
+	header, the inbox ring, the delivery queue and the reliability
+	system at both ends. The socket bench above is the same work going
+	through the kernel. The ring bench has several threads sending
+	into one inbox while the main thread receives.
+*/
+
+void bench_loopback_mesh( int maxNodes, int neighbours, int packetSize )
+{
+	const int Frames = 600;
+	const float DeltaTime = 1.0f / 60.0f;
+
+	TransportLoopback::Config config;
+	config.maxNodes = maxNodes;
+	config.maxPacketSize = packetSize;
+	config.queueSize = 256;
+
+	std::vector<TransportLoopback*> transports( maxNodes );
+	for ( int i = 0; i < maxNodes; ++i )
+	{
+		transports[i] = new TransportLoopback();
+		transports[i]->Configure( config );
+		transports[i]->Start();
+	}
+
+	std::vector<unsigned char> packet( packetSize, 0 );
+	std::vector<unsigned char> data( packetSize );
+	int sent = 0;
+	int received = 0;
+
+	Timer timer;
+	for ( int frame = 0; frame < Frames; ++frame )
+	{
+		for ( int i = 0; i < maxNodes; ++i )
+		{
+			for ( int k = 1; k <= neighbours; ++k )
+			{
+				if ( transports[i]->SendPacket( ( i + k ) % maxNodes, &packet[0], packetSize ) )
+					sent++;
+			}
+		}
+		for ( int i = 0; i < maxNodes; ++i )
+		{
+			transports[i]->Update( DeltaTime );
+			int nodeId = -1;
+			while ( transports[i]->ReceivePacket( nodeId, &data[0], packetSize ) )
+				received++;
+		}
+	}
+	const double seconds = timer.GetSeconds();
+
+	printf( "%4d nodes, %2d neighbours, %4d byte packets: %5.1fns per packet, %5.2f million packets/sec (%d of %d received)\n",
+		maxNodes, neighbours, packetSize, seconds * 1000000000.0 / sent, sent / seconds / 1000000.0, received, sent );
+
+	for ( int i = 0; i < maxNodes; ++i )
+		delete transports[i];
+}
+
+struct RingSender
+{
+	PacketRing * ring;
+	int nodeId;
+	int packets;
+};
+
+void * ring_sender( void * data )
+{
+	RingSender * sender = (RingSender*) data;
+	unsigned char packet[64];
+	memset( packet, 0, sizeof( packet ) );
+	for ( int i = 0; i < sender->packets; ++i )
+	{
+		while ( !sender->ring->Push( sender->nodeId, 0.0f, packet, sizeof( packet ) ) )
+			sched_yield();
+	}
+	return NULL;
+}
+
+void bench_packet_ring( int senders )
+{
+	const int MaxSenders = 8;
+	const int Packets = 1000000;
+
+	assert( senders <= MaxSenders );
+
+	PacketRing ring( 1024, 64 );
+	RingSender senderData[MaxSenders];
+	pthread_t threads[MaxSenders];
+
+	Timer timer;
+	for ( int i = 0; i < senders; ++i )
+	{
+		senderData[i].ring = &ring;
+		senderData[i].nodeId = i;
+		senderData[i].packets = Packets / senders;
+		pthread_create( &threads[i], NULL, ring_sender, &senderData[i] );
+	}
+
+	const int total = ( Packets / senders ) * senders;
+	int received = 0;
+	while ( received < total )
+	{
+		unsigned char data[64];
+		int nodeId = 0;
+		float delay = 0.0f;
+		int size = 0;
+		if ( ring.Pop( nodeId, delay, data, size ) )
+			received++;
+		else
+			sched_yield();
+	}
+
+	for ( int i = 0; i < senders; ++i )
+		pthread_join( threads[i], NULL );
+	const double seconds = timer.GetSeconds();
+
+	printf( "%d sender thread%s: %5.1fns per packet, %5.2f million packets/sec\n",
+		senders, senders == 1 ? " " : "s", seconds * 1000000000.0 / total, total / seconds / 1000000.0 );
+}
+
+// -------------------------------------------------------------------------------
+// lan transport rtt with 30ms frame stalls, with and without the i/o thread
+// -------------------------------------------------------------------------------
+
+/*
+	The server runs on a thread of its own and sends every packet
+	straight back, so each packet is acked within a millisecond or so.
+	The client sends one packet per 16ms frame, and some frames stall
+	for another 30ms. Without the i/o thread an ack that arrives during
+	a stall waits in the socket until the next update, and the rtt
+	estimate takes in the stall. With the i/o thread the ack is stamped
+	when it arrives. The error is against the rtt measured with the i/o
+	thread and no stalls, which is what the echo round trip really is.
+*/
+
+struct EchoServer
+{
+	TransportLAN * transport;
+	int running;
+};
+
+void * echo_server( void * data )
+{
+	EchoServer * server = (EchoServer*) data;
+	double previous = time_seconds();
+	while ( __atomic_load_n( &server->running, __ATOMIC_ACQUIRE ) )
+	{
+		const double now = time_seconds();
+		server->transport->Update( (float) ( now - previous ) );
+		previous = now;
+		while ( true )
+		{
+			int nodeId = -1;
+			unsigned char packet[256];
+			const int bytes = server->transport->ReceivePacket( nodeId, packet, sizeof( packet ) );
+			if ( bytes == 0 )
+				break;
+			server->transport->SendPacket( nodeId, packet, bytes );
+		}
+		wait_seconds( 0.0005f );
+	}
+	return NULL;
+}
+
+double bench_lan_transport_rtt( bool ioThread, int stallEvery, double referenceRtt )
+{
+	const int Frames = 240;
+	const float FrameTime = 1.0f / 60.0f;
+	const float StallTime = 0.03f;
+
+	float rtt = 0.0f, minRtt = 0.0f, jitter = 0.0f;
+	bool connected = false;
+
+	{
+		QuietStdout quiet;
+
+		TransportLAN::Config config;
+		config.reliability = true;
+		config.ioThread = ioThread;
+
+		TransportLAN server;
+		server.Configure( config );
+		server.StartServer( "bench" );
+
+		TransportLAN client;
+		client.Configure( config );
+		client.ConnectClient( "127.0.0.1:30000" );
+
+		EchoServer echo;
+		echo.transport = &server;
+		echo.running = 1;
+		pthread_t thread;
+		pthread_create( &thread, NULL, echo_server, &echo );
+
+		double previous = time_seconds();
+		for ( int frame = -120; frame < Frames; ++frame )
+		{
+			const double now = time_seconds();
+			client.Update( (float) ( now - previous ) );
+			previous = now;
+
+			while ( true )
+			{
+				int nodeId = -1;
+				unsigned char packet[256];
+				const int bytes = client.ReceivePacket( nodeId, packet, sizeof( packet ) );
+				if ( bytes == 0 )
+					break;
+			}
+
+			connected = client.IsConnected() && client.IsNodeConnected( 0 );
+			if ( connected )
+			{
+				unsigned char packet[16];
+				memset( packet, 0, sizeof( packet ) );
+				client.SendPacket( 0, packet, sizeof( packet ) );
+			}
+
+			// frames before zero are warm up: join and let the rtt settle
+
+			if ( frame == 0 && connected )
+				client.GetReliability( 0 ).Reset();
+
+			wait_seconds( FrameTime );
+			if ( frame >= 0 && stallEvery > 0 && frame % stallEvery == 0 )
+				wait_seconds( StallTime );
+		}
+
+		if ( connected )
+		{
+			ReliabilitySystem & reliability = client.GetReliability( 0 );
+			rtt = reliability.GetRoundTripTime();
+			minRtt = reliability.GetMinRoundTripTime();
+			jitter = reliability.GetJitter();
+		}
+
+		__atomic_store_n( &echo.running, 0, __ATOMIC_RELEASE );
+		pthread_join( thread, NULL );
+	}
+
+	if ( !connected )
+	{
+		printf( "%-13s failed to connect\n", ioThread ? "i/o thread" : "no i/o thread" );
+		return 0.0;
+	}
+
+	char error[32];
+	if ( referenceRtt > 0.0 )
+		sprintf( error, "error %+5.1fms", ( rtt - referenceRtt ) * 1000.0 );
+	else
+		sprintf( error, "reference" );
+
+	char stalls[32];
+	if ( stallEvery > 0 )
+		sprintf( stalls, "30ms stall every %d", stallEvery );
+	else
+		sprintf( stalls, "no stalls" );
+
+	printf( "%-13s %-19s rtt %5.1fms (%-15s), min rtt %4.1fms, jitter %4.1fms\n",
+		ioThread ? "i/o thread" : "no i/o thread", stalls, rtt * 1000.0f, error, minRtt * 1000.0f, jitter * 1000.0f );
+
+	return rtt;
+}
+
+// -------------------------------------------------------------------------------
+
+int main( int argc, char * argv[] )
+{
+	if ( !InitializeSockets() )
+	{
+		printf( "failed to initialize sockets\n" );
+		return 1;
+	}
+
+	printf( "-----------------------------------------------------\n" );
+	printf( "bench socket (%s)\n", NET_MMSG ? "recvmmsg/sendmmsg" : "sendto/recvfrom fallback" );
+	printf( "-----------------------------------------------------\n" );
+
+	bench_socket( false );
+	bench_socket( true );
+
+	printf( "-----------------------------------------------------\n" );
+	printf( "bench reliability system (1000 connections)\n" );
+	printf( "-----------------------------------------------------\n" );
+
+	bench_reliability( 30 );
+	bench_reliability( 120 );
+	bench_reliability( 480 );
+
+	printf( "-----------------------------------------------------\n" );
+	printf( "bench mesh (join with free slot reuse, keep alive lookup)\n" );
+	printf( "-----------------------------------------------------\n" );
+
+	bench_mesh( 64 );
+	bench_mesh( 255 );
+	bench_mesh( 1024 );
+	bench_mesh( 4096 );
+
+	printf( "-----------------------------------------------------\n" );
+	printf( "bench flow control (60 seconds over a simulated link)\n" );
+	printf( "-----------------------------------------------------\n" );
+
+	const float links[][3] = 
+	{
+		// latency, loss, bottleneck kbps
+		{ 0.05f, 0.0f, 1000.0f },
+		{ 0.1f, 0.0f, 256.0f },
+		{ 0.1f, 0.0f, 48.0f },
+		{ 0.1f, 0.02f, 256.0f },
+		{ 0.2f, 0.05f, 128.0f },
+	};
+
+	for ( int i = 0; i < (int) ( sizeof( links ) / sizeof( links[0] ) ); ++i )
+	{
+		bench_flow_control( FlowControl::Binary, links[i][0], links[i][1], links[i][2] );
+		bench_flow_control( FlowControl::Adaptive, links[i][0], links[i][1], links[i][2] );
+	}
+
+	printf( "-----------------------------------------------------\n" );
+	printf( "bench loopback transport (600 frames, every packet received)\n" );
+	printf( "-----------------------------------------------------\n" );
+
+	bench_loopback_mesh( 16, 8, 64 );
+	bench_loopback_mesh( 64, 8, 64 );
+	bench_loopback_mesh( 64, 63, 64 );
+	bench_loopback_mesh( 256, 8, 64 );
+	bench_loopback_mesh( 64, 8, 1024 );
+
+	printf( "-----------------------------------------------------\n" );
+	printf( "bench loopback inbox ring (1M 64 byte packets, one receiver)\n" );
+	printf( "-----------------------------------------------------\n" );
+
+	bench_packet_ring( 1 );
+	bench_packet_ring( 2 );
+	bench_packet_ring( 4 );
+
+	printf( "-----------------------------------------------------\n" );
+	printf( "bench lan transport rtt with 30ms frame stalls (echo server, 60fps client)\n" );
+	printf( "-----------------------------------------------------\n" );
+
+	const double reference = bench_lan_transport_rtt( true, 0, 0.0 );
+	bench_lan_transport_rtt( false, 0, reference );
+	bench_lan_transport_rtt( false, 4, reference );
+	bench_lan_transport_rtt( true, 4, reference );
+	bench_lan_transport_rtt( false, 1, reference );
+	bench_lan_transport_rtt( true, 1, reference );
+
+	ShutdownSockets();
+
+	return 0;
+}
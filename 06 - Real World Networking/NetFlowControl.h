@@ -7,19 +7,37 @@
 #ifndef NET_FLOW_CONTROL_H
 #define NET_FLOW_CONTROL_H
 
+#include <assert.h>
+#include <stdio.h>
+#include <algorithm>
+
+#include "NetReliability.h"
+
 namespace net
 {
-	// simple binary flow control
-	//  + two modes of operation: good and bad mode
-	//  + if RTT exceeds 250ms drop to bad mode immediately
-	//  + if RTT is under 250ms for a period of time, return to good mode
+	// flow control with two selectable controllers
+	//  + binary: two modes of operation, good and bad mode
+	//  + binary: if RTT exceeds 250ms drop to bad mode immediately
+	//  + binary: if RTT is under 250ms for a period of time, return to good mode
+	//  + adaptive: AIMD on a continuous byte rate, fed rtt, lost packets and acked bandwidth from the reliability system
+	//  + adaptive: backs off when packets are lost or rtt climbs above its baseline, as that means a queue is building
+	//  + either way the send rate is turned into a byte budget per tick, so callers can send variable sized packets
 
 	class FlowControl
 	{
 	public:
 
-		FlowControl()
+		enum Controller
+		{
+			Binary,
+			Adaptive
+		};
+
+		FlowControl( Controller controller = Binary, int packetSize = 256 )
 		{
+			assert( packetSize > 0 );
+			this->controller = controller;
+			this->packetSize = packetSize;
 			printf( "flow control initialized\n" );
 			Reset();
 		}
@@ -30,9 +48,80 @@ namespace net
 			penalty_time = 4.0f;
 			good_conditions_time = 0.0f;
 			penalty_reduction_accumulator = 0.0f;
+			byte_rate = (float) MinimumSendRate * packetSize;
+			byte_budget = 0.0f;
+			min_rtt = 0.0f;
+			lost_packets = 0;
+			slow_start = true;
+			decrease_time = 0.0f;
+		}
+
+		void Update( float deltaTime, const ReliabilitySystem & reliabilitySystem )
+		{
+			Update( deltaTime, reliabilitySystem.GetRoundTripTime() * 1000.0f, reliabilitySystem.GetLostPackets(), 
+					reliabilitySystem.GetAckedBandwidth(), reliabilitySystem.GetMinRoundTripTime() * 1000.0f );
 		}
 
 		void Update( float deltaTime, float rtt )
+		{
+			Update( deltaTime, rtt, lost_packets, 0.0f );
+		}
+
+		// rtt is in milliseconds, lost packets is the running total and acked bandwidth is in kbps.
+		// min rtt (ms) is the rtt baseline if known, otherwise the adaptive controller estimates its own
+
+		void Update( float deltaTime, float rtt, unsigned int lostPackets, float ackedBandwidth, float minRtt = 0.0f )
+		{
+			const float MaximumBurstTime = 0.1f;		// most budget that can build up, in seconds of send rate
+
+			if ( controller == Binary )
+			{
+				UpdateBinary( deltaTime, rtt );
+				byte_rate = GetSendRate() * packetSize;
+			}
+			else
+				UpdateAdaptive( deltaTime, rtt, lostPackets, ackedBandwidth, minRtt );
+
+			lost_packets = lostPackets;
+
+			// note: budget is capped so an idle sender can't save up a burst bigger than the link would absorb
+
+			byte_budget += byte_rate * deltaTime;
+			const float max_budget = std::max( byte_rate * MaximumBurstTime, (float) packetSize );
+			if ( byte_budget > max_budget )
+				byte_budget = max_budget;
+		}
+
+		void PacketSent( int size )
+		{
+			byte_budget -= size;
+		}
+
+		float GetSendRate() const
+		{
+			if ( controller == Binary )
+				return mode == Good ? 30.0f : 10.0f;
+			return byte_rate / packetSize;
+		}
+
+		float GetByteRate() const
+		{
+			return byte_rate;
+		}
+
+		int GetByteBudget() const
+		{
+			return byte_budget > 0.0f ? (int) byte_budget : 0;
+		}
+
+		Controller GetController() const
+		{
+			return controller;
+		}
+
+	private:
+
+		void UpdateBinary( float deltaTime, float rtt )
 		{
 			const float RTT_Threshold = 250.0f;
 
@@ -85,12 +174,70 @@ namespace net
 			}
 		}
 
-		float GetSendRate()
+		void UpdateAdaptive( float deltaTime, float rtt, unsigned int lostPackets, float ackedBandwidth, float minRtt )
 		{
-			return mode == Good ? 30.0f : 10.0f;
-		}
+			const float MinimumRTT = 10.0f;				// floor on rtt (ms) when timing increases and decreases
+			const float DelayThreshold = 20.0f;			// queueing delay (ms) over the baseline that counts as congestion...
+			const float DelayFraction = 0.25f;			// ...or this fraction of the baseline, whichever is larger
+			const float DecreaseFactor = 0.7f;
+			const float DeliveredFactor = 0.9f;
+			const float BaselineTime = 5.0f;			// time for the rtt baseline to follow the rtt up
 
-	private:
+			// nothing acked yet, so nothing to go on: hold the rate
+
+			if ( rtt <= 0.0f )
+				return;
+
+			// note: without a min rtt, the baseline drops straight to a lower rtt but only creeps up, so it
+			// recovers from the low values a smoothed rtt can start with, and from the path getting longer
+
+			if ( minRtt > 0.0f )
+				min_rtt = minRtt;
+			else if ( min_rtt == 0.0f || rtt < min_rtt )
+				min_rtt = rtt;
+			else
+				min_rtt += ( rtt - min_rtt ) * std::min( deltaTime / BaselineTime, 1.0f );
+
+			decrease_time += deltaTime;
+
+			const float rtt_seconds = std::max( rtt, MinimumRTT ) / 1000.0f;
+			const float queue_delay = rtt - min_rtt;
+			const bool lost = lostPackets != lost_packets;
+			const bool delayed = queue_delay > std::max( DelayThreshold, min_rtt * DelayFraction );
+
+			if ( lost || delayed )
+			{
+				// multiplicative decrease, at most once per round trip so one congestion event isn't counted twice.
+				// the path just delivered the acked bandwidth, so never drop below most of that
+
+				if ( decrease_time > rtt_seconds )
+				{
+					const float delivered = ackedBandwidth * ( 1000.0f / 8.0f );
+					byte_rate = std::max( byte_rate * DecreaseFactor, std::min( byte_rate, delivered * DeliveredFactor ) );
+					slow_start = false;
+					decrease_time = 0.0f;
+				}
+			}
+			else if ( slow_start )
+			{
+				// grow by half the current rate each round trip until the first congestion signal
+
+				byte_rate += byte_rate * 0.5f * deltaTime / rtt_seconds;
+			}
+			else
+			{
+				// additive increase: one more packet per second each round trip
+
+				byte_rate += packetSize * deltaTime / rtt_seconds;
+			}
+
+			const float min_rate = (float) MinimumSendRate * packetSize;
+			const float max_rate = (float) MaximumSendRate * packetSize;
+			if ( byte_rate < min_rate )
+				byte_rate = min_rate;
+			if ( byte_rate > max_rate )
+				byte_rate = max_rate;
+		}
 
 		enum Mode
 		{
@@ -98,10 +245,26 @@ namespace net
 			Bad
 		};
 
+		enum
+		{
+			MinimumSendRate = 10,			// packets per second, same as binary bad mode
+			MaximumSendRate = 240			// packets per second
+		};
+
+		Controller controller;
+		int packetSize;
+
 		Mode mode;
 		float penalty_time;
 		float good_conditions_time;
 		float penalty_reduction_accumulator;
+
+		float byte_rate;					// current send rate in bytes per second
+		float byte_budget;					// bytes that may be sent now, topped up by byte rate each update
+		float min_rtt;						// rtt baseline (ms), taken as the rtt with no queueing on the path
+		unsigned int lost_packets;			// lost packet total at the last update
+		bool slow_start;					// true until the first decrease
+		float decrease_time;				// time since the last decrease
 	};
 }
 
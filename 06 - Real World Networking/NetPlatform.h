@@ -27,7 +27,13 @@
 
 #include <assert.h>
 #include <stdio.h>
+
+#if PLATFORM != PLATFORM_WINDOWS
 #include <unistd.h>
+#include <sys/time.h>
+#include <time.h>
+#include <pthread.h>
+#endif
 
 namespace net
 {
@@ -44,6 +50,64 @@ namespace net
 
 	inline void wait_seconds( float seconds ) { usleep( (int) ( seconds * 1000000.0f ) ); }
 
+#endif
+
+	// platform independent monotonic time in seconds, for timestamping packets.
+	// not wall clock time, so it doesn't jump when the system clock is set
+
+#if PLATFORM == PLATFORM_WINDOWS
+
+	inline double time_seconds()
+	{
+		LARGE_INTEGER frequency, counter;
+		QueryPerformanceFrequency( &frequency );
+		QueryPerformanceCounter( &counter );
+		return (double) counter.QuadPart / (double) frequency.QuadPart;
+	}
+
+#else
+
+	inline double time_seconds()
+	{
+		timespec now;
+		clock_gettime( CLOCK_MONOTONIC, &now );
+		return now.tv_sec + now.tv_nsec / 1000000000.0;
+	}
+
+#endif
+
+	// platform independent mutex
+
+#if PLATFORM == PLATFORM_WINDOWS
+
+	class Mutex
+	{
+	public:
+		Mutex()			{ InitializeCriticalSection( &criticalSection ); }
+		~Mutex()		{ DeleteCriticalSection( &criticalSection ); }
+		void Lock()		{ EnterCriticalSection( &criticalSection ); }
+		void Unlock()	{ LeaveCriticalSection( &criticalSection ); }
+	private:
+		Mutex( const Mutex & other );
+		Mutex & operator = ( const Mutex & other );
+		CRITICAL_SECTION criticalSection;
+	};
+
+#else
+
+	class Mutex
+	{
+	public:
+		Mutex()			{ pthread_mutex_init( &mutex, NULL ); }
+		~Mutex()		{ pthread_mutex_destroy( &mutex ); }
+		void Lock()		{ pthread_mutex_lock( &mutex ); }
+		void Unlock()	{ pthread_mutex_unlock( &mutex ); }
+	private:
+		Mutex( const Mutex & other );
+		Mutex & operator = ( const Mutex & other );
+		pthread_mutex_t mutex;
+	};
+
 #endif
 }
 
@@ -8,22 +8,22 @@
 #define NET_RELIABILITY_H
 
 #include <assert.h>
+#include <stdio.h>
+#include <math.h>
 #include <vector>
 #include <map>
 #include <stack>
-#include <list>
 #include <algorithm>
 #include <functional>
 
 namespace net
 {
-	// packet queue to store information about sent and received packets sorted in sequence order
+	// packet data stored for each received packet, indexed by sequence in a sequence buffer
 	//  + we define ordering using the "sequence_more_recent" function, this works provided there is a large gap when sequence wrap occurs
 	
 	struct PacketData
 	{
 		unsigned int sequence;			// packet sequence number
-		float time;					    // time offset since packet was sent or received (depending on context)
 		int size;						// packet size in bytes
 	};
 
@@ -31,77 +31,366 @@ namespace net
 	{
 		return ( s1 > s2 ) && ( s1 - s2 <= max_sequence/2 ) || ( s2 > s1 ) && ( s2 - s1 > max_sequence/2 );
 	}		
-	
-	class PacketQueue : public std::list<PacketData>
+
+	// sequence buffer
+	//  + fixed size ring buffer of entries indexed by sequence modulo buffer size, allocated once up front
+	//  + each entry remembers the sequence it was inserted with, so stale entries from an earlier lap are ignored
+	//  + the buffer size must divide ( max_sequence + 1 ) so that neighbouring sequences map to neighbouring entries
+
+	template <typename T> class SequenceBuffer
 	{
 	public:
-		
-		bool exists( unsigned int sequence )
+
+		SequenceBuffer( int size = 256 )
 		{
-			for ( iterator itor = begin(); itor != end(); ++itor )
-				if ( itor->sequence == sequence )
-					return true;
-			return false;
+			assert( size > 0 );
+			entries.resize( size );
+			Reset();
 		}
-		
-		void insert_sorted( const PacketData & p, unsigned int max_sequence )
+
+		void Reset()
+		{
+			for ( unsigned int i = 0; i < entries.size(); ++i )
+				entries[i].valid = false;
+		}
+
+		T * Insert( unsigned int sequence )
+		{
+			Entry & entry = entries[ sequence % entries.size() ];
+			entry.sequence = sequence;
+			entry.valid = true;
+			return &entry.data;
+		}
+
+		void Remove( unsigned int sequence )
+		{
+			Entry & entry = entries[ sequence % entries.size() ];
+			if ( entry.valid && entry.sequence == sequence )
+				entry.valid = false;
+		}
+
+		void Clear( unsigned int sequence )
+		{
+			// invalidate the entry for this sequence, whatever sequence is currently stored in it
+			entries[ sequence % entries.size() ].valid = false;
+		}
+
+		bool Exists( unsigned int sequence ) const
+		{
+			const Entry & entry = entries[ sequence % entries.size() ];
+			return entry.valid && entry.sequence == sequence;
+		}
+
+		T * Find( unsigned int sequence )
+		{
+			Entry & entry = entries[ sequence % entries.size() ];
+			return entry.valid && entry.sequence == sequence ? &entry.data : NULL;
+		}
+
+		const T * Find( unsigned int sequence ) const
+		{
+			const Entry & entry = entries[ sequence % entries.size() ];
+			return entry.valid && entry.sequence == sequence ? &entry.data : NULL;
+		}
+
+		int GetSize() const
 		{
-			if ( empty() )
+			return (int) entries.size();
+		}
+
+	private:
+
+		struct Entry
+		{
+			unsigned int sequence;
+			bool valid;
+			T data;
+		};
+
+		std::vector<Entry> entries;
+	};
+
+	// packet queue to store information about packets sorted in sequence order
+	//  + keeps the old list based interface, but it is a thin adapter over a sequence buffer so lookups are O(1)
+	//  + remembers the oldest and most recent sequence inserted, iteration walks that window and skips empty entries
+	//  + the window must fit in the buffer, 256 entries by default is plenty for the 32 packet ack window
+
+	class PacketQueue
+	{
+	public:
+
+		class const_iterator
+		{
+		public:
+
+			const_iterator( const PacketQueue * queue = NULL, unsigned int sequence = 0, int remaining = 0 )
 			{
-				push_back( p );
+				this->queue = queue;
+				this->sequence = sequence;
+				this->remaining = remaining;
 			}
-			else
+
+			const PacketData & operator * () const
 			{
-				if ( !sequence_more_recent( p.sequence, front().sequence, max_sequence ) )
-				{
-					push_front( p );
-				}
-				else if ( sequence_more_recent( p.sequence, back().sequence, max_sequence ) )
-				{
-					push_back( p );
-				}
-				else
-				{
-					for ( PacketQueue::iterator itor = begin(); itor != end(); itor++ )
-					{
-						assert( itor->sequence != p.sequence );
-						if ( sequence_more_recent( itor->sequence, p.sequence, max_sequence ) )
-						{
-							insert( itor, p );
-							break;
-						}
-					}
-				}
+				return *queue->buffer.Find( sequence );
+			}
+
+			const PacketData * operator -> () const
+			{
+				return queue->buffer.Find( sequence );
+			}
+
+			const_iterator & operator ++ ()
+			{
+				assert( remaining > 0 );
+				if ( --remaining > 0 )
+					sequence = queue->next_entry( sequence );
+				return *this;
+			}
+
+			const_iterator operator ++ ( int )
+			{
+				const_iterator previous = *this;
+				++(*this);
+				return previous;
+			}
+
+			bool operator == ( const const_iterator & other ) const
+			{
+				return remaining == other.remaining && ( remaining == 0 || sequence == other.sequence );
 			}
+
+			bool operator != ( const const_iterator & other ) const
+			{
+				return !( *this == other );
+			}
+
+		private:
+
+			const PacketQueue * queue;
+			unsigned int sequence;
+			int remaining;
+		};
+
+		typedef const_iterator iterator;
+
+		PacketQueue( int size = 256 )
+			: buffer( size )
+		{
+			max_sequence = 0xFFFFFFFF;
+			clear();
 		}
-		
-		void verify_sorted( unsigned int max_sequence )
+
+		void clear()
 		{
-			PacketQueue::iterator prev = end();
-			for ( PacketQueue::iterator itor = begin(); itor != end(); itor++ )
+			buffer.Reset();
+			count = 0;
+			oldest = 0;
+			newest = 0;
+		}
+
+		bool empty() const
+		{
+			return count == 0;
+		}
+
+		size_t size() const
+		{
+			return count;
+		}
+
+		bool exists( unsigned int sequence ) const
+		{
+			return buffer.Exists( sequence );
+		}
+
+		const PacketData * find( unsigned int sequence ) const
+		{
+			return buffer.Find( sequence );
+		}
+
+		void insert_sorted( const PacketData & p, unsigned int max_sequence )
+		{
+			assert( p.sequence <= max_sequence );
+			assert( max_sequence < (unsigned int) buffer.GetSize() || ( max_sequence + 1 ) % buffer.GetSize() == 0 );
+			assert( !exists( p.sequence ) );
+			this->max_sequence = max_sequence;
+			if ( count == 0 || sequence_more_recent( oldest, p.sequence, max_sequence ) )
+				oldest = p.sequence;
+			if ( count == 0 || sequence_more_recent( p.sequence, newest, max_sequence ) )
+				newest = p.sequence;
+			assert( ( newest >= oldest ? newest - oldest : max_sequence - oldest + newest + 1 ) < (unsigned int) buffer.GetSize() );
+			*buffer.Insert( p.sequence ) = p;
+			count++;
+		}
+
+		void erase( unsigned int sequence )
+		{
+			assert( exists( sequence ) );
+			buffer.Remove( sequence );
+			if ( --count == 0 )
+				return;
+			if ( sequence == oldest )
+				oldest = next_entry( oldest );
+			if ( sequence == newest )
+			{
+				do
+					newest = newest == 0 ? max_sequence : newest - 1;
+				while ( !buffer.Exists( newest ) );
+			}
+		}
+
+		void verify_sorted( unsigned int max_sequence ) const
+		{
+			const_iterator prev = end();
+			for ( const_iterator itor = begin(); itor != end(); itor++ )
 			{
 				assert( itor->sequence <= max_sequence );
 				if ( prev != end() )
-				{
 					assert( sequence_more_recent( itor->sequence, prev->sequence, max_sequence ) );
-					prev = itor;
+				prev = itor;
+			}
+		}
+
+		const_iterator begin() const
+		{
+			return const_iterator( this, oldest, count );
+		}
+
+		const_iterator end() const
+		{
+			return const_iterator( this );
+		}
+
+		const SequenceBuffer<PacketData> & get_buffer() const
+		{
+			return buffer;
+		}
+
+	private:
+
+		unsigned int next_entry( unsigned int sequence ) const
+		{
+			do
+				sequence = sequence == max_sequence ? 0 : sequence + 1;
+			while ( !buffer.Exists( sequence ) );
+			return sequence;
+		}
+
+		SequenceBuffer<PacketData> buffer;
+		unsigned int max_sequence;
+		unsigned int oldest;
+		unsigned int newest;
+		int count;
+	};
+
+	// sent packet data stored in the sent packet sequence buffer
+
+	struct SentPacketData
+	{
+		double time;					// time the packet was sent (reliability system clock)
+		int size;						// packet size in bytes
+		bool pending;					// true while waiting for an ack (until rtt_maximum)
+		bool acked;						// true once the packet has been acked
+		bool lost;						// true once it went unacked past the loss timeout, a late ack is then only an rtt sample
+	};
+
+	// round trip time estimates, updated with each rtt sample
+	//  + smoothed rtt and rtt variance as in RFC 6298, so the loss timeout follows the path instead of a constant
+	//  + jitter as in RFC 3550: smoothed difference between consecutive samples
+	//  + min rtt over a sliding window of two periods, so it recovers if the path gets longer
+
+	struct RoundTripStats
+	{
+		RoundTripStats()
+		{
+			Reset();
+		}
+
+		void Reset()
+		{
+			samples = 0;
+			srtt = 0.0f;
+			rttvar = 0.0f;
+			jitter = 0.0f;
+			last_rtt = 0.0f;
+			min_rtt = 0.0f;
+			previous_min_rtt = 0.0f;
+			min_rtt_time = 0.0;
+		}
+
+		void AddSample( float rtt, double time )
+		{
+			const float MinRttPeriod = 10.0f;
+
+			if ( samples == 0 )
+			{
+				srtt = rtt;
+				rttvar = rtt * 0.5f;
+				min_rtt = rtt;
+				previous_min_rtt = rtt;
+				min_rtt_time = time;
+			}
+			else
+			{
+				rttvar += ( fabs( srtt - rtt ) - rttvar ) * 0.25f;
+				srtt += ( rtt - srtt ) * 0.125f;
+				jitter += ( fabs( rtt - last_rtt ) - jitter ) * 0.0625f;
+				if ( time - min_rtt_time > MinRttPeriod )
+				{
+					previous_min_rtt = min_rtt;
+					min_rtt = rtt;
+					min_rtt_time = time;
 				}
+				else if ( rtt < min_rtt )
+					min_rtt = rtt;
 			}
+			last_rtt = rtt;
+			samples++;
+		}
+
+		float GetMinRtt() const
+		{
+			return std::min( min_rtt, previous_min_rtt );
 		}
+
+		unsigned int samples;			// number of rtt samples taken
+		float srtt;						// smoothed rtt
+		float rttvar;					// smoothed mean deviation of rtt samples from srtt
+		float jitter;					// smoothed difference between consecutive rtt samples
+		float last_rtt;					// most recent rtt sample
+		float min_rtt;					// lowest rtt sample in the current period
+		float previous_min_rtt;			// lowest rtt sample in the previous period
+		double min_rtt_time;			// time the current min rtt period started
 	};
 
 	// reliability system to support reliable connection
-	//  + manages sent, received, pending ack and acked packet queues
+	//  + tracks sent and received packets in sequence buffers, so sending, receiving and acking never allocate
+	//  + sent packets are kept until rtt_maximum * 2 for bandwidth stats, received packets for ack bits and duplicate detection
+	//  + sent packets are stamped with the time they were sent, so aging them costs nothing per update
+	//  + sent and acked bandwidth come from running byte counters, updated as packets cross the rtt_maximum boundaries
+	//  + a packet is lost once it goes unacked past the loss timeout: srtt + 4 * rttvar, capped at rtt_maximum
+	//  + a late ack for a packet already counted lost is only an rtt sample, so a packet is never both lost and acked,
+	//    but a queue building up on the path still shows in the rtt
 	//  + separated out from reliable connection because it is quite complex and i want to unit test it!
 	
 	class ReliabilitySystem
 	{
 	public:
 		
+		enum
+		{
+			SentBufferSize = 1024,
+			ReceivedBufferSize = 256
+		};
+		
 		ReliabilitySystem( unsigned int max_sequence = 0xFFFFFFFF )
+			: sentBuffer( buffer_size( SentBufferSize, max_sequence ) ), 
+			  receivedBuffer( buffer_size( ReceivedBufferSize, max_sequence ) )
 		{
 			this->rtt_maximum = rtt_maximum;
 			this->max_sequence = max_sequence;
+			acks.reserve( SentBufferSize );
 			Reset();
 		}
 		
@@ -109,70 +398,88 @@ namespace net
 		{
 			local_sequence = 0;
 			remote_sequence = 0;
-			sentQueue.clear();
-			receivedQueue.clear();
-			pendingAckQueue.clear();
-			ackedQueue.clear();
+			sent_tail = 0;
+			window_tail = 0;
+			loss_tail = 0;
+			time = 0.0;
+			deltaTime = 0.0f;
+			sent_bytes = 0;
+			acked_bytes = 0;
+			sentBuffer.Reset();
+			receivedBuffer.Reset();
+			acks.clear();
 			sent_packets = 0;
 			recv_packets = 0;
 			lost_packets = 0;
 			acked_packets = 0;
 			sent_bandwidth = 0.0f;
 			acked_bandwidth = 0.0f;
-			rtt = 0.0f;
+			rtt_stats.Reset();
 			rtt_maximum = 1.0f;
 		}
 		
-		void PacketSent( int size )
+		// note: time offsets say how long after the last update a packet was really sent, or its ack really
+		// arrived (negative for before), when that is known more precisely than the time of the last update
+
+		void PacketSent( int size, float timeOffset = 0.0f )
 		{
-			if ( sentQueue.exists( local_sequence ) )
-			{
-				printf( "local sequence %d exists\n", local_sequence );				
-				for ( PacketQueue::iterator itor = sentQueue.begin(); itor != sentQueue.end(); ++itor )
-					printf( " + %d\n", itor->sequence );
-			}
-			assert( !sentQueue.exists( local_sequence ) );
-			assert( !pendingAckQueue.exists( local_sequence ) );
-			PacketData data;
-			data.sequence = local_sequence;
-			data.time = 0.0f;
-			data.size = size;
-			sentQueue.push_back( data );
-			pendingAckQueue.push_back( data );
+			// note: one entry is kept free so a full window is never mistaken for an empty one when the buffer covers every sequence
+			while ( sequence_distance( sent_tail, local_sequence, max_sequence ) >= (unsigned int) sentBuffer.GetSize() - 1 )
+				RetireOldestSent();
+			assert( !sentBuffer.Exists( local_sequence ) );
+			SentPacketData * data = sentBuffer.Insert( local_sequence );
+			data->time = time + timeOffset;
+			data->size = size;
+			data->pending = true;
+			data->acked = false;
+			data->lost = false;
 			sent_packets++;
-			local_sequence++;
-			if ( local_sequence > max_sequence )
-				local_sequence = 0;
+			sent_bytes += size;
+			local_sequence = next_sequence( local_sequence, max_sequence );
 		}
 		
 		void PacketReceived( unsigned int sequence, int size )
 		{
 			recv_packets++;
-			if ( receivedQueue.exists( sequence ) )
-				return;
-			PacketData data;
-			data.sequence = sequence;
-			data.time = 0.0f;
-			data.size = size;
-			receivedQueue.push_back( data );
 			if ( sequence_more_recent( sequence, remote_sequence, max_sequence ) )
+			{
+				// clear out entries left over from the previous lap between the old and new most recent sequence
+				const unsigned int gap = sequence_distance( remote_sequence, sequence, max_sequence );
+				const unsigned int count = std::min( gap, (unsigned int) receivedBuffer.GetSize() );
+				for ( unsigned int i = 0; i < count; ++i )
+					receivedBuffer.Clear( previous_sequence( sequence, i, max_sequence ) );
 				remote_sequence = sequence;
+			}
+			else if ( receivedBuffer.Exists( sequence ) )
+			{
+				// duplicate
+				return;
+			}
+			else if ( sequence_distance( sequence, remote_sequence, max_sequence ) >= (unsigned int) receivedBuffer.GetSize() )
+			{
+				// too old to ack or detect duplicates
+				return;
+			}
+			PacketData * data = receivedBuffer.Insert( sequence );
+			data->sequence = sequence;
+			data->size = size;
 		}
 
 		unsigned int GenerateAckBits()
 		{
-			return generate_ack_bits( GetRemoteSequence(), receivedQueue, max_sequence );
+			return generate_ack_bits( GetRemoteSequence(), receivedBuffer, max_sequence );
 		}
 		
-		void ProcessAck( unsigned int ack, unsigned int ack_bits )
+		void ProcessAck( unsigned int ack, unsigned int ack_bits, float timeOffset = 0.0f )
 		{
-			process_ack( ack, ack_bits, pendingAckQueue, ackedQueue, acks, acked_packets, rtt, max_sequence );
+			process_ack( ack, ack_bits, sentBuffer, time + timeOffset, acks, acked_packets, rtt_stats, max_sequence );
 		}
 				
 		void Update( float deltaTime )
 		{
 			acks.clear();
-			AdvanceQueueTime( deltaTime );
+			time += deltaTime;
+			this->deltaTime = deltaTime;
 			UpdateQueues();
 			UpdateStats();
 			#ifdef NET_UNIT_TEST
@@ -182,10 +489,30 @@ namespace net
 		
 		void Validate()
 		{
-			sentQueue.verify_sorted( max_sequence );
-			receivedQueue.verify_sorted( max_sequence );
-			pendingAckQueue.verify_sorted( max_sequence );
-			ackedQueue.verify_sorted( max_sequence );
+			const unsigned int sent_window = sequence_distance( sent_tail, local_sequence, max_sequence );
+			assert( sent_window < (unsigned int) sentBuffer.GetSize() );
+			assert( sequence_distance( sent_tail, window_tail, max_sequence ) <= sent_window );
+			assert( sequence_distance( sent_tail, window_tail, max_sequence ) <= sequence_distance( sent_tail, loss_tail, max_sequence ) );
+			assert( sequence_distance( sent_tail, loss_tail, max_sequence ) <= sent_window );
+			int window_sent_bytes = 0;
+			int window_acked_bytes = 0;
+			for ( unsigned int sequence = sent_tail; sequence != window_tail; sequence = next_sequence( sequence, max_sequence ) )
+			{
+				const SentPacketData * data = sentBuffer.Find( sequence );
+				if ( data && data->acked )
+					window_acked_bytes += data->size;
+			}
+			for ( unsigned int sequence = window_tail; sequence != local_sequence; sequence = next_sequence( sequence, max_sequence ) )
+			{
+				const SentPacketData * data = sentBuffer.Find( sequence );
+				assert( data );
+				assert( !( data->pending && data->acked ) );
+				assert( !( data->lost && data->acked ) );
+				window_sent_bytes += data->size;
+			}
+
+			assert( window_sent_bytes == sent_bytes );
+			assert( window_acked_bytes == acked_bytes );
 		}
 
 		// utility functions
@@ -195,6 +522,32 @@ namespace net
 			return ( s1 > s2 ) && ( s1 - s2 <= max_sequence/2 ) || ( s2 > s1 ) && ( s2 - s1 > max_sequence/2 );
 		}
 		
+		static unsigned int next_sequence( unsigned int sequence, unsigned int max_sequence )
+		{
+			return sequence == max_sequence ? 0 : sequence + 1;
+		}
+		
+		static unsigned int sequence_distance( unsigned int from, unsigned int to, unsigned int max_sequence )
+		{
+			// number of steps forward from "from" to reach "to", allowing for wrap around
+			return to >= from ? to - from : ( max_sequence - from ) + to + 1;
+		}
+		
+		static unsigned int previous_sequence( unsigned int sequence, unsigned int n, unsigned int max_sequence )
+		{
+			// sequence n steps back from "sequence", allowing for wrap around
+			return sequence >= n ? sequence - n : max_sequence - ( n - sequence - 1 );
+		}
+		
+		static int buffer_size( int size, unsigned int max_sequence )
+		{
+			assert( ( size & ( size - 1 ) ) == 0 );
+			if ( max_sequence < (unsigned int) size )
+				return (int) max_sequence + 1;
+			assert( ( max_sequence + 1 ) % size == 0 );
+			return size;
+		}
+		
 		static int bit_index_for_sequence( unsigned int sequence, unsigned int ack, unsigned int max_sequence )
 		{
 			assert( sequence != ack );
@@ -213,56 +566,90 @@ namespace net
 			}
 		}
 		
-		static unsigned int generate_ack_bits( unsigned int ack, const PacketQueue & received_queue, unsigned int max_sequence )
+		static unsigned int sequence_for_bit_index( unsigned int ack, int bit_index, unsigned int max_sequence )
+		{
+			assert( bit_index >= 0 );
+			assert( bit_index <= 31 );
+			return previous_sequence( ack, bit_index + 1, max_sequence );
+		}
+		
+		static unsigned int generate_ack_bits( unsigned int ack, const SequenceBuffer<PacketData> & received_buffer, unsigned int max_sequence )
 		{
 			unsigned int ack_bits = 0;
-			for ( PacketQueue::const_iterator itor = received_queue.begin(); itor != received_queue.end(); itor++ )
+			for ( int bit_index = 0; bit_index <= 31; ++bit_index )
 			{
-				if ( itor->sequence == ack || sequence_more_recent( itor->sequence, ack, max_sequence ) )
+				unsigned int sequence = sequence_for_bit_index( ack, bit_index, max_sequence );
+				if ( sequence == ack || sequence_more_recent( sequence, ack, max_sequence ) )
 					break;
-				int bit_index = bit_index_for_sequence( itor->sequence, ack, max_sequence );
-				if ( bit_index <= 31 )
+				if ( received_buffer.Exists( sequence ) )
 					ack_bits |= 1 << bit_index;
 			}
 			return ack_bits;
 		}
 		
+		static unsigned int generate_ack_bits( unsigned int ack, const PacketQueue & received_queue, unsigned int max_sequence )
+		{
+			return generate_ack_bits( ack, received_queue.get_buffer(), max_sequence );
+		}
+		
 		static void process_ack( unsigned int ack, unsigned int ack_bits, 
 								 PacketQueue & pending_ack_queue, PacketQueue & acked_queue, 
 								 std::vector<unsigned int> & acks, unsigned int & acked_packets, 
-								 float & rtt, unsigned int max_sequence )
+								 unsigned int max_sequence )
 		{
-			if ( pending_ack_queue.empty() )
-				return;
-				
-			PacketQueue::iterator itor = pending_ack_queue.begin();
-			while ( itor != pending_ack_queue.end() )
+			// queue adapter: ack the pending packets through a sent buffer, then move whatever was acked across
+
+			SequenceBuffer<SentPacketData> sent_buffer( pending_ack_queue.get_buffer().GetSize() );
+			for ( PacketQueue::const_iterator itor = pending_ack_queue.begin(); itor != pending_ack_queue.end(); ++itor )
 			{
-				bool acked = false;
-				
-				if ( itor->sequence == ack )
-				{
-					acked = true;
-				}
-				else if ( !sequence_more_recent( itor->sequence, ack, max_sequence ) )
-				{
-					int bit_index = bit_index_for_sequence( itor->sequence, ack, max_sequence );
-					if ( bit_index <= 31 )
-						acked = ( ack_bits >> bit_index ) & 1;
-				}
-				
-				if ( acked )
+				SentPacketData * data = sent_buffer.Insert( itor->sequence );
+				data->time = 0.0;
+				data->size = itor->size;
+				data->pending = true;
+				data->acked = false;
+				data->lost = false;
+			}
+			RoundTripStats rtt;
+			const unsigned int first = (unsigned int) acks.size();
+			process_ack( ack, ack_bits, sent_buffer, 0.0, acks, acked_packets, rtt, max_sequence );
+			for ( unsigned int i = first; i < acks.size(); ++i )
+			{
+				acked_queue.insert_sorted( *pending_ack_queue.find( acks[i] ), max_sequence );
+				pending_ack_queue.erase( acks[i] );
+			}
+		}
+		
+		static void process_ack( unsigned int ack, unsigned int ack_bits, 
+								 SequenceBuffer<SentPacketData> & sent_buffer, double time,
+								 std::vector<unsigned int> & acks, unsigned int & acked_packets, 
+								 RoundTripStats & rtt, unsigned int max_sequence )
+		{
+			// walk the ack bits oldest first so acks come out in sequence order
+			for ( int bit_index = 31; bit_index >= 0; --bit_index )
+			{
+				if ( ( ack_bits >> bit_index ) & 1 )
 				{
-					rtt += ( itor->time - rtt ) * 0.1f;
-
-					acked_queue.insert_sorted( *itor, max_sequence );
-					acks.push_back( itor->sequence );
-					acked_packets++;
-					itor = pending_ack_queue.erase( itor );
+					unsigned int sequence = sequence_for_bit_index( ack, bit_index, max_sequence );
+					if ( sequence != ack && !sequence_more_recent( sequence, ack, max_sequence ) )
+						ack_packet( sequence, sent_buffer, time, acks, acked_packets, rtt );
 				}
-				else
-					++itor;
 			}
+			ack_packet( ack, sent_buffer, time, acks, acked_packets, rtt );
+		}
+		
+		static void ack_packet( unsigned int sequence, SequenceBuffer<SentPacketData> & sent_buffer, double time,
+								std::vector<unsigned int> & acks, unsigned int & acked_packets, RoundTripStats & rtt )
+		{
+			SentPacketData * data = sent_buffer.Find( sequence );
+			if ( !data || !data->pending )
+				return;
+			rtt.AddSample( (float) std::max( time - data->time, 0.0 ), time );
+			data->pending = false;
+			if ( data->lost )
+				return;
+			data->acked = true;
+			acks.push_back( sequence );
+			acked_packets++;
 		}
 		
 		// data accessors
@@ -320,75 +707,121 @@ namespace net
 
 		float GetRoundTripTime() const
 		{
-			return rtt;
+			return rtt_stats.srtt;
 		}
-		
-		int GetHeaderSize() const
+
+		float GetRoundTripTimeVariance() const
 		{
-			return 12;
+			return rtt_stats.rttvar;
 		}
 
-	protected:
-		
-		void AdvanceQueueTime( float deltaTime )
+		float GetJitter() const
 		{
-			for ( PacketQueue::iterator itor = sentQueue.begin(); itor != sentQueue.end(); itor++ )
-				itor->time += deltaTime;
+			return rtt_stats.jitter;
+		}
 
-			for ( PacketQueue::iterator itor = receivedQueue.begin(); itor != receivedQueue.end(); itor++ )
-				itor->time += deltaTime;
+		float GetMinRoundTripTime() const
+		{
+			return rtt_stats.GetMinRtt();
+		}
 
-			for ( PacketQueue::iterator itor = pendingAckQueue.begin(); itor != pendingAckQueue.end(); itor++ )
-				itor->time += deltaTime;
+		float GetLossTimeout() const
+		{
+			// note: until the first rtt sample there is nothing to go on, so wait the full rtt_maximum.
+			// rttvar can settle to zero on a steady link, so allow at least one update of slack
 
-			for ( PacketQueue::iterator itor = ackedQueue.begin(); itor != ackedQueue.end(); itor++ )
-				itor->time += deltaTime;
+			if ( rtt_stats.samples == 0 )
+				return rtt_maximum;
+			const float timeout = rtt_stats.srtt + std::max( 4 * rtt_stats.rttvar, deltaTime );
+			return std::min( timeout, rtt_maximum );
 		}
 		
+		int GetHeaderSize() const
+		{
+			return 12;
+		}
+
+	protected:
+		
 		void UpdateQueues()
 		{
-			const float epsilon = 0.001f;
+			// note: each sent packet crosses each boundary exactly once, so the cost here is proportional to packets sent, not to the size of the window
 
-			while ( sentQueue.size() && sentQueue.front().time > rtt_maximum + epsilon )
-				sentQueue.pop_front();
+			const double epsilon = 0.001;
 
-			if ( receivedQueue.size() )
+			const float loss_timeout = GetLossTimeout();
+
+			while ( loss_tail != local_sequence )
 			{
-				const unsigned int latest_sequence = receivedQueue.back().sequence;
-				const unsigned int minimum_sequence = latest_sequence >= 34 ? ( latest_sequence - 34 ) : max_sequence - ( 34 - latest_sequence );
-				while ( receivedQueue.size() && !sequence_more_recent( receivedQueue.front().sequence, minimum_sequence, max_sequence ) )
-					receivedQueue.pop_front();
+				SentPacketData * data = sentBuffer.Find( loss_tail );
+				if ( data && time - data->time <= loss_timeout + epsilon )
+					break;
+				if ( data && data->pending )
+				{
+					data->lost = true;
+					lost_packets++;
+				}
+				loss_tail = next_sequence( loss_tail, max_sequence );
 			}
 
-			while ( ackedQueue.size() && ackedQueue.front().time > rtt_maximum * 2 - epsilon )
-				ackedQueue.pop_front();
+			while ( window_tail != local_sequence )
+			{
+				SentPacketData * data = sentBuffer.Find( window_tail );
+				if ( data && time - data->time <= rtt_maximum + epsilon )
+					break;
+				assert( window_tail != loss_tail );
+				if ( data )
+				{
+					data->pending = false;
+					sent_bytes -= data->size;
+					if ( data->acked )
+						acked_bytes += data->size;
+				}
+				window_tail = next_sequence( window_tail, max_sequence );
+			}
 
-			while ( pendingAckQueue.size() && pendingAckQueue.front().time > rtt_maximum + epsilon )
+			while ( sent_tail != window_tail )
 			{
-				pendingAckQueue.pop_front();
-				lost_packets++;
+				const SentPacketData * data = sentBuffer.Find( sent_tail );
+				if ( data && time - data->time <= rtt_maximum * 2 - epsilon )
+					break;
+				if ( data && data->acked )
+					acked_bytes -= data->size;
+				sentBuffer.Remove( sent_tail );
+				sent_tail = next_sequence( sent_tail, max_sequence );
 			}
 		}
 		
 		void UpdateStats()
 		{
-			int sent_bytes_per_second = 0;
-			for ( PacketQueue::iterator itor = sentQueue.begin(); itor != sentQueue.end(); ++itor )
-				sent_bytes_per_second += itor->size;
-			int acked_packets_per_second = 0;
-			int acked_bytes_per_second = 0;
-			for ( PacketQueue::iterator itor = ackedQueue.begin(); itor != ackedQueue.end(); ++itor )
+			assert( sent_bytes >= 0 );
+			assert( acked_bytes >= 0 );
+			sent_bandwidth = sent_bytes / rtt_maximum * ( 8 / 1000.0f );
+			acked_bandwidth = acked_bytes / rtt_maximum * ( 8 / 1000.0f );
+		}
+		
+		void RetireOldestSent()
+		{
+			// sent buffer is full: drop the oldest entry early, if it was still waiting for an ack it counts as lost
+			SentPacketData * data = sentBuffer.Find( sent_tail );
+			if ( window_tail == sent_tail )
 			{
-				if ( itor->time >= rtt_maximum )
+				if ( loss_tail == sent_tail )
 				{
-					acked_packets_per_second++;
-					acked_bytes_per_second += itor->size;
+					if ( data && data->pending )
+						lost_packets++;
+					loss_tail = next_sequence( loss_tail, max_sequence );
 				}
+				if ( data )
+					sent_bytes -= data->size;
+				window_tail = next_sequence( window_tail, max_sequence );
+			}
+			else if ( data && data->acked )
+			{
+				acked_bytes -= data->size;
 			}
-			sent_bytes_per_second /= rtt_maximum;
-			acked_bytes_per_second /= rtt_maximum;
-			sent_bandwidth = sent_bytes_per_second * ( 8 / 1000.0f );
-			acked_bandwidth = acked_bytes_per_second * ( 8 / 1000.0f );
+			sentBuffer.Remove( sent_tail );
+			sent_tail = next_sequence( sent_tail, max_sequence );
 		}
 		
 	private:
@@ -396,6 +829,13 @@ namespace net
 		unsigned int max_sequence;			// maximum sequence value before wrap around (used to test sequence wrap at low # values)
 		unsigned int local_sequence;		// local sequence number for most recently sent packet
 		unsigned int remote_sequence;		// remote sequence number for most recently received packet
+		unsigned int sent_tail;				// oldest sequence still held in the sent buffer (kept until rtt_maximum * 2)
+		unsigned int window_tail;			// oldest sequence in the sent bandwidth window (kept until rtt_maximum)
+		unsigned int loss_tail;				// oldest sequence that may still be pending ack (kept until the loss timeout)
+		double time;						// current time, advanced each update. sent packets are stamped with this
+		float deltaTime;					// time step of the last update, the clock granularity for the loss timeout
+		int sent_bytes;						// bytes sent within the last rtt_maximum (packets from window_tail to local_sequence)
+		int acked_bytes;					// bytes acked between rtt_maximum and rtt_maximum * 2 ago (acked packets from sent_tail to window_tail)
 		
 		unsigned int sent_packets;			// total number of packets sent
 		unsigned int recv_packets;			// total number of packets received
@@ -404,15 +844,13 @@ namespace net
 
 		float sent_bandwidth;				// approximate sent bandwidth over the last second
 		float acked_bandwidth;				// approximate acked bandwidth over the last second
-		float rtt;							// estimated round trip time
+		RoundTripStats rtt_stats;			// smoothed rtt, rtt variance, jitter and min rtt
 		float rtt_maximum;					// maximum expected round trip time (hard coded to one second for the moment)
 
 		std::vector<unsigned int> acks;		// acked packets from last set of packet receives. cleared each update!
 
-		PacketQueue sentQueue;				// sent packets used to calculate sent bandwidth (kept until rtt_maximum)
-		PacketQueue pendingAckQueue;		// sent packets which have not been acked yet (kept until rtt_maximum * 2 )
-		PacketQueue receivedQueue;			// received packets for determining acks to send (kept up to most recent recv sequence - 32)
-		PacketQueue ackedQueue;				// acked packets (kept until rtt_maximum * 2)
+		SequenceBuffer<SentPacketData> sentBuffer;		// sent packets, pending ack until the loss timeout and kept for bandwidth stats until rtt_maximum * 2
+		SequenceBuffer<PacketData> receivedBuffer;		// received packets for generating ack bits and detecting duplicates
 	};
 }
 
@@ -15,6 +15,7 @@ namespace net
 	{
 		Transport_None,
 		Transport_LAN,
+		Transport_Loopback,
 		Transport_RakNet,
 		Transport_OpenTNL,
 		Transport_eNet
@@ -64,6 +65,10 @@ namespace net
 	//  + lan lobby is filled via net listener
 	//  + a mesh runs on the server IP and manages node connections
 	//  + a node runs on each transport, for the server with the mesh a local node also runs
+	//  + optionally packets carry a 12 byte header with sequence and acks, for a reliability system per remote node.
+	//    off by default, so packets go out exactly as they are sent
+	//  + optionally the node socket runs on its own i/o thread, so a long frame doesn't delay receives and inflate rtt.
+	//    rtt then uses the time packets were really sent and received, so pass the real frame time to update
 	
 	class TransportLAN : public Transport
 	{
@@ -95,6 +100,8 @@ namespace net
 			float meshSendRate;
 			float timeout;
 			int maxNodes;
+			bool reliability;
+			bool ioThread;
 			
 			Config()
 			{
@@ -107,6 +114,8 @@ namespace net
 				meshSendRate = 0.25f;
 				timeout = 10.0f;
 				maxNodes = 4;
+				reliability = false;
+				ioThread = false;
 			}
 		};
 		
@@ -162,12 +171,94 @@ namespace net
 		class Beacon * beacon;
 		class Listener * listener;
 		float beaconAccumulator;
+		struct LANPeer * peers;
+		int peerCount;
+		double updateTime;
 
 		bool connectingByName;
 		char connectName[65];
 		float connectAccumulator;
 		bool connectFailed;
 	};
+
+	// loopback transport implementation
+	//  + every node lives in this process and sends through lock-free in-memory queues, no sockets
+	//  + the first node to start creates the loopback network, the last one to stop destroys it
+	//  + link settings add latency, jitter, loss etc. from a seeded generator, so runs are repeatable
+	//  + packets carry a sequence and acks, with a reliability system per remote node
+
+	class TransportLoopback : public Transport
+	{
+	public:
+
+		// static interface
+
+		static bool Initialize();
+
+		static void Shutdown();
+
+		static void UnitTest();
+
+		// loopback specific interface
+
+		TransportLoopback();
+		~TransportLoopback();
+
+		struct Config
+		{
+			int maxNodes;
+			int maxPacketSize;
+			int queueSize;
+			unsigned int seed;
+
+			Config()
+			{
+				maxNodes = 64;
+				maxPacketSize = 1024;
+				queueSize = 1024;
+				seed = 1;
+			}
+		};
+
+		void Configure( Config & config );
+
+		const Config & GetConfig() const;
+
+		bool Start();
+
+		void Stop();
+
+		bool IsRunning() const;
+
+		void SetLinkSettings( const struct LinkSettings & settings );
+
+		void SetLinkSettings( int nodeId, const struct LinkSettings & settings );
+
+		// implement transport interface
+
+		bool IsNodeConnected( int nodeId );
+
+		int GetLocalNodeId() const;
+
+		int GetMaxNodes() const;
+
+		bool SendPacket( int nodeId, const unsigned char data[], int size );
+
+		int ReceivePacket( int & nodeId, unsigned char data[], int size );
+
+		class ReliabilitySystem & GetReliability( int nodeId );
+
+		void Update( float deltaTime );
+
+		TransportType GetType() const;
+
+	private:
+
+		Config config;
+		class LoopbackNetwork * network;
+		class LoopbackNode * node;
+		struct LoopbackPeer * peers;
+	};
 }
 
 #endif
@@ -9,5 +9,6 @@
 int main( int argc, char * argv[] )
 {
 	net::TransportLAN::UnitTest();
+	net::TransportLoopback::UnitTest();
 	return 0;
 }
@@ -0,0 +1,216 @@
+/*
+	Simple Network Library from "Networking for Game Programmers"
+	http://www.gaffer.org/networking-for-game-programmers
+	Author: Glenn Fiedler <gaffer@gaffer.org>
+*/
+
+#ifndef NET_LAN_ADDRESS_H
+#define NET_LAN_ADDRESS_H
+
+#include <assert.h>
+#include <vector>
+
+namespace net
+{
+	// internet address
+
+	class Address
+	{
+	public:
+	
+		Address()
+		{
+			address = 0;
+			port = 0;
+		}
+	
+		Address( unsigned char a, unsigned char b, unsigned char c, unsigned char d, unsigned short port )
+		{
+			this->address = ( a << 24 ) | ( b << 16 ) | ( c << 8 ) | d;
+			this->port = port;
+		}
+	
+		Address( unsigned int address, unsigned short port )
+		{
+			this->address = address;
+			this->port = port;
+		}
+	
+		unsigned int GetAddress() const
+		{
+			return address;
+		}
+	
+		unsigned char GetA() const
+		{
+			return ( unsigned char ) ( address >> 24 );
+		}
+	
+		unsigned char GetB() const
+		{
+			return ( unsigned char ) ( address >> 16 );
+		}
+	
+		unsigned char GetC() const
+		{
+			return ( unsigned char ) ( address >> 8 );
+		}
+	
+		unsigned char GetD() const
+		{
+			return ( unsigned char ) ( address );
+		}
+	
+		unsigned short GetPort() const
+		{ 
+			return port;
+		}
+	
+		bool operator == ( const Address & other ) const
+		{
+			return address == other.address && port == other.port;
+		}
+	
+		bool operator != ( const Address & other ) const
+		{
+			return ! ( *this == other );
+		}
+		
+		bool operator < ( const Address & other ) const
+		{
+			// note: this is so we can use address as a key in std::map
+			if ( address < other.address )
+				return true;
+			if ( address > other.address )
+				return false;
+			else
+				return port < other.port;
+		}
+	
+	private:
+	
+		unsigned int address;
+		unsigned short port;
+	};
+
+	// hash table mapping addresses to small integer indices (eg. client or node slots)
+	//  + open addressing with linear probing, sized to a power of two at least twice the capacity so probes stay short
+	//  + remove shifts later entries back into the hole, so there are no tombstones and no allocation after construction
+	
+	class AddressTable
+	{
+	public:
+		
+		AddressTable( int capacity )
+		{
+			assert( capacity > 0 );
+			this->capacity = capacity;
+			int size = 1;
+			while ( size < capacity * 2 )
+				size *= 2;
+			entries.resize( size );
+			mask = size - 1;
+			Clear();
+		}
+		
+		void Clear()
+		{
+			for ( int i = 0; i < (int) entries.size(); ++i )
+				entries[i].index = -1;
+			count = 0;
+		}
+		
+		bool Insert( const Address & address, int index )
+		{
+			assert( index >= 0 );
+			if ( count == capacity )
+				return false;
+			int slot = hash( address ) & mask;
+			while ( entries[slot].index != -1 )
+			{
+				if ( entries[slot].address == address )
+					return false;
+				slot = ( slot + 1 ) & mask;
+			}
+			entries[slot].address = address;
+			entries[slot].index = index;
+			count++;
+			return true;
+		}
+		
+		int Find( const Address & address ) const
+		{
+			int slot = hash( address ) & mask;
+			while ( entries[slot].index != -1 )
+			{
+				if ( entries[slot].address == address )
+					return entries[slot].index;
+				slot = ( slot + 1 ) & mask;
+			}
+			return -1;
+		}
+		
+		bool Remove( const Address & address )
+		{
+			int slot = hash( address ) & mask;
+			while ( entries[slot].address != address )
+			{
+				if ( entries[slot].index == -1 )
+					return false;
+				slot = ( slot + 1 ) & mask;
+			}
+			if ( entries[slot].index == -1 )
+				return false;
+			// shift back any following entries whose probe sequence passes through the hole
+			int hole = slot;
+			int next = slot;
+			while ( true )
+			{
+				next = ( next + 1 ) & mask;
+				if ( entries[next].index == -1 )
+					break;
+				const int home = hash( entries[next].address ) & mask;
+				if ( ( ( next - home ) & mask ) >= ( ( next - hole ) & mask ) )
+				{
+					entries[hole] = entries[next];
+					hole = next;
+				}
+			}
+			entries[hole].index = -1;
+			count--;
+			return true;
+		}
+		
+		int GetCount() const
+		{
+			return count;
+		}
+		
+		int GetCapacity() const
+		{
+			return capacity;
+		}
+		
+	private:
+		
+		static int hash( const Address & address )
+		{
+			unsigned int h = address.GetAddress() * 0x9E3779B1 ^ address.GetPort() * 0x85EBCA6B;
+			h ^= h >> 16;
+			return (int) ( h & 0x7FFFFFFF );
+		}
+		
+		struct Entry
+		{
+			Address address;
+			int index;			// -1 if the entry is empty
+		};
+		
+		std::vector<Entry> entries;
+		int mask;
+		int count;
+		int capacity;
+	};
+}
+
+#endif
@@ -10,6 +10,8 @@
 #include "NetSockets.h"
 #include "../NetReliability.h"
 
+#include <vector>
+
 namespace net
 {
 	// virtual connection over UDP
@@ -32,6 +34,9 @@ namespace net
 			this->timeout = timeout;
 			mode = None;
 			running = false;
+			batchPacketSize = 0;
+			batchIndex = 0;
+			batchCount = 0;
 			ClearData();
 		}
 		
@@ -48,6 +53,8 @@ namespace net
 			if ( !socket.Open( port ) )
 				return false;
 			running = true;
+			batchIndex = 0;
+			batchCount = 0;
 			OnStart();
 			return true;
 		}
@@ -59,6 +66,8 @@ namespace net
 			bool connected = IsConnected();
 			ClearData();
 			socket.Close();
+			batchIndex = 0;
+			batchCount = 0;
 			running = false;
 			if ( connected )
 				OnDisconnect();
@@ -160,11 +169,25 @@ namespace net
 		virtual int ReceivePacket( unsigned char data[], int size )
 		{
 			assert( running );
-			unsigned char packet[size+4];
-			Address sender;
-			int bytes_read = socket.Receive( sender, packet, size + 4 );
-			if ( bytes_read == 0 )
+			// drain the socket a batch at a time, then hand out packets from the batch
+			if ( batchIndex == batchCount )
+			{
+				if ( size + 4 > batchPacketSize )
+				{
+					batchPacketSize = size + 4;
+					batchBuffer.resize( ReceiveBatchSize * batchPacketSize );
+					for ( int i = 0; i < ReceiveBatchSize; ++i )
+						batch[i].data = &batchBuffer[i*batchPacketSize];
+				}
+				batchIndex = 0;
+				batchCount = socket.ReceiveBatch( batch, ReceiveBatchSize, batchPacketSize );
+			}
+			if ( batchIndex == batchCount )
 				return 0;
+			const SocketPacket & received = batch[batchIndex++];
+			const Address & sender = received.address;
+			const unsigned char * packet = received.data;
+			int bytes_read = std::min( received.size, size + 4 );
 			if ( bytes_read <= 4 )
 				return 0;
 			if ( packet[0] != (unsigned char) ( protocolId >> 24 ) || 
@@ -234,6 +257,13 @@ namespace net
 		Socket socket;
 		float timeoutAccumulator;
 		Address address;
+
+		enum { ReceiveBatchSize = 32 };
+		std::vector<unsigned char> batchBuffer;
+		SocketPacket batch[ReceiveBatchSize];
+		int batchPacketSize;
+		int batchIndex;
+		int batchCount;
 	};
 	
 	// connection with reliability (seq/ack)
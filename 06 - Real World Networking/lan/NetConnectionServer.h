@@ -0,0 +1,302 @@
+/*
+	Simple Network Library from "Networking for Game Programmers"
+	http://www.gaffer.org/networking-for-game-programmers
+	Author: Glenn Fiedler <gaffer@gaffer.org>
+*/
+
+#ifndef NET_LAN_CONNECTION_SERVER_H
+#define NET_LAN_CONNECTION_SERVER_H
+
+#include "NetSockets.h"
+#include "../NetReliability.h"
+
+#include <assert.h>
+#include <vector>
+
+namespace net
+{
+	// server hosting many reliable connections over a single UDP socket
+	//  + packets are demultiplexed by sender address through a hashed address table
+	//  + each client slot runs its own reliability system, so acks, rtt and bandwidth are tracked per client
+	//  + packet format matches reliable connection, so a reliable connection client can connect to this server
+	//  + a new address is accepted as a client on its first valid packet, if there is a free slot
+	//  + one update advances timeouts and reliability for every client
+
+	class ConnectionServer
+	{
+	public:
+
+		ConnectionServer( unsigned int protocolId, float timeout, int maxClients, unsigned int max_sequence = 0xFFFFFFFF )
+			: addressTable( maxClients ), clients( maxClients, Client( max_sequence ) )
+		{
+			assert( maxClients >= 1 );
+			this->protocolId = protocolId;
+			this->timeout = timeout;
+			running = false;
+			batchPacketSize = 0;
+			batchIndex = 0;
+			batchCount = 0;
+			ClearData();
+		}
+
+		virtual ~ConnectionServer()
+		{
+			if ( IsRunning() )
+				Stop();
+		}
+
+		bool Start( int port )
+		{
+			assert( !running );
+			printf( "start connection server on port %d\n", port );
+			if ( !socket.Open( port ) )
+				return false;
+			running = true;
+			batchIndex = 0;
+			batchCount = 0;
+			return true;
+		}
+
+		void Stop()
+		{
+			assert( running );
+			printf( "stop connection server\n" );
+			for ( int i = 0; i < (int) clients.size(); ++i )
+			{
+				if ( clients[i].connected )
+					DisconnectClient( i );
+			}
+			ClearData();
+			socket.Close();
+			batchIndex = 0;
+			batchCount = 0;
+			running = false;
+		}
+
+		bool IsRunning() const
+		{
+			return running;
+		}
+
+		void Update( float deltaTime )
+		{
+			assert( running );
+			for ( int i = 0; i < (int) clients.size(); ++i )
+			{
+				Client & client = clients[i];
+				if ( !client.connected )
+					continue;
+				client.timeoutAccumulator += deltaTime;
+				if ( client.timeoutAccumulator > timeout )
+				{
+					printf( "connection server timed out client %d\n", i );
+					DisconnectClient( i );
+					continue;
+				}
+				client.reliabilitySystem.Update( deltaTime );
+			}
+		}
+
+		bool SendPacket( int clientIndex, const unsigned char data[], int size )
+		{
+			assert( running );
+			assert( clientIndex >= 0 );
+			assert( clientIndex < (int) clients.size() );
+			Client & client = clients[clientIndex];
+			if ( !client.connected )
+				return false;
+			ReliabilitySystem & reliabilitySystem = client.reliabilitySystem;
+			unsigned char packet[HeaderSize+size];
+			WriteInteger( packet, protocolId );
+			WriteInteger( packet + 4, reliabilitySystem.GetLocalSequence() );
+			WriteInteger( packet + 8, reliabilitySystem.GetRemoteSequence() );
+			WriteInteger( packet + 12, reliabilitySystem.GenerateAckBits() );
+			memcpy( packet + HeaderSize, data, size );
+			if ( !socket.Send( client.address, packet, size + HeaderSize ) )
+				return false;
+			reliabilitySystem.PacketSent( size );
+			return true;
+		}
+
+		int ReceivePacket( int & clientIndex, unsigned char data[], int size )
+		{
+			assert( running );
+			assert( size > 0 );
+			// drain the socket a batch at a time, skipping packets that are not for us
+			if ( size + HeaderSize > batchPacketSize )
+			{
+				batchPacketSize = size + HeaderSize;
+				batchBuffer.resize( ReceiveBatchSize * batchPacketSize );
+				for ( int i = 0; i < ReceiveBatchSize; ++i )
+					batch[i].data = &batchBuffer[i*batchPacketSize];
+				batchIndex = 0;
+				batchCount = 0;
+			}
+			while ( true )
+			{
+				if ( batchIndex == batchCount )
+				{
+					batchIndex = 0;
+					batchCount = socket.ReceiveBatch( batch, ReceiveBatchSize, batchPacketSize );
+					if ( batchCount == 0 )
+						return 0;
+				}
+				const SocketPacket & received = batch[batchIndex++];
+				const int bytes_read = std::min( received.size, size + HeaderSize );
+				if ( bytes_read <= HeaderSize )
+					continue;
+				unsigned int packet_protocolId = 0;
+				ReadInteger( received.data, packet_protocolId );
+				if ( packet_protocolId != protocolId )
+					continue;
+				int index = addressTable.Find( received.address );
+				if ( index == -1 )
+				{
+					index = ConnectClient( received.address );
+					if ( index == -1 )
+						continue;
+				}
+				Client & client = clients[index];
+				unsigned int packet_sequence = 0;
+				unsigned int packet_ack = 0;
+				unsigned int packet_ack_bits = 0;
+				ReadInteger( received.data + 4, packet_sequence );
+				ReadInteger( received.data + 8, packet_ack );
+				ReadInteger( received.data + 12, packet_ack_bits );
+				client.timeoutAccumulator = 0.0f;
+				client.reliabilitySystem.PacketReceived( packet_sequence, bytes_read - HeaderSize );
+				client.reliabilitySystem.ProcessAck( packet_ack, packet_ack_bits );
+				memcpy( data, received.data + HeaderSize, bytes_read - HeaderSize );
+				clientIndex = index;
+				return bytes_read - HeaderSize;
+			}
+		}
+
+		void DisconnectClient( int clientIndex )
+		{
+			assert( clientIndex >= 0 );
+			assert( clientIndex < (int) clients.size() );
+			Client & client = clients[clientIndex];
+			if ( !client.connected )
+				return;
+			addressTable.Remove( client.address );
+			client.connected = false;
+			client.address = Address();
+			client.timeoutAccumulator = 0.0f;
+			client.reliabilitySystem.Reset();
+			freeClients.push_back( clientIndex );
+			OnClientDisconnect( clientIndex );
+		}
+
+		int FindClient( const Address & address ) const
+		{
+			return addressTable.Find( address );
+		}
+
+		bool IsClientConnected( int clientIndex ) const
+		{
+			assert( clientIndex >= 0 );
+			assert( clientIndex < (int) clients.size() );
+			return clients[clientIndex].connected;
+		}
+
+		const Address & GetClientAddress( int clientIndex ) const
+		{
+			assert( clientIndex >= 0 );
+			assert( clientIndex < (int) clients.size() );
+			return clients[clientIndex].address;
+		}
+
+		ReliabilitySystem & GetReliabilitySystem( int clientIndex )
+		{
+			assert( clientIndex >= 0 );
+			assert( clientIndex < (int) clients.size() );
+			return clients[clientIndex].reliabilitySystem;
+		}
+
+		int GetClientCount() const
+		{
+			return addressTable.GetCount();
+		}
+
+		int GetMaxClients() const
+		{
+			return (int) clients.size();
+		}
+
+		int GetHeaderSize() const
+		{
+			return HeaderSize;
+		}
+
+	protected:
+
+		virtual void OnClientConnect( int clientIndex )		{}
+		virtual void OnClientDisconnect( int clientIndex )	{}
+
+	private:
+
+		int ConnectClient( const Address & address )
+		{
+			if ( freeClients.empty() )
+				return -1;
+			const int clientIndex = freeClients.back();
+			freeClients.pop_back();
+			Client & client = clients[clientIndex];
+			assert( !client.connected );
+			client.connected = true;
+			client.address = address;
+			client.timeoutAccumulator = 0.0f;
+			client.reliabilitySystem.Reset();
+			addressTable.Insert( address, clientIndex );
+			printf( "connection server accepts %d.%d.%d.%d:%d as client %d\n",
+				address.GetA(), address.GetB(), address.GetC(), address.GetD(), address.GetPort(), clientIndex );
+			OnClientConnect( clientIndex );
+			return clientIndex;
+		}
+
+		void ClearData()
+		{
+			addressTable.Clear();
+			freeClients.clear();
+			// note: free list is a stack, so push in reverse to hand out the lowest client index first
+			for ( int i = (int) clients.size() - 1; i >= 0; --i )
+			{
+				clients[i].connected = false;
+				clients[i].address = Address();
+				clients[i].timeoutAccumulator = 0.0f;
+				clients[i].reliabilitySystem.Reset();
+				freeClients.push_back( i );
+			}
+		}
+
+		enum { HeaderSize = 16 };				// protocol id + reliable connection header (seq, ack, ack bits)
+		enum { ReceiveBatchSize = 32 };
+
+		struct Client
+		{
+			Client( unsigned int max_sequence ) : reliabilitySystem( max_sequence ) {}
+			bool connected;
+			Address address;
+			float timeoutAccumulator;
+			ReliabilitySystem reliabilitySystem;
+		};
+
+		unsigned int protocolId;
+		float timeout;
+
+		bool running;
+		Socket socket;
+		AddressTable addressTable;
+		std::vector<Client> clients;
+		std::vector<int> freeClients;
+
+		std::vector<unsigned char> batchBuffer;
+		SocketPacket batch[ReceiveBatchSize];
+		int batchPacketSize;
+		int batchIndex;
+		int batchCount;
+	};
+}
+
+#endif
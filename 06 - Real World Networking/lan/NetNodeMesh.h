@@ -8,18 +8,32 @@
 #define NET_LAN_NODE_MESH_H
 
 #include "NetSockets.h"
+#include "NetSocketThread.h"
 #include "../NetReliability.h"
 
 #include <assert.h>
+#include <algorithm>
 #include <vector>
-#include <map>
-#include <stack>
 
 namespace net
 {
+	// node ids and the node count go over the wire as 16 bit values, but the mesh update
+	// packet carries 6 bytes per node, so the default mesh packet only has room for 255 nodes.
+	// a larger mesh must be given a larger max packet size, and so must each node joining it
+
+	const int MaxMeshNodes = 255;
+	const int MaxMeshNodeIds = 65536;
+
+	inline int GetMeshUpdatePacketSize( int maxNodes )
+	{
+		return 5 + 6 * maxNodes;
+	}
+
 	// node mesh
 	//  + manages node join and leave
 	//  + updates each node with set of currently joined nodes
+	//  + sender address maps to node slot through a hashed address table, free slots are kept on a stack
+	//  + the update packet sent to each node must fit in maxPacketSize, or the mesh fails to start
 	
 	class Mesh
 	{
@@ -39,31 +53,35 @@ namespace net
 			}
 		};
 		
+		enum { ReceiveBatchSize = 32 };
+
 		unsigned int protocolId;
 		float sendRate;
 		float timeout;
+		int maxPacketSize;
 
 		Socket socket;
 		std::vector<NodeState> nodes;
-		typedef std::map<int,NodeState*> IdToNode;
-		typedef std::map<Address,NodeState*> AddrToNode;
-		IdToNode id2node;
-		AddrToNode addr2node;
+		AddressTable addressTable;
+		std::vector<int> freeNodes;
 		bool running;
 		float sendAccumulator;
 				
 	public:
 
-		Mesh( unsigned int protocolId, int maxNodes = 255, float sendRate = 0.25f, float timeout = 10.0f )
+		Mesh( unsigned int protocolId, int maxNodes = MaxMeshNodes, float sendRate = 0.25f, float timeout = 10.0f, int maxPacketSize = GetMeshUpdatePacketSize( MaxMeshNodes ) )
+			: addressTable( maxNodes )
 		{
 			assert( maxNodes >= 1 );
-			assert( maxNodes <= 255 );
+			assert( maxNodes <= MaxMeshNodeIds );
 			this->protocolId = protocolId;
 			this->sendRate = sendRate;
 			this->timeout = timeout;
+			this->maxPacketSize = maxPacketSize;
 			nodes.resize( maxNodes );
 			running = false;
 			sendAccumulator = 0.0f;
+			ClearData();
 		}
 		
 		~Mesh()
@@ -76,6 +94,11 @@ namespace net
 		{
 			assert( !running );
 			printf( "start mesh on port %d\n", port );
+			if ( GetMeshUpdatePacketSize( (int) nodes.size() ) > maxPacketSize )
+			{
+				printf( "mesh update for %d nodes does not fit in %d byte packets\n", (int) nodes.size(), maxPacketSize );
+				return false;
+			}
 			if ( !socket.Open( port ) )
 				return false;
 			running = true;
@@ -87,12 +110,8 @@ namespace net
 			assert( running );
 			printf( "stop mesh\n" );
 			socket.Close();
-			id2node.clear();
-			addr2node.clear();
-			for ( unsigned int i = 0; i < nodes.size(); ++i )
-				nodes[i] = NodeState();
+			ClearData();
 			running = false;
-			sendAccumulator = 0.0f;
 		}	
 		
 		void Update( float deltaTime )
@@ -119,34 +138,49 @@ namespace net
 
 	    int GetMaxNodes() const
 		{
-			assert( nodes.size() <= 255 );
+			assert( nodes.size() <= MaxMeshNodeIds );
 			return (int) nodes.size();
 		}
 		
+		int GetNodeCount() const
+		{
+			return addressTable.GetCount();
+		}
+		
 		void Reserve( int nodeId, const Address & address )
 		{
 			assert( nodeId >= 0 );
 			assert( nodeId < (int) nodes.size() );
+			assert( nodes[nodeId].mode == NodeState::Disconnected );
+			assert( addressTable.Find( address ) == -1 );
 			printf( "mesh reserves node id %d for %d.%d.%d.%d:%d\n", 
 				nodeId, address.GetA(), address.GetB(), address.GetC(), address.GetD(), address.GetPort() );
+			// note: reserve is rare, so a linear search of the free list is fine here
+			std::vector<int>::iterator itor = std::find( freeNodes.begin(), freeNodes.end(), nodeId );
+			assert( itor != freeNodes.end() );
+			freeNodes.erase( itor );
 			nodes[nodeId].mode = NodeState::ConnectionAccept;
 			nodes[nodeId].nodeId = nodeId;
 			nodes[nodeId].address = address;
-			addr2node.insert( std::make_pair( address, &nodes[nodeId] ) );
+			addressTable.Insert( address, nodeId );
 		}
 		
 	protected:
 		
 		void ReceivePackets()
 		{
+			const int MaxPacketSize = 256;
+			unsigned char buffer[ReceiveBatchSize][MaxPacketSize];
+			SocketPacket packets[ReceiveBatchSize];
+			for ( int i = 0; i < ReceiveBatchSize; ++i )
+				packets[i].data = buffer[i];
 			while ( true )
 			{
-				Address sender;
-				unsigned char data[256];
-				int size = socket.Receive( sender, data, sizeof(data) );
-				if ( !size )
+				int count = socket.ReceiveBatch( packets, ReceiveBatchSize, MaxPacketSize );
+				for ( int i = 0; i < count; ++i )
+					ProcessPacket( packets[i].address, packets[i].data, packets[i].size );
+				if ( count < ReceiveBatchSize )
 					break;
-				ProcessPacket( sender, data, size );
 			}
 		}
 
@@ -175,50 +209,44 @@ namespace net
 				case JoinRequest:
 				{
 					// is address already joining or joined?
-					AddrToNode::iterator itor = addr2node.find( sender );
-					if ( itor == addr2node.end() )
+					const int nodeId = addressTable.Find( sender );
+					if ( nodeId == -1 )
 					{
 						// no entry for address, start join process...
-						int freeSlot = -1;
-						for ( unsigned int i = 0; i < nodes.size(); ++i )
-						{
-							if ( nodes[i].mode == NodeState::Disconnected )
-							{
-								freeSlot = (int) i;
-								break;
-							}
-						}
-						if ( freeSlot >= 0 )
+						if ( !freeNodes.empty() )
 						{
+							const int freeSlot = freeNodes.back();
+							freeNodes.pop_back();
 							printf( "mesh accepts %d.%d.%d.%d:%d as node %d\n", 
 								sender.GetA(), sender.GetB(), sender.GetC(), sender.GetD(), sender.GetPort(), freeSlot );
 							assert( nodes[freeSlot].mode == NodeState::Disconnected );
 							nodes[freeSlot].mode = NodeState::ConnectionAccept;
 							nodes[freeSlot].nodeId = freeSlot;
 							nodes[freeSlot].address = sender;
-							addr2node.insert( std::make_pair( sender, &nodes[freeSlot] ) );
+							addressTable.Insert( sender, freeSlot );
 						}
 					}
-					else if ( itor->second->mode == NodeState::ConnectionAccept )
+					else if ( nodes[nodeId].mode == NodeState::ConnectionAccept )
 					{
 						// reset timeout accumulator, but only while joining
-						itor->second->timeoutAccumulator = 0.0f;
+						nodes[nodeId].timeoutAccumulator = 0.0f;
 					}
 				}
 				break;
 				case KeepAlive:
 				{
-					AddrToNode::iterator itor = addr2node.find( sender );
-					if ( itor != addr2node.end() )
+					const int nodeId = addressTable.Find( sender );
+					if ( nodeId != -1 )
 					{
 						// progress from "connection accept" to "connected"
-						if ( itor->second->mode == NodeState::ConnectionAccept )
+						NodeState & node = nodes[nodeId];
+						if ( node.mode == NodeState::ConnectionAccept )
 						{
-							itor->second->mode = NodeState::Connected;
-							printf( "mesh completes join of node %d\n", itor->second->nodeId );
+							node.mode = NodeState::Connected;
+							printf( "mesh completes join of node %d\n", node.nodeId );
 						}
 						// reset timeout accumulator for node
-						itor->second->timeoutAccumulator = 0.0f;
+						node.timeoutAccumulator = 0.0f;
 					}
 				}
 				break;
@@ -235,14 +263,16 @@ namespace net
 					if ( nodes[i].mode == NodeState::ConnectionAccept )
 					{
 						// node is negotiating join: send "connection accepted" packets
-						unsigned char packet[7];
+						unsigned char packet[9];
 						packet[0] = (unsigned char) ( ( protocolId >> 24 ) & 0xFF );
 						packet[1] = (unsigned char) ( ( protocolId >> 16 ) & 0xFF );
 						packet[2] = (unsigned char) ( ( protocolId >> 8 ) & 0xFF );
 						packet[3] = (unsigned char) ( ( protocolId ) & 0xFF );
 						packet[4] = 0;
-						packet[5] = (unsigned char) i;
-						packet[6] = (unsigned char) nodes.size();
+						packet[5] = (unsigned char) ( ( i >> 8 ) & 0xFF );
+						packet[6] = (unsigned char) ( i & 0xFF );
+						packet[7] = (unsigned char) ( ( nodes.size() >> 8 ) & 0xFF );
+						packet[8] = (unsigned char) ( nodes.size() & 0xFF );
 						socket.Send( nodes[i].address, packet, sizeof(packet) );
 					}
 					else if ( nodes[i].mode == NodeState::Connected )
@@ -282,17 +312,35 @@ namespace net
 					if ( nodes[i].timeoutAccumulator > timeout )
 					{
 						printf( "mesh timed out node %d\n", i );
-						AddrToNode::iterator addr_itor = addr2node.find( nodes[i].address );
-						assert( addr_itor != addr2node.end() );
-						addr2node.erase( addr_itor );
+						const bool removed = addressTable.Remove( nodes[i].address );
+						assert( removed );
 						nodes[i] = NodeState();
+						freeNodes.push_back( i );
 					}
 				}
 			}
 		}
+		
+		void ClearData()
+		{
+			addressTable.Clear();
+			freeNodes.clear();
+			// note: free list is a stack, so push in reverse to hand out the lowest node id first
+			for ( int i = (int) nodes.size() - 1; i >= 0; --i )
+			{
+				nodes[i] = NodeState();
+				freeNodes.push_back( i );
+			}
+			sendAccumulator = 0.0f;
+		}
 	};
 
 	// node
+	//  + max packet size defaults to the mesh update for MaxMeshNodes, the same as the mesh, so defaults always join
+	//  + packets from other nodes are queued in a preallocated ring of maxPacketSize slots
+	//  + received packets come out in the order they arrived, with no allocation per packet
+	//  + when the ring is full new packets are dropped and counted, call ReceivePacket often enough to keep up
+	//  + optionally the socket belongs to an i/o thread (see SocketThread), node logic stays on the calling thread
 	
 	class Node
 	{
@@ -307,14 +355,24 @@ namespace net
 			}
 		};
 		
-		struct BufferedPacket
+		struct QueuedPacket
 		{
 			int nodeId;
-			std::vector<unsigned char> data;
+			int size;
+			double time;
 		};
 		
-		typedef std::stack<BufferedPacket*> PacketBuffer;
-		PacketBuffer receivedPackets;
+		std::vector<QueuedPacket> receiveQueue;
+		std::vector<unsigned char> receiveQueueData;
+		int receiveQueueHead;
+		int receiveQueueCount;
+		unsigned int receiveQueueOverflows;
+		unsigned int receiveQueueDiscards;
+
+		enum { ReceiveBatchSize = 32 };
+		std::vector<unsigned char> receiveBuffer;
+		SocketPacket receiveBatch[ReceiveBatchSize];
+		double receiveTimes[ReceiveBatchSize];
 
 		unsigned int protocolId;
 		float sendRate;
@@ -322,10 +380,9 @@ namespace net
 		int maxPacketSize;
 
 		Socket socket;
+		SocketThread * socketThread;			// owns the socket instead when running with an i/o thread
 		std::vector<NodeState> nodes;
-		typedef std::map<int,NodeState*> IdToNode;
-		typedef std::map<Address,NodeState*> AddrToNode;
-		AddrToNode addr2node;
+		AddressTable addressTable;
 		bool running;
 		float sendAccumulator;
 		float timeoutAccumulator;
@@ -342,14 +399,23 @@ namespace net
 
 	public:
 
-		Node( unsigned int protocolId, float sendRate = 0.25f, float timeout = 10.0f, int maxPacketSize = 1024 )
+		Node( unsigned int protocolId, float sendRate = 0.25f, float timeout = 10.0f, int maxPacketSize = GetMeshUpdatePacketSize( MaxMeshNodes ), int receiveQueueSize = 256 )
+			: addressTable( 1 )
 		{
+			assert( maxPacketSize > 0 );
+			assert( receiveQueueSize > 0 );
 			this->protocolId = protocolId;
 			this->sendRate = sendRate;
 			this->timeout = timeout;
 			this->maxPacketSize = maxPacketSize;
+			receiveQueue.resize( receiveQueueSize );
+			receiveQueueData.resize( receiveQueueSize * maxPacketSize );
+			receiveBuffer.resize( ReceiveBatchSize * maxPacketSize );
+			for ( int i = 0; i < ReceiveBatchSize; ++i )
+				receiveBatch[i].data = &receiveBuffer[i*maxPacketSize];
 			state = Disconnected;
 			running = false;
+			socketThread = NULL;
 			ClearData();
 		}
 
@@ -359,11 +425,31 @@ namespace net
 				Stop();
 		}
 
-		bool Start( int port )
+		// with an i/o thread, a thread of its own sends and receives on the socket continuously,
+		// and packets are stamped with the time they were received rather than the time of the update
+
+		bool Start( int port, bool ioThread = false )
 		{
 			assert( !running );
-			printf( "start node on port %d\n", port );
-			if ( !socket.Open( port ) )
+			#if PLATFORM == PLATFORM_WINDOWS
+			if ( ioThread )
+			{
+				printf( "no i/o thread on windows, node socket runs on the calling thread\n" );
+				ioThread = false;
+			}
+			#endif
+			printf( "start node on port %d%s\n", port, ioThread ? " with i/o thread" : "" );
+			if ( ioThread )
+			{
+				socketThread = new SocketThread( maxPacketSize, (int) receiveQueue.size() );
+				if ( !socketThread->Open( port ) )
+				{
+					delete socketThread;
+					socketThread = NULL;
+					return false;
+				}
+			}
+			else if ( !socket.Open( port ) )
 				return false;
 			running = true;
 			return true;
@@ -374,9 +460,21 @@ namespace net
 			assert( running );
 			printf( "stop node\n" );
 			ClearData();
-			socket.Close();
+			if ( socketThread )
+			{
+				socketThread->Close();
+				delete socketThread;
+				socketThread = NULL;
+			}
+			else
+				socket.Close();
 			running = false;
 		}	
+
+		bool HasIOThread() const
+		{
+			return socketThread != NULL;
+		}
 		
 		void Join( const Address & address )
 		{
@@ -431,7 +529,7 @@ namespace net
 
 	    int GetMaxNodes() const
 		{
-			assert( nodes.size() <= 255 );
+			assert( nodes.size() <= MaxMeshNodeIds );
 			return (int) nodes.size();
 		}
 		
@@ -449,50 +547,84 @@ namespace net
 			assert( size <= maxPacketSize );
 			if ( size > maxPacketSize )
 				return false;
-			return socket.Send( nodes[nodeId].address, data, size );
+			return Send( nodes[nodeId].address, data, size );
 		}
 		
 		int ReceivePacket( int & nodeId, unsigned char data[], int size )
+		{
+			double time = 0.0;
+			return ReceivePacket( nodeId, data, size, time );
+		}
+
+		// time is when the packet came off the socket (see time_seconds), or zero without an i/o thread
+
+		int ReceivePacket( int & nodeId, unsigned char data[], int size, double & time )
 		{
 			assert( running );
-			if ( !receivedPackets.empty() )
+			if ( receiveQueueCount == 0 )
+				return 0;
+			const QueuedPacket & packet = receiveQueue[receiveQueueHead];
+			const unsigned char * packetData = &receiveQueueData[receiveQueueHead*maxPacketSize];
+			receiveQueueHead = ( receiveQueueHead + 1 ) % (int) receiveQueue.size();
+			receiveQueueCount--;
+			if ( packet.size > size )
 			{
-				BufferedPacket * packet = receivedPackets.top();
-				assert( packet );
-				if ( (int) packet->data.size() <= size )
-				{
-					nodeId = packet->nodeId;
-					size = packet->data.size();
-					memcpy( data, &packet->data[0], size );
-					delete packet;
-					receivedPackets.pop();
-					return size;
-				}
-				else
-				{
-					delete packet;
-					receivedPackets.pop();
-				}
+				// packet does not fit in the callers buffer, drop it
+				receiveQueueDiscards++;
+				return 0;
 			}
-			return 0;
+			nodeId = packet.nodeId;
+			time = packet.time;
+			memcpy( data, packetData, packet.size );
+			return packet.size;
+		}
+		
+		int GetReceiveQueueCount() const
+		{
+			return receiveQueueCount;
+		}
+		
+		int GetReceiveQueueSize() const
+		{
+			return (int) receiveQueue.size();
+		}
+		
+		unsigned int GetReceiveQueueOverflows() const
+		{
+			return receiveQueueOverflows;
+		}
+		
+		unsigned int GetReceiveQueueDiscards() const
+		{
+			return receiveQueueDiscards;
 		}
 
 	protected:
 
+		bool Send( const Address & address, const unsigned char data[], int size )
+		{
+			if ( socketThread )
+				return socketThread->Send( address, data, size );
+			return socket.Send( address, data, size );
+		}
+
 		void ReceivePackets()
 		{
 			while ( true )
 			{
-				Address sender;
-				unsigned char data[maxPacketSize];
-				int size = socket.Receive( sender, data, sizeof(data) );
-				if ( !size )
+				int count = 0;
+				if ( socketThread )
+					count = socketThread->ReceiveBatch( receiveBatch, receiveTimes, ReceiveBatchSize, maxPacketSize );
+				else
+					count = socket.ReceiveBatch( receiveBatch, ReceiveBatchSize, maxPacketSize );
+				for ( int i = 0; i < count; ++i )
+					ProcessPacket( receiveBatch[i].address, receiveBatch[i].data, receiveBatch[i].size, socketThread ? receiveTimes[i] : 0.0 );
+				if ( count < ReceiveBatchSize )
 					break;
-				ProcessPacket( sender, data, size );
 			}
 		}
 
-		void ProcessPacket( const Address & sender, unsigned char data[], int size )
+		void ProcessPacket( const Address & sender, unsigned char data[], int size, double time )
 		{
 			assert( sender != Address() );
 			assert( size > 0 );
@@ -520,12 +652,23 @@ namespace net
 				{
 					case ConnectionAccepted:
 					{
-						if ( size != 7 )
+						if ( size != 9 )
 							return;
 						if ( state == Joining )
 						{
-							localNodeId = data[5];
-							nodes.resize( data[6] );
+							localNodeId = ( data[5] << 8 ) | data[6];
+							const int maxNodes = ( data[7] << 8 ) | data[8];
+							if ( maxNodes < 1 || localNodeId >= maxNodes )
+								return;
+							if ( GetMeshUpdatePacketSize( maxNodes ) > maxPacketSize )
+							{
+								printf( "node join failed: mesh update for %d nodes does not fit in %d byte packets\n", maxNodes, maxPacketSize );
+								state = JoinFail;
+								ClearData();
+								return;
+							}
+							nodes.resize( maxNodes );
+							addressTable = AddressTable( maxNodes );
 							printf( "node accepts join as node %d of %d\n", localNodeId, (int) nodes.size() );
 							state = Joined;
 						}
@@ -539,40 +682,32 @@ namespace net
 						if ( state == Joined )
 						{
 							// process update packet
-							unsigned char * ptr = &data[5];
+							// note: two passes, so an address that moves from one node slot to another
+							// in the same update is removed from the table before it is inserted again
 							for ( unsigned int i = 0; i < nodes.size(); ++i )
 							{
-								unsigned char a = ptr[0];
-								unsigned char b = ptr[1];
-								unsigned char c = ptr[2];
-								unsigned char d = ptr[3];
-								unsigned short port = (unsigned short)ptr[4] << 8 | (unsigned short)ptr[5];
-								Address address( a, b, c, d, port );
-								if ( address.GetAddress() != 0 )
+								const Address address = ReadNodeAddress( &data[5+i*6] );
+								if ( nodes[i].connected && address != nodes[i].address )
 								{
-									// node is connected
-									if ( address != nodes[i].address )
-									{
-										printf( "node %d: node %d connected\n", localNodeId, i );
-										nodes[i].connected = true;
-										nodes[i].address = address;
-										addr2node[address] = &nodes[i];
-									}
-								}
-								else
-								{
-									// node is not connected
-									if ( nodes[i].connected )
+									addressTable.Remove( nodes[i].address );
+									if ( address.GetAddress() == 0 )
 									{
 										printf( "node %d: node %d disconnected\n", localNodeId, i );
-										AddrToNode::iterator itor = addr2node.find( nodes[i].address );
-										assert( itor != addr2node.end() );
-										addr2node.erase( itor );
 										nodes[i].connected = false;
 										nodes[i].address = Address();
 									}
 								}
-								ptr += 6;
+							}
+							for ( unsigned int i = 0; i < nodes.size(); ++i )
+							{
+								const Address address = ReadNodeAddress( &data[5+i*6] );
+								if ( address.GetAddress() != 0 && ( !nodes[i].connected || address != nodes[i].address ) )
+								{
+									printf( "node %d: node %d connected\n", localNodeId, i );
+									nodes[i].connected = true;
+									nodes[i].address = address;
+									addressTable.Insert( address, i );
+								}
 							}
 						}
 						timeoutAccumulator = 0.0f;
@@ -582,20 +717,23 @@ namespace net
 			}
 			else
 			{
-				AddrToNode::iterator itor = addr2node.find( sender );
-				if ( itor != addr2node.end() )
+				const int nodeId = addressTable.Find( sender );
+				if ( nodeId != -1 )
 				{
 					// *** packet sent from another node ***
-					NodeState * node = itor->second;
-					assert( node );
-					int nodeId = (int) ( node - &nodes[0] );
-					assert( nodeId >= 0 );
 					assert( nodeId < (int) nodes.size() );
-					BufferedPacket * packet = new BufferedPacket;
-					packet->nodeId = nodeId;
-					packet->data.resize( size );
-					memcpy( &packet->data[0], data, size );
-					receivedPackets.push( packet );
+					assert( size <= maxPacketSize );
+					if ( receiveQueueCount == (int) receiveQueue.size() )
+					{
+						receiveQueueOverflows++;
+						return;
+					}
+					const int index = ( receiveQueueHead + receiveQueueCount ) % (int) receiveQueue.size();
+					receiveQueue[index].nodeId = nodeId;
+					receiveQueue[index].size = size;
+					receiveQueue[index].time = time;
+					memcpy( &receiveQueueData[index*maxPacketSize], data, size );
+					receiveQueueCount++;
 				}
 			}
 		}
@@ -614,7 +752,7 @@ namespace net
 					packet[2] = (unsigned char) ( ( protocolId >> 8 ) & 0xFF );
 					packet[3] = (unsigned char) ( ( protocolId ) & 0xFF );
 					packet[4] = 0;
-					socket.Send( meshAddress, packet, sizeof(packet) );
+					Send( meshAddress, packet, sizeof(packet) );
 				}
 				else if ( state == Joined )
 				{
@@ -625,7 +763,7 @@ namespace net
 					packet[2] = (unsigned char) ( ( protocolId >> 8 ) & 0xFF );
 					packet[3] = (unsigned char) ( ( protocolId ) & 0xFF );
 					packet[4] = 1;
-					socket.Send( meshAddress, packet, sizeof(packet) );
+					Send( meshAddress, packet, sizeof(packet) );
 				}
 				sendAccumulator -= sendRate;
 			}
@@ -653,16 +791,20 @@ namespace net
 			}
 		}
 		
+		static Address ReadNodeAddress( const unsigned char * ptr )
+		{
+			unsigned short port = (unsigned short)ptr[4] << 8 | (unsigned short)ptr[5];
+			return Address( ptr[0], ptr[1], ptr[2], ptr[3], port );
+		}
+		
 		void ClearData()
 		{
 			nodes.clear();
-			addr2node.clear();
-			while ( !receivedPackets.empty() )
-			{
-				BufferedPacket * packet = receivedPackets.top();
-				delete packet;
-				receivedPackets.pop();
-			}
+			addressTable.Clear();
+			receiveQueueHead = 0;
+			receiveQueueCount = 0;
+			receiveQueueOverflows = 0;
+			receiveQueueDiscards = 0;
 			sendAccumulator = 0.0f;
 			timeoutAccumulator = 0.0f;
 			localNodeId = -1;
@@ -0,0 +1,357 @@
+/*
+	Simple Network Library from "Networking for Game Programmers"
+	http://www.gaffer.org/networking-for-game-programmers
+	Author: Glenn Fiedler <gaffer@gaffer.org>
+*/
+
+#ifndef NET_LAN_SOCKET_THREAD_H
+#define NET_LAN_SOCKET_THREAD_H
+
+#include "NetSockets.h"
+
+#include <assert.h>
+#include <vector>
+
+#if PLATFORM != PLATFORM_WINDOWS
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+namespace net
+{
+#if PLATFORM != PLATFORM_WINDOWS
+
+	// bounded datagram queue between exactly one producer thread and one consumer thread, without locks
+	//  + the producer only moves the tail and the consumer only moves the head, each publishes with a release store
+	//  + capacity is a power of two and each entry has a max packet size buffer, so nothing is allocated after construction
+
+	class DatagramRing
+	{
+	public:
+
+		DatagramRing( int capacity, int maxPacketSize )
+		{
+			assert( capacity > 0 );
+			assert( ( capacity & ( capacity - 1 ) ) == 0 );
+			assert( maxPacketSize > 0 );
+			this->capacity = capacity;
+			this->maxPacketSize = maxPacketSize;
+			entries.resize( capacity );
+			data.resize( capacity * maxPacketSize );
+			Clear();
+		}
+
+		// note: not safe while either thread is using the ring
+
+		void Clear()
+		{
+			head = 0;
+			tail = 0;
+		}
+
+		// producer side. returns false if the ring is full
+
+		bool Push( const Address & address, const unsigned char packet[], int size, double time )
+		{
+			assert( size > 0 );
+			assert( size <= maxPacketSize );
+			const unsigned int position = tail;
+			if ( position - __atomic_load_n( &head, __ATOMIC_ACQUIRE ) == (unsigned int) capacity )
+				return false;
+			const int index = position & ( capacity - 1 );
+			entries[index].address = address;
+			entries[index].size = size;
+			entries[index].time = time;
+			memcpy( &data[index*maxPacketSize], packet, size );
+			__atomic_store_n( &tail, position + 1, __ATOMIC_RELEASE );
+			return true;
+		}
+
+		// consumer side
+
+		bool IsEmpty() const
+		{
+			return head == __atomic_load_n( &tail, __ATOMIC_ACQUIRE );
+		}
+
+		// consumer side. packet must hold max packet size bytes. returns false if the ring is empty
+
+		bool Pop( Address & address, unsigned char packet[], int & size, double & time )
+		{
+			const unsigned int position = head;
+			if ( position == __atomic_load_n( &tail, __ATOMIC_ACQUIRE ) )
+				return false;
+			const int index = position & ( capacity - 1 );
+			address = entries[index].address;
+			size = entries[index].size;
+			time = entries[index].time;
+			memcpy( packet, &data[index*maxPacketSize], size );
+			__atomic_store_n( &head, position + 1, __ATOMIC_RELEASE );
+			return true;
+		}
+
+		int GetCapacity() const
+		{
+			return capacity;
+		}
+
+	private:
+
+		enum { CacheLine = 64 };
+
+		struct Entry
+		{
+			Address address;
+			int size;
+			double time;
+		};
+
+		int capacity;
+		int maxPacketSize;
+		std::vector<Entry> entries;
+		std::vector<unsigned char> data;
+
+		char headPadding[CacheLine];
+		unsigned int head;					// next entry to pop, written by the consumer
+		char tailPadding[CacheLine];
+		unsigned int tail;					// next entry to push, written by the producer
+		char endPadding[CacheLine];
+	};
+
+	// udp socket owned by a dedicated i/o thread
+	//  + the thread sends whatever the game thread has queued and receives whatever is waiting, continuously,
+	//    so packets don't sit in the socket buffer while the game thread is busy with a long frame
+	//  + each received packet is stamped with the time it came off the socket (see time_seconds)
+	//  + the game thread and the i/o thread only share two single producer / single consumer rings
+	//  + when there is nothing to do the thread blocks on the socket. a send queued while it sleeps, or close,
+	//    wakes it by writing to a pipe, so the thread uses no cpu while idle and sends still go out right away
+
+	class SocketThread
+	{
+	public:
+
+		SocketThread( int maxPacketSize = 1024, int queueSize = 256 )
+			: outgoing( queueSize, maxPacketSize ), incoming( queueSize, maxPacketSize )
+		{
+			assert( maxPacketSize > 0 );
+			this->maxPacketSize = maxPacketSize;
+			sendBuffer.resize( Socket::MaxBatchSize * maxPacketSize );
+			receiveBuffer.resize( Socket::MaxBatchSize * maxPacketSize );
+			for ( int i = 0; i < Socket::MaxBatchSize; ++i )
+			{
+				sendBatch[i].data = &sendBuffer[i*maxPacketSize];
+				receiveBatch[i].data = &receiveBuffer[i*maxPacketSize];
+			}
+			running = 0;
+			sleeping = 0;
+			wakeup[0] = -1;
+			wakeup[1] = -1;
+			sendOverflows = 0;
+			receiveOverflows = 0;
+		}
+
+		~SocketThread()
+		{
+			if ( IsOpen() )
+				Close();
+		}
+
+		bool Open( unsigned short port )
+		{
+			assert( !IsOpen() );
+			if ( !socket.Open( port ) )
+				return false;
+			if ( pipe( wakeup ) != 0 )
+			{
+				printf( "error: failed to create wakeup pipe\n" );
+				socket.Close();
+				return false;
+			}
+			fcntl( wakeup[0], F_SETFL, O_NONBLOCK );
+			fcntl( wakeup[1], F_SETFL, O_NONBLOCK );
+			outgoing.Clear();
+			incoming.Clear();
+			sendOverflows = 0;
+			receiveOverflows = 0;
+			sleeping = 0;
+			running = 1;
+			if ( pthread_create( &thread, NULL, StaticRun, (void*) this ) != 0 )
+			{
+				printf( "error: pthread_create failed\n" );
+				running = 0;
+				ClosePipe();
+				socket.Close();
+				return false;
+			}
+			return true;
+		}
+
+		void Close()
+		{
+			assert( IsOpen() );
+			__atomic_store_n( &running, 0, __ATOMIC_SEQ_CST );
+			Wake();
+			if ( pthread_join( thread, NULL ) != 0 )
+				printf( "error: pthread_join failed\n" );
+			ClosePipe();
+			socket.Close();
+		}
+
+		bool IsOpen() const
+		{
+			return socket.IsOpen();
+		}
+
+		// game thread: queue a packet for the i/o thread to send. returns false if the send queue is full
+
+		bool Send( const Address & destination, const void * data, int size )
+		{
+			assert( IsOpen() );
+			if ( !outgoing.Push( destination, (const unsigned char*) data, size, 0.0 ) )
+			{
+				sendOverflows++;
+				return false;
+			}
+			// note: pairs with the fence in Run. either the i/o thread sees this packet before it sleeps,
+			// or we see that it is asleep and wake it. only the first send to find it asleep writes the pipe
+			__atomic_thread_fence( __ATOMIC_SEQ_CST );
+			if ( __atomic_load_n( &sleeping, __ATOMIC_RELAXED ) && __atomic_exchange_n( &sleeping, 0, __ATOMIC_RELAXED ) )
+				Wake();
+			return true;
+		}
+
+		// game thread: take up to "count" received packets, with the time each came off the socket
+
+		int ReceiveBatch( SocketPacket packets[], double times[], int count, int maxSize )
+		{
+			assert( IsOpen() );
+			assert( maxSize >= maxPacketSize );
+			int received = 0;
+			while ( received < count && incoming.Pop( packets[received].address, packets[received].data, packets[received].size, times[received] ) )
+				received++;
+			return received;
+		}
+
+		unsigned int GetSendOverflows() const
+		{
+			return sendOverflows;
+		}
+
+		unsigned int GetReceiveOverflows() const
+		{
+			return __atomic_load_n( &receiveOverflows, __ATOMIC_RELAXED );
+		}
+
+	private:
+
+		static void * StaticRun( void * data )
+		{
+			SocketThread * self = (SocketThread*) data;
+			self->Run();
+			return NULL;
+		}
+
+		void Run()
+		{
+			// note: sends and close wake the thread, this timeout is only a backstop
+			const float WaitTime = 0.25f;
+
+			while ( __atomic_load_n( &running, __ATOMIC_ACQUIRE ) )
+			{
+				int sendCount = 0;
+				double unused = 0.0;
+				while ( sendCount < Socket::MaxBatchSize &&
+						outgoing.Pop( sendBatch[sendCount].address, sendBatch[sendCount].data, sendBatch[sendCount].size, unused ) )
+					sendCount++;
+				if ( sendCount > 0 )
+					socket.SendBatch( sendBatch, sendCount );
+
+				const int receiveCount = socket.ReceiveBatch( receiveBatch, Socket::MaxBatchSize, maxPacketSize );
+				if ( receiveCount > 0 )
+				{
+					const double time = time_seconds();
+					for ( int i = 0; i < receiveCount; ++i )
+					{
+						// note: if the game thread falls this far behind, new packets are dropped like a full socket buffer would
+						if ( !incoming.Push( receiveBatch[i].address, receiveBatch[i].data, receiveBatch[i].size, time ) )
+							__atomic_add_fetch( &receiveOverflows, 1, __ATOMIC_RELAXED );
+					}
+				}
+
+				if ( sendCount == 0 && receiveCount == 0 )
+				{
+					__atomic_store_n( &sleeping, 1, __ATOMIC_RELAXED );
+					__atomic_thread_fence( __ATOMIC_SEQ_CST );
+					if ( outgoing.IsEmpty() && __atomic_load_n( &running, __ATOMIC_ACQUIRE ) )
+						socket.Wait( WaitTime, wakeup[0] );
+					__atomic_store_n( &sleeping, 0, __ATOMIC_RELAXED );
+					DrainWakeup();
+				}
+			}
+		}
+
+		void Wake()
+		{
+			const unsigned char byte = 0;
+			if ( write( wakeup[1], &byte, 1 ) < 0 )
+			{
+				// note: the pipe is full, so a wakeup is already pending
+			}
+		}
+
+		void DrainWakeup()
+		{
+			unsigned char bytes[64];
+			while ( read( wakeup[0], bytes, sizeof( bytes ) ) > 0 );
+		}
+
+		void ClosePipe()
+		{
+			close( wakeup[0] );
+			close( wakeup[1] );
+			wakeup[0] = -1;
+			wakeup[1] = -1;
+		}
+
+		int maxPacketSize;
+		Socket socket;
+		pthread_t thread;
+		int running;
+		int sleeping;							// set by the i/o thread while it waits, cleared by the send that wakes it
+		int wakeup[2];							// pipe: read end in the i/o thread's wait, sends and close write to it
+
+		DatagramRing outgoing;					// game thread -> i/o thread
+		DatagramRing incoming;					// i/o thread -> game thread
+
+		std::vector<unsigned char> sendBuffer;
+		std::vector<unsigned char> receiveBuffer;
+		SocketPacket sendBatch[Socket::MaxBatchSize];
+		SocketPacket receiveBatch[Socket::MaxBatchSize];
+
+		unsigned int sendOverflows;
+		unsigned int receiveOverflows;
+	};
+
+#else
+
+	// no i/o thread on windows yet. nodes run their socket on the calling thread instead (see Node::Start),
+	// this is only here so code that can use an i/o thread still compiles
+
+	class SocketThread
+	{
+	public:
+		SocketThread( int maxPacketSize = 1024, int queueSize = 256 ) {}
+		bool Open( unsigned short port ) { return false; }
+		void Close() {}
+		bool IsOpen() const { return false; }
+		bool Send( const Address & destination, const void * data, int size ) { return false; }
+		int ReceiveBatch( SocketPacket packets[], double times[], int count, int maxSize ) { return 0; }
+		unsigned int GetSendOverflows() const { return 0; }
+		unsigned int GetReceiveOverflows() const { return 0; }
+	};
+
+#endif
+}
+
+#endif
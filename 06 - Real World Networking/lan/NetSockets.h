@@ -0,0 +1,418 @@
+/*
+	Simple Network Library from "Networking for Game Programmers"
+	http://www.gaffer.org/networking-for-game-programmers
+	Author: Glenn Fiedler <gaffer@gaffer.org>
+*/
+
+#ifndef NET_LAN_SOCKETS_H
+#define NET_LAN_SOCKETS_H
+
+#include "../NetPlatform.h"
+#include "NetAddress.h"
+
+#if PLATFORM == PLATFORM_WINDOWS
+
+	#include <winsock2.h>
+	#pragma comment( lib, "wsock32.lib" )
+
+#elif PLATFORM == PLATFORM_MAC || PLATFORM == PLATFORM_UNIX
+
+	#include <sys/socket.h>
+	#include <sys/select.h>
+	#include <netinet/in.h>
+	#include <fcntl.h>
+
+#endif
+
+// batched socket io via recvmmsg/sendmmsg (linux only)
+
+#if PLATFORM == PLATFORM_UNIX && defined(__linux__) && defined(MSG_WAITFORONE) && !defined(NET_NO_MMSG)
+#define NET_MMSG 1
+#else
+#define NET_MMSG 0
+#endif
+
+#include <string.h>
+#include <algorithm>
+
+namespace net
+{
+	// sockets
+
+	inline bool InitializeSockets()
+	{
+		#if PLATFORM == PLATFORM_WINDOWS
+	    WSADATA WsaData;
+		return WSAStartup( MAKEWORD(2,2), &WsaData ) == NO_ERROR;
+		#else
+		return true;
+		#endif
+	}
+
+	inline void ShutdownSockets()
+	{
+		#if PLATFORM == PLATFORM_WINDOWS
+		WSACleanup();
+		#endif
+	}
+
+	// one datagram in a batched send or receive
+	//  + on send: address is the destination, size is the number of bytes in data
+	//  + on receive: data must point to at least "maxSize" bytes, address and size are filled in
+
+	struct SocketPacket
+	{
+		Address address;
+		unsigned char * data;
+		int size;
+	};
+
+	class Socket
+	{
+	public:
+
+		enum Options
+		{
+			NonBlocking = 1,
+			Broadcast = 2
+		};
+
+		enum { MaxBatchSize = 64 };
+
+		Socket( int options = NonBlocking )
+		{
+			this->options = options;
+			socket = 0;
+		}
+
+		~Socket()
+		{
+			Close();
+		}
+
+		bool Open( unsigned short port )
+		{
+			assert( !IsOpen() );
+
+			// create socket
+
+			socket = ::socket( AF_INET, SOCK_DGRAM, IPPROTO_UDP );
+
+			if ( socket <= 0 )
+			{
+				printf( "failed to create socket\n" );
+				socket = 0;
+				return false;
+			}
+
+			// bind to port
+
+			sockaddr_in address;
+			address.sin_family = AF_INET;
+			address.sin_addr.s_addr = INADDR_ANY;
+			address.sin_port = htons( (unsigned short) port );
+
+			if ( bind( socket, (const sockaddr*) &address, sizeof(sockaddr_in) ) < 0 )
+			{
+				printf( "failed to bind socket\n" );
+				Close();
+				return false;
+			}
+
+			// set non-blocking io
+
+			if ( options & NonBlocking )
+			{
+				#if PLATFORM == PLATFORM_MAC || PLATFORM == PLATFORM_UNIX
+
+					int nonBlocking = 1;
+					if ( fcntl( socket, F_SETFL, O_NONBLOCK, nonBlocking ) == -1 )
+					{
+						printf( "failed to set non-blocking socket\n" );
+						Close();
+						return false;
+					}
+
+				#elif PLATFORM == PLATFORM_WINDOWS
+
+					DWORD nonBlocking = 1;
+					if ( ioctlsocket( socket, FIONBIO, &nonBlocking ) != 0 )
+					{
+						printf( "failed to set non-blocking socket\n" );
+						Close();
+						return false;
+					}
+
+				#endif
+			}
+
+			// set broadcast socket
+
+			if ( options & Broadcast )
+			{
+				int enable = 1;
+				if ( setsockopt( socket, SOL_SOCKET, SO_BROADCAST, (const char*) &enable, sizeof( enable ) ) < 0 )
+				{
+					printf( "failed to set socket to broadcast\n" );
+					Close();
+					return false;
+				}
+			}
+
+			return true;
+		}
+
+		void Close()
+		{
+			if ( socket != 0 )
+			{
+				#if PLATFORM == PLATFORM_MAC || PLATFORM == PLATFORM_UNIX
+				close( socket );
+				#elif PLATFORM == PLATFORM_WINDOWS
+				closesocket( socket );
+				#endif
+				socket = 0;
+			}
+		}
+
+		bool IsOpen() const
+		{
+			return socket != 0;
+		}
+
+		bool Send( const Address & destination, const void * data, int size )
+		{
+			assert( data );
+			assert( size > 0 );
+
+			if ( socket == 0 )
+				return false;
+
+			assert( destination.GetAddress() != 0 );
+			assert( destination.GetPort() != 0 );
+
+			sockaddr_in address;
+			address.sin_family = AF_INET;
+			address.sin_addr.s_addr = htonl( destination.GetAddress() );
+			address.sin_port = htons( (unsigned short) destination.GetPort() );
+
+			int sent_bytes = sendto( socket, (const char*)data, size, 0, (sockaddr*)&address, sizeof(sockaddr_in) );
+
+			return sent_bytes == size;
+		}
+
+		int Receive( Address & sender, void * data, int size )
+		{
+			assert( data );
+			assert( size > 0 );
+
+			if ( socket == 0 )
+				return false;
+
+			#if PLATFORM == PLATFORM_WINDOWS
+			typedef int socklen_t;
+			#endif
+
+			sockaddr_in from;
+			socklen_t fromLength = sizeof( from );
+
+			int received_bytes = recvfrom( socket, (char*)data, size, 0, (sockaddr*)&from, &fromLength );
+
+			if ( received_bytes <= 0 )
+				return 0;
+
+			unsigned int address = ntohl( from.sin_addr.s_addr );
+			unsigned short port = ntohs( from.sin_port );
+
+			sender = Address( address, port );
+
+			return received_bytes;
+		}
+
+		// send a batch of packets, returns the number of packets sent
+		//  + with recvmmsg/sendmmsg this is one syscall per "MaxBatchSize" packets, otherwise one per packet
+
+		int SendBatch( const SocketPacket packets[], int count )
+		{
+			assert( packets );
+			assert( count >= 0 );
+
+			if ( socket == 0 )
+				return 0;
+
+			#if NET_MMSG
+
+				int sent = 0;
+				while ( sent < count )
+				{
+					const int batchSize = std::min( count - sent, (int) MaxBatchSize );
+					mmsghdr messages[MaxBatchSize];
+					iovec buffers[MaxBatchSize];
+					sockaddr_in addresses[MaxBatchSize];
+					for ( int i = 0; i < batchSize; ++i )
+					{
+						const SocketPacket & packet = packets[sent+i];
+						assert( packet.data );
+						assert( packet.size > 0 );
+						assert( packet.address.GetAddress() != 0 );
+						assert( packet.address.GetPort() != 0 );
+						addresses[i].sin_family = AF_INET;
+						addresses[i].sin_addr.s_addr = htonl( packet.address.GetAddress() );
+						addresses[i].sin_port = htons( packet.address.GetPort() );
+						buffers[i].iov_base = packet.data;
+						buffers[i].iov_len = packet.size;
+						memset( &messages[i], 0, sizeof( mmsghdr ) );
+						messages[i].msg_hdr.msg_name = &addresses[i];
+						messages[i].msg_hdr.msg_namelen = sizeof( sockaddr_in );
+						messages[i].msg_hdr.msg_iov = &buffers[i];
+						messages[i].msg_hdr.msg_iovlen = 1;
+					}
+					int result = sendmmsg( socket, messages, batchSize, 0 );
+					if ( result <= 0 )
+						break;
+					sent += result;
+					if ( result < batchSize )
+						break;
+				}
+				return sent;
+
+			#else
+
+				int sent = 0;
+				for ( int i = 0; i < count; ++i )
+				{
+					if ( Send( packets[i].address, packets[i].data, packets[i].size ) )
+						sent++;
+				}
+				return sent;
+
+			#endif
+		}
+
+		// receive up to "count" packets, each into a buffer of "maxSize" bytes
+		//  + returns the number of packets received, zero if there are none waiting
+		//  + if fewer than "count" packets are returned the socket has been drained
+
+		int ReceiveBatch( SocketPacket packets[], int count, int maxSize )
+		{
+			assert( packets );
+			assert( count >= 0 );
+			assert( maxSize > 0 );
+
+			if ( socket == 0 )
+				return 0;
+
+			#if NET_MMSG
+
+				int received = 0;
+				while ( received < count )
+				{
+					const int batchSize = std::min( count - received, (int) MaxBatchSize );
+					mmsghdr messages[MaxBatchSize];
+					iovec buffers[MaxBatchSize];
+					sockaddr_in addresses[MaxBatchSize];
+					for ( int i = 0; i < batchSize; ++i )
+					{
+						assert( packets[received+i].data );
+						buffers[i].iov_base = packets[received+i].data;
+						buffers[i].iov_len = maxSize;
+						memset( &messages[i], 0, sizeof( mmsghdr ) );
+						messages[i].msg_hdr.msg_name = &addresses[i];
+						messages[i].msg_hdr.msg_namelen = sizeof( sockaddr_in );
+						messages[i].msg_hdr.msg_iov = &buffers[i];
+						messages[i].msg_hdr.msg_iovlen = 1;
+					}
+					const int flags = received > 0 ? MSG_DONTWAIT : MSG_WAITFORONE;
+					int result = recvmmsg( socket, messages, batchSize, flags, NULL );
+					if ( result <= 0 )
+						break;
+					int valid = 0;
+					for ( int i = 0; i < result; ++i )
+					{
+						if ( messages[i].msg_len == 0 )
+							continue;
+						SocketPacket & packet = packets[received+valid];
+						if ( valid != i )
+							memmove( packet.data, buffers[i].iov_base, messages[i].msg_len );
+						packet.address = Address( ntohl( addresses[i].sin_addr.s_addr ), ntohs( addresses[i].sin_port ) );
+						packet.size = (int) messages[i].msg_len;
+						valid++;
+					}
+					received += valid;
+					if ( result < batchSize )
+						break;
+				}
+				return received;
+
+			#else
+
+				int received = 0;
+				while ( received < count )
+				{
+					SocketPacket & packet = packets[received];
+					int size = Receive( packet.address, packet.data, maxSize );
+					if ( size == 0 )
+						break;
+					packet.size = size;
+					received++;
+				}
+				return received;
+
+			#endif
+		}
+
+		// wait until a packet can be received, or "seconds" have passed. returns true if a packet is waiting
+
+		bool Wait( float seconds, int wakeup = -1 )
+		{
+			// note: wakeup is another descriptor that ends the wait early when it becomes readable, eg. a pipe
+
+			if ( socket == 0 )
+				return false;
+
+			fd_set readable;
+			FD_ZERO( &readable );
+			FD_SET( socket, &readable );
+			if ( wakeup >= 0 )
+				FD_SET( wakeup, &readable );
+
+			timeval timeout;
+			timeout.tv_sec = (int) seconds;
+			timeout.tv_usec = (int) ( ( seconds - timeout.tv_sec ) * 1000000.0f );
+
+			return select( std::max( socket, wakeup ) + 1, &readable, NULL, NULL, &timeout ) > 0;
+		}
+
+	private:
+
+		int socket;
+		int options;
+	};
+
+	// get host name helper
+
+	inline bool GetHostName( char * hostname, int size )
+	{
+		gethostname( hostname, size );
+		hostname[size-1] = '\0';
+		return true;
+	}
+
+	// helper functions for reading and writing integer values to packets
+
+	inline void WriteInteger( unsigned char * data, unsigned int value )
+	{
+		data[0] = (unsigned char) ( value >> 24 );
+		data[1] = (unsigned char) ( ( value >> 16 ) & 0xFF );
+		data[2] = (unsigned char) ( ( value >> 8 ) & 0xFF );
+		data[3] = (unsigned char) ( value & 0xFF );
+	}
+
+	inline void ReadInteger( const unsigned char * data, unsigned int & value )
+	{
+		value = ( ( (unsigned int)data[0] << 24 ) | ( (unsigned int)data[1] << 16 ) |
+			      ( (unsigned int)data[2] << 8 )  | ( (unsigned int)data[3] ) );
+	}
+}
+
+#endif
@@ -0,0 +1,572 @@
+/*
+	Simple Network Library from "Networking for Game Programmers"
+	http://www.gaffer.org/networking-for-game-programmers
+	Author: Glenn Fiedler <gaffer@gaffer.org>
+*/
+
+#ifndef NET_LOOPBACK_H
+#define NET_LOOPBACK_H
+
+#include <assert.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "../NetReliability.h"
+
+namespace net
+{
+	// conditions applied to packets sent from one loopback node to another, the defaults deliver everything at the next update
+
+	struct LinkSettings
+	{
+		LinkSettings()
+		{
+			latency = 0.0f;
+			jitter = 0.0f;
+			packetLoss = 0.0f;
+			duplicate = 0.0f;
+		}
+
+		float latency;				// one way delay in seconds
+		float jitter;				// delay varies uniformly by up to +/- jitter seconds, so packets can overtake each other
+		float packetLoss;			// chance of dropping a packet
+		float duplicate;			// chance of delivering a packet twice
+	};
+
+	// bounded packet queue with any number of senders and one receiver, without locks
+	//  + each cell has a sequence number saying whose turn it is. a sender claims a cell by moving the tail on with
+	//    compare and swap, fills it in, then publishes it by storing the next sequence. the receiver only moves the head
+	//  + capacity is a power of two and cells are a fixed size, so nothing is allocated after construction
+	//  + head and tail are kept on separate cache lines so senders and the receiver don't fight over one line
+
+	class PacketRing
+	{
+	public:
+
+		PacketRing( int capacity, int maxPacketSize )
+		{
+			assert( capacity > 0 );
+			assert( ( capacity & ( capacity - 1 ) ) == 0 );
+			assert( maxPacketSize > 0 );
+			this->capacity = capacity;
+			this->maxPacketSize = maxPacketSize;
+			stride = ( sizeof( Cell ) + maxPacketSize + 15 ) & ~15;
+			cells.resize( capacity * stride );
+			Clear();
+		}
+
+		// note: not safe while anybody else is using the ring
+
+		void Clear()
+		{
+			for ( int i = 0; i < capacity; ++i )
+				GetCell( i )->sequence = i;
+			__atomic_store_n( &tail, 0, __ATOMIC_RELEASE );
+			head = 0;
+		}
+
+		// sender side, any thread. returns false if the ring is full
+
+		bool Push( int nodeId, float delay, const unsigned char data[], int size )
+		{
+			assert( size >= 0 );
+			assert( size <= maxPacketSize );
+			unsigned int position = __atomic_load_n( &tail, __ATOMIC_RELAXED );
+			Cell * cell = NULL;
+			while ( true )
+			{
+				cell = GetCell( position );
+				const unsigned int sequence = __atomic_load_n( &cell->sequence, __ATOMIC_ACQUIRE );
+				const int difference = (int) ( sequence - position );
+				if ( difference == 0 )
+				{
+					if ( __atomic_compare_exchange_n( &tail, &position, position + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED ) )
+						break;
+				}
+				else if ( difference < 0 )
+					return false;
+				else
+					position = __atomic_load_n( &tail, __ATOMIC_RELAXED );
+			}
+			cell->nodeId = nodeId;
+			cell->delay = delay;
+			cell->size = size;
+			if ( size > 0 )
+				memcpy( cell + 1, data, size );
+			__atomic_store_n( &cell->sequence, position + 1, __ATOMIC_RELEASE );
+			return true;
+		}
+
+		// receiver side, one thread only. data must hold max packet size bytes.
+		// returns false if the ring is empty, or the next cell is claimed but not filled in yet
+
+		bool Pop( int & nodeId, float & delay, unsigned char data[], int & size )
+		{
+			Cell * cell = GetCell( head );
+			if ( __atomic_load_n( &cell->sequence, __ATOMIC_ACQUIRE ) != head + 1 )
+				return false;
+			nodeId = cell->nodeId;
+			delay = cell->delay;
+			size = cell->size;
+			if ( size > 0 )
+				memcpy( data, cell + 1, size );
+			__atomic_store_n( &cell->sequence, head + capacity, __ATOMIC_RELEASE );
+			head++;
+			return true;
+		}
+
+		int GetCapacity() const
+		{
+			return capacity;
+		}
+
+		int GetMaxPacketSize() const
+		{
+			return maxPacketSize;
+		}
+
+	private:
+
+		enum { CacheLine = 64 };
+
+		struct Cell
+		{
+			unsigned int sequence;
+			int nodeId;
+			float delay;
+			int size;
+		};
+
+		Cell * GetCell( unsigned int position )
+		{
+			return (Cell*) &cells[ ( position & ( capacity - 1 ) ) * stride ];
+		}
+
+		int capacity;
+		int maxPacketSize;
+		int stride;
+		std::vector<unsigned char> cells;			// each cell is a header followed by max packet size bytes
+
+		char tailPadding[CacheLine];
+		unsigned int tail;							// next cell a sender will claim, shared by all senders
+		char headPadding[CacheLine];
+		unsigned int head;							// next cell the receiver will read, receiver only
+		char endPadding[CacheLine];
+	};
+
+	// loopback network shared by the nodes in one process
+	//  + each node slot has an inbox ring that every other node sends into
+	//  + a slot's generation goes up each time a node attaches, so peers can tell a restarted node from the old one
+	//  + attach and detach must not run at the same time as each other or as sends to that slot, the loopback transport
+	//    serializes them under its lock. everything else can be called from any thread
+
+	class LoopbackNetwork
+	{
+	public:
+
+		LoopbackNetwork( int maxNodes, int queueSize, int maxPacketSize )
+		{
+			assert( maxNodes > 0 );
+			this->maxNodes = maxNodes;
+			this->queueSize = queueSize;
+			this->maxPacketSize = maxPacketSize;
+			inboxes.resize( maxNodes );
+			for ( int i = 0; i < maxNodes; ++i )
+				inboxes[i] = new PacketRing( queueSize, maxPacketSize );
+			attached.resize( maxNodes, 0 );
+			generations.resize( maxNodes, 0 );
+			attachedCount = 0;
+		}
+
+		~LoopbackNetwork()
+		{
+			assert( attachedCount == 0 );
+			for ( int i = 0; i < maxNodes; ++i )
+				delete inboxes[i];
+		}
+
+		// returns the node id of the first free slot, or -1 if every slot is taken
+
+		int Attach()
+		{
+			for ( int i = 0; i < maxNodes; ++i )
+			{
+				if ( !attached[i] )
+				{
+					inboxes[i]->Clear();
+					__atomic_store_n( &generations[i], generations[i] + 1, __ATOMIC_RELEASE );
+					__atomic_store_n( &attached[i], 1, __ATOMIC_RELEASE );
+					attachedCount++;
+					return i;
+				}
+			}
+			return -1;
+		}
+
+		void Detach( int nodeId )
+		{
+			assert( nodeId >= 0 && nodeId < maxNodes );
+			assert( attached[nodeId] );
+			__atomic_store_n( &attached[nodeId], 0, __ATOMIC_RELEASE );
+			attachedCount--;
+		}
+
+		bool IsAttached( int nodeId ) const
+		{
+			assert( nodeId >= 0 && nodeId < maxNodes );
+			return __atomic_load_n( &attached[nodeId], __ATOMIC_ACQUIRE ) != 0;
+		}
+
+		unsigned int GetGeneration( int nodeId ) const
+		{
+			assert( nodeId >= 0 && nodeId < maxNodes );
+			return __atomic_load_n( &generations[nodeId], __ATOMIC_ACQUIRE );
+		}
+
+		PacketRing & GetInbox( int nodeId )
+		{
+			assert( nodeId >= 0 && nodeId < maxNodes );
+			return *inboxes[nodeId];
+		}
+
+		int GetAttachedCount() const
+		{
+			return attachedCount;
+		}
+
+		int GetMaxNodes() const
+		{
+			return maxNodes;
+		}
+
+		int GetQueueSize() const
+		{
+			return queueSize;
+		}
+
+		int GetMaxPacketSize() const
+		{
+			return maxPacketSize;
+		}
+
+	private:
+
+		int maxNodes;
+		int queueSize;
+		int maxPacketSize;
+		int attachedCount;
+		std::vector<PacketRing*> inboxes;
+		std::vector<int> attached;
+		std::vector<unsigned int> generations;
+	};
+
+	// loopback node
+	//  + one node on a loopback network. send pushes straight into the destination inbox, update moves the inbox
+	//    into a preallocated pool of queue size packets, receive hands out the ones whose delay has passed
+	//  + the sender rolls loss, delay and duplicates per destination, from a generator seeded by the seed and both
+	//    node ids, so a seed gives the same packets no matter which order nodes started in or who else is sending
+	//  + delays count from the receiver's next update, so with zero latency a packet arrives one update after it was sent
+	//  + a node is used by one thread at a time, different nodes can be on different threads
+
+	class LoopbackNode
+	{
+	public:
+
+		LoopbackNode( unsigned int seed = 1 )
+		{
+			this->seed = seed;
+			network = NULL;
+			localNodeId = -1;
+			ClearData();
+		}
+
+		~LoopbackNode()
+		{
+			if ( IsRunning() )
+				Stop();
+		}
+
+		bool Start( LoopbackNetwork & network )
+		{
+			assert( !IsRunning() );
+			const int nodeId = network.Attach();
+			if ( nodeId < 0 )
+				return false;
+			this->network = &network;
+			localNodeId = nodeId;
+			const int maxNodes = network.GetMaxNodes();
+			links.resize( maxNodes );
+			for ( int i = 0; i < maxNodes; ++i )
+				links[i].random = LinkSeed( localNodeId, i );
+			const int queueSize = network.GetQueueSize();
+			const int maxPacketSize = network.GetMaxPacketSize();
+			packetData.resize( queueSize * maxPacketSize );
+			packets.resize( queueSize );
+			deliveries.resize( queueSize );
+			freePackets.reserve( queueSize );
+			ClearData();
+			return true;
+		}
+
+		void Stop()
+		{
+			assert( IsRunning() );
+			network->Detach( localNodeId );
+			network = NULL;
+			localNodeId = -1;
+			ClearData();
+		}
+
+		bool IsRunning() const
+		{
+			return network != NULL;
+		}
+
+		int GetLocalNodeId() const
+		{
+			return localNodeId;
+		}
+
+		int GetMaxNodes() const
+		{
+			assert( IsRunning() );
+			return network->GetMaxNodes();
+		}
+
+		bool IsNodeConnected( int nodeId ) const
+		{
+			assert( IsRunning() );
+			return nodeId >= 0 && nodeId < network->GetMaxNodes() && network->IsAttached( nodeId );
+		}
+
+		void SetLinkSettings( const LinkSettings & settings )
+		{
+			assert( IsRunning() );
+			for ( int i = 0; i < (int) links.size(); ++i )
+				links[i].settings = settings;
+		}
+
+		void SetLinkSettings( int nodeId, const LinkSettings & settings )
+		{
+			GetLink( nodeId ).settings = settings;
+		}
+
+		const LinkSettings & GetLinkSettings( int nodeId )
+		{
+			return GetLink( nodeId ).settings;
+		}
+
+		bool SendPacket( int nodeId, const unsigned char data[], int size )
+		{
+			assert( IsRunning() );
+			assert( size <= network->GetMaxPacketSize() );
+			if ( size > network->GetMaxPacketSize() )
+				return false;
+			if ( !IsNodeConnected( nodeId ) )
+				return false;
+
+			sent++;
+
+			Link & link = GetLink( nodeId );
+			const LinkSettings & settings = link.settings;
+
+			if ( settings.packetLoss > 0.0f && link.Random() < settings.packetLoss )
+			{
+				lost++;
+				return true;
+			}
+
+			PacketRing & inbox = network->GetInbox( nodeId );
+			if ( !inbox.Push( localNodeId, link.Delay(), data, size ) )
+			{
+				overflows++;
+				return false;
+			}
+
+			if ( settings.duplicate > 0.0f && link.Random() < settings.duplicate )
+			{
+				if ( inbox.Push( localNodeId, link.Delay(), data, size ) )
+					duplicated++;
+			}
+
+			return true;
+		}
+
+		int ReceivePacket( int & nodeId, unsigned char data[], int size )
+		{
+			assert( IsRunning() );
+			if ( deliveryCount == 0 || deliveries[deliveryHead].time > time )
+				return 0;
+			const int index = deliveries[deliveryHead].packet;
+			deliveryHead = ( deliveryHead + 1 ) % (int) deliveries.size();
+			deliveryCount--;
+			freePackets.push_back( index );
+			const PacketInfo & packet = packets[index];
+			if ( packet.size > size )
+			{
+				// packet does not fit in the callers buffer, drop it
+				discards++;
+				return 0;
+			}
+			nodeId = packet.nodeId;
+			if ( packet.size > 0 )
+				memcpy( data, &packetData[index*network->GetMaxPacketSize()], packet.size );
+			return packet.size;
+		}
+
+		void Update( float deltaTime )
+		{
+			assert( IsRunning() );
+			time += deltaTime;
+			PacketRing & inbox = network->GetInbox( localNodeId );
+			const int maxPacketSize = network->GetMaxPacketSize();
+			while ( true )
+			{
+				// note: with no free packet the inbox is left alone, it fills up and senders see the overflow
+				if ( freePackets.empty() )
+					break;
+				const int index = freePackets.back();
+				PacketInfo & packet = packets[index];
+				float delay = 0.0f;
+				if ( !inbox.Pop( packet.nodeId, delay, &packetData[index*maxPacketSize], packet.size ) )
+					break;
+				freePackets.pop_back();
+				AddDelivery( index, time + delay );
+			}
+		}
+
+		double GetTime() const						{ return time; }
+		int GetPacketsPending() const				{ return deliveryCount; }
+		unsigned int GetPacketsSent() const			{ return sent; }
+		unsigned int GetPacketsLost() const			{ return lost; }
+		unsigned int GetPacketsDuplicated() const	{ return duplicated; }
+		unsigned int GetSendOverflows() const		{ return overflows; }
+		unsigned int GetReceiveDiscards() const		{ return discards; }
+
+	private:
+
+		struct Link
+		{
+			LinkSettings settings;
+			unsigned int random;			// lcg state for this link
+
+			float Random()
+			{
+				// uniform in [0,1) from the high bits, the low bits of an lcg repeat quickly
+				random = random * 1664525 + 1013904223;
+				return ( random >> 8 ) * ( 1.0f / 16777216.0f );
+			}
+
+			float Delay()
+			{
+				if ( settings.jitter <= 0.0f )
+					return settings.latency;
+				return std::max( settings.latency + ( Random() * 2.0f - 1.0f ) * settings.jitter, 0.0f );
+			}
+		};
+
+		struct PacketInfo
+		{
+			int nodeId;
+			int size;
+		};
+
+		struct Delivery
+		{
+			double time;
+			int packet;
+		};
+
+		void ClearData()
+		{
+			freePackets.clear();
+			for ( int i = (int) packets.size() - 1; i >= 0; --i )
+				freePackets.push_back( i );
+			deliveryHead = 0;
+			deliveryCount = 0;
+			time = 0.0;
+			sent = 0;
+			lost = 0;
+			duplicated = 0;
+			overflows = 0;
+			discards = 0;
+		}
+
+		Link & GetLink( int nodeId )
+		{
+			assert( nodeId >= 0 && nodeId < (int) links.size() );
+			return links[nodeId];
+		}
+
+		unsigned int LinkSeed( int from, int to ) const
+		{
+			unsigned int hash = seed ^ 0x9E3779B9;
+			hash = ( hash ^ (unsigned int) from ) * 0x01000193;
+			hash = ( hash ^ (unsigned int) to ) * 0x01000193;
+			hash ^= hash >> 16;
+			return hash;
+		}
+
+		void AddDelivery( int packet, double deliveryTime )
+		{
+			// keep the ring sorted by delivery time. packets mostly come in due order, so this is usually
+			// just an append, and a packet that jitter pushed ahead of others only steps back past those.
+			// equal times keep the order they came out of the inbox
+
+			const int size = (int) deliveries.size();
+			assert( deliveryCount < size );
+			int position = ( deliveryHead + deliveryCount ) % size;
+			for ( int i = deliveryCount; i > 0; --i )
+			{
+				const int previous = ( position + size - 1 ) % size;
+				if ( deliveries[previous].time <= deliveryTime )
+					break;
+				deliveries[position] = deliveries[previous];
+				position = previous;
+			}
+			deliveries[position].time = deliveryTime;
+			deliveries[position].packet = packet;
+			deliveryCount++;
+		}
+
+		unsigned int seed;
+		LoopbackNetwork * network;
+		int localNodeId;
+		double time;
+		std::vector<Link> links;				// outgoing link to each node
+		std::vector<unsigned char> packetData;	// queue size packets of max packet size bytes each
+		std::vector<PacketInfo> packets;
+		std::vector<int> freePackets;			// packets not waiting for delivery, a stack
+		std::vector<Delivery> deliveries;		// packets waiting for delivery, a ring sorted by delivery time
+		int deliveryHead;
+		int deliveryCount;
+
+		unsigned int sent;
+		unsigned int lost;
+		unsigned int duplicated;
+		unsigned int overflows;
+		unsigned int discards;
+	};
+
+	// per peer state for the loopback transport, reliability is created the first time a peer is used
+
+	struct LoopbackPeer
+	{
+		LoopbackPeer()
+		{
+			reliability = NULL;
+			generation = 0;
+		}
+
+		~LoopbackPeer()
+		{
+			delete reliability;
+		}
+
+		ReliabilitySystem * reliability;
+		unsigned int generation;			// peer's network generation when reliability was last reset
+	};
+}
+
+#endif
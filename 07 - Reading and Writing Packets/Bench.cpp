@@ -0,0 +1,305 @@
+/*
+	Benchmarks for Networking Library
+	From "Networking for Game Programmers" - http://www.gaffer.org/networking-for-game-programmers
+	Author: Glenn Fiedler <gaffer@gaffer.org>
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "NetStream.h"
+
+using namespace net;
+
+// simple wall clock timer for benchmarks
+
+class Timer
+{
+public:
+
+	Timer()
+	{
+		Reset();
+	}
+
+	void Reset()
+	{
+		gettimeofday( &start, NULL );
+	}
+
+	double GetSeconds() const
+	{
+		timeval now;
+		gettimeofday( &now, NULL );
+		return ( now.tv_sec - start.tv_sec ) + ( now.tv_usec - start.tv_usec ) / 1000000.0;
+	}
+
+private:
+
+	timeval start;
+};
+
+// -------------------------------------------------------------------------------
+// mixed width values, like a packet full of quantized object state
+// -------------------------------------------------------------------------------
+
+const int PacketSize = 1200;
+const int MaxValues = PacketSize * 8;
+const int Packets = 100000;
+
+int num_values = 0;
+int value_bits[MaxValues];
+unsigned int values[MaxValues];
+int packet_bits = 0;
+
+void generate_values()
+{
+	srand( 0 );
+	const int widths[] = { 1, 1, 3, 7, 10, 12, 16, 18, 32 };
+	num_values = 0;
+	packet_bits = 0;
+	while ( true )
+	{
+		const int bits = widths[ rand() % ( sizeof( widths ) / sizeof( int ) ) ];
+		if ( packet_bits + bits > PacketSize * 8 )
+			break;
+		unsigned int value = (unsigned int) rand() ^ ( (unsigned int) rand() << 16 );
+		if ( bits < 32 )
+			value &= ( 1U << bits ) - 1;
+		value_bits[num_values] = bits;
+		values[num_values] = value;
+		num_values++;
+		packet_bits += bits;
+	}
+}
+
+// -------------------------------------------------------------------------------
+// bitpackers: write then read a packet worth of mixed width values
+// -------------------------------------------------------------------------------
+
+template <typename Packer> void bench_packer( const char * name )
+{
+	static unsigned char buffer[PacketSize];
+
+	unsigned int checksum = 0;
+
+	Timer writeTimer;
+	for ( int packet = 0; packet < Packets; ++packet )
+	{
+		Packer writer( Packer::Write, buffer, PacketSize );
+		for ( int i = 0; i < num_values; ++i )
+			writer.WriteBits( values[i], value_bits[i] );
+		writer.Flush();
+	}
+	const double writeSeconds = writeTimer.GetSeconds();
+
+	Timer readTimer;
+	for ( int packet = 0; packet < Packets; ++packet )
+	{
+		Packer reader( Packer::Read, buffer, PacketSize );
+		for ( int i = 0; i < num_values; ++i )
+		{
+			unsigned int value;
+			reader.ReadBits( value, value_bits[i] );
+			checksum += value;
+		}
+	}
+	const double readSeconds = readTimer.GetSeconds();
+
+	unsigned int expected = 0;
+	for ( int i = 0; i < num_values; ++i )
+		expected += values[i];
+	expected *= Packets;
+
+	const double bits = (double) packet_bits * Packets;
+	printf( "%-16s write %7.1f Mbit/sec, read %7.1f Mbit/sec%s\n", name, bits / writeSeconds / 1000000.0, bits / readSeconds / 1000000.0, checksum == expected ? "" : " (checksum mismatch!)" );
+}
+
+// -------------------------------------------------------------------------------
+// streams: the same values through serialize integer
+// -------------------------------------------------------------------------------
+
+template <typename StreamType> void bench_stream( const char * name )
+{
+	// note: random values don't compress, so leave the range coder room to expand them a little
+	const int BufferSize = PacketSize * 2;
+	static unsigned char buffer[BufferSize];
+
+	unsigned int checksum = 0;
+
+	Timer writeTimer;
+	for ( int packet = 0; packet < Packets; ++packet )
+	{
+		StreamType stream( StreamType::Write, buffer, BufferSize );
+		for ( int i = 0; i < num_values; ++i )
+		{
+			unsigned int value = values[i];
+			const unsigned int max = value_bits[i] < 32 ? ( 1U << value_bits[i] ) - 1 : 0xFFFFFFFF;
+			stream.SerializeInteger( value, 0, max );
+		}
+		stream.Flush();
+	}
+	const double writeSeconds = writeTimer.GetSeconds();
+
+	Timer readTimer;
+	for ( int packet = 0; packet < Packets; ++packet )
+	{
+		StreamType stream( StreamType::Read, buffer, BufferSize );
+		for ( int i = 0; i < num_values; ++i )
+		{
+			unsigned int value = 0;
+			const unsigned int max = value_bits[i] < 32 ? ( 1U << value_bits[i] ) - 1 : 0xFFFFFFFF;
+			stream.SerializeInteger( value, 0, max );
+			checksum += value;
+		}
+	}
+	const double readSeconds = readTimer.GetSeconds();
+
+	unsigned int expected = 0;
+	for ( int i = 0; i < num_values; ++i )
+		expected += values[i];
+	expected *= Packets;
+
+	const double bits = (double) packet_bits * Packets;
+	printf( "%-16s write %7.1f Mbit/sec, read %7.1f Mbit/sec%s\n", name, bits / writeSeconds / 1000000.0, bits / readSeconds / 1000000.0, checksum == expected ? "" : " (checksum mismatch!)" );
+}
+
+// -------------------------------------------------------------------------------
+// object updates: hand written serialize vs. compile time schema
+// -------------------------------------------------------------------------------
+
+struct ObjectUpdate
+{
+	unsigned short id;
+	bool interacting;
+	int x, y, z;
+	unsigned char authority;
+	float orientation;
+	
+	template <typename Stream> bool Serialize( Stream & stream )
+	{
+		unsigned int value = id;
+		stream.SerializeInteger( value, 0, 1023 );
+		id = (unsigned short) value;
+		stream.SerializeBoolean( interacting );
+		stream.SerializeInteger( x, -32768, 32767 );
+		stream.SerializeInteger( y, -32768, 32767 );
+		stream.SerializeInteger( z, -512, 511 );
+		stream.SerializeByte( authority, 0, 4 );
+		stream.SerializeFloat( orientation );
+		return true;
+	}
+	
+	typedef Schema< IntegerField<ObjectUpdate, unsigned short, &ObjectUpdate::id, 0, 1023>,
+			Schema< BooleanField<ObjectUpdate, &ObjectUpdate::interacting>,
+			Schema< SignedIntegerField<ObjectUpdate, int, &ObjectUpdate::x, -32768, 32767>,
+			Schema< SignedIntegerField<ObjectUpdate, int, &ObjectUpdate::y, -32768, 32767>,
+			Schema< SignedIntegerField<ObjectUpdate, int, &ObjectUpdate::z, -512, 511>,
+			Schema< IntegerField<ObjectUpdate, unsigned char, &ObjectUpdate::authority, 0, 4>,
+			Schema< FloatField<ObjectUpdate, &ObjectUpdate::orientation> > > > > > > > Layout;
+};
+
+template <typename StreamType, bool UseSchema> void bench_schema( const char * name, unsigned char * output )
+{
+	const int NumObjects = PacketSize * 8 / ObjectUpdate::Layout::Bits;
+	static ObjectUpdate objects[NumObjects];
+	static unsigned char buffer[PacketSize];
+
+	srand( 0 );
+	for ( int i = 0; i < NumObjects; ++i )
+	{
+		objects[i].id = rand() % 1024;
+		objects[i].interacting = rand() % 2 != 0;
+		objects[i].x = rand() % 65536 - 32768;
+		objects[i].y = rand() % 65536 - 32768;
+		objects[i].z = rand() % 1024 - 512;
+		objects[i].authority = rand() % 5;
+		objects[i].orientation = ( rand() % 1000 ) / 1000.0f;
+	}
+
+	Timer writeTimer;
+	for ( int packet = 0; packet < Packets; ++packet )
+	{
+		StreamType stream( StreamType::Write, buffer, PacketSize );
+		for ( int i = 0; i < NumObjects; ++i )
+		{
+			if ( UseSchema )
+				ObjectUpdate::Layout::Serialize( stream, objects[i] );
+			else
+				objects[i].Serialize( stream );
+		}
+		stream.Flush();
+	}
+	const double writeSeconds = writeTimer.GetSeconds();
+
+	unsigned int checksum = 0;
+	Timer readTimer;
+	for ( int packet = 0; packet < Packets; ++packet )
+	{
+		StreamType stream( StreamType::Read, buffer, PacketSize );
+		for ( int i = 0; i < NumObjects; ++i )
+		{
+			ObjectUpdate object = ObjectUpdate();
+			if ( UseSchema )
+				ObjectUpdate::Layout::Serialize( stream, object );
+			else
+				object.Serialize( stream );
+			checksum += object.x;
+		}
+	}
+	const double readSeconds = readTimer.GetSeconds();
+
+	unsigned int expected = 0;
+	for ( int i = 0; i < NumObjects; ++i )
+		expected += objects[i].x;
+	expected *= Packets;
+
+	memcpy( output, buffer, PacketSize );
+
+	const double updates = (double) NumObjects * Packets;
+	printf( "%-24s write %6.1f M updates/sec, read %6.1f M updates/sec (%d bits each)%s\n", name, updates / writeSeconds / 1000000.0, updates / readSeconds / 1000000.0, 
+		(int) ObjectUpdate::Layout::Bits, checksum == expected ? "" : " (checksum mismatch!)" );
+}
+
+// -------------------------------------------------------------------------------
+
+int main( int argc, char * argv[] )
+{
+	generate_values();
+
+	printf( "-----------------------------------------------------\n" );
+	printf( "bench bitpacker (%d byte packets, %d values from 1 to 32 bits)\n", PacketSize, num_values );
+	printf( "-----------------------------------------------------\n" );
+
+	bench_packer<BitPacker>( "bit packer" );
+	bench_packer<WordBitPacker>( "word bit packer" );
+
+	printf( "-----------------------------------------------------\n" );
+	printf( "bench stream serialize integer\n" );
+	printf( "-----------------------------------------------------\n" );
+
+	bench_stream<Stream>( "stream" );
+	bench_stream<WordStream>( "word stream" );
+	bench_stream<RangeStream>( "range stream" );
+
+	printf( "-----------------------------------------------------\n" );
+	printf( "bench object updates: hand written vs. schema\n" );
+	printf( "-----------------------------------------------------\n" );
+
+	static unsigned char handWritten[PacketSize];
+	static unsigned char schema[PacketSize];
+
+	bench_schema<Stream,false>( "stream hand written", handWritten );
+	bench_schema<Stream,true>( "stream schema", schema );
+	if ( memcmp( handWritten, schema, PacketSize ) != 0 )
+		printf( "stream schema output differs from hand written!\n" );
+
+	bench_schema<WordStream,false>( "word stream hand written", handWritten );
+	bench_schema<WordStream,true>( "word stream schema", schema );
+	if ( memcmp( handWritten, schema, PacketSize ) != 0 )
+		printf( "word stream schema output differs from hand written!\n" );
+
+	return 0;
+}
@@ -28,17 +28,23 @@ struct ExampleA
 	unsigned int intValue;
 	float floatValue;
 	
-	bool Serialize( Stream & stream, GameMode mode )
+	// fixed layout, so the schema works out its bits at compile time
+	
+	typedef net::Schema< net::BooleanField<ExampleA, &ExampleA::booleanValue>,
+			net::Schema< net::IntegerField<ExampleA, unsigned char, &ExampleA::byteValue, 0, 0xFF>,
+			net::Schema< net::IntegerField<ExampleA, unsigned short, &ExampleA::shortValue, 0, 0xFFFF>,
+			net::Schema< net::IntegerField<ExampleA, unsigned int, &ExampleA::intValue, 0, 0xFFFFFFFF>,
+			net::Schema< net::FloatField<ExampleA, &ExampleA::floatValue> > > > > > Layout;
+	
+	template <typename Stream> bool Serialize( Stream & stream, GameMode mode )
 	{
 		int bits_before = stream.GetBitsProcessed();
-		stream.SerializeBoolean( booleanValue );
-		stream.SerializeByte( byteValue );
-		stream.SerializeShort( shortValue );
-		stream.SerializeInteger( intValue );
-		stream.SerializeFloat( floatValue );
+		if ( !Layout::Serialize( stream, *this ) )
+			return false;
 		int bits_after = stream.GetBitsProcessed();
 		int serialized_bits = bits_after - bits_before;
-		assert( serialized_bits == 1 + 8 + 16 + 32 + 32 );
+		assert( Layout::Bits == 1 + 8 + 16 + 32 + 32 );
+		assert( serialized_bits == Layout::Bits );
 		return true;
 	}
 };
@@ -47,7 +53,7 @@ struct ExampleB
 {
 	float health;
 	
-	bool Serialize( Stream & stream, GameMode mode )
+	template <typename Stream> bool Serialize( Stream & stream, GameMode mode )
 	{
 		bool dead = stream.IsWriting() && health < 0.001f;
 		stream.SerializeBoolean( dead );
@@ -62,11 +68,13 @@ struct ExampleC
 	unsigned char count;
 	unsigned int values[15];
 	
-	bool Serialize( Stream & stream, GameMode mode )
+	template <typename Stream> bool Serialize( Stream & stream, GameMode mode )
 	{
 		stream.SerializeByte( count, 0, 15 );
+		// the values are full range but mostly small, so the range coder codes their magnitude adaptively
+		FrequencyModel magnitude( 33 );
 		for ( int i = 0; i < count; ++i )
-			stream.SerializeInteger( values[i] );
+			stream.SerializeInteger( values[i], 0, 0xFFFFFFFF, magnitude );
 		return true;
 	}
 };
@@ -76,7 +84,7 @@ struct ExampleD
 	unsigned int clientToServerData;
 	unsigned int serverToClientData;
 	
-	bool Serialize( Stream & stream, GameMode mode )
+	template <typename Stream> bool Serialize( Stream & stream, GameMode mode )
 	{
 		if ( mode == Client && stream.IsWriting() || mode == Server && stream.IsReading() )
 			stream.SerializeInteger( clientToServerData );
@@ -91,7 +99,7 @@ struct ExampleE
 	char stringOne[64];
 	char stringTwo[64];
 	
-	bool Serialize( Stream & stream, GameMode mode )
+	template <typename Stream> bool Serialize( Stream & stream, GameMode mode )
 	{
 		for ( int i = 0; i < (int) sizeof(stringOne); ++i )
 		{
@@ -133,7 +141,7 @@ struct Object
 		this->bits = bits;
 	}
 	
-	bool Serialize( Stream & stream )
+	template <typename Stream> bool Serialize( Stream & stream )
 	{
 		stream.SerializeByte( id, 0, MaxObjects - 1 );
 		unsigned int value = 0xFFFFFFFF;
@@ -148,7 +156,7 @@ struct ExampleF
 	unsigned int count;
 	Object objects[MaxObjects];
 	
-	bool Serialize( Stream & stream, GameMode mode )
+	template <typename Stream> bool Serialize( Stream & stream, GameMode mode )
 	{
 		unsigned char tmp[256];
 
@@ -201,7 +209,7 @@ struct ExampleG
 	struct X
 	{
 		float one,two,three;
-		bool Serialize( Stream & stream, GameMode mode )
+		template <typename Stream> bool Serialize( Stream & stream, GameMode mode )
 		{
 			stream.SerializeFloat( one );
 			stream.SerializeFloat( two );
@@ -214,7 +222,7 @@ struct ExampleG
 	{
 		int left;
 		int right;
-		bool Serialize( Stream & stream, GameMode mode )
+		template <typename Stream> bool Serialize( Stream & stream, GameMode mode )
 		{
 			stream.SerializeInteger( left );
 			stream.SerializeInteger( right );
@@ -225,7 +233,7 @@ struct ExampleG
 	struct Z
 	{
 		bool testing;
-		bool Serialize( Stream & stream, GameMode mode )
+		template <typename Stream> bool Serialize( Stream & stream, GameMode mode )
 		{
 			stream.SerializeBoolean( testing );
 			return true;
@@ -286,7 +294,7 @@ struct ExampleG
 		EnumValue = (EnumType) value;														\
 	}
 
-	bool Serialize( Stream & stream, GameMode mode )
+	template <typename Stream> bool Serialize( Stream & stream, GameMode mode )
 	{
 		SERIALIZE_ENUM( stream, dataType, DataType, DataTypeMax );
 		
@@ -304,6 +312,19 @@ struct ExampleG
 
 class ExampleH
 {
+public:
+
+	ExampleH()
+	{
+		a = 5;
+		b = 2;
+		c = 1;
+		d = 1000;
+		e = 17;
+	}
+
+private:
+
 	unsigned int a : 3;
 	unsigned int b : 2;
 	unsigned int c : 1;
@@ -318,7 +339,9 @@ class ExampleH
 		bitfield = value;											\
 	}
 
-	bool Serialize( Stream & stream, GameMode mode )
+public:
+
+	template <typename Stream> bool Serialize( Stream & stream, GameMode mode )
 	{
 		SERIALIZE_BITFIELD( stream, a, 3 );
 		SERIALIZE_BITFIELD( stream, b, 2 );
@@ -387,10 +410,8 @@ struct GameData
 	ExampleF f;
 	ExampleG g;
 	
-	bool Serialize( Stream & stream )
+	template <typename Stream> bool Serialize( Stream & stream )
 	{
-		printf( "serialize packet (%s %s)\n", mode == Server ? "server" : "client", stream.IsReading() ? "read" : "write" );
-		
 		stream.Checkpoint();
 
 		if ( !a.Serialize( stream, mode ) )
@@ -420,6 +441,37 @@ struct GameData
 	}
 };
 
+// bytes per snapshot with the bitpacker and with the arithmetic coder as stream backend
+
+template <typename Stream, typename T> int MeasureBytes( T & data, GameMode mode, int count = 1 )
+{
+	unsigned char buffer[4096];
+	Stream stream( Stream::Write, buffer, sizeof(buffer) );
+	for ( int i = 0; i < count; ++i )
+		data.Serialize( stream, mode );
+	stream.Flush();
+	return stream.GetDataBytes();
+}
+
+template <typename T> void ReportBytes( const char * name, T & data, GameMode mode, int count = 1 )
+{
+	const int bitpacked = MeasureBytes<Stream>( data, mode, count );
+	const int rangecoded = MeasureBytes<RangeStream>( data, mode, count );
+	printf( " %-24s %4d bytes bitpacked, %4d bytes range coded (%+.0f%%)\n", name, bitpacked, rangecoded, ( rangecoded - bitpacked ) * 100.0f / bitpacked );
+}
+
+struct GameDataSnapshot
+{
+	GameData & data;
+
+	GameDataSnapshot( GameData & data ) : data( data ) {}
+
+	template <typename Stream> bool Serialize( Stream & stream, GameMode mode )
+	{
+		return data.Serialize( stream );
+	}
+};
+
 int main( int argc, char * argv[] )
 {
 	GameData server_game( Server );
@@ -435,8 +487,10 @@ int main( int argc, char * argv[] )
 	int buffer_bytes_written = 0;
 	int journal_bytes_written = 0;
 	{
+		printf( "serialize packet (server write)\n" );
 		Stream stream( Stream::Write, server_buffer, sizeof(server_buffer), server_journal, sizeof(server_journal) );
 		server_game.Serialize( stream );
+		stream.Flush();
 		buffer_bytes_written = stream.GetDataBytes();
 		journal_bytes_written = stream.GetJournalBytes();
 	}
@@ -456,6 +510,7 @@ int main( int argc, char * argv[] )
 	int client_buffer_bytes_read = 0;
 	int client_journal_bytes_read = 0;
 	{
+		printf( "serialize packet (client read)\n" );
 		Stream stream( Stream::Read, client_buffer, buffer_bytes_read, client_journal, journal_bytes_read );
 		client_game.Serialize( stream );
 		client_buffer_bytes_read = stream.GetDataBytes();
@@ -467,5 +522,28 @@ int main( int argc, char * argv[] )
 
 	// todo: send it back the other way ...
 
+	// bytes per snapshot for each backend
+
+	printf( "bytes per snapshot:\n" );
+	{
+		GameData server( Server );
+		GameData client( Client );
+		ExampleH h;
+		ReportBytes( "ExampleA", server.a, Server );
+		ReportBytes( "ExampleB", server.b, Server );
+		ReportBytes( "ExampleC (server)", server.c, Server );
+		ReportBytes( "ExampleC (client)", client.c, Client );
+		ReportBytes( "ExampleD", server.d, Server );
+		ReportBytes( "ExampleE", server.e, Server );
+		ReportBytes( "ExampleF", server.f, Server );
+		ReportBytes( "ExampleG", server.g, Server );
+		ReportBytes( "ExampleH", h, Server );
+		GameDataSnapshot serverSnapshot( server );
+		ReportBytes( "GameData (server)", serverSnapshot, Server );
+		ReportBytes( "GameData (server) x 8", serverSnapshot, Server, 8 );
+	}
+
+	printf( "--------------------------------------------\n" );
+
 	return 0;
 }
@@ -110,6 +110,11 @@ namespace net
 			}
 		}
 		
+		void Flush()
+		{
+			// note: bits go straight into the buffer, so there is nothing to flush
+		}
+		
 		void * GetData()
 		{
 			return buffer;
@@ -149,8 +154,311 @@ namespace net
 		Mode mode;
 	};
 	
+	// word at a time bitpacker class
+	//  + same interface and bit layout as the bitpacker, but bits are gathered in a 64 bit scratch word
+	//  + written a 32 bit little endian word at a time, and read back the same way
+	//  + call flush when done writing to store any bits still in the scratch word
+	//  + the buffer is not cleared on write, so there is no memset of the whole packet up front
+	
+	class WordBitPacker
+	{
+	public:
+		
+		enum Mode
+		{
+			Read,
+			Write
+		};
+		
+		WordBitPacker( Mode mode, void * buffer, int bytes )
+		{
+			assert( bytes >= 0 );
+			this->mode = mode;
+			this->buffer = (unsigned char*) buffer;
+			this->bytes = bytes;
+			scratch = 0;
+			scratch_bits = 0;
+			word_index = 0;
+			bits_processed = 0;
+		}
+		
+		void WriteBits( unsigned int value, int bits = 32 )
+		{
+			assert( buffer );
+			assert( bits > 0 );
+			assert( bits <= 32 );
+			assert( mode == Write );
+			assert( bits_processed + bits <= bytes * 8 );
+			if ( bits < 32 )
+				value &= ( 1U << bits ) - 1;
+			scratch |= (unsigned long long) value << scratch_bits;
+			scratch_bits += bits;
+			bits_processed += bits;
+			if ( scratch_bits >= 32 )
+			{
+				WriteWord( (unsigned int) scratch );
+				scratch >>= 32;
+				scratch_bits -= 32;
+			}
+		}
+		
+		void ReadBits( unsigned int & value, int bits = 32 )
+		{
+			assert( buffer );
+			assert( bits > 0 );
+			assert( bits <= 32 );
+			assert( mode == Read );
+			assert( bits_processed + bits <= bytes * 8 );
+			if ( scratch_bits < bits )
+			{
+				scratch |= (unsigned long long) ReadWord() << scratch_bits;
+				scratch_bits += 32;
+			}
+			value = (unsigned int) scratch;
+			if ( bits < 32 )
+				value &= ( 1U << bits ) - 1;
+			scratch >>= bits;
+			scratch_bits -= bits;
+			bits_processed += bits;
+		}
+		
+		void Flush()
+		{
+			// store the bytes still in the scratch word, writing may carry on afterwards
+			if ( mode == Write )
+			{
+				unsigned char * ptr = buffer + word_index;
+				unsigned long long value = scratch;
+				for ( int i = 0; i < ( scratch_bits + 7 ) / 8; ++i )
+				{
+					assert( ptr + i < buffer + bytes );
+					ptr[i] = (unsigned char) value;
+					value >>= 8;
+				}
+			}
+		}
+		
+		void * GetData()
+		{
+			return buffer;
+		}
+		
+		int GetBits() const
+		{
+			return bits_processed;
+		}
+		
+		int GetBytes() const
+		{
+			return ( bits_processed + 7 ) / 8;
+		}
+		
+		int BitsRemaining() const
+		{
+			return bytes * 8 - bits_processed;
+		}
+		
+		Mode GetMode() const
+		{
+			return mode;
+		}
+		
+		bool IsValid() const
+		{
+			return buffer != NULL;
+		}
+		
+	private:
+		
+		void WriteWord( unsigned int value )
+		{
+			assert( word_index + 4 <= bytes );
+			unsigned char * ptr = buffer + word_index;
+			ptr[0] = (unsigned char) value;
+			ptr[1] = (unsigned char) ( value >> 8 );
+			ptr[2] = (unsigned char) ( value >> 16 );
+			ptr[3] = (unsigned char) ( value >> 24 );
+			word_index += 4;
+		}
+		
+		unsigned int ReadWord()
+		{
+			// note: the last word of the buffer may be partial, missing bytes read as zero
+			const unsigned char * ptr = buffer + word_index;
+			unsigned int value = 0;
+			if ( word_index + 4 <= bytes )
+			{
+				value = (unsigned int) ptr[0] | ( (unsigned int) ptr[1] << 8 ) | ( (unsigned int) ptr[2] << 16 ) | ( (unsigned int) ptr[3] << 24 );
+			}
+			else
+			{
+				for ( int i = 0; i < bytes - word_index; ++i )
+					value |= (unsigned int) ptr[i] << ( i * 8 );
+			}
+			word_index += 4;
+			return value;
+		}
+		
+		unsigned long long scratch;
+		int scratch_bits;
+		int word_index;
+		int bits_processed;
+		unsigned char * buffer;
+		int bytes;
+		Mode mode;
+	};
+	
+	// frequency model for the arithmetic coder
+	//  + static: frequencies are set up front and never change, eg. from a measured distribution
+	//  + adaptive: starts flat and counts each symbol as it is coded, so values that repeat get cheaper
+	//  + the reader must use the same model as the writer, coding the same symbols in the same order
+	//  + cumulative frequencies live in a fenwick tree, so finding, coding and counting a symbol are O(log n)
+	
+	class FrequencyModel
+	{
+	public:
+		
+		enum { MaxSymbols = 256 };
+		enum { MaxTotal = 1 << 16 };			// must not exceed the coder bottom value
+		enum { Increment = 24 };
+		
+		FrequencyModel( int numSymbols = 2, bool adaptive = true )
+		{
+			Reset( numSymbols, adaptive );
+		}
+		
+		void Reset( int numSymbols, bool adaptive )
+		{
+			assert( numSymbols >= 2 );
+			assert( numSymbols <= MaxSymbols );
+			this->numSymbols = numSymbols;
+			this->adaptive = adaptive;
+			for ( int i = 0; i < numSymbols; ++i )
+				frequency[i] = 1;
+			BuildTree();
+		}
+		
+		void SetFrequency( int symbol, unsigned int value )
+		{
+			assert( symbol >= 0 );
+			assert( symbol < numSymbols );
+			assert( value >= 1 );
+			total = total - frequency[symbol] + value;
+			assert( total <= MaxTotal );
+			// note: the tree works modulo 2^32, so adding the difference is fine even when the frequency goes down
+			AddToTree( symbol, value - frequency[symbol] );
+			frequency[symbol] = value;
+		}
+		
+		void GetRange( int symbol, unsigned int & cumulative, unsigned int & symbolFrequency ) const
+		{
+			assert( symbol >= 0 );
+			assert( symbol < numSymbols );
+			cumulative = 0;
+			for ( int i = symbol; i > 0; i -= i & -i )
+				cumulative += tree[i];
+			symbolFrequency = frequency[symbol];
+		}
+		
+		int FindSymbol( unsigned int target, unsigned int & cumulative, unsigned int & symbolFrequency ) const
+		{
+			// walk down the tree to the last symbol whose cumulative frequency is <= target
+			assert( target < total );
+			int symbol = 0;
+			unsigned int remaining = target;
+			for ( int step = treeStep; step > 0; step >>= 1 )
+			{
+				const int next = symbol + step;
+				if ( next <= numSymbols && tree[next] <= remaining )
+				{
+					symbol = next;
+					remaining -= tree[next];
+				}
+			}
+			assert( symbol < numSymbols );
+			cumulative = target - remaining;
+			symbolFrequency = frequency[symbol];
+			return symbol;
+		}
+		
+		void Update( int symbol )
+		{
+			if ( !adaptive )
+				return;
+			if ( total + Increment > MaxTotal )
+			{
+				// rescale so recent symbols count for more than old ones
+				for ( int i = 0; i < numSymbols; ++i )
+					frequency[i] = ( frequency[i] + 1 ) / 2;
+				BuildTree();
+			}
+			frequency[symbol] += Increment;
+			total += Increment;
+			AddToTree( symbol, Increment );
+		}
+		
+		unsigned int GetTotal() const
+		{
+			return total;
+		}
+		
+		int GetNumSymbols() const
+		{
+			return numSymbols;
+		}
+		
+		bool IsAdaptive() const
+		{
+			return adaptive;
+		}
+		
+	private:
+		
+		void BuildTree()
+		{
+			// tree[i] holds the sum of the frequencies of symbols ( i - lowbit(i), i ], one based
+			total = 0;
+			tree[0] = 0;
+			for ( int i = 1; i <= numSymbols; ++i )
+			{
+				tree[i] = frequency[i-1];
+				total += frequency[i-1];
+			}
+			for ( int i = 1; i <= numSymbols; ++i )
+			{
+				const int parent = i + ( i & -i );
+				if ( parent <= numSymbols )
+					tree[parent] += tree[i];
+			}
+			treeStep = 1;
+			while ( treeStep * 2 <= numSymbols )
+				treeStep *= 2;
+		}
+		
+		void AddToTree( int symbol, unsigned int value )
+		{
+			for ( int i = symbol + 1; i <= numSymbols; i += i & -i )
+				tree[i] += value;
+		}
+		
+		int numSymbols;
+		int treeStep;
+		bool adaptive;
+		unsigned int total;
+		unsigned int frequency[MaxSymbols];
+		unsigned int tree[MaxSymbols+1];
+	};
+	
 	// arithmetic coder
-	//  + todo: implement arithmetic coder based on jon blow's game developer article
+	//  + 32 bit carryless range coder (after dmitry subbotin), codes symbols in fractional bits
+	//  + integers can be coded uniformly in a [min,max] range, or as symbols with a static or adaptive model
+	//  + also implements the bitpacker interface so a stream can use it as its backend:
+	//    each value is coded uniformly over its exact range, so never takes more than the bits a bitpacker would,
+	//    unless the field passes in an adaptive model of its own (see BasicStream::SerializeInteger)
+	//  + a field too wide for its model has the model code its magnitude (number of significant bits),
+	//    and the bits below the leading one are coded uniformly. small values in a wide field get cheap
+	//  + bits reports logical bits serialized (as a bitpacker would), bytes reports coded bytes
+	//  + call flush when done writing, it stores the fewest bytes that identify the final range
 	
 	class ArithmeticCoder
 	{
@@ -162,39 +470,314 @@ namespace net
 			Write
 		};
 		
-		ArithmeticCoder( Mode mode, void * buffer, unsigned int size )
+		ArithmeticCoder( Mode mode, void * buffer, int bytes )
 		{
-			assert( buffer );
-			assert( size >= 0 );
+			assert( bytes >= 0 );
 			this->mode = mode;
 			this->buffer = (unsigned char*) buffer;
-			this->size = size;
+			this->bytes = bytes;
+			low = 0;
+			range = 0xFFFFFFFF;
+			code = 0;
+			byte_index = 0;
+			bits_processed = 0;
+			overflow = false;
+			flushed = false;
+			if ( mode == Read && buffer )
+			{
+				for ( int i = 0; i < 4; ++i )
+					code = ( code << 8 ) | InputByte();
+			}
 		}
-
+		
+		void Encode( unsigned int cumulative, unsigned int frequency, unsigned int total )
+		{
+			assert( mode == Write );
+			assert( !flushed );
+			assert( frequency > 0 );
+			assert( cumulative + frequency <= total );
+			assert( total <= Bottom );
+			range /= total;
+			low += cumulative * range;
+			range *= frequency;
+			while ( ( low ^ ( low + range ) ) < Top || ( range < Bottom && ( ( range = -low & ( Bottom - 1 ) ), true ) ) )
+			{
+				OutputByte( (unsigned char) ( low >> 24 ) );
+				low <<= 8;
+				range <<= 8;
+			}
+		}
+		
+		unsigned int DecodeTarget( unsigned int total )
+		{
+			// first half of decoding a symbol: find where the code lies in [0,total)
+			assert( mode == Read );
+			assert( total <= Bottom );
+			range /= total;
+			const unsigned int target = ( code - low ) / range;
+			return target < total ? target : total - 1;
+		}
+		
+		void Decode( unsigned int cumulative, unsigned int frequency )
+		{
+			// second half: consume the symbol found at the target
+			assert( mode == Read );
+			assert( frequency > 0 );
+			low += cumulative * range;
+			range *= frequency;
+			while ( ( low ^ ( low + range ) ) < Top || ( range < Bottom && ( ( range = -low & ( Bottom - 1 ) ), true ) ) )
+			{
+				code = ( code << 8 ) | InputByte();
+				low <<= 8;
+				range <<= 8;
+			}
+		}
+		
 		bool WriteInteger( unsigned int value, unsigned int minimum = 0, unsigned int maximum = 0xFFFFFFFF )
 		{
-			// ...
-			return false;
+			assert( minimum < maximum );
+			assert( value >= minimum );
+			assert( value <= maximum );
+			EncodeUniform( value - minimum, (unsigned long long) ( maximum - minimum ) + 1 );
+			return !overflow;
+		}
+		
+		bool ReadInteger( unsigned int & value, unsigned int minimum = 0, unsigned int maximum = 0xFFFFFFFF )
+		{
+			assert( minimum < maximum );
+			value = DecodeUniform( (unsigned long long) ( maximum - minimum ) + 1 ) + minimum;
+			if ( value < minimum || value > maximum )
+				return false;
+			return !overflow;
+		}
+		
+		bool WriteSymbol( int symbol, FrequencyModel & model )
+		{
+			unsigned int cumulative, frequency;
+			model.GetRange( symbol, cumulative, frequency );
+			Encode( cumulative, frequency, model.GetTotal() );
+			model.Update( symbol );
+			return !overflow;
+		}
+		
+		bool ReadSymbol( int & symbol, FrequencyModel & model )
+		{
+			unsigned int cumulative, frequency;
+			symbol = model.FindSymbol( DecodeTarget( model.GetTotal() ), cumulative, frequency );
+			Decode( cumulative, frequency );
+			model.Update( symbol );
+			return !overflow;
+		}
+		
+		void WriteBits( unsigned int value, int bits = 32 )
+		{
+			assert( bits > 0 );
+			assert( bits <= 32 );
+			const unsigned int mask = bits < 32 ? ( 1U << bits ) - 1 : 0xFFFFFFFF;
+			WriteValue( value & mask, bits, mask );
+		}
+		
+		void ReadBits( unsigned int & value, int bits = 32 )
+		{
+			assert( bits > 0 );
+			assert( bits <= 32 );
+			ReadValue( value, bits, bits < 32 ? ( 1U << bits ) - 1 : 0xFFFFFFFF );
+		}
+		
+		// stream backend: code a value in [0,maximum] that a bitpacker would write in "bits" bits.
+		// with a model the value is coded as a symbol, or its magnitude is if the range has more values 
+		// than the model has symbols. either way the model learns only from this field
+		
+		void WriteValue( unsigned int value, int bits, unsigned int maximum, FrequencyModel * model = NULL )
+		{
+			assert( bits > 0 );
+			assert( bits <= 32 );
+			assert( value <= maximum );
+			if ( model && (unsigned int) model->GetNumSymbols() > maximum )
+			{
+				WriteSymbol( (int) value, *model );
+			}
+			else if ( model )
+			{
+				assert( model->GetNumSymbols() > bits );
+				int magnitude = 0;
+				while ( magnitude < 32 && ( value >> magnitude ) != 0 )
+					magnitude++;
+				WriteSymbol( magnitude, *model );
+				if ( magnitude > 1 )
+					EncodeUniform( value & ( ( 1U << ( magnitude - 1 ) ) - 1 ), 1ULL << ( magnitude - 1 ) );
+			}
+			else
+				EncodeUniform( value, (unsigned long long) maximum + 1 );
+			bits_processed += bits;
 		}
 		
-		bool ReadInteger( unsigned int value, unsigned int minimum = 0, unsigned int maximum = 0xFFFFFFFF )
+		void ReadValue( unsigned int & value, int bits, unsigned int maximum, FrequencyModel * model = NULL )
 		{
-			// ...
-			return false;
+			assert( bits > 0 );
+			assert( bits <= 32 );
+			if ( model && (unsigned int) model->GetNumSymbols() > maximum )
+			{
+				int symbol = 0;
+				ReadSymbol( symbol, *model );
+				value = (unsigned int) symbol;
+			}
+			else if ( model )
+			{
+				assert( model->GetNumSymbols() > bits );
+				int magnitude = 0;
+				ReadSymbol( magnitude, *model );
+				if ( magnitude > bits )
+					value = 0xFFFFFFFF;				// note: corrupt data, the stream rejects it as out of range
+				else if ( magnitude > 1 )
+					value = ( 1U << ( magnitude - 1 ) ) | DecodeUniform( 1ULL << ( magnitude - 1 ) );
+				else
+					value = (unsigned int) magnitude;
+			}
+			else
+				value = DecodeUniform( (unsigned long long) maximum + 1 );
+			bits_processed += bits;
+		}
+		
+		void Flush()
+		{
+			// any value in [low,low+range) identifies the final range and the reader pads with zeros,
+			// so store the value in that range with the most trailing zero bytes, leaving them off
+			if ( mode != Write || flushed )
+				return;
+			flushed = true;
+			const unsigned long long end = (unsigned long long) low + range;
+			for ( int n = 1; n <= 4; ++n )
+			{
+				const unsigned long long mask = ( 1ULL << ( 32 - n * 8 ) ) - 1;
+				const unsigned long long value = ( (unsigned long long) low + mask ) & ~mask;
+				if ( value < end && value <= 0xFFFFFFFFULL )
+				{
+					for ( int i = 0; i < n; ++i )
+						OutputByte( (unsigned char) ( value >> ( 24 - i * 8 ) ) );
+					return;
+				}
+			}
+			for ( int i = 0; i < 4; ++i )
+				OutputByte( (unsigned char) ( low >> ( 24 - i * 8 ) ) );
+		}
+		
+		void * GetData()
+		{
+			return buffer;
+		}
+		
+		int GetBits() const
+		{
+			return bits_processed;
+		}
+		
+		int GetBytes() const
+		{
+			// note: when writing this is exact once flushed, before that the range still holds up to four bytes
+			if ( mode == Write )
+				return flushed ? byte_index : std::min( byte_index + 4, bytes );
+			return std::min( byte_index, bytes );
+		}
+		
+		int BitsRemaining() const
+		{
+			// note: coded bits are not logical bits. when writing this is the room left for coded bits,
+			// when reading there is no way to tell, so it reports room for one more value until the input runs out
+			if ( overflow )
+				return 0;
+			if ( mode == Write )
+				return std::max( 0, bytes - byte_index - 4 ) * 8;
+			return 32;
+		}
+		
+		Mode GetMode() const
+		{
+			return mode;
+		}
+		
+		bool IsValid() const
+		{
+			return buffer != NULL;
+		}
+		
+		bool IsOverflow() const
+		{
+			return overflow;
 		}
 		
 	private:
 		
+		enum { Top = 1 << 24 };
+		enum { Bottom = 1 << 16 };
+		
+		void EncodeUniform( unsigned int value, unsigned long long count )
+		{
+			// totals are limited to 16 bits, so wider ranges are coded 16 bits at a time, high part first
+			if ( count <= Bottom )
+			{
+				Encode( value, 1, (unsigned int) count );
+				return;
+			}
+			EncodeUniform( value >> 16, ( ( count - 1 ) >> 16 ) + 1 );
+			Encode( value & 0xFFFF, 1, Bottom );
+		}
+		
+		unsigned int DecodeUniform( unsigned long long count )
+		{
+			if ( count <= Bottom )
+			{
+				const unsigned int value = DecodeTarget( (unsigned int) count );
+				Decode( value, 1 );
+				return value;
+			}
+			const unsigned int high = DecodeUniform( ( ( count - 1 ) >> 16 ) + 1 );
+			const unsigned int value = DecodeTarget( Bottom );
+			Decode( value, 1 );
+			return ( high << 16 ) | value;
+		}
+		
+		void OutputByte( unsigned char value )
+		{
+			if ( byte_index >= bytes )
+			{
+				overflow = true;
+				return;
+			}
+			buffer[byte_index++] = value;
+		}
+		
+		unsigned char InputByte()
+		{
+			// note: the writer leaves trailing zero bytes off, and the reader reads four bytes ahead
+			if ( byte_index >= bytes )
+			{
+				if ( byte_index++ >= bytes + 4 )
+					overflow = true;
+				return 0;
+			}
+			return buffer[byte_index++];
+		}
+		
+		unsigned int low;
+		unsigned int range;
+		unsigned int code;
+		int byte_index;
+		int bits_processed;
+		bool overflow;
+		bool flushed;
 		unsigned char * buffer;
-		int size;
+		int bytes;
 		Mode mode;
 	};
 	
 	// stream class
 	//  + unifies read and write into a serialize operation
 	//  + provides attribution of stream for debugging purposes
+	//  + templated on the backend used for data: bitpacker, word bitpacker or arithmetic coder
+	//  + the journal always uses the byte at a time bitpacker
 	
-	class Stream
+	template <typename Packer> class BasicStream
 	{
 	public:
 		
@@ -204,8 +787,8 @@ namespace net
 			Write
 		};
 		
-		Stream( Mode mode, void * buffer, int bytes, void * journal_buffer = NULL, int journal_bytes = 0 )
-			: bitpacker( mode == Write ? BitPacker::Write : BitPacker::Read, buffer, bytes ), 
+		BasicStream( Mode mode, void * buffer, int bytes, void * journal_buffer = NULL, int journal_bytes = 0 )
+			: bitpacker( mode == Write ? Packer::Write : Packer::Read, buffer, bytes ), 
 			  journal( mode == Write ? BitPacker::Write : BitPacker::Read, journal_buffer, journal_bytes )
 		{
 		}
@@ -218,6 +801,14 @@ namespace net
 			return result;
 		}
 
+		bool SerializeBoolean( bool & value, FrequencyModel & model )
+		{
+			unsigned int tmp = (unsigned int) value;
+			bool result = SerializeValue( tmp, 1, 1, &model );
+			value = (bool) tmp;
+			return result;
+		}
+
 		bool SerializeByte( char & value, char min = -127, char max = +128 )
 		{
 			// wtf: why do I have to do this!?
@@ -277,7 +868,7 @@ namespace net
 			}
 			const int bits_required = BitsRequired( min, max );
 			unsigned int bits = value - min;
-			bool result = SerializeBits( bits, bits_required );
+			bool result = SerializeValue( bits, bits_required, max - min, NULL );
 			if ( IsReading() )
 			{
 				value = bits + min;
@@ -286,6 +877,30 @@ namespace net
 			}
 			return result;
 		}
+
+		// opt in to an adaptive model for one field. the model belongs to that field alone and must start 
+		// out the same on read and write, eg. a local in the serialize function. the bitpackers ignore it.
+		// a wide field needs a model with at least bits + 1 symbols, the range coder then codes its magnitude
+		
+		bool SerializeInteger( unsigned int & value, unsigned int min, unsigned int max, FrequencyModel & model )
+		{
+			assert( min < max );
+			assert( max - min < (unsigned int) model.GetNumSymbols() || BitsRequired( min, max ) < model.GetNumSymbols() );
+			if ( IsWriting() )
+			{
+				assert( value >= min );
+				assert( value <= max );
+			}
+			unsigned int bits = value - min;
+			bool result = SerializeValue( bits, BitsRequired( min, max ), max - min, &model );
+			if ( IsReading() )
+			{
+				if ( bits > max - min )
+					return false;
+				value = bits + min;
+			}
+			return result;
+		}
 		
 		bool SerializeFloat( float & value )
 		{
@@ -314,31 +929,11 @@ namespace net
 		{
 			assert( bits >= 1 );
 			assert( bits <= 32 );
-			if ( bitpacker.BitsRemaining() < bits )
-				return false;
-			if ( journal.IsValid() )
-			{
-				unsigned int token = 2 + bits;		// note: 0 = end, 1 = checkpoint, [2,34] = n - 2 bits written
-				if ( IsWriting() )
-				{
-					journal.WriteBits( token, 6 );
-				}
-				else
-				{
-					journal.ReadBits( token, 6 );
-					int bits_written = token - 2;
-					if ( bits != bits_written )
-					{
-						printf( "desync read/write: attempting to read %d bits when %d bits were written\n", bits, bits_written );
-						return false;
-					}
-				}
-			}
+			const unsigned int mask = bits < 32 ? ( 1U << bits ) - 1 : 0xFFFFFFFF;
 			if ( IsReading() )
-				bitpacker.ReadBits( value, bits );
-			else
-				bitpacker.WriteBits( value, bits );
-			return true;
+				return SerializeValue( value, bits, mask, NULL );
+			unsigned int tmp = value & mask;
+			return SerializeValue( tmp, bits, mask, NULL );
 		}
 		
 		bool Checkpoint()
@@ -381,12 +976,19 @@ namespace net
 		
 		bool IsReading() const
 		{
-			return bitpacker.GetMode() == BitPacker::Read;
+			return bitpacker.GetMode() == Packer::Read;
 		}
 		
 		bool IsWriting() const
 		{
-			return bitpacker.GetMode() == BitPacker::Write;
+			return bitpacker.GetMode() == Packer::Write;
+		}
+		
+		void Flush()
+		{
+			// call once done writing, before sending the data
+			bitpacker.Flush();
+			journal.Flush();
 		}
 		
 		int GetBitsProcessed() const
@@ -457,9 +1059,207 @@ namespace net
 		
 	private:
 		
-		BitPacker bitpacker;
+		// value is in [0,maximum] and takes "bits" bits. only the arithmetic coder makes use of the range 
+		// and the model, the bitpackers just write the bits
+		
+		bool SerializeValue( unsigned int & value, int bits, unsigned int maximum, FrequencyModel * model )
+		{
+			assert( bits >= 1 );
+			assert( bits <= 32 );
+			if ( bitpacker.BitsRemaining() < bits )
+				return false;
+			if ( journal.IsValid() )
+			{
+				unsigned int token = 2 + bits;		// note: 0 = end, 1 = checkpoint, [2,34] = n - 2 bits written
+				if ( IsWriting() )
+				{
+					journal.WriteBits( token, 6 );
+				}
+				else
+				{
+					journal.ReadBits( token, 6 );
+					int bits_written = token - 2;
+					if ( bits != bits_written )
+					{
+						printf( "desync read/write: attempting to read %d bits when %d bits were written\n", bits, bits_written );
+						return false;
+					}
+				}
+			}
+			if ( IsReading() )
+				ReadValue( bitpacker, value, bits, maximum, model );
+			else
+				WriteValue( bitpacker, value, bits, maximum, model );
+			return true;
+		}
+		
+		template <typename P> static void WriteValue( P & packer, unsigned int value, int bits, unsigned int maximum, FrequencyModel * model )
+		{
+			packer.WriteBits( value, bits );
+		}
+		
+		template <typename P> static void ReadValue( P & packer, unsigned int & value, int bits, unsigned int maximum, FrequencyModel * model )
+		{
+			packer.ReadBits( value, bits );
+		}
+		
+		static void WriteValue( ArithmeticCoder & coder, unsigned int value, int bits, unsigned int maximum, FrequencyModel * model )
+		{
+			coder.WriteValue( value, bits, maximum, model );
+		}
+		
+		static void ReadValue( ArithmeticCoder & coder, unsigned int & value, int bits, unsigned int maximum, FrequencyModel * model )
+		{
+			coder.ReadValue( value, bits, maximum, model );
+		}
+		
+		Packer bitpacker;
 		BitPacker journal;
 	};
+	
+	typedef BasicStream<BitPacker> Stream;
+	typedef BasicStream<WordBitPacker> WordStream;
+	typedef BasicStream<ArithmeticCoder> RangeStream;
+	
+	// bits required at compile time
+	//  + same results as stream bits required, including 32 bits for any range of 0x7FFFFFF or more
+	
+	template <unsigned int MaximumValue> struct StaticBitsToRepresent
+	{
+		enum { Value = 1 + StaticBitsToRepresent<( MaximumValue >> 1 )>::Value };
+	};
+	
+	template <> struct StaticBitsToRepresent<0> { enum { Value = 1 }; };
+	template <> struct StaticBitsToRepresent<1> { enum { Value = 1 }; };
+	
+	template <unsigned int Minimum, unsigned int Maximum> struct StaticBitsRequired
+	{
+		enum { Value = ( Maximum - Minimum >= 0x7FFFFFF ) ? 32 : StaticBitsToRepresent<Maximum - Minimum>::Value };
+	};
+	
+	// schema fields
+	//  + each field names a struct member and its range as template arguments, so its bits are a constant
+	//  + the field reads and writes through the stream, so the journal and desync checks work as before
+	//  + fields write the same bits as the equivalent hand written serialize call
+	
+	template <typename T, bool T::*Member> struct BooleanField
+	{
+		enum { Bits = 1 };
+		
+		template <typename Stream> static bool Serialize( Stream & stream, T & object )
+		{
+			unsigned int value = (unsigned int) ( object.*Member );
+			if ( !stream.SerializeBits( value, Bits ) )
+				return false;
+			object.*Member = value != 0;
+			return true;
+		}
+	};
+	
+	template <typename T, typename Type, Type T::*Member, unsigned int Minimum, unsigned int Maximum> struct IntegerField
+	{
+		enum { Bits = StaticBitsRequired<Minimum,Maximum>::Value };
+		
+		template <typename Stream> static bool Serialize( Stream & stream, T & object )
+		{
+			unsigned int value = 0;
+			if ( stream.IsWriting() )
+			{
+				assert( (unsigned int) ( object.*Member ) >= Minimum );
+				assert( (unsigned int) ( object.*Member ) <= Maximum );
+				value = (unsigned int) ( object.*Member ) - Minimum;
+			}
+			if ( !stream.SerializeBits( value, Bits ) )
+				return false;
+			if ( stream.IsReading() )
+			{
+				value += Minimum;
+				if ( value < Minimum || value > Maximum )
+					return false;
+				object.*Member = (Type) value;
+			}
+			return true;
+		}
+	};
+	
+	template <typename T, typename Type, Type T::*Member, int Minimum, int Maximum> struct SignedIntegerField
+	{
+		enum { Bits = StaticBitsRequired<0,(unsigned int) Maximum - (unsigned int) Minimum>::Value };
+		
+		template <typename Stream> static bool Serialize( Stream & stream, T & object )
+		{
+			unsigned int value = 0;
+			if ( stream.IsWriting() )
+			{
+				assert( object.*Member >= Minimum );
+				assert( object.*Member <= Maximum );
+				value = (unsigned int) ( object.*Member ) - (unsigned int) Minimum;
+			}
+			if ( !stream.SerializeBits( value, Bits ) )
+				return false;
+			if ( stream.IsReading() )
+			{
+				if ( value > (unsigned int) Maximum - (unsigned int) Minimum )
+					return false;
+				object.*Member = (Type) (int) ( value + (unsigned int) Minimum );
+			}
+			return true;
+		}
+	};
+	
+	template <typename T, float T::*Member> struct FloatField
+	{
+		enum { Bits = 32 };
+		
+		template <typename Stream> static bool Serialize( Stream & stream, T & object )
+		{
+			union FloatInt
+			{
+				unsigned int i;
+				float f;
+			};
+			FloatInt floatInt;
+			floatInt.f = object.*Member;
+			if ( !stream.SerializeBits( floatInt.i, Bits ) )
+				return false;
+			object.*Member = floatInt.f;
+			return true;
+		}
+	};
+	
+	// serialization schema
+	//  + a schema chains fields, eg. Schema< FieldA, Schema< FieldB, Schema< FieldC > > >
+	//  + the total bits and the bit offset of each field are summed at compile time
+	//  + in debug builds each field checks that the stream is at the offset the schema expects
+	
+	struct SchemaEnd
+	{
+		enum { Bits = 0 };
+		
+		template <int Offset, typename Stream, typename T> static bool SerializeAt( Stream & stream, T & object, int start )
+		{
+			assert( stream.GetBitsProcessed() - start == Offset );
+			return true;
+		}
+	};
+	
+	template <typename Field, typename Next = SchemaEnd> struct Schema
+	{
+		enum { Bits = Field::Bits + Next::Bits };
+		
+		template <typename Stream, typename T> static bool Serialize( Stream & stream, T & object )
+		{
+			return SerializeAt<0>( stream, object, stream.GetBitsProcessed() );
+		}
+		
+		template <int Offset, typename Stream, typename T> static bool SerializeAt( Stream & stream, T & object, int start )
+		{
+			assert( stream.GetBitsProcessed() - start == Offset );
+			if ( !Field::Serialize( stream, object ) )
+				return false;
+			return Next::template SerializeAt<Offset + Field::Bits>( stream, object, start );
+		}
+	};
 }
 
 #endif
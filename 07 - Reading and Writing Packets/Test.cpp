@@ -233,6 +233,467 @@ void test_bit_packer()
 	}
 }
 
+void test_word_bit_packer()
+{
+	printf( "-----------------------------------------------------\n" );
+	printf( "test word bit packer\n" );
+	printf( "-----------------------------------------------------\n" );
+
+	printf( "write bits (odd)\n" );
+	{
+		unsigned char buffer[256];
+		memset( buffer, 0xCD, sizeof( buffer ) );
+		WordBitPacker bitpacker( WordBitPacker::Write, buffer, sizeof(buffer) );
+		
+		bitpacker.WriteBits( 0xFFFFFFFF, 9 );
+		check( bitpacker.GetBytes() == 2 );
+		check( bitpacker.GetBits() == 9 );
+		
+		bitpacker.WriteBits( 0xFFFFFFFF, 1 );
+		bitpacker.WriteBits( 0xFFFFFFFF, 11 );
+		bitpacker.WriteBits( 0xFFFFFFFF, 6 );
+		check( bitpacker.GetBytes() == 4 );
+		check( bitpacker.GetBits() == 9 + 1 + 11 + 6 );
+		
+		bitpacker.WriteBits( 0xFFFFFFFF, 5 );
+		check( bitpacker.GetBytes() == 4 );
+		check( bitpacker.GetBits() == 32 );
+		
+		bitpacker.WriteBits( 0, 3 );
+		bitpacker.WriteBits( 0x1F, 5 );
+		check( bitpacker.GetBytes() == 5 );
+		check( bitpacker.GetBits() == 40 );
+		
+		check( buffer[0] == 0xFF );
+		check( buffer[1] == 0xFF );
+		check( buffer[2] == 0xFF );
+		check( buffer[3] == 0xFF );
+		check( buffer[4] == 0xCD );		// note: not written until flush
+		
+		bitpacker.Flush();
+		check( buffer[4] == 0xF8 );
+		check( buffer[5] == 0xCD );
+	}
+
+	printf( "same bits as bit packer\n" );
+	{
+		const int NumValues = 1000;
+		const int BufferSize = 4 * NumValues + 3;		// note: not a multiple of 4, so the last word read is partial
+
+		unsigned int values[NumValues];
+		int bits[NumValues];
+		srand( 0 );
+		for ( int i = 0; i < NumValues; ++i )
+		{
+			bits[i] = 1 + rand() % 32;
+			values[i] = (unsigned int) rand() ^ ( (unsigned int) rand() << 16 );
+			if ( bits[i] < 32 )
+				values[i] &= ( 1U << bits[i] ) - 1;
+		}
+
+		static unsigned char byte_buffer[BufferSize];
+		static unsigned char word_buffer[BufferSize];
+		memset( word_buffer, 0xCD, sizeof( word_buffer ) );
+
+		BitPacker byte_writer( BitPacker::Write, byte_buffer, BufferSize );
+		WordBitPacker word_writer( WordBitPacker::Write, word_buffer, BufferSize );
+		for ( int i = 0; i < NumValues; ++i )
+		{
+			byte_writer.WriteBits( values[i], bits[i] );
+			word_writer.WriteBits( values[i], bits[i] );
+			check( byte_writer.GetBits() == word_writer.GetBits() );
+			check( byte_writer.GetBytes() == word_writer.GetBytes() );
+			check( byte_writer.BitsRemaining() == word_writer.BitsRemaining() );
+		}
+		word_writer.Flush();
+		check( memcmp( byte_buffer, word_buffer, byte_writer.GetBytes() ) == 0 );
+
+		// read each buffer back with the other packer
+
+		BitPacker byte_reader( BitPacker::Read, word_buffer, BufferSize );
+		WordBitPacker word_reader( WordBitPacker::Read, byte_buffer, BufferSize );
+		for ( int i = 0; i < NumValues; ++i )
+		{
+			unsigned int byte_value = 0xFFFFFFFF;
+			unsigned int word_value = 0xFFFFFFFF;
+			byte_reader.ReadBits( byte_value, bits[i] );
+			word_reader.ReadBits( word_value, bits[i] );
+			check( byte_value == values[i] );
+			check( word_value == values[i] );
+			check( byte_reader.GetBits() == word_reader.GetBits() );
+		}
+
+		// fill the buffer right up to the last bit, through the partial last word
+
+		WordBitPacker full_writer( WordBitPacker::Write, word_buffer, 7 );
+		for ( int i = 0; i < 7; ++i )
+			full_writer.WriteBits( 0x80 | i, 8 );
+		full_writer.Flush();
+		check( full_writer.BitsRemaining() == 0 );
+		WordBitPacker full_reader( WordBitPacker::Read, word_buffer, 7 );
+		for ( int i = 0; i < 7; ++i )
+		{
+			unsigned int value = 0;
+			full_reader.ReadBits( value, 8 );
+			check( value == ( 0x80 | (unsigned int) i ) );
+		}
+		check( full_reader.BitsRemaining() == 0 );
+	}
+
+	printf( "word stream\n" );
+	{
+		unsigned char buffer[256];
+		unsigned char journal[256];
+		memset( journal, 0, sizeof( journal ) );
+
+		unsigned int a = 123;
+		bool b = true;
+		signed int c = -10004;
+		float d = 1.5f;
+
+ 		WordStream stream( WordStream::Write, buffer, sizeof(buffer), journal, sizeof(journal) );
+		check( stream.SerializeInteger( a, 0, a ) );
+		check( stream.Checkpoint() );
+		check( stream.SerializeBoolean( b ) );
+		check( stream.SerializeInteger( c, -20000, 0 ) );
+		check( stream.SerializeFloat( d ) );
+		check( stream.Checkpoint() );
+		stream.Flush();
+		const int bits_written = stream.GetBitsProcessed();
+
+		unsigned int a_out = 0xFFFFFFFF;
+		bool b_out = false;
+		signed int c_out = 0;
+		float d_out = 0.0f;
+
+		stream = WordStream( WordStream::Read, buffer, stream.GetDataBytes(), journal, sizeof(journal) );
+		check( stream.SerializeInteger( a_out, 0, a ) );
+		check( stream.Checkpoint() );
+		check( stream.SerializeBoolean( b_out ) );
+		check( stream.SerializeInteger( c_out, -20000, 0 ) );
+		check( stream.SerializeFloat( d_out ) );
+		check( stream.Checkpoint() );
+		check( stream.GetBitsProcessed() == bits_written );
+
+		check( a == a_out );
+		check( b == b_out );
+		check( c == c_out );
+		check( d == d_out );
+	}
+}
+
+void test_arithmetic_coder()
+{
+	printf( "-----------------------------------------------------\n" );
+	printf( "test arithmetic coder\n" );
+	printf( "-----------------------------------------------------\n" );
+
+	printf( "read/write integers\n" );
+	{
+		unsigned char buffer[256];
+		memset( buffer, 0, sizeof( buffer ) );
+
+		ArithmeticCoder writer( ArithmeticCoder::Write, buffer, sizeof(buffer) );
+		check( writer.WriteInteger( 5, 0, 10 ) );
+		check( writer.WriteInteger( 0, 0, 1 ) );
+		check( writer.WriteInteger( 100000, 1000, 1000000 ) );
+		check( writer.WriteInteger( 0xFFFFFFFF ) );
+		check( writer.WriteInteger( 12345678 ) );
+		check( writer.WriteInteger( 65535, 0, 65535 ) );
+		check( writer.WriteInteger( 65536, 0, 65536 ) );
+		writer.Flush();
+		check( writer.GetBytes() <= 4 + 1 + 3 + 4 + 4 + 2 + 3 );
+
+		ArithmeticCoder reader( ArithmeticCoder::Read, buffer, writer.GetBytes() );
+		unsigned int value = 0;
+		check( reader.ReadInteger( value, 0, 10 ) && value == 5 );
+		check( reader.ReadInteger( value, 0, 1 ) && value == 0 );
+		check( reader.ReadInteger( value, 1000, 1000000 ) && value == 100000 );
+		check( reader.ReadInteger( value ) && value == 0xFFFFFFFF );
+		check( reader.ReadInteger( value ) && value == 12345678 );
+		check( reader.ReadInteger( value, 0, 65535 ) && value == 65535 );
+		check( reader.ReadInteger( value, 0, 65536 ) && value == 65536 );
+	}
+
+	printf( "static model\n" );
+	{
+		// one symbol in 16 is not zero, so a static model fit to that codes well under 2 bits each
+		const int NumSymbols = 1000;
+		unsigned char buffer[1024];
+		memset( buffer, 0, sizeof( buffer ) );
+
+		FrequencyModel write_model( 4, false );
+		write_model.SetFrequency( 0, 45 );
+		ArithmeticCoder writer( ArithmeticCoder::Write, buffer, sizeof(buffer) );
+		for ( int i = 0; i < NumSymbols; ++i )
+			check( writer.WriteSymbol( i % 16 == 0 ? 1 + i % 3 : 0, write_model ) );
+		writer.Flush();
+		check( writer.GetBytes() < NumSymbols * 2 / 8 / 2 );
+		check( write_model.GetTotal() == 48 );
+
+		FrequencyModel read_model( 4, false );
+		read_model.SetFrequency( 0, 45 );
+		ArithmeticCoder reader( ArithmeticCoder::Read, buffer, writer.GetBytes() );
+		for ( int i = 0; i < NumSymbols; ++i )
+		{
+			int symbol = -1;
+			check( reader.ReadSymbol( symbol, read_model ) );
+			check( symbol == ( i % 16 == 0 ? 1 + i % 3 : 0 ) );
+		}
+	}
+
+	printf( "adaptive model\n" );
+	{
+		// the model starts flat, but learns the skew as it goes
+		const int NumSymbols = 1000;
+		unsigned char buffer[1024];
+		memset( buffer, 0, sizeof( buffer ) );
+
+		FrequencyModel write_model( 256 );
+		ArithmeticCoder writer( ArithmeticCoder::Write, buffer, sizeof(buffer) );
+		for ( int i = 0; i < NumSymbols; ++i )
+			check( writer.WriteSymbol( i % 10 == 0 ? i % 256 : 100 + i % 2, write_model ) );
+		writer.Flush();
+		check( writer.GetBytes() < NumSymbols / 3 );
+
+		FrequencyModel read_model( 256 );
+		ArithmeticCoder reader( ArithmeticCoder::Read, buffer, writer.GetBytes() );
+		for ( int i = 0; i < NumSymbols; ++i )
+		{
+			int symbol = -1;
+			check( reader.ReadSymbol( symbol, read_model ) );
+			check( symbol == ( i % 10 == 0 ? i % 256 : 100 + i % 2 ) );
+		}
+	}
+
+	printf( "cumulative frequencies\n" );
+	{
+		// the tree must agree with a linear sum over the frequencies, including across rescales
+		for ( int numSymbols = 2; numSymbols <= 256; numSymbols += 37 )
+		{
+			FrequencyModel model( numSymbols );
+			unsigned int frequency[256];
+			for ( int i = 0; i < numSymbols; ++i )
+				frequency[i] = 1;
+			unsigned int total = numSymbols;
+			for ( int i = 0; i < 5000; ++i )
+			{
+				const int updated = ( i % 3 == 0 ) ? i % numSymbols : 0;
+				if ( total + FrequencyModel::Increment > FrequencyModel::MaxTotal )
+				{
+					total = 0;
+					for ( int j = 0; j < numSymbols; ++j )
+					{
+						frequency[j] = ( frequency[j] + 1 ) / 2;
+						total += frequency[j];
+					}
+				}
+				frequency[updated] += FrequencyModel::Increment;
+				total += FrequencyModel::Increment;
+				model.Update( updated );
+				check( model.GetTotal() == total );
+
+				if ( i % 97 != 0 )
+					continue;
+				unsigned int expected = 0;
+				for ( int symbol = 0; symbol < numSymbols; ++symbol )
+				{
+					unsigned int cumulative = 0;
+					unsigned int symbolFrequency = 0;
+					model.GetRange( symbol, cumulative, symbolFrequency );
+					check( cumulative == expected );
+					check( symbolFrequency == frequency[symbol] );
+					check( model.FindSymbol( expected, cumulative, symbolFrequency ) == symbol );
+					check( model.FindSymbol( expected + frequency[symbol] - 1, cumulative, symbolFrequency ) == symbol );
+					check( cumulative == expected );
+					expected += frequency[symbol];
+				}
+			}
+		}
+	}
+
+	printf( "read/write bits\n" );
+	{
+		const int NumValues = 1000;
+		unsigned int values[NumValues];
+		int bits[NumValues];
+		srand( 0 );
+		for ( int i = 0; i < NumValues; ++i )
+		{
+			bits[i] = 1 + rand() % 32;
+			values[i] = ( rand() % 4 ) ? rand() % 3 : (unsigned int) rand() ^ ( (unsigned int) rand() << 16 );
+			if ( bits[i] < 32 )
+				values[i] &= ( 1U << bits[i] ) - 1;
+		}
+
+		static unsigned char buffer[NumValues*4];
+		ArithmeticCoder writer( ArithmeticCoder::Write, buffer, sizeof(buffer) );
+		int total_bits = 0;
+		for ( int i = 0; i < NumValues; ++i )
+		{
+			writer.WriteBits( values[i], bits[i] );
+			total_bits += bits[i];
+		}
+		writer.Flush();
+		check( writer.GetBits() == total_bits );
+		check( !writer.IsOverflow() );
+
+		ArithmeticCoder reader( ArithmeticCoder::Read, buffer, writer.GetBytes() );
+		for ( int i = 0; i < NumValues; ++i )
+		{
+			unsigned int value = 0xFFFFFFFF;
+			reader.ReadBits( value, bits[i] );
+			check( value == values[i] );
+		}
+		check( reader.GetBits() == total_bits );
+		check( !reader.IsOverflow() );
+	}
+
+	printf( "overflow\n" );
+	{
+		unsigned char buffer[8];
+		ArithmeticCoder writer( ArithmeticCoder::Write, buffer, sizeof(buffer) );
+		for ( int i = 0; i < 4; ++i )
+			writer.WriteInteger( 0xFFFFFFFF - i );
+		writer.Flush();
+		check( writer.IsOverflow() );
+		check( writer.BitsRemaining() == 0 );
+	}
+
+	printf( "range stream\n" );
+	{
+		unsigned char buffer[256];
+		unsigned char journal[256];
+		memset( journal, 0, sizeof( journal ) );
+
+		unsigned int a = 123;
+		bool b = true;
+		signed int c = -10004;
+		float d = 1.5f;
+
+		// the booleans have a model of their own, the other values are coded uniformly over their range
+
+		FrequencyModel write_model( 2 );
+ 		RangeStream stream( RangeStream::Write, buffer, sizeof(buffer), journal, sizeof(journal) );
+		check( stream.SerializeInteger( a, 0, a ) );
+		check( stream.Checkpoint() );
+		for ( int i = 0; i < 32; ++i )
+			check( stream.SerializeBoolean( b, write_model ) );
+		check( stream.SerializeInteger( c, -20000, 0 ) );
+		check( stream.SerializeFloat( d ) );
+		check( stream.Checkpoint() );
+		stream.Flush();
+		const int bits_written = stream.GetBitsProcessed();
+		check( bits_written == 7 + 32 + 32 + 15 + 32 + 32 );
+		check( stream.GetDataBytes() < bits_written / 8 );
+
+		unsigned int a_out = 0xFFFFFFFF;
+		bool b_out = false;
+		signed int c_out = 0;
+		float d_out = 0.0f;
+
+		FrequencyModel read_model( 2 );
+		stream = RangeStream( RangeStream::Read, buffer, stream.GetDataBytes(), journal, sizeof(journal) );
+		check( stream.SerializeInteger( a_out, 0, a ) );
+		check( stream.Checkpoint() );
+		for ( int i = 0; i < 32; ++i )
+		{
+			check( stream.SerializeBoolean( b_out, read_model ) );
+			check( b == b_out );
+		}
+		check( stream.SerializeInteger( c_out, -20000, 0 ) );
+		check( stream.SerializeFloat( d_out ) );
+		check( stream.Checkpoint() );
+		check( stream.GetBitsProcessed() == bits_written );
+
+		check( a == a_out );
+		check( c == c_out );
+		check( d == d_out );
+	}
+
+	printf( "range stream without models\n" );
+	{
+		// every value is coded uniformly over its exact range, so it costs at most the bitpacker's size plus the flush
+		unsigned char bitpacked[1024];
+		unsigned char rangecoded[1024];
+		srand( 0 );
+		for ( int run = 0; run < 100; ++run )
+		{
+			unsigned int values[64];
+			unsigned int maximum[64];
+			for ( int i = 0; i < 64; ++i )
+			{
+				maximum[i] = 1 + (unsigned int) rand() % ( ( run % 4 == 0 ) ? 3 : 100000 );
+				values[i] = (unsigned int) rand() % ( maximum[i] + 1 );
+			}
+
+			Stream bit_stream( Stream::Write, bitpacked, sizeof(bitpacked) );
+			RangeStream range_stream( RangeStream::Write, rangecoded, sizeof(rangecoded) );
+			for ( int i = 0; i < 64; ++i )
+			{
+				check( bit_stream.SerializeInteger( values[i], 0, maximum[i] ) );
+				check( range_stream.SerializeInteger( values[i], 0, maximum[i] ) );
+			}
+			bit_stream.Flush();
+			range_stream.Flush();
+			check( range_stream.GetBitsProcessed() == bit_stream.GetBitsProcessed() );
+			check( range_stream.GetDataBytes() <= bit_stream.GetDataBytes() + 1 );
+
+			RangeStream reader( RangeStream::Read, rangecoded, range_stream.GetDataBytes() );
+			for ( int i = 0; i < 64; ++i )
+			{
+				unsigned int value = 0xFFFFFFFF;
+				check( reader.SerializeInteger( value, 0, maximum[i] ) );
+				check( value == values[i] );
+			}
+		}
+	}
+
+	printf( "range stream magnitudes\n" );
+	{
+		// a field wider than its model has the model code its magnitude, so small values in it are cheap
+		const unsigned int values[] = { 0, 1, 2, 3, 1000, 38000, 173, 0x80000000, 0xFFFFFFFF, 12 };
+		const int NumValues = sizeof( values ) / sizeof( values[0] );
+		unsigned char buffer[256];
+
+		FrequencyModel write_model( 33 );
+		RangeStream writer( RangeStream::Write, buffer, sizeof(buffer) );
+		for ( int i = 0; i < NumValues; ++i )
+		{
+			unsigned int value = values[i];
+			check( writer.SerializeInteger( value, 0, 0xFFFFFFFF, write_model ) );
+		}
+		writer.Flush();
+		check( writer.GetBitsProcessed() == NumValues * 32 );
+		check( writer.GetDataBytes() < NumValues * 3 );
+
+		FrequencyModel read_model( 33 );
+		RangeStream reader( RangeStream::Read, buffer, writer.GetDataBytes() );
+		for ( int i = 0; i < NumValues; ++i )
+		{
+			unsigned int value = 0;
+			check( reader.SerializeInteger( value, 0, 0xFFFFFFFF, read_model ) );
+			check( value == values[i] );
+		}
+
+		// a magnitude or value past the range the reader expects is rejected
+
+		const unsigned int wide_values[] = { 1 << 19, 1023 };
+		for ( int i = 0; i < 2; ++i )
+		{
+			unsigned int value = wide_values[i];
+			FrequencyModel wide_model( 33 );
+			writer = RangeStream( RangeStream::Write, buffer, sizeof(buffer) );
+			check( writer.SerializeInteger( value, 0, 0xFFFFFFFF, wide_model ) );
+			writer.Flush();
+
+			FrequencyModel narrow_model( 33 );
+			reader = RangeStream( RangeStream::Read, buffer, writer.GetDataBytes() );
+			check( !reader.SerializeInteger( value, 0, 1000, narrow_model ) );
+		}
+	}
+}
+
 void test_stream()
 {
 	printf( "-----------------------------------------------------\n" );
@@ -695,10 +1156,147 @@ void test_stream()
 	// todo: add test for integer values with non-zero min
 }
 
+struct SchemaObject
+{
+	bool active;
+	unsigned char type;
+	unsigned short id;
+	int position;
+	float value;
+	
+	template <typename Stream> bool Serialize( Stream & stream )
+	{
+		stream.SerializeBoolean( active );
+		stream.SerializeByte( type, 0, 9 );
+		stream.SerializeShort( id, 100, 4000 );
+		stream.SerializeInteger( position, -1000, 1000 );
+		stream.SerializeFloat( value );
+		return true;
+	}
+	
+	typedef Schema< BooleanField<SchemaObject, &SchemaObject::active>,
+			Schema< IntegerField<SchemaObject, unsigned char, &SchemaObject::type, 0, 9>,
+			Schema< IntegerField<SchemaObject, unsigned short, &SchemaObject::id, 100, 4000>,
+			Schema< SignedIntegerField<SchemaObject, int, &SchemaObject::position, -1000, 1000>,
+			Schema< FloatField<SchemaObject, &SchemaObject::value> > > > > > Layout;
+};
+
+void test_schema()
+{
+	printf( "-----------------------------------------------------\n" );
+	printf( "test schema\n" );
+	printf( "-----------------------------------------------------\n" );
+
+	printf( "static bits required\n" );
+	{
+		check( (int) ( StaticBitsRequired<0,1>::Value ) == Stream::BitsRequired( 0, 1 ) );
+		check( (int) ( StaticBitsRequired<0,9>::Value ) == Stream::BitsRequired( 0, 9 ) );
+		check( (int) ( StaticBitsRequired<0,255>::Value ) == Stream::BitsRequired( 0, 255 ) );
+		check( (int) ( StaticBitsRequired<100,4000>::Value ) == Stream::BitsRequired( 100, 4000 ) );
+		check( (int) ( StaticBitsRequired<0,65535>::Value ) == Stream::BitsRequired( 0, 65535 ) );
+		check( (int) ( StaticBitsRequired<0,0x7FFFFFE>::Value ) == Stream::BitsRequired( 0, 0x7FFFFFE ) );
+		check( (int) ( StaticBitsRequired<0,0x7FFFFFF>::Value ) == Stream::BitsRequired( 0, 0x7FFFFFF ) );
+		check( (int) ( StaticBitsRequired<0,0xFFFFFFFF>::Value ) == Stream::BitsRequired( 0, 0xFFFFFFFF ) );
+		check( SchemaObject::Layout::Bits == 1 + 4 + 12 + 11 + 32 );
+	}
+
+	printf( "schema matches hand written serialize\n" );
+	{
+		const int NumObjects = 16;
+		SchemaObject objects[NumObjects];
+		for ( int i = 0; i < NumObjects; ++i )
+		{
+			objects[i].active = ( i & 1 ) != 0;
+			objects[i].type = i % 10;
+			objects[i].id = 100 + i * 243;
+			objects[i].position = i * 125 - 1000;
+			objects[i].value = i * 0.5f;
+		}
+
+		unsigned char handWritten[256];
+		unsigned char schema[256];
+		memset( handWritten, 0, sizeof( handWritten ) );
+		memset( schema, 0, sizeof( schema ) );
+
+		Stream handStream( Stream::Write, handWritten, sizeof( handWritten ) );
+		Stream schemaStream( Stream::Write, schema, sizeof( schema ) );
+		for ( int i = 0; i < NumObjects; ++i )
+		{
+			check( objects[i].Serialize( handStream ) );
+			check( SchemaObject::Layout::Serialize( schemaStream, objects[i] ) );
+		}
+		check( handStream.GetBitsProcessed() == NumObjects * SchemaObject::Layout::Bits );
+		check( schemaStream.GetBitsProcessed() == NumObjects * SchemaObject::Layout::Bits );
+		check( memcmp( handWritten, schema, sizeof( schema ) ) == 0 );
+
+		Stream readStream( Stream::Read, schema, sizeof( schema ) );
+		for ( int i = 0; i < NumObjects; ++i )
+		{
+			SchemaObject object;
+			memset( &object, 0, sizeof( object ) );
+			check( SchemaObject::Layout::Serialize( readStream, object ) );
+			check( object.active == objects[i].active );
+			check( object.type == objects[i].type );
+			check( object.id == objects[i].id );
+			check( object.position == objects[i].position );
+			check( object.value == objects[i].value );
+		}
+	}
+
+	printf( "schema journal\n" );
+	{
+		unsigned char buffer[256];
+		unsigned char journal[256];
+		memset( buffer, 0, sizeof( buffer ) );
+		memset( journal, 0, sizeof( journal ) );
+
+		SchemaObject object;
+		object.active = true;
+		object.type = 7;
+		object.id = 1234;
+		object.position = -567;
+		object.value = 3.0f;
+
+		WordStream stream( WordStream::Write, buffer, sizeof( buffer ), journal, sizeof( journal ) );
+		check( SchemaObject::Layout::Serialize( stream, object ) );
+		stream.Flush();
+
+		// reading back with the same layout passes the journal checks
+
+		SchemaObject object_out;
+		memset( &object_out, 0, sizeof( object_out ) );
+		stream = WordStream( WordStream::Read, buffer, sizeof( buffer ), journal, sizeof( journal ) );
+		check( SchemaObject::Layout::Serialize( stream, object_out ) );
+		check( object_out.id == object.id );
+		check( object_out.position == object.position );
+
+		// reading back with a different layout is caught as a desync
+
+		typedef Schema< BooleanField<SchemaObject, &SchemaObject::active>,
+				Schema< IntegerField<SchemaObject, unsigned char, &SchemaObject::type, 0, 255> > > WrongLayout;
+
+		stream = WordStream( WordStream::Read, buffer, sizeof( buffer ), journal, sizeof( journal ) );
+		check( !WrongLayout::Serialize( stream, object_out ) );
+	}
+
+	printf( "schema overflow\n" );
+	{
+		unsigned char buffer[4];
+		SchemaObject object;
+		memset( &object, 0, sizeof( object ) );
+		object.id = 100;
+		Stream stream( Stream::Write, buffer, sizeof( buffer ) );
+		check( !SchemaObject::Layout::Serialize( stream, object ) );
+	}
+}
+
 int main( int argc, char * argv[] )
 {
 	test_bit_packer();
+	test_word_bit_packer();
+	test_arithmetic_coder();
 	test_stream();
+	test_schema();
 
 	printf( "-----------------------------------------------------\n" );
 	printf( "passed!\n" );
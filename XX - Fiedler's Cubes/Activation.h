@@ -67,6 +67,11 @@ namespace activation
 		The set template is used by game code to maintain
 		sets of objects. Objects are unordered and deletion
 		is implemented by replacing the deleted item with the last.
+		
+		Pass maxObjects to allocate to keep an id to index table
+		alongside the objects, so finding an object by id is constant
+		time instead of a linear scan. Object ids must be less than
+		maxObjects. Without it the set stays small (eg. cell objects).
 	*/
 	template <typename T> class Set
 	{
@@ -77,6 +82,8 @@ namespace activation
 			count = 0;
 			size = 0;
 			objects = NULL;
+			maxObjects = 0;
+			index = NULL;
 		}
 
 		~Set()
@@ -84,25 +91,41 @@ namespace activation
 			Free();
 		}
 
-		void Allocate( int initialSize )
+		void Allocate( int initialSize, int maxObjects = 0 )
 		{
 			assert( objects == NULL );
 			assert( initialSize > 0 );
+			assert( maxObjects >= 0 );
 			objects = new T[initialSize];
 			size = initialSize;
 			count = 0;
+			if ( maxObjects > 0 )
+			{
+				this->maxObjects = maxObjects;
+				index = new int[maxObjects];
+				for ( int i = 0; i < maxObjects; ++i )
+					index[i] = -1;
+			}
 		}
 		
 		void Free()
 		{
 			delete[] objects;
+			delete[] index;
 			objects = NULL;
+			index = NULL;
 			count = 0;
 			size = 0;
+			maxObjects = 0;
 		}
 
 		void Clear()
 		{
+			if ( index )
+			{
+				for ( int i = 0; i < count; ++i )
+					SetIndex( objects[i].id, -1 );
+			}
 			count = 0;
 		}
 
@@ -110,21 +133,17 @@ namespace activation
 		{
 			if ( count >= size )
 				Grow();
+			// note: the caller fills in the object, including its id, which must match the id passed in here
+			SetIndex( id, count );
 			return objects[count++];
 		}
 
 		void DeleteObject( ObjectId id )
 		{
 			assert( count >= 1 );
-			for ( int i = 0; i < count; ++i )
-			{
-				if ( objects[i].id == id )
-				{
-					DeleteObject( &objects[i] );
-					return;
-				}
-			}
-			assert( false );
+			T * object = FindObject( id );
+			assert( object );
+			DeleteObject( *object );
 		}
 
 		void DeleteObject( T & object )
@@ -134,8 +153,12 @@ namespace activation
 			assert( i >= 0 );
 			assert( i < count );
 			int last = count - 1;
+			SetIndex( objects[i].id, -1 );
 			if ( i != last )
+			{
 				objects[i] = objects[last];
+				SetIndex( objects[i].id, i );
+			}
 			count--;
 			if ( count < size/3 )
 				Shrink();
@@ -150,20 +173,14 @@ namespace activation
 
  		T * FindObject( ObjectId id )
 		{
-			assert( count >= 0 );
-			for ( int i = 0; i < count; ++i )
-				if ( objects[i].id == id )
-					return &objects[i];
-			return NULL;
+			const int i = FindIndex( id );
+			return i != -1 ? &objects[i] : NULL;
 		}
 
 	 	const T * FindObject( ObjectId id ) const
 		{
-			assert( count >= 0 );
-			for ( int i = 0; i < count; ++i )
-				if ( objects[i].id == id )
-					return &objects[i];
-			return NULL;
+			const int i = FindIndex( id );
+			return i != -1 ? &objects[i] : NULL;
 		}
 
 		int GetCount() const
@@ -178,11 +195,37 @@ namespace activation
 		
 		int GetBytes() const
 		{
-			return sizeof(T) * size;
+			return sizeof(T) * size + sizeof(int) * maxObjects;
 		}
 		
 	protected:
 
+		int FindIndex( ObjectId id ) const
+		{
+			assert( count >= 0 );
+			if ( index )
+			{
+				if ( id >= (ObjectId) maxObjects )
+					return -1;
+				const int i = index[id];
+				assert( i == -1 || objects[i].id == id );
+				return i;
+			}
+			for ( int i = 0; i < count; ++i )
+				if ( objects[i].id == id )
+					return i;
+			return -1;
+		}
+		
+		void SetIndex( ObjectId id, int i )
+		{
+			// note: derived sets that move objects around themselves must call this to keep the id to index table up to date
+			if ( !index )
+				return;
+			assert( id < (ObjectId) maxObjects );
+			index[id] = i;
+		}
+
 		void Grow()
 		{
 			size *= 2;
@@ -205,6 +248,8 @@ namespace activation
 		int count;
 		int size;
 		T * objects;
+		int maxObjects;
+		int * index;						// id to index table, NULL unless allocated with maxObjects
 	};
 
 	/*
@@ -220,15 +265,9 @@ namespace activation
 		void DeleteObject( ActiveObject * activeObjects, ObjectId id )
 		{
 			assert( count >= 1 );
-			for ( int i = 0; i < count; ++i )
-			{
-				if ( objects[i].id == id )
-				{
-					DeleteObject( activeObjects, objects[i] );
-					return;
-				}
-			}
-			assert( false );
+			const int i = FindIndex( id );
+			assert( i != -1 );
+			DeleteObject( activeObjects, objects[i] );
 		}
 
 		void DeleteObject( ActiveObject * activeObjects, CellObject & cellObject )
@@ -239,9 +278,11 @@ namespace activation
 			assert( i >= 0 );
 			assert( i < count );
 			int last = count - 1;
+			SetIndex( cellObjects[i].id, -1 );
 			if ( i != last )
 			{
 				cellObjects[i] = cellObjects[last];
+				SetIndex( cellObjects[i].id, i );
 				if ( cellObjects[i].active )
 				{
 					const int activeObjectIndex = cellObjects[i].activeObjectIndex;
@@ -389,15 +430,9 @@ namespace activation
 		void DeleteObject( Cell * cells, ObjectId id )
 		{
 			assert( count >= 1 );
-			for ( int i = 0; i < count; ++i )
-			{
-				if ( objects[i].id == id )
-				{
-					DeleteObject( cells, objects[i] );
-					return;
-				}
-			}
-			assert( false );
+			const int i = FindIndex( id );
+			assert( i != -1 );
+			DeleteObject( cells, objects[i] );
 		}
 
 		void DeleteObject( Cell * cells, ActiveObject & activeObject )
@@ -408,9 +443,11 @@ namespace activation
 			assert( i >= 0 );
 			assert( i < count );
 			int last = count - 1;
+			SetIndex( activeObjects[i].id, -1 );
 			if ( i != last )
 			{
 				activeObjects[i] = activeObjects[last];
+				SetIndex( activeObjects[i].id, i );
 				// note: we must patch up the cell object active id to match new index
 				Cell & cell = cells[activeObjects[i].cellIndex];
 				CellObject & cellObject = cell.GetObject( activeObjects[i].cellObjectIndex );
@@ -516,7 +553,7 @@ namespace activation
 			#endif
 			enabled = true;
 			enabled_last_frame = false;
-			active_objects.Allocate( initialActiveObjects );
+			active_objects.Allocate( initialActiveObjects, maxObjects );
 			initial_objects_per_cell = initialObjectsPerCell;
 		}
 
@@ -5,6 +5,7 @@
 */
 
 #include "Cubes.h"
+#include "Snapshot.h"
 
 class AuthorityDemo : public Demo
 {
@@ -42,8 +43,8 @@ protected:
 	SyncMode syncMode;
 	Visualization vis;
 	game::Interface * gameInstance[MaxPlayers];
-	GameWorkerThread workerThread[MaxPlayers];
-	view::Packet viewPacket[MaxPlayers];
+	GameWorkers workers;
+	const view::Packet * viewPacket[MaxPlayers];
 	view::ObjectManager viewObjectManager[MaxPlayers];
 	render::Render * render;
 	Camera camera[MaxPlayers];
@@ -54,6 +55,8 @@ protected:
 	bool enterDownLastFrame;
 	bool tabDownLastFrame;
 	float lag;
+	engine::SnapshotConnection connection[MaxPlayers][MaxPlayers];		// [local player][remote player]
+	float reportTime;
 
 public:
 
@@ -69,6 +72,7 @@ public:
 		tabDownLastFrame = false;
 		t = 0.0f;
 		lag = 0.0f;
+		reportTime = 0.0f;
 	}
 
 	~AuthorityDemo()
@@ -90,6 +94,7 @@ public:
 		{
 			game::Config config;
 			config.maxObjects = GridSize * GridSize * CubeDensity + MaxPlayers + 1;
+			config.maxPriorityObjects = MaxObjectsInPacket;
 			config.deactivationTime = 0.5f;
 			config.cellSize = CellSize;
 			config.cellWidth = GridSize + 2;
@@ -110,6 +115,7 @@ public:
 				new game::Instance<cubes::DatabaseObject, cubes::ActiveObject> ( config );
 			
 			gameInstance[i] = instance;
+			viewPacket[i] = &gameInstance[i]->GetViewPacket();
 			
 			origin[i] = math::Vector(0,0,0);
 
@@ -153,6 +159,8 @@ public:
 			}
 
 			instance->SetLocalPlayer( i );
+
+			instance->SetFlag( game::FLAG_Quantize );
 		}
 	}
 
@@ -290,31 +298,19 @@ public:
 
 	void Update( float deltaTime )
 	{
-		// fake some networking
+		// fake some networking: snapshots between every pair of players, delta encoded against the last acked snapshot
 
-		struct TempObject
-		{
-			ObjectId id;
-			uint32_t enabled : 1;
-			uint32_t authority : 3;				// [0,MaxPlayers]
-			math::Quaternion orientation;
-			math::Vector position;
-			math::Vector linearVelocity;
-			math::Vector angularVelocity;
-		};
+		enum { MaxPacketSize = MaxObjectsInPacket * 64 + 256 };
 
-		struct TempPacket
-		{
-			uint32_t frame;
-			game::Input input;
-			int objectCount;
-			TempObject object[MaxObjectsInPacket];
-		};
+		unsigned char buffer[MaxPacketSize];
+		engine::SnapshotObject objects[MaxObjectsInPacket];
 		
 		const int sendRate = 1;
 
-		static engine::PacketQueue packetQueue;
-		packetQueue.SetDelay( lag );
+		static engine::NetworkSimulator networkSimulator( MaxPlayers );
+		engine::LinkSettings linkSettings;
+		linkSettings.latency = lag;
+		networkSimulator.SetLinkSettings( linkSettings );
 
 		// update flags
 		
@@ -362,32 +358,39 @@ public:
 						if ( to == from )
 							continue;
 							
-						TempPacket packet;
-					
-						packet.frame = instance->GetPlayerFrame( from );
-						instance->GetPlayerInput( from, packet.input );
+						unsigned int frame = instance->GetPlayerFrame( from );
+						game::Input input;
+						instance->GetPlayerInput( from, input );
 					
-						packet.objectCount = MaxObjectsInPacket;
-						if ( packet.objectCount > instance->GetActiveObjectCount() )
-							packet.objectCount = instance->GetActiveObjectCount();
+						int objectCount = MaxObjectsInPacket;
+						if ( objectCount > instance->GetActiveObjectCount() )
+							objectCount = instance->GetActiveObjectCount();
 					
-						for ( int i = 0; i < packet.objectCount; ++i )
+						for ( int i = 0; i < objectCount; ++i )
 						{
 							const cubes::ActiveObject & activeObject = instance->GetPriorityObject( to, i );
 							instance->ResetObjectPriority( to, i );
-							packet.object[i].id = activeObject.id;
+							objects[i].id = activeObject.id;
 							if ( syncMode == SYNC_Naive )
-								packet.object[i].authority = from;
+								objects[i].authority = from;
 							else
-								packet.object[i].authority = instance->GetObjectAuthority( packet.object[i].id );
-							packet.object[i].enabled = activeObject.enabled;
-							packet.object[i].position = activeObject.position;
-							packet.object[i].orientation = activeObject.orientation;
-							packet.object[i].linearVelocity = activeObject.linearVelocity;
-							packet.object[i].angularVelocity = activeObject.angularVelocity;
+								objects[i].authority = instance->GetObjectAuthority( activeObject.id );
+							objects[i].enabled = activeObject.enabled;
+							objects[i].position = activeObject.position;
+							objects[i].orientation = activeObject.orientation;
+							objects[i].linearVelocity = activeObject.linearVelocity;
+							objects[i].angularVelocity = activeObject.angularVelocity;
 						}
 
-						packetQueue.QueuePacket( from, to, (unsigned char*)&packet, sizeof(TempPacket) );
+						net::Stream stream( net::Stream::Write, buffer, MaxPacketSize );
+						stream.SerializeInteger( frame );
+						input.Serialize( stream );
+						bool result = connection[from][to].WriteSnapshot( stream, objects, objectCount );
+						assert( result );
+						(void) result;
+						const int bytes = stream.GetDataBytes();
+						networkSimulator.SendPacket( from, to, buffer, bytes );
+						connection[from][to].PacketSent( bytes );
 					}
 				}
 				
@@ -397,33 +400,42 @@ public:
 
 		// receive packets
 		{
-			packetQueue.Update( deltaTime );
+			networkSimulator.Update( deltaTime );
 
-			while ( engine::PacketQueue::Packet * pkt = packetQueue.PacketReadyToSend() )
+			while ( const engine::NetworkSimulator::Packet * pkt = networkSimulator.ReceivePacket() )
 			{
-				TempPacket * packet = (TempPacket*) &pkt->data[0];
-				if ( syncMode != SYNC_Disabled )
+				int from = pkt->sourceNodeId;
+				int to = pkt->destinationNodeId;
+
+				// note: always decode, even when sync is disabled, so the snapshot history stays in step with the sender
+
+				unsigned int frame = 0;
+				game::Input input;
+				int objectCount = 0;
+				net::Stream stream( net::Stream::Read, (unsigned char*) pkt->data, pkt->size );
+				stream.SerializeInteger( frame );
+				input.Serialize( stream );
+				const bool decoded = connection[to][from].ReadSnapshot( stream, objects, objectCount, MaxObjectsInPacket );
+
+				if ( decoded && syncMode != SYNC_Disabled )
 				{
-					int from = pkt->sourceNodeId;
-					int to = pkt->destinationNodeId;
-					
 					game::Instance<cubes::DatabaseObject, cubes::ActiveObject> * instance = 
 						static_cast< game::Instance<cubes::DatabaseObject, cubes::ActiveObject>* > ( gameInstance[to] );
 					
-					instance->SetPlayerInput( from, packet->input );
-					instance->SetPlayerFrame( from, packet->frame );
+					instance->SetPlayerInput( from, input );
+					instance->SetPlayerFrame( from, frame );
 					
-					if ( packet->objectCount > 0 )
+					if ( objectCount > 0 )
 					{
-						for ( int i = 0; i < packet->objectCount; ++i )
+						for ( int i = 0; i < objectCount; ++i )
 						{
 							cubes::ActiveObject activeObject;
-							instance->GetObjectState( packet->object[i].id, activeObject );
-							activeObject.enabled = packet->object[i].enabled;
-							activeObject.position = packet->object[i].position;
-							activeObject.orientation = packet->object[i].orientation;
-							activeObject.linearVelocity = packet->object[i].linearVelocity;
-							activeObject.angularVelocity = packet->object[i].angularVelocity;
+							instance->GetObjectState( objects[i].id, activeObject );
+							activeObject.enabled = objects[i].enabled;
+							activeObject.position = objects[i].position;
+							activeObject.orientation = objects[i].orientation;
+							activeObject.linearVelocity = objects[i].linearVelocity;
+							activeObject.angularVelocity = objects[i].angularVelocity;
 							
 							if ( syncMode == SYNC_Naive )
 							{
@@ -434,7 +446,7 @@ public:
 								if ( activeObject.id == (ObjectId) (from + 1) )
 								{
 									instance->SetObjectState( activeObject.id, activeObject );
-									instance->SetObjectAuthority( packet->object[i].id, from );
+									instance->SetObjectAuthority( objects[i].id, from );
 								}
 								else if ( activeObject.id > MaxPlayers )
 									instance->SetObjectState( activeObject.id, activeObject );
@@ -445,11 +457,11 @@ public:
 								{
 									// player authority
 									instance->SetObjectState( activeObject.id, activeObject );
-									instance->SetObjectAuthority( packet->object[i].id, from, true );
+									instance->SetObjectAuthority( objects[i].id, from, true );
 								}
 								else
 								{
-									int remoteAuthority = packet->object[i].authority;
+									int remoteAuthority = objects[i].authority;
 									int localAuthority = instance->GetObjectAuthority( activeObject.id );
 									if ( remoteAuthority == from )
 									{
@@ -479,15 +491,44 @@ public:
 						}
 					}
 				}
-				delete pkt;
 			}
+
+			for ( int i = 0; i < MaxPlayers; ++i )
+			{
+				for ( int j = 0; j < MaxPlayers; ++j )
+				{
+					if ( i != j )
+						connection[i][j].Update( deltaTime );
+				}
+			}
+		}
+
+		// bandwidth report: all players, all connections
+
+		reportTime += deltaTime;
+		if ( reportTime >= 1.0f )
+		{
+			engine::SnapshotStats stats;
+			for ( int i = 0; i < MaxPlayers; ++i )
+			{
+				for ( int j = 0; j < MaxPlayers; ++j )
+				{
+					stats.Add( connection[i][j].GetStats() );
+					connection[i][j].ClearStats();
+				}
+			}
+			#ifdef PRINT_SNAPSHOT_STATS
+			const char * syncModeNames[] = { "disabled", "naive", "player authority", "tie break authority", "interaction authority" };
+			engine::PrintSnapshotStats( syncModeNames[syncMode], stats, reportTime );
+			#endif
+			reportTime = 0.0f;
 		}
 		
 		// grab the view packets & start the worker threads...
 		for ( int i = 0; i < MaxPlayers; ++i )
 		{
-			gameInstance[i]->GetViewPacket( viewPacket[i] );
-			workerThread[i].Start( gameInstance[i] );
+			viewPacket[i] = &gameInstance[i]->GetViewPacket();
+			workers.Start( gameInstance[i] );
 		}
 		
 		// advance time
@@ -529,20 +570,20 @@ public:
 		{
 			// update the scene to be rendered
 
-			if ( viewPacket[i].objectCount >= 1 )
+			if ( viewPacket[i]->objectCount >= 1 )
 			{
 				view::ObjectUpdate updates[MaxViewObjects];
-				getViewObjectUpdates( updates, viewPacket[i], ( syncMode == SYNC_Disabled ) ? i : -1 );
-				viewObjectManager[i].UpdateObjects( updates, viewPacket[i].objectCount );
+				getViewObjectUpdates( updates, *viewPacket[i], ( syncMode == SYNC_Disabled ) ? i : -1 );
+				viewObjectManager[i].UpdateObjects( updates, viewPacket[i]->objectCount );
 			}
 			viewObjectManager[i].ExtrapolateObjects( deltaTime );
 			viewObjectManager[i].Update( deltaTime );
 
 			// track player origin
 
-			view::Object * playerCube = viewObjectManager[i].GetObject( i + 1 );
-			if ( playerCube )
-				origin[i] = playerCube->position + playerCube->positionError;
+			view::Object playerCube;
+			if ( viewObjectManager[i].GetObject( i + 1, playerCube ) )
+				origin[i] = playerCube.position + playerCube.positionError;
 
 			// update camera
 
@@ -580,6 +621,31 @@ public:
 			render->EnterScreenSpace();
 			render->RenderShadowQuad();
 		}
+
+		// round trip time overlay: the active player's connections to the other players
+
+		if ( syncMode != SYNC_Disabled )
+		{
+			const float MaxRtt = 0.5f;
+			float rtt[MaxPlayers];
+			float rttVariance[MaxPlayers];
+			float jitter[MaxPlayers];
+			float minRtt[MaxPlayers];
+			int count = 0;
+			for ( int i = 0; i < MaxPlayers; ++i )
+			{
+				if ( i == activePlayer )
+					continue;
+				const net::ReliabilitySystem & reliabilitySystem = connection[activePlayer][i].GetReliabilitySystem();
+				rtt[count] = reliabilitySystem.GetRoundTripTime();
+				rttVariance[count] = reliabilitySystem.GetRoundTripTimeVariance();
+				jitter[count] = reliabilitySystem.GetJitter();
+				minRtt[count] = reliabilitySystem.GetMinRoundTripTime();
+				count++;
+			}
+			render->EnterScreenSpace();
+			render->RenderRoundTripTime( rtt, rttVariance, jitter, minRtt, count, MaxRtt );
+		}
 	}
 
 	enum View
@@ -721,7 +787,6 @@ public:
 	void PostRender()
 	{
 		// join worker threads
-		for ( int i = 0; i < MaxPlayers; ++i )
-			workerThread[i].Join();
+		workers.Join();
 	}
 };
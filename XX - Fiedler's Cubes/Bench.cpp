@@ -0,0 +1,1717 @@
+/*
+	Fiedler's Cubes
+	Copyright © 2008-2009 Glenn Fiedler
+	http://www.gafferongames.com/fiedlers-cubes
+*/
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "Config.h"
+
+#if PLATFORM != PLATFORM_WINDOWS
+	#include <unistd.h>
+#endif
+
+#include "Platform.h"
+#include "Activation.h"
+#include "Engine.h"
+#include "Snapshot.h"
+#include "ViewObject.h"
+#include "ViewArrays.h"
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+using activation::ObjectId;
+using engine::PrioritySet;
+using engine::AuthorityManager;
+using engine::AuthorityEntry;
+using engine::InteractionManager;
+using engine::InteractionPair;
+using engine::InteractionPairSet;
+using engine::Simulation;
+using engine::SimulationObjectState;
+using engine::SnapshotObject;
+using engine::SnapshotConnection;
+using engine::SnapshotStats;
+
+const float DeltaTime = 1.0f / 60.0f;
+
+// ------------------------------------------------------------------------------------
+// game instance update priority: one find by id per active object, per player, per frame
+// ------------------------------------------------------------------------------------
+
+/*
+	This mirrors game::Instance::UpdatePriority over an activation::Set
+	and engine::PrioritySet. The activation system is limited to 1024 
+	active objects, so the loop is reproduced here to measure it at 
+	larger active object counts.
+*/
+
+struct PriorityObject
+{
+	ObjectId id;
+	bool enabled;
+	math::Vector position;
+};
+
+float bench_update_priority( int objectCount, bool indexed )
+{
+	const int Frames = 16;
+	const float ActivationDistance = 100.0f;
+
+	activation::Set<PriorityObject> activeObjects;
+	activeObjects.Allocate( 256, indexed ? objectCount + 1 : 0 );
+
+	PrioritySet prioritySet[MaxPlayers];
+
+	srand( 0 );
+	for ( int i = 0; i < objectCount; ++i )
+	{
+		const ObjectId id = i + 1;
+		PriorityObject & object = activeObjects.InsertObject( id );
+		object.id = id;
+		object.enabled = ( rand() % 4 ) != 0;
+		object.position = math::Vector( math::random_float( -50.0f, 50.0f ), math::random_float( -50.0f, 50.0f ), 0.0f );
+		for ( int playerId = 0; playerId < MaxPlayers; ++playerId )
+		{
+			prioritySet[playerId].AddObject( id );
+			prioritySet[playerId].SetPriorityAtIndex( i, math::random_float( 0.0f, 1.0f ) );
+		}
+	}
+
+	for ( int playerId = 0; playerId < MaxPlayers; ++playerId )
+		prioritySet[playerId].SortObjects();
+
+	const ObjectId focusId = 1;
+	const math::Vector origin( 0, 0, 0 );
+
+	platform::Timer timer;
+
+	for ( int frame = 0; frame < Frames; ++frame )
+	{
+		for ( int playerId = 0; playerId < MaxPlayers; ++playerId )
+		{
+			for ( int i = 0; i < objectCount; ++i )
+			{
+				float scale = 1.0f;
+
+				ObjectId id = prioritySet[playerId].GetPriorityObject( i );
+				const PriorityObject * activeObject = activeObjects.FindObject( id );
+				assert( activeObject );
+
+				if ( !activeObject->enabled )
+					scale *= 0.25f;
+
+				float priority = prioritySet[playerId].GetPriorityAtIndex( i );
+
+				priority += DeltaTime * scale;
+
+				if ( activeObject->id == focusId )
+					priority = 1000000.0f;
+
+				const float distanceSquared = ( activeObject->position - origin ).lengthSquared();
+				if ( distanceSquared > ActivationDistance * ActivationDistance )
+					priority = 0.0f;
+
+				prioritySet[playerId].SetPriorityAtIndex( i, priority );
+			}
+			prioritySet[playerId].SortObjects();
+		}
+	}
+
+	return timer.time() * 1000.0f / Frames;
+}
+
+// ------------------------------------------------------------------------------------
+// priority set: full sort vs. top n sort, with objects activating and deactivating
+// ------------------------------------------------------------------------------------
+
+float bench_priority_set( int objectCount, int sortCount )
+{
+	const int Frames = 32;
+	const int ChurnPerFrame = objectCount / 100;
+
+	PrioritySet prioritySet;
+
+	srand( 0 );
+	for ( int i = 0; i < objectCount; ++i )
+		prioritySet.AddObject( i + 1 );
+
+	platform::Timer timer;
+
+	for ( int frame = 0; frame < Frames; ++frame )
+	{
+		// deactivate and reactivate some objects, like activation events do
+		for ( int i = 0; i < ChurnPerFrame; ++i )
+		{
+			const ObjectId id = 1 + rand() % objectCount;
+			prioritySet.RemoveObject( id );
+			prioritySet.AddObject( id );
+		}
+
+		for ( int i = 0; i < objectCount; ++i )
+		{
+			float priority = prioritySet.GetPriorityAtIndex( i ) + DeltaTime * math::random_float( 0.25f, 2.0f );
+			prioritySet.SetPriorityAtIndex( i, priority );
+		}
+
+		if ( sortCount > 0 )
+			prioritySet.SortObjects( sortCount );
+		else
+			prioritySet.SortObjects();
+
+		// the packet takes the top objects and resets their priority
+		const int sent = sortCount > 0 ? sortCount : 256;
+		for ( int i = 0; i < sent && i < objectCount; ++i )
+			prioritySet.SetPriorityAtIndex( i, 0.0f );
+	}
+
+	return timer.time() * 1000.0f / Frames;
+}
+
+// ------------------------------------------------------------------------------------
+// authority manager: linear scan vs. hashed lookup
+// ------------------------------------------------------------------------------------
+
+/*
+	The authority manager as it was before it was hashed, 
+	kept here as the baseline: every call scans all entries.
+*/
+
+class LinearAuthorityManager
+{
+public:
+
+	bool SetAuthority( ObjectId id, int authority, bool force = false )
+	{
+		const int count = entries.size();
+		for ( int i = 0; i < count; ++i )
+		{
+			if ( entries[i].id == id )
+			{
+				if ( ( authority <= entries[i].authority && !entries[i].forced ) || force )
+				{
+					entries[i].authority = authority;
+					entries[i].forced = force;
+					entries[i].time = 0.0f;
+					return true;
+				}
+				else
+					return false;
+			}
+		}
+		entries.resize( count + 1 );
+		entries[count].id = id;
+		entries[count].time = 0.0f;
+		entries[count].forced = force;
+		entries[count].authority = authority;
+		return true;
+	}
+
+	int GetAuthority( ObjectId id )
+	{
+		const int count = entries.size();
+		for ( int i = 0; i < count; ++i )
+		{
+			if ( entries[i].id == id )
+				return entries[i].authority;
+		}
+		return MaxPlayers;
+	}
+
+	void Update( float deltaTime, float authorityTimeout )
+	{
+		int count = entries.size();
+		for ( int i = 0; i < count; )
+		{
+			entries[i].time += deltaTime;
+			if ( entries[i].time >= authorityTimeout || entries[i].authority == MaxPlayers )
+			{
+				if ( i != count - 1 )
+					entries[i] = entries[count-1];
+				entries.resize( count - 1 );
+				count--;
+			}
+			else
+				++i;
+		}
+	}
+
+	int GetEntryCount() const
+	{
+		return entries.size();
+	}
+
+private:
+
+	std::vector<AuthorityEntry> entries;
+};
+
+template <typename T> float bench_authority( int entryCount, int & checksum )
+{
+	/*
+		Each frame every object has its authority looked up once per
+		player (update priority and view packet construction), a tenth 
+		of the objects are touched again by interactions, and entries 
+		older than the timeout expire in update.
+	*/
+
+	const int Frames = 8;
+	const float AuthorityTimeout = 0.1f;
+
+	T authorityManager;
+
+	srand( 0 );
+	for ( int i = 0; i < entryCount; ++i )
+		authorityManager.SetAuthority( i + 1, rand() % MaxPlayers );
+
+	platform::Timer timer;
+
+	checksum = 0;
+
+	for ( int frame = 0; frame < Frames; ++frame )
+	{
+		for ( int playerId = 0; playerId < MaxPlayers; ++playerId )
+		{
+			for ( int i = 0; i < entryCount; ++i )
+				checksum += authorityManager.GetAuthority( i + 1 );
+		}
+
+		for ( int i = 0; i < entryCount / 10; ++i )
+		{
+			const ObjectId id = 1 + rand() % entryCount;
+			authorityManager.SetAuthority( id, authorityManager.GetAuthority( id ) == MaxPlayers ? rand() % MaxPlayers : 0 );
+		}
+
+		authorityManager.Update( DeltaTime, AuthorityTimeout );
+
+		checksum += authorityManager.GetEntryCount();
+	}
+
+	return timer.time() * 1000.0f / Frames;
+}
+
+// ------------------------------------------------------------------------------------
+// interaction walk over stacked cubes: recursive walk vs. union find islands
+// ------------------------------------------------------------------------------------
+
+/*
+	The recursive walk the interaction manager used before islands,
+	kept here as the baseline and to check islands give the same set.
+*/
+
+void recursive_walk( int activeId, const InteractionPair * interactionPairs, int numInteractionPairs, const std::vector<bool> & ignore, std::vector<bool> & interacting )
+{
+	if ( interacting[activeId] )
+		return;
+	if ( ignore[activeId] )
+		return;
+	interacting[activeId] = true;
+	for ( int i = 0; i < numInteractionPairs; ++i )
+	{
+		if ( interactionPairs[i].a == activeId )
+			recursive_walk( interactionPairs[i].b, interactionPairs, numInteractionPairs, ignore, interacting );
+		if ( interactionPairs[i].b == activeId )
+			recursive_walk( interactionPairs[i].a, interactionPairs, numInteractionPairs, ignore, interacting );
+	}
+}
+
+void bench_interactions( int gridSize, int stackHeight )
+{
+	/*
+		A grid of cube stacks. Each cube touches the one below it
+		and, half the time, the cubes beside it. About one in ten
+		cubes is at rest or owned by another player and so breaks
+		the chain. A player cube sits on top of each of a few stacks.
+	*/
+
+	const int Frames = 4;
+	const int Starts = 8;
+
+	const int objectCount = gridSize * gridSize * stackHeight;
+
+	std::vector<InteractionPair> pairs;
+	std::vector<bool> ignore( objectCount, false );
+	std::vector<int> starts;
+
+	srand( 0 );
+	for ( int x = 0; x < gridSize; ++x )
+	{
+		for ( int y = 0; y < gridSize; ++y )
+		{
+			for ( int z = 0; z < stackHeight; ++z )
+			{
+				const int id = ( x * gridSize + y ) * stackHeight + z;
+				InteractionPair pair;
+				pair.a = id;
+				if ( z > 0 )
+				{
+					pair.b = id - 1;
+					pairs.push_back( pair );
+				}
+				if ( x > 0 && rand() % 2 )
+				{
+					pair.b = id - gridSize * stackHeight;
+					pairs.push_back( pair );
+				}
+				if ( y > 0 && rand() % 2 )
+				{
+					pair.b = id - stackHeight;
+					pairs.push_back( pair );
+				}
+				ignore[id] = rand() % 10 == 0;
+			}
+		}
+	}
+	for ( int i = 0; i < Starts; ++i )
+	{
+		const int id = ( rand() % ( gridSize * gridSize ) ) * stackHeight + stackHeight - 1;
+		ignore[id] = false;
+		starts.push_back( id );
+	}
+
+	const InteractionPair * interactionPairs = &pairs[0];
+	const int numInteractionPairs = pairs.size();
+
+	// recursive walk
+
+	std::vector<bool> interacting;
+
+	platform::Timer recursiveTimer;
+
+	for ( int frame = 0; frame < Frames; ++frame )
+	{
+		interacting.assign( objectCount, false );
+		for ( int i = 0; i < Starts; ++i )
+			recursive_walk( starts[i], interactionPairs, numInteractionPairs, ignore, interacting );
+	}
+
+	const float recursive = recursiveTimer.time() * 1000.0f / Frames;
+
+	// islands
+
+	InteractionManager interactionManager;
+
+	platform::Timer islandTimer;
+
+	for ( int frame = 0; frame < Frames; ++frame )
+	{
+		interactionManager.ClearInteractions();
+		interactionManager.PrepInteractions( objectCount - 1 );
+		interactionManager.BuildIslands( interactionPairs, numInteractionPairs, ignore );
+		for ( int i = 0; i < Starts; ++i )
+			interactionManager.WalkInteractions( starts[i], ignore );
+		for ( int i = 0; i < objectCount; ++i )
+			interactionManager.IsInteracting( i );
+	}
+
+	const float islands = islandTimer.time() * 1000.0f / Frames;
+
+	int interactingCount = 0;
+	bool match = true;
+	for ( int i = 0; i < objectCount; ++i )
+	{
+		if ( interacting[i] )
+			interactingCount++;
+		if ( interactionManager.IsInteracting( i ) != interacting[i] )
+			match = false;
+	}
+
+	printf( "%6d cubes (%dx%dx%d), %6d pairs, %6d interacting: recursive %8.3fms, islands %6.3fms per player%s\n",
+		objectCount, gridSize, gridSize, stackHeight, numInteractionPairs, interactingCount, recursive, islands, match ? "" : " (mismatch!)" );
+}
+
+// ------------------------------------------------------------------------------------
+// unique interaction pair filter: linear scan vs. pair set
+// ------------------------------------------------------------------------------------
+
+/*
+	Feeds the contacts of a collapsed tower through the filter
+	the way the near callback does, without needing the physics.
+	Every touching pair of cubes shows up in random order, and some
+	show up twice, as if the simulation reported them again.
+*/
+
+void bench_pair_filter( int gridSize, int towerHeight )
+{
+	const int Steps = 8;
+
+	std::vector<InteractionPair> contacts;
+
+	srand( 0 );
+	for ( int x = 0; x < gridSize; ++x )
+	{
+		for ( int y = 0; y < gridSize; ++y )
+		{
+			for ( int z = 0; z < towerHeight; ++z )
+			{
+				const int id = ( x * gridSize + y ) * towerHeight + z;
+				InteractionPair pair;
+				pair.a = id;
+				for ( int i = 0; i < 3; ++i )
+				{
+					if ( i == 0 && z > 0 )
+						pair.b = id - 1;
+					else if ( i == 1 && x > 0 )
+						pair.b = id - gridSize * towerHeight;
+					else if ( i == 2 && y > 0 )
+						pair.b = id - towerHeight;
+					else
+						continue;
+					if ( rand() % 2 )
+						std::swap( pair.a, pair.b );
+					contacts.push_back( pair );
+					if ( rand() % 4 == 0 )
+						contacts.push_back( pair );
+					pair.a = id;
+				}
+			}
+		}
+	}
+	for ( int i = (int) contacts.size() - 1; i > 0; --i )
+		std::swap( contacts[i], contacts[ rand() % ( i + 1 ) ] );
+
+	std::vector<InteractionPair> interactionPairs;
+
+	// linear scan, as the near callback did before
+
+	platform::Timer linearTimer;
+
+	for ( int step = 0; step < Steps; ++step )
+	{
+		interactionPairs.clear();
+		for ( int c = 0; c < (int) contacts.size(); ++c )
+		{
+			const int objectId1 = contacts[c].a;
+			const int objectId2 = contacts[c].b;
+			bool unique = true;
+			for ( int i = 0; i < (int) interactionPairs.size(); ++i )
+			{
+				if ( ( interactionPairs[i].a == objectId1 && interactionPairs[i].b == objectId2 ) ||
+					 ( interactionPairs[i].a == objectId2 && interactionPairs[i].b == objectId1 ) )
+				{
+					unique = false;
+					break;
+				}
+			}
+			if ( unique )
+				interactionPairs.push_back( contacts[c] );
+		}
+	}
+
+	const float linear = linearTimer.time() * 1000.0f / Steps;
+	const int linearCount = interactionPairs.size();
+
+	// pair set
+
+	InteractionPairSet interactionPairSet;
+
+	platform::Timer setTimer;
+
+	for ( int step = 0; step < Steps; ++step )
+	{
+		interactionPairs.clear();
+		interactionPairSet.Clear();
+		for ( int c = 0; c < (int) contacts.size(); ++c )
+		{
+			if ( interactionPairSet.Insert( contacts[c].a, contacts[c].b ) )
+				interactionPairs.push_back( contacts[c] );
+		}
+	}
+
+	const float hashed = setTimer.time() * 1000.0f / Steps;
+	const int hashedCount = interactionPairs.size();
+
+	printf( "%dx%dx%d tower, %6d contacts, %6d unique pairs: linear scan %8.3fms, pair set %6.3fms per step%s\n",
+		gridSize, gridSize, towerHeight, (int) contacts.size(), hashedCount, linear, hashed, linearCount == hashedCount ? "" : " (mismatch!)" );
+}
+
+// ------------------------------------------------------------------------------------
+// simulation update while a tower of cubes falls over
+// ------------------------------------------------------------------------------------
+
+void bench_tower( int gridSize, int towerHeight )
+{
+	const int Frames = 300;
+
+	Simulation simulation;
+	simulation.Initialize();
+	simulation.AddPlane( math::Vector( 0, 0, 1 ), 0 );
+
+	// stack the cubes slightly apart and jitter them so the tower collapses
+
+	srand( 0 );
+	for ( int x = 0; x < gridSize; ++x )
+	{
+		for ( int y = 0; y < gridSize; ++y )
+		{
+			for ( int z = 0; z < towerHeight; ++z )
+			{
+				SimulationObjectState objectState;
+				objectState.position = math::Vector( ( x - gridSize * 0.5f ) * 1.05f + math::random_float( -0.1f, 0.1f ),
+													 ( y - gridSize * 0.5f ) * 1.05f + math::random_float( -0.1f, 0.1f ),
+													 0.5f + z * 1.1f );
+				objectState.linearVelocity = math::Vector( math::random_float( -1.0f, 1.0f ), math::random_float( -1.0f, 1.0f ), 0.0f );
+				simulation.AddObject( objectState );
+			}
+		}
+	}
+
+	int maxPairs = 0;
+	float maxUpdate = 0.0f;
+
+	platform::Timer timer;
+
+	for ( int frame = 0; frame < Frames; ++frame )
+	{
+		platform::Timer updateTimer;
+		simulation.Update( DeltaTime );
+		maxUpdate = std::max( maxUpdate, (float) updateTimer.time() );
+		maxPairs = std::max( maxPairs, simulation.GetNumInteractionPairs() );
+	}
+
+	const float average = timer.time() * 1000.0f / Frames;
+
+	printf( "%dx%dx%d tower: %.3fms average, %.3fms worst per update (up to %d interaction pairs)\n",
+		gridSize, gridSize, towerHeight, average, maxUpdate * 1000.0f, maxPairs );
+}
+
+// ------------------------------------------------------------------------------------
+// snapshot encoding: delta against the last acked snapshot, with packet loss
+// ------------------------------------------------------------------------------------
+
+/*
+	A field of cubes where most are at rest and a few are being pushed
+	around, sent 256 at a time in priority order like the demos do.
+	Packets and acks are delayed and dropped, and every snapshot the
+	receiver decodes is checked against what the sender quantized.
+*/
+
+struct SnapshotPacket
+{
+	int deliverFrame;
+	int from;
+	int sequence;
+	std::vector<unsigned char> data;
+};
+
+bool SnapshotObjectIdLess( const SnapshotObject & a, const SnapshotObject & b )
+{
+	return a.id < b.id;
+}
+
+void bench_snapshots( int objectCount, int movingCount, int latencyFrames, int lossPercent )
+{
+	const int Frames = 600;
+	const int MaxObjectsInPacket = 256;
+	const int BufferSize = MaxObjectsInPacket * 64 + 256;
+
+	std::vector<SnapshotObject> objects( objectCount );
+
+	srand( 0 );
+	for ( int i = 0; i < objectCount; ++i )
+	{
+		SnapshotObject & object = objects[i];
+		object.id = i + 1;
+		object.enabled = i < movingCount;
+		object.authority = i < movingCount ? 0 : MaxPlayers;
+		object.position = math::Vector( math::random_float( -20.0f, 20.0f ), math::random_float( -20.0f, 20.0f ), 0.2f );
+		object.orientation = math::Quaternion( 1, 0, 0, 0 );
+		object.linearVelocity = math::Vector( 0, 0, 0 );
+		object.angularVelocity = math::Vector( 0, 0, 0 );
+	}
+
+	SnapshotConnection connection[2];
+	std::vector<SnapshotPacket> inFlight;
+	std::vector<SnapshotObject> received( MaxObjectsInPacket );
+	std::vector< std::vector<SnapshotObject> > expected( Frames );
+	static unsigned char buffer[BufferSize];
+
+	int next = 0;
+	int lost = 0;
+	int mismatches = 0;
+	int decodeFailures = 0;
+	double encodeSeconds = 0.0;
+	double decodeSeconds = 0.0;
+	int firstPacketBytes = 0;
+
+	for ( int frame = 0; frame < Frames; ++frame )
+	{
+		// move the objects that are not at rest
+
+		for ( int i = 0; i < movingCount; ++i )
+		{
+			SnapshotObject & object = objects[i];
+			object.linearVelocity += math::Vector( math::random_float( -0.5f, 0.5f ), math::random_float( -0.5f, 0.5f ), 0.0f );
+			object.angularVelocity = math::Vector( 0, 0, math::random_float( -2.0f, 2.0f ) );
+			object.position += object.linearVelocity * DeltaTime;
+			math::Quaternion spin = math::Quaternion( 0, object.angularVelocity.x, object.angularVelocity.y, object.angularVelocity.z ) * object.orientation;
+			object.orientation += spin * ( 0.5f * DeltaTime );
+			object.orientation.normalize();
+		}
+
+		// sender: the next 256 objects, round robin as the priority set would give them
+
+		std::vector<SnapshotObject> packetObjects;
+		for ( int i = 0; i < MaxObjectsInPacket && i < objectCount; ++i )
+			packetObjects.push_back( objects[ ( next + i ) % objectCount ] );
+		next = ( next + MaxObjectsInPacket ) % objectCount;
+
+		// what the receiver should decode: quantized state, sorted by id
+
+		expected[frame].resize( packetObjects.size() );
+		for ( int i = 0; i < (int) packetObjects.size(); ++i )
+		{
+			engine::QuantizedSnapshotObject quantized;
+			engine::QuantizeSnapshotObject( packetObjects[i], quantized );
+			engine::DequantizeSnapshotObject( quantized, expected[frame][i] );
+		}
+		std::sort( expected[frame].begin(), expected[frame].end(), SnapshotObjectIdLess );
+
+		{
+			platform::Timer encodeTimer;
+			net::Stream stream( net::Stream::Write, buffer, BufferSize );
+			bool result = connection[0].WriteSnapshot( stream, &packetObjects[0], (int) packetObjects.size() );
+			assert( result );
+			(void) result;
+			const int bytes = stream.GetDataBytes();
+			connection[0].PacketSent( bytes );
+			encodeSeconds += encodeTimer.time();
+			if ( frame == 0 )
+				firstPacketBytes = bytes;
+			SnapshotPacket packet;
+			packet.deliverFrame = frame + latencyFrames;
+			packet.from = 0;
+			packet.sequence = frame;
+			packet.data.resize( bytes );
+			memcpy( &packet.data[0], buffer, bytes );
+			if ( rand() % 100 >= lossPercent )
+				inFlight.push_back( packet );
+			else
+				lost++;
+		}
+
+		// receiver: empty snapshot back, just to carry acks
+
+		{
+			net::Stream stream( net::Stream::Write, buffer, BufferSize );
+			connection[1].WriteSnapshot( stream, NULL, 0 );
+			const int bytes = stream.GetDataBytes();
+			connection[1].PacketSent( bytes );
+			SnapshotPacket packet;
+			packet.deliverFrame = frame + latencyFrames;
+			packet.from = 1;
+			packet.sequence = frame;
+			packet.data.resize( bytes );
+			memcpy( &packet.data[0], buffer, bytes );
+			if ( rand() % 100 >= lossPercent )
+				inFlight.push_back( packet );
+		}
+
+		// deliver packets
+
+		for ( int i = 0; i < (int) inFlight.size(); )
+		{
+			if ( inFlight[i].deliverFrame > frame )
+			{
+				++i;
+				continue;
+			}
+
+			SnapshotPacket & packet = inFlight[i];
+			const int to = 1 - packet.from;
+			net::Stream stream( net::Stream::Read, &packet.data[0], (int) packet.data.size() );
+			int count = 0;
+			platform::Timer decodeTimer;
+			const bool result = connection[to].ReadSnapshot( stream, &received[0], count, MaxObjectsInPacket );
+			if ( to == 1 )
+				decodeSeconds += decodeTimer.time();
+			if ( !result )
+				decodeFailures++;
+
+			// received state must be exactly what the sender quantized when it sent it
+
+			if ( to == 1 && result )
+			{
+				const std::vector<SnapshotObject> & sent = expected[packet.sequence];
+				if ( count != (int) sent.size() )
+					mismatches++;
+				for ( int j = 0; j < count && j < (int) sent.size(); ++j )
+				{
+					const SnapshotObject & a = received[j];
+					const SnapshotObject & b = sent[j];
+					if ( a.id != b.id || a.enabled != b.enabled || a.authority != b.authority ||
+						 a.position.x != b.position.x || a.position.y != b.position.y || a.position.z != b.position.z ||
+						 a.orientation.w != b.orientation.w || a.orientation.x != b.orientation.x || a.orientation.y != b.orientation.y || a.orientation.z != b.orientation.z ||
+						 a.linearVelocity.x != b.linearVelocity.x || a.linearVelocity.y != b.linearVelocity.y || a.linearVelocity.z != b.linearVelocity.z ||
+						 a.angularVelocity.x != b.angularVelocity.x || a.angularVelocity.y != b.angularVelocity.y || a.angularVelocity.z != b.angularVelocity.z )
+						mismatches++;
+				}
+			}
+
+			inFlight.erase( inFlight.begin() + i );
+		}
+
+		for ( int i = 0; i < 2; ++i )
+			connection[i].Update( DeltaTime );
+	}
+
+	const SnapshotStats & stats = connection[0].GetStats();
+
+	printf( "%4d objects, %3d moving, %d frame latency, %2d%% loss: %5d bytes first packet, %4d bytes average (%5d uncompressed), %2d%% unchanged, %2d%% delta, %2d%% absolute\n",
+		objectCount, movingCount, latencyFrames, lossPercent, firstPacketBytes, stats.bytes / stats.packets, stats.uncompressedBytes / stats.packets,
+		stats.unchanged * 100 / stats.objects, stats.deltas * 100 / stats.objects, stats.absolute * 100 / stats.objects );
+	printf( "     encode %.3fms, decode %.3fms per packet, %.1f kbps at 60 packets/sec%s\n",
+		encodeSeconds * 1000.0 / Frames, decodeSeconds * 1000.0 / Frames, stats.bytes * 8.0 / 1000.0 / ( Frames * DeltaTime ),
+		mismatches == 0 && decodeFailures == 0 ? "" : " (decode mismatch!)" );
+}
+
+// ------------------------------------------------------------------------------------
+// quantization: reconstruction error and bits per object
+// ------------------------------------------------------------------------------------
+
+/*
+	Random states over the full quantization range, plus orientations
+	close to a tie between the two largest components (cubes resting on
+	a face rotated 90 degrees), which is the hard case for smallest three.
+	Snapped state must be a fixed point: quantizing it again has to give
+	back exactly the same floats, otherwise the network would not carry
+	the simulation state bit for bit.
+*/
+
+float quaternion_angle( const math::Quaternion & a, const math::Quaternion & b )
+{
+	const float dot = math::abs( a.w*b.w + a.x*b.x + a.y*b.y + a.z*b.z );
+	return 2.0f * acosf( dot < 1.0f ? dot : 1.0f );
+}
+
+void bench_quantization( int stateCount )
+{
+	const int PositionBits = net::Stream::BitsRequired( 0, 2 * engine::GetPositionLimit() );
+	const int OrientationBits = 2 + 3 * net::Stream::BitsRequired( 0, 2 * engine::GetOrientationLimit() );
+	const int LinearVelocityBits = net::Stream::BitsRequired( 0, 2 * engine::GetLinearVelocityLimit() );
+	const int AngularVelocityBits = net::Stream::BitsRequired( 0, 2 * engine::GetAngularVelocityLimit() );
+	const int StateBits = 3 * PositionBits + OrientationBits + 3 * LinearVelocityBits + 3 * AngularVelocityBits;
+
+	std::vector<SimulationObjectState> states( stateCount );
+
+	srand( 0 );
+	for ( int i = 0; i < stateCount; ++i )
+	{
+		SimulationObjectState & state = states[i];
+		const float bound = PositionBound - 1.0f;
+		state.position = math::Vector( math::random_float( -bound, bound ), math::random_float( -bound, bound ), math::random_float( -bound, bound ) );
+		if ( i % 4 == 0 )
+		{
+			// near a tie: two components at 1/sqrt(2), nudged by less than the resolution
+			const float epsilon = math::random_float( -OrientationResolution, OrientationResolution );
+			state.orientation = math::Quaternion( engine::SmallestThreeBound + epsilon, 0, 0, ( i & 4 ) ? engine::SmallestThreeBound : -engine::SmallestThreeBound );
+		}
+		else
+			state.orientation = math::Quaternion( math::random_float( -1, 1 ), math::random_float( -1, 1 ), math::random_float( -1, 1 ), math::random_float( -1, 1 ) );
+		state.orientation.normalize();
+		state.linearVelocity = math::Vector( math::random_float( -MaxLinearVelocity, MaxLinearVelocity ), math::random_float( -MaxLinearVelocity, MaxLinearVelocity ), math::random_float( -MaxLinearVelocity, MaxLinearVelocity ) );
+		state.angularVelocity = math::Vector( math::random_float( -MaxAngularVelocity, MaxAngularVelocity ), math::random_float( -MaxAngularVelocity, MaxAngularVelocity ), math::random_float( -MaxAngularVelocity, MaxAngularVelocity ) );
+	}
+
+	std::vector<SimulationObjectState> snapped( states );
+
+	platform::Timer timer;
+	for ( int i = 0; i < stateCount; ++i )
+		engine::QuantizeObjectState( snapped[i] );
+	const double seconds = timer.time();
+
+	float positionError = 0.0f;
+	float orientationError = 0.0f;
+	float linearVelocityError = 0.0f;
+	float angularVelocityError = 0.0f;
+	int notFixed = 0;
+
+	for ( int i = 0; i < stateCount; ++i )
+	{
+		const SimulationObjectState & a = states[i];
+		const SimulationObjectState & b = snapped[i];
+
+		positionError = math::maximum( positionError, ( a.position - b.position ).length() );
+		orientationError = math::maximum( orientationError, quaternion_angle( a.orientation, b.orientation ) );
+		linearVelocityError = math::maximum( linearVelocityError, ( a.linearVelocity - b.linearVelocity ).length() );
+		angularVelocityError = math::maximum( angularVelocityError, ( a.angularVelocity - b.angularVelocity ).length() );
+
+		// what the network does with snapped state: quantize, send the integers, dequantize
+
+		engine::QuantizedState quantized;
+		engine::QuantizeState( b.position, b.orientation, b.linearVelocity, b.angularVelocity, quantized );
+		SimulationObjectState c;
+		engine::DequantizeState( quantized, c.position, c.orientation, c.linearVelocity, c.angularVelocity );
+
+		if ( memcmp( &b.position, &c.position, sizeof( math::Vector ) ) != 0 ||
+			 memcmp( &b.orientation, &c.orientation, sizeof( math::Quaternion ) ) != 0 ||
+			 memcmp( &b.linearVelocity, &c.linearVelocity, sizeof( math::Vector ) ) != 0 ||
+			 memcmp( &b.angularVelocity, &c.angularVelocity, sizeof( math::Vector ) ) != 0 )
+			notFixed++;
+	}
+
+	printf( "%d states: %d bits per object (position %d, orientation %d, linear velocity %d, angular velocity %d), raw %d bits\n",
+		stateCount, StateBits, 3 * PositionBits, OrientationBits, 3 * LinearVelocityBits, 3 * AngularVelocityBits, 13 * 32 );
+	printf( "     max error: position %.6f, orientation %.4f degrees, linear velocity %.6f, angular velocity %.6f\n",
+		positionError, orientationError * 180.0f / 3.1415926f, linearVelocityError, angularVelocityError );
+	printf( "     quantize %.1fns per object, %d not a fixed point%s\n",
+		seconds * 1000000000.0 / stateCount, notFixed, notFixed == 0 ? "" : " (quantization mismatch!)" );
+}
+
+// ------------------------------------------------------------------------------------
+// view packets: copy per player per frame vs. double buffered
+// ------------------------------------------------------------------------------------
+
+/*
+	Each demo frame used to copy the whole view packet out of every game
+	instance before starting the worker threads. Now the instance builds
+	into a back buffer and hands out a reference to the front buffer,
+	and GetViewPacket( view::Packet & ) copies only the objects in use.
+*/
+
+enum ViewPacketMode
+{
+	VIEW_CopyAll,
+	VIEW_CopyUsed,
+	VIEW_DoubleBuffered
+};
+
+void bench_view_packet( int objectCount, ViewPacketMode mode )
+{
+	const int Players = MaxPlayers;
+	const int Frames = 600;
+
+	static view::Packet instancePacket[MaxPlayers][2];
+	static view::Packet demoPacket[MaxPlayers];
+	const view::Packet * renderPacket[MaxPlayers];
+
+	for ( int i = 0; i < Players; ++i )
+	{
+		for ( int j = 0; j < 2; ++j )
+		{
+			instancePacket[i][j].objectCount = objectCount;
+			for ( int k = 0; k < objectCount; ++k )
+				instancePacket[i][j].object[k].id = k + 1;
+		}
+	}
+
+	double bytes = 0.0;
+	unsigned int checksum = 0;
+
+	platform::Timer timer;
+
+	for ( int frame = 0; frame < Frames; ++frame )
+	{
+		for ( int i = 0; i < Players; ++i )
+		{
+			const view::Packet & front = instancePacket[i][frame&1];
+			switch ( mode )
+			{
+				case VIEW_CopyAll:
+					demoPacket[i] = front;
+					renderPacket[i] = &demoPacket[i];
+					bytes += sizeof( view::Packet );
+					break;
+
+				case VIEW_CopyUsed:
+					view::CopyPacket( front, demoPacket[i] );
+					renderPacket[i] = &demoPacket[i];
+					bytes += sizeof( view::Packet ) - ( MaxViewObjects - front.objectCount ) * sizeof( view::ObjectState );
+					break;
+
+				case VIEW_DoubleBuffered:
+					renderPacket[i] = &front;
+					break;
+			}
+		}
+
+		// the renderer reads every object, whichever way the packet got here
+
+		for ( int i = 0; i < Players; ++i )
+			for ( int j = 0; j < renderPacket[i]->objectCount; ++j )
+				checksum += renderPacket[i]->object[j].id;
+	}
+
+	const double seconds = timer.time();
+
+	const char * modeNames[] = { "copy all", "copy used", "double buffered" };
+	printf( "%4d objects, %-15s: %7.3fms per frame, %7.1f MB/sec copied at 60 frames/sec (checksum %u)\n",
+		objectCount, modeNames[mode], seconds * 1000.0 / Frames, bytes / Frames * 60.0 / ( 1024.0 * 1024.0 ), checksum );
+}
+
+// ------------------------------------------------------------------------------------
+// view objects: map of heap objects vs. structure of arrays
+// ------------------------------------------------------------------------------------
+
+/*
+	MapObjectManager is view::ObjectManager as it was before the object
+	arrays: one heap allocated view::Object per map node. Each frame runs
+	extrapolation, error smoothing and hermite interpolation, the work a
+	demo does per view object, over both layouts, then checks that they
+	agree.
+*/
+
+class MapObjectManager
+{
+public:
+
+	~MapObjectManager()
+	{
+		for ( std::map<unsigned int, view::Object*>::iterator itor = objects.begin(); itor != objects.end(); ++itor )
+			delete itor->second;
+	}
+
+	void Add( const view::Object & object )
+	{
+		objects[object.id] = new view::Object( object );
+	}
+
+	void ExtrapolateObjects( float deltaTime )
+	{
+		for ( std::map<unsigned int, view::Object*>::iterator itor = objects.begin(); itor != objects.end(); ++itor )
+		{
+			view::Object * object = itor->second;
+			object->position += object->linearVelocity * deltaTime;
+			math::Quaternion orientationSpin = 0.5f * math::Quaternion( 0, object->angularVelocity.x, object->angularVelocity.y, object->angularVelocity.z ) * object->orientation;
+			object->orientation += orientationSpin * deltaTime;
+			object->orientation.normalize();
+			math::Quaternion visualOrientationSpin = 0.5f * math::Quaternion( 0, object->angularVelocity.x, object->angularVelocity.y, object->angularVelocity.z ) * object->visualOrientation;
+			object->visualOrientation += visualOrientationSpin * deltaTime;
+			object->visualOrientation.normalize();
+		}
+	}
+
+	void SmoothErrors( float positionTightness, float orientationTightness )
+	{
+		for ( std::map<unsigned int, view::Object*>::iterator itor = objects.begin(); itor != objects.end(); ++itor )
+		{
+			view::Object * object = itor->second;
+			object->positionError *= ( 1.0f - positionTightness );
+			object->visualOrientation = math::slerp( object->visualOrientation, object->orientation, orientationTightness );
+		}
+	}
+
+	void InterpolateHermite( float t, float stepSize )
+	{
+		for ( std::map<unsigned int, view::Object*>::iterator itor = objects.begin(); itor != objects.end(); ++itor )
+		{
+			view::Object * object = itor->second;
+			math::hermite_spline( t, object->previousPosition, object->position, object->previousLinearVelocity * stepSize, object->linearVelocity * stepSize, object->interpolatedPosition );
+			math::Quaternion spin0 = 0.5f * math::Quaternion( 0, object->previousAngularVelocity.x, object->previousAngularVelocity.y, object->previousAngularVelocity.z ) * object->previousOrientation;
+			math::Quaternion spin1 = 0.5f * math::Quaternion( 0, object->angularVelocity.x, object->angularVelocity.y, object->angularVelocity.z ) * object->orientation;
+			math::hermite_spline( t, object->previousOrientation, object->orientation, spin0 * stepSize, spin1 * stepSize, object->interpolatedOrientation );
+		}
+	}
+
+	std::map<unsigned int, view::Object*> objects;
+};
+
+void bench_view_objects( int objectCount )
+{
+	const int Frames = 120;
+	const float PositionTightness = 0.075f;
+	const float OrientationTightness = 0.2f;
+
+	MapObjectManager mapObjects;
+	view::ObjectArrays arrayObjects;
+
+	srand( 0 );
+	for ( int i = 0; i < objectCount; ++i )
+	{
+		view::Object object;
+		object.id = ( i * 7919 ) % 1000003 + 1;
+		object.position = math::Vector( math::random_float( -100, 100 ), math::random_float( -100, 100 ), math::random_float( 0, 10 ) );
+		object.orientation = math::Quaternion( math::random_float( -1, 1 ), math::random_float( -1, 1 ), math::random_float( -1, 1 ), math::random_float( -1, 1 ) );
+		object.orientation.normalize();
+		object.linearVelocity = math::Vector( math::random_float( -5, 5 ), math::random_float( -5, 5 ), math::random_float( -5, 5 ) );
+		object.angularVelocity = math::Vector( math::random_float( -5, 5 ), math::random_float( -5, 5 ), math::random_float( -5, 5 ) );
+		object.positionError = math::Vector( math::random_float( -1, 1 ), math::random_float( -1, 1 ), math::random_float( -1, 1 ) );
+		object.visualOrientation = object.orientation;
+		object.previousPosition = object.position - object.linearVelocity * DeltaTime;
+		object.previousLinearVelocity = object.linearVelocity;
+		object.previousAngularVelocity = object.angularVelocity;
+		object.previousOrientation = object.orientation;
+		object.interpolatedPosition = object.position;
+		object.interpolatedOrientation = object.orientation;
+		object.scale = 1.0f;
+		object.r = object.g = object.b = object.a = 1.0f;
+		object.blend_time = object.blend_start = object.blend_finish = 0.0f;
+		mapObjects.Add( object );
+		arrayObjects.Set( arrayObjects.Add( object.id ), object );
+	}
+
+	platform::Timer mapTimer;
+	for ( int frame = 0; frame < Frames; ++frame )
+	{
+		mapObjects.ExtrapolateObjects( DeltaTime );
+		mapObjects.SmoothErrors( PositionTightness, OrientationTightness );
+		mapObjects.InterpolateHermite( ( frame % 4 ) * 0.25f, DeltaTime * 4 );
+	}
+	const double mapSeconds = mapTimer.time();
+
+	platform::Timer arrayTimer;
+	for ( int frame = 0; frame < Frames; ++frame )
+	{
+		arrayObjects.Extrapolate( DeltaTime );
+		arrayObjects.SmoothErrors( PositionTightness, OrientationTightness );
+		arrayObjects.InterpolateHermite( ( frame % 4 ) * 0.25f, DeltaTime * 4, false );
+	}
+	const double arraySeconds = arrayTimer.time();
+
+	float maxError = 0.0f;
+	for ( std::map<unsigned int, view::Object*>::iterator itor = mapObjects.objects.begin(); itor != mapObjects.objects.end(); ++itor )
+	{
+		const view::Object & a = *itor->second;
+		view::Object b;
+		arrayObjects.Get( arrayObjects.Find( a.id ), b );
+		maxError = math::maximum( maxError, ( a.position - b.position ).length() );
+		maxError = math::maximum( maxError, ( a.positionError - b.positionError ).length() );
+		maxError = math::maximum( maxError, ( a.interpolatedPosition - b.interpolatedPosition ).length() );
+		maxError = math::maximum( maxError, math::abs( a.orientation.dot( b.orientation ) ) < 1.0f - 0.0001f ? 1.0f : 0.0f );
+		maxError = math::maximum( maxError, math::abs( a.visualOrientation.dot( b.visualOrientation ) ) < 1.0f - 0.0001f ? 1.0f : 0.0f );
+		maxError = math::maximum( maxError, math::abs( a.interpolatedOrientation.dot( b.interpolatedOrientation ) ) < 1.0f - 0.0001f ? 1.0f : 0.0f );
+	}
+
+	printf( "%5d objects: map %7.3fms, arrays %6.3fms per frame (%.1fx)%s\n",
+		objectCount, mapSeconds * 1000.0 / Frames, arraySeconds * 1000.0 / Frames, mapSeconds / arraySeconds,
+		maxError < 0.001f ? "" : " (results differ!)" );
+}
+
+// ------------------------------------------------------------------------------------
+// batch math: simd batch operations vs. a loop over the scalar versions
+// ------------------------------------------------------------------------------------
+
+/*
+	Each batch op is checked against the scalar op it replaces before it
+	is timed. Counts that are not a multiple of the simd width exercise
+	the scalar tail. The quaternions include zero length ones for
+	normalize, and nearly equal or opposite hemisphere pairs for slerp,
+	which take the linear and flip paths.
+*/
+
+float quaternion_difference( const math::Quaternion & a, const math::Quaternion & b )
+{
+	return math::maximum( math::maximum( math::abs( a.w - b.w ), math::abs( a.x - b.x ) ), math::maximum( math::abs( a.y - b.y ), math::abs( a.z - b.z ) ) );
+}
+
+float vector_difference( const math::Vector & a, const math::Vector & b )
+{
+	return math::maximum( math::abs( a.x - b.x ), math::maximum( math::abs( a.y - b.y ), math::abs( a.z - b.z ) ) );
+}
+
+void print_batch_result( const char * name, int count, double scalarSeconds, double batchSeconds, int repeat, float maxError, float tolerance )
+{
+	printf( "%-13s %6d: scalar %6.2fns, batch %6.2fns per element (%.1fx), max error %g%s\n",
+		name, count, scalarSeconds * 1000000000.0 / ( count * repeat ), batchSeconds * 1000000000.0 / ( count * repeat ),
+		scalarSeconds / batchSeconds, maxError, maxError <= tolerance ? "" : " (results differ!)" );
+}
+
+void bench_math_batch( int count, int repeat )
+{
+	std::vector<math::Quaternion> a( count );
+	std::vector<math::Quaternion> b( count );
+	std::vector<math::Vector> points( count );
+
+	srand( 0 );
+	for ( int i = 0; i < count; ++i )
+	{
+		a[i] = math::Quaternion( math::random_float( -1, 1 ), math::random_float( -1, 1 ), math::random_float( -1, 1 ), math::random_float( -1, 1 ) );
+		b[i] = math::Quaternion( math::random_float( -1, 1 ), math::random_float( -1, 1 ), math::random_float( -1, 1 ), math::random_float( -1, 1 ) );
+		points[i] = math::Vector( math::random_float( -100, 100 ), math::random_float( -100, 100 ), math::random_float( -100, 100 ) );
+	}
+
+	// normalize, unnormalized input with some zero quaternions
+
+	for ( int i = 0; i < count; i += 7 )
+		a[i] = math::Quaternion( 0, 0, 0, 0 );
+
+	{
+		std::vector<math::Quaternion> scalar( a );
+		std::vector<math::Quaternion> batch( a );
+		for ( int i = 0; i < count; ++i )
+			scalar[i].normalize();
+		math::normalize( &batch[0], count );
+
+		float maxError = 0.0f;
+		for ( int i = 0; i < count; ++i )
+			maxError = math::maximum( maxError, quaternion_difference( scalar[i], batch[i] ) );
+
+		// note: after the first pass these are already normalized, but the work is the same
+
+		platform::Timer timer;
+		for ( int j = 0; j < repeat; ++j )
+			for ( int i = 0; i < count; ++i )
+				scalar[i].normalize();
+		const double scalarSeconds = timer.time();
+		timer.reset();
+		for ( int j = 0; j < repeat; ++j )
+			math::normalize( &batch[0], count );
+		const double batchSeconds = timer.time();
+
+		print_batch_result( "normalize", count, scalarSeconds, batchSeconds, repeat, maxError, 0.000001f );
+	}
+
+	// slerp, unit quaternions with some nearly equal and some opposite hemisphere pairs
+
+	math::normalize( &a[0], count );
+	math::normalize( &b[0], count );
+	for ( int i = 0; i < count; i += 5 )
+		b[i] = -b[i];
+	for ( int i = 3; i < count; i += 11 )
+		b[i] = a[i];
+	for ( int i = 6; i < count; i += 13 )
+	{
+		b[i] = a[i] + math::Quaternion( 0.001f, 0, 0, 0 );
+		b[i].normalize();
+	}
+
+	{
+		const float t = 0.3f;
+		std::vector<math::Quaternion> scalar( count );
+		std::vector<math::Quaternion> batch( count );
+		for ( int i = 0; i < count; ++i )
+			scalar[i] = math::slerp( a[i], b[i], t );
+		math::slerp( &a[0], &b[0], &batch[0], count, t );
+
+		float maxError = 0.0f;
+		for ( int i = 0; i < count; ++i )
+			maxError = math::maximum( maxError, quaternion_difference( scalar[i], batch[i] ) );
+
+		platform::Timer timer;
+		for ( int j = 0; j < repeat; ++j )
+			for ( int i = 0; i < count; ++i )
+				scalar[i] = math::slerp( a[i], b[i], t );
+		const double scalarSeconds = timer.time();
+		timer.reset();
+		for ( int j = 0; j < repeat; ++j )
+			math::slerp( &a[0], &b[0], &batch[0], count, t );
+		const double batchSeconds = timer.time();
+
+		print_batch_result( "slerp", count, scalarSeconds, batchSeconds, repeat, maxError, 0.00001f );
+	}
+
+	// slerp over component arrays, the layout view::ObjectArrays keeps orientations in
+
+	{
+		const float t = 0.3f;
+		std::vector<float> aw( count ), ax( count ), ay( count ), az( count );
+		std::vector<float> bw( count ), bx( count ), by( count ), bz( count );
+		std::vector<float> ow( count ), ox( count ), oy( count ), oz( count );
+		for ( int i = 0; i < count; ++i )
+		{
+			aw[i] = a[i].w; ax[i] = a[i].x; ay[i] = a[i].y; az[i] = a[i].z;
+			bw[i] = b[i].w; bx[i] = b[i].x; by[i] = b[i].y; bz[i] = b[i].z;
+		}
+		std::vector<math::Quaternion> scalar( count );
+		for ( int i = 0; i < count; ++i )
+			scalar[i] = math::slerp( a[i], b[i], t );
+		math::slerp( &aw[0], &ax[0], &ay[0], &az[0], &bw[0], &bx[0], &by[0], &bz[0], &ow[0], &ox[0], &oy[0], &oz[0], count, t );
+
+		float maxError = 0.0f;
+		for ( int i = 0; i < count; ++i )
+			maxError = math::maximum( maxError, quaternion_difference( scalar[i], math::Quaternion( ow[i], ox[i], oy[i], oz[i] ) ) );
+
+		platform::Timer timer;
+		for ( int j = 0; j < repeat; ++j )
+			for ( int i = 0; i < count; ++i )
+				scalar[i] = math::slerp( a[i], b[i], t );
+		const double scalarSeconds = timer.time();
+		timer.reset();
+		for ( int j = 0; j < repeat; ++j )
+			math::slerp( &aw[0], &ax[0], &ay[0], &az[0], &bw[0], &bx[0], &by[0], &bz[0], &ow[0], &ox[0], &oy[0], &oz[0], count, t );
+		const double batchSeconds = timer.time();
+
+		print_batch_result( "slerp arrays", count, scalarSeconds, batchSeconds, repeat, maxError, 0.00001f );
+	}
+
+	// transform and transform3x3 by a rotation + translation matrix, and matrix multiply
+
+	math::Matrix matrix;
+	a[1].to_matrix( matrix );
+	matrix.m14 = 10.0f;
+	matrix.m24 = -20.0f;
+	matrix.m34 = 30.0f;
+
+	for ( int pass = 0; pass < 2; ++pass )
+	{
+		const bool translate = pass == 0;
+
+		std::vector<math::Vector> scalar( count );
+		std::vector<math::Vector> batch( count );
+		for ( int i = 0; i < count; ++i )
+		{
+			if ( translate )
+				matrix.transform( points[i], scalar[i] );
+			else
+				matrix.transform3x3( points[i], scalar[i] );
+		}
+		if ( translate )
+			math::transform( matrix, &points[0], &batch[0], count );
+		else
+			math::transform3x3( matrix, &points[0], &batch[0], count );
+
+		float maxError = 0.0f;
+		for ( int i = 0; i < count; ++i )
+			maxError = math::maximum( maxError, vector_difference( scalar[i], batch[i] ) );
+
+		platform::Timer timer;
+		for ( int j = 0; j < repeat; ++j )
+		{
+			if ( translate )
+			{
+				for ( int i = 0; i < count; ++i )
+					matrix.transform( points[i], scalar[i] );
+			}
+			else
+			{
+				for ( int i = 0; i < count; ++i )
+					matrix.transform3x3( points[i], scalar[i] );
+			}
+		}
+		const double scalarSeconds = timer.time();
+		timer.reset();
+		for ( int j = 0; j < repeat; ++j )
+		{
+			if ( translate )
+				math::transform( matrix, &points[0], &batch[0], count );
+			else
+				math::transform3x3( matrix, &points[0], &batch[0], count );
+		}
+		const double batchSeconds = timer.time();
+
+		print_batch_result( translate ? "transform" : "transform3x3", count, scalarSeconds, batchSeconds, repeat, maxError, 0.0001f );
+	}
+
+	{
+		std::vector<math::Matrix> matrices( count );
+		for ( int i = 0; i < count; ++i )
+		{
+			a[i].to_matrix( matrices[i] );
+			matrices[i].m14 = points[i].x;
+			matrices[i].m24 = points[i].y;
+			matrices[i].m34 = points[i].z;
+		}
+
+		std::vector<math::Matrix> scalar( count );
+		std::vector<math::Matrix> batch( count );
+		for ( int i = 0; i < count; ++i )
+			scalar[i] = matrix * matrices[i];
+		for ( int i = 0; i < count; ++i )
+			math::multiply( matrix, matrices[i], batch[i] );
+
+		float maxError = 0.0f;
+		for ( int i = 0; i < count; ++i )
+			for ( int j = 0; j < 16; ++j )
+				maxError = math::maximum( maxError, math::abs( scalar[i].data()[j] - batch[i].data()[j] ) );
+
+		// note: each pass multiplies onto the last result so the compiler can't skip repeats
+
+		platform::Timer timer;
+		for ( int j = 0; j < repeat; ++j )
+			for ( int i = 0; i < count; ++i )
+				scalar[i] = matrix * scalar[i];
+		const double scalarSeconds = timer.time();
+		timer.reset();
+		for ( int j = 0; j < repeat; ++j )
+			for ( int i = 0; i < count; ++i )
+				math::multiply( matrix, batch[i], batch[i] );
+		const double batchSeconds = timer.time();
+
+		print_batch_result( "multiply", count, scalarSeconds, batchSeconds, repeat, maxError, 0.0001f );
+	}
+}
+
+// ------------------------------------------------------------------------------------
+// network simulator: pooled slots and a heap vs. the old packet queue
+// ------------------------------------------------------------------------------------
+
+/*
+	VectorPacketQueue is the old engine::PacketQueue, kept here as a
+	reference: a new Packet and a std::vector per packet, and a pop
+	from the front of a vector. Both carry the same traffic, every
+	player sending to every other player each frame, and both are
+	drained at the end so the bytes delivered can be compared (the
+	old queue sums frame times in a float, so at the edge of a run it
+	can be a frame out). Then single links are run with loss, jitter,
+	reordering and a bandwidth cap, to check that what comes out
+	matches the settings, and each is run twice to check the same
+	seed gives the same deliveries.
+*/
+
+class VectorPacketQueue
+{
+public:
+
+	struct Packet
+	{
+		float timeInQueue;
+		int sourceNodeId;
+		int destinationNodeId;
+		std::vector<unsigned char> data;
+	};
+
+	VectorPacketQueue()
+	{
+		delay = 0.0f;
+	}
+
+	void QueuePacket( int sourceNodeId, int destinationNodeId, unsigned char * data, int bytes )
+	{
+		Packet * packet = new Packet();
+		packet->timeInQueue = 0.0f;
+		packet->sourceNodeId = sourceNodeId;
+		packet->destinationNodeId = destinationNodeId;
+		packet->data.resize( bytes );
+		memcpy( &packet->data[0], data, bytes );
+		queue.push_back( packet );
+	}
+
+	void SetDelay( float delay )
+	{
+		this->delay = delay;
+	}
+
+	void Update( float deltaTime )
+	{
+		for ( int i = 0; i < (int) queue.size(); ++i )
+			queue[i]->timeInQueue += deltaTime;
+	}
+
+	Packet * PacketReadyToSend()
+	{
+		if ( queue.size() > 0 && queue[0]->timeInQueue >= delay )
+		{
+			Packet * packet = queue[0];
+			queue.erase( queue.begin() );
+			return packet;
+		}
+		return NULL;
+	}
+
+private:
+
+	float delay;
+	std::vector<Packet*> queue;
+};
+
+void bench_network_simulator( int packetSize, int packetsPerLink, float latency )
+{
+	const int Frames = 600;
+
+	std::vector<unsigned char> data( packetSize, 1 );
+	const int packetsPerFrame = MaxPlayers * ( MaxPlayers - 1 ) * packetsPerLink;
+
+	double queueSeconds = 0.0;
+	double simulatorSeconds = 0.0;
+	unsigned int queueBytes = 0;
+	unsigned int simulatorBytes = 0;
+
+	{
+		VectorPacketQueue packetQueue;
+		packetQueue.SetDelay( latency );
+		platform::Timer timer;
+		for ( int frame = 0; frame < Frames; ++frame )
+		{
+			for ( int from = 0; from < MaxPlayers; ++from )
+				for ( int to = 0; to < MaxPlayers; ++to )
+					for ( int i = 0; from != to && i < packetsPerLink; ++i )
+						packetQueue.QueuePacket( from, to, &data[0], packetSize );
+			packetQueue.Update( DeltaTime );
+			while ( VectorPacketQueue::Packet * packet = packetQueue.PacketReadyToSend() )
+			{
+				queueBytes += packet->data.size();
+				delete packet;
+			}
+		}
+		queueSeconds = timer.time();
+		packetQueue.Update( latency + 1.0f );
+		while ( VectorPacketQueue::Packet * packet = packetQueue.PacketReadyToSend() )
+		{
+			queueBytes += packet->data.size();
+			delete packet;
+		}
+	}
+
+	{
+		engine::NetworkSimulator networkSimulator( MaxPlayers );
+		engine::LinkSettings settings;
+		settings.latency = latency;
+		networkSimulator.SetLinkSettings( settings );
+		platform::Timer timer;
+		for ( int frame = 0; frame < Frames; ++frame )
+		{
+			for ( int from = 0; from < MaxPlayers; ++from )
+				for ( int to = 0; to < MaxPlayers; ++to )
+					for ( int i = 0; from != to && i < packetsPerLink; ++i )
+						networkSimulator.SendPacket( from, to, &data[0], packetSize );
+			networkSimulator.Update( DeltaTime );
+			while ( const engine::NetworkSimulator::Packet * packet = networkSimulator.ReceivePacket() )
+				simulatorBytes += packet->size;
+		}
+		simulatorSeconds = timer.time();
+		networkSimulator.Update( latency + 1.0f );
+		while ( const engine::NetworkSimulator::Packet * packet = networkSimulator.ReceivePacket() )
+			simulatorBytes += packet->size;
+	}
+
+	printf( "%5d byte packets, %3d per frame, %4.0fms latency: %6.1fns per packet (old packet queue %7.1fns, %.1fx)%s\n",
+		packetSize, packetsPerFrame, latency * 1000.0f, simulatorSeconds * 1000000000.0 / ( Frames * packetsPerFrame ), 
+		queueSeconds * 1000000000.0 / ( Frames * packetsPerFrame ), queueSeconds / simulatorSeconds,
+		queueBytes == simulatorBytes ? "" : " (deliveries differ!)" );
+}
+
+struct LinkResult
+{
+	unsigned int hash;
+	int delivered;
+	int duplicates;
+	int outOfOrder;
+	int lossBursts;
+	int lostPackets;
+	double latency;
+	double latencySquared;
+};
+
+LinkResult run_network_link( const engine::LinkSettings & settings, int packets, unsigned int seed )
+{
+	// one packet per frame from node 0 to node 1, each carrying its sequence number and send time
+
+	engine::NetworkSimulator networkSimulator( 2, seed );
+	networkSimulator.SetLinkSettings( 0, 1, settings );
+
+	LinkResult result;
+	memset( &result, 0, sizeof( result ) );
+	result.hash = 2166136261U;
+
+	std::vector<int> receiveCount( packets, 0 );
+	int highest = -1;
+
+	for ( int frame = 0; frame < packets + 600; ++frame )
+	{
+		if ( frame < packets )
+		{
+			unsigned char data[12];
+			const double time = networkSimulator.GetTime();
+			memcpy( data, &frame, 4 );
+			memcpy( data + 4, &time, 8 );
+			networkSimulator.SendPacket( 0, 1, data, sizeof( data ) );
+		}
+		networkSimulator.Update( DeltaTime );
+		while ( const engine::NetworkSimulator::Packet * packet = networkSimulator.ReceivePacket() )
+		{
+			int sequence;
+			double sendTime;
+			memcpy( &sequence, packet->data, 4 );
+			memcpy( &sendTime, packet->data + 4, 8 );
+			result.hash = ( result.hash ^ sequence ) * 16777619U;
+			result.hash = ( result.hash ^ frame ) * 16777619U;
+			if ( receiveCount[sequence]++ > 0 )
+			{
+				result.duplicates++;
+				continue;
+			}
+			if ( sequence < highest )
+				result.outOfOrder++;
+			highest = std::max( highest, sequence );
+			const double latency = networkSimulator.GetTime() - sendTime;
+			result.latency += latency;
+			result.latencySquared += latency * latency;
+			result.delivered++;
+		}
+	}
+
+	for ( int i = 0; i < packets; ++i )
+	{
+		if ( receiveCount[i] == 0 )
+		{
+			result.lostPackets++;
+			if ( i == 0 || receiveCount[i-1] != 0 )
+				result.lossBursts++;
+		}
+	}
+
+	return result;
+}
+
+void bench_network_link( const char * name, const engine::LinkSettings & settings )
+{
+	const int Packets = 36000;
+
+	const LinkResult result = run_network_link( settings, Packets, 1 );
+	const LinkResult repeat = run_network_link( settings, Packets, 1 );
+
+	const double mean = result.delivered ? result.latency / result.delivered : 0.0;
+	const double deviation = result.delivered ? sqrt( std::max( result.latencySquared / result.delivered - mean * mean, 0.0 ) ) : 0.0;
+
+	printf( "%-9s: delivered %5.1f%%, lost %4.1f%% (%4.1f per burst), duplicated %3.1f%%, out of order %3.1f%%, latency %5.1fms +/- %4.1fms%s\n",
+		name, result.delivered * 100.0f / Packets, result.lostPackets * 100.0f / Packets, 
+		result.lossBursts ? result.lostPackets / (float) result.lossBursts : 0.0f,
+		result.duplicates * 100.0f / Packets, result.outOfOrder * 100.0f / Packets, mean * 1000.0, deviation * 1000.0,
+		result.hash == repeat.hash ? "" : " (not deterministic!)" );
+}
+
+// ------------------------------------------------------------------------------------
+
+int main( int argc, char * argv[] )
+{
+	printf( "-----------------------------------------------------\n" );
+	printf( "bench update priority (%d players)\n", MaxPlayers );
+	printf( "-----------------------------------------------------\n" );
+
+	const int objectCounts[] = { 1024, 4096, 16384 };
+
+	for ( int i = 0; i < (int) ( sizeof( objectCounts ) / sizeof( int ) ); ++i )
+	{
+		const int objectCount = objectCounts[i];
+		const float linear = bench_update_priority( objectCount, false );
+		const float indexed = bench_update_priority( objectCount, true );
+		printf( "%6d active objects: linear find %8.3fms, indexed find %6.3fms per update\n", objectCount, linear, indexed );
+	}
+
+	printf( "-----------------------------------------------------\n" );
+	printf( "bench priority set (1%% churn per frame)\n" );
+	printf( "-----------------------------------------------------\n" );
+
+	const int setCounts[] = { 1024, 4096, 16384, 65536 };
+
+	for ( int i = 0; i < (int) ( sizeof( setCounts ) / sizeof( int ) ); ++i )
+	{
+		const int objectCount = setCounts[i];
+		const float full = bench_priority_set( objectCount, 0 );
+		const float top = bench_priority_set( objectCount, 256 );
+		printf( "%6d active objects: full sort %7.3fms, top 256 sort %6.3fms per frame\n", objectCount, full, top );
+	}
+
+	printf( "-----------------------------------------------------\n" );
+	printf( "bench authority manager (%d players)\n", MaxPlayers );
+	printf( "-----------------------------------------------------\n" );
+
+	const int authorityCounts[] = { 1000, 10000 };
+
+	for ( int i = 0; i < (int) ( sizeof( authorityCounts ) / sizeof( int ) ); ++i )
+	{
+		const int entryCount = authorityCounts[i];
+		int linearChecksum = 0;
+		int hashedChecksum = 0;
+		const float linear = bench_authority<LinearAuthorityManager>( entryCount, linearChecksum );
+		const float hashed = bench_authority<AuthorityManager>( entryCount, hashedChecksum );
+		printf( "%6d authority entries: linear scan %8.3fms, hashed %6.3fms per frame%s\n", entryCount, linear, hashed, linearChecksum == hashedChecksum ? "" : " (checksum mismatch!)" );
+	}
+
+	printf( "-----------------------------------------------------\n" );
+	printf( "bench interactions (stacked cubes)\n" );
+	printf( "-----------------------------------------------------\n" );
+
+	bench_interactions( 8, 8 );
+	bench_interactions( 16, 10 );
+	bench_interactions( 20, 20 );
+
+	printf( "-----------------------------------------------------\n" );
+	printf( "bench interaction pair filter\n" );
+	printf( "-----------------------------------------------------\n" );
+
+	bench_pair_filter( 10, 10 );
+	bench_pair_filter( 20, 10 );
+
+	printf( "-----------------------------------------------------\n" );
+	printf( "bench snapshot encoding (256 objects per packet)\n" );
+	printf( "-----------------------------------------------------\n" );
+
+	bench_snapshots( 324, 8, 0, 0 );
+	bench_snapshots( 324, 8, 3, 5 );
+	bench_snapshots( 324, 64, 3, 5 );
+	bench_snapshots( 1024, 64, 6, 10 );
+
+	printf( "-----------------------------------------------------\n" );
+	printf( "bench network simulator (%d players)\n", MaxPlayers );
+	printf( "-----------------------------------------------------\n" );
+
+	bench_network_simulator( 64, 1, 0.1f );
+	bench_network_simulator( 1024, 1, 0.1f );
+	bench_network_simulator( 16640, 1, 0.1f );
+	bench_network_simulator( 64, 16, 0.1f );
+	bench_network_simulator( 1024, 1, 1.0f );
+	bench_network_simulator( 64, 16, 1.0f );
+
+	{
+		engine::LinkSettings settings;
+		settings.latency = 0.05f;
+		bench_network_link( "latency", settings );
+
+		settings.jitter = 0.02f;
+		bench_network_link( "jitter", settings );
+
+		settings.packetLoss = 0.05f;
+		bench_network_link( "loss", settings );
+
+		settings.packetLoss = 0.01f;
+		settings.burstEnter = 0.01f;
+		settings.burstExit = 0.25f;
+		settings.burstLoss = 0.75f;
+		bench_network_link( "bursty", settings );
+
+		settings = engine::LinkSettings();
+		settings.latency = 0.05f;
+		settings.jitter = 0.01f;
+		settings.duplicate = 0.02f;
+		settings.reorder = 0.05f;
+		bench_network_link( "reorder", settings );
+
+		settings = engine::LinkSettings();
+		settings.latency = 0.05f;
+		settings.bandwidth = 4.0f;
+		bench_network_link( "4kbps cap", settings );
+	}
+
+	printf( "-----------------------------------------------------\n" );
+	printf( "bench view packets (%d players, %d bytes per packet)\n", MaxPlayers, (int) sizeof( view::Packet ) );
+	printf( "-----------------------------------------------------\n" );
+
+	const int viewCounts[] = { 64, 256, 1024 };
+
+	for ( int i = 0; i < (int) ( sizeof( viewCounts ) / sizeof( int ) ); ++i )
+	{
+		bench_view_packet( viewCounts[i], VIEW_CopyAll );
+		bench_view_packet( viewCounts[i], VIEW_CopyUsed );
+		bench_view_packet( viewCounts[i], VIEW_DoubleBuffered );
+	}
+
+	printf( "-----------------------------------------------------\n" );
+	printf( "bench view objects (extrapolate, smooth, interpolate)\n" );
+	printf( "-----------------------------------------------------\n" );
+
+	bench_view_objects( MaxViewObjects );
+	bench_view_objects( 16384 );
+
+	printf( "-----------------------------------------------------\n" );
+#if defined( MATH_AVX )
+	printf( "bench batch math (avx)\n" );
+#elif defined( MATH_SSE2 )
+	printf( "bench batch math (sse2)\n" );
+#else
+	printf( "bench batch math (scalar)\n" );
+#endif
+	printf( "-----------------------------------------------------\n" );
+
+	bench_math_batch( 1027, 1000 );
+	bench_math_batch( 65536, 20 );
+
+	printf( "-----------------------------------------------------\n" );
+	printf( "bench quantization\n" );
+	printf( "-----------------------------------------------------\n" );
+
+	bench_quantization( 1000000 );
+
+	printf( "-----------------------------------------------------\n" );
+	printf( "bench simulation (falling tower)\n" );
+	printf( "-----------------------------------------------------\n" );
+
+	bench_tower( 20, 10 );
+
+	return 0;
+}
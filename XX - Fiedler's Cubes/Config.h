@@ -29,15 +29,19 @@
 // compile time configuration
 
 #define MULTITHREADED
+//#define WORKER_SPAWN_PER_FRAME
 //#define VISUALIZE_SHADOW_VOLUMES
 //#define FRUSTUM_CULLING
 //#define USE_SECONDARY_DISPLAY_IF_EXISTS
 //#define DISCOVER_KEY_CODES
+//#define SCALAR_MATH
+//#define PRINT_SNAPSHOT_STATS
 
 const int MaxPlayers = 4;
 
 const float MaxLinearVelocity = 100;
 const float MaxAngularVelocity = 100;
+const float PositionBound = 512.0f;
 const float PositionResolution = 0.001f;
 const float OrientationResolution = 0.001f;
 const float LinearVelocityResolution = 0.001f;
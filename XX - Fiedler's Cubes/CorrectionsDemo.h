@@ -55,6 +55,7 @@ public:
 		{
 			game::Config config;
 			config.maxObjects = GridSize * GridSize + MaxPlayers + 1;
+			config.maxPriorityObjects = MaxObjectsInPacket;
 			config.deactivationTime = 0.5f;
 			config.cellSize = 4.0f;
 			config.cellWidth = GridSize / config.cellSize + 2;
@@ -74,6 +75,7 @@ public:
 				new game::Instance<hypercube::DatabaseObject, hypercube::ActiveObject> ( config );
 
 			gameInstance[i] = instance;
+			viewPacket[i] = &gameInstance[i]->GetViewPacket();
 
 			origin[i] = math::Vector(0,0,0);
 
@@ -166,8 +168,10 @@ public:
 		
 		const int sendRate = 1;
 
-		static engine::PacketQueue packetQueue;
-		packetQueue.SetDelay( lag );
+		static engine::NetworkSimulator networkSimulator( MaxPlayers );
+		engine::LinkSettings linkSettings;
+		linkSettings.latency = lag;
+		networkSimulator.SetLinkSettings( linkSettings );
 
 		// -----------------------------------------------------------------------------------------------
 		// send packets
@@ -269,7 +273,7 @@ public:
 							This queue has no packet loss, but it does simulate latency
 							for us, so we can see the effects of latency on our "networking"
 						*/
-						packetQueue.QueuePacket( from, to, (unsigned char*)&packet, sizeof(TempPacket) );
+						networkSimulator.SendPacket( from, to, (unsigned char*)&packet, sizeof(TempPacket) );
 					}
 				}
 				
@@ -281,11 +285,11 @@ public:
 		// receive packets
 		// -----------------------------------------------------------------------------------------------
 		{
-			packetQueue.Update( deltaTime );
+			networkSimulator.Update( deltaTime );
 
-			while ( engine::PacketQueue::Packet * pkt = packetQueue.PacketReadyToSend() )
+			while ( const engine::NetworkSimulator::Packet * pkt = networkSimulator.ReceivePacket() )
 			{
-				TempPacket & packet = * (TempPacket*) &pkt->data[0];
+				const TempPacket & packet = * (const TempPacket*) pkt->data;
 				int from = pkt->sourceNodeId;
 				int to = pkt->destinationNodeId;
 				
@@ -548,8 +552,6 @@ public:
 				*/
 				
 				// todo: reverse corrections
-
-				delete pkt;
 			}
 		}
 		
@@ -559,8 +561,8 @@ public:
 
 		for ( int i = 0; i < MaxPlayers; ++i )
 		{
-			gameInstance[i]->GetViewPacket( viewPacket[i] );
-			workerThread[i].Start( gameInstance[i] );
+			viewPacket[i] = &gameInstance[i]->GetViewPacket();
+			workers.Start( gameInstance[i] );
 		}
 		
 		t += deltaTime;
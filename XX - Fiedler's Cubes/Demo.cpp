@@ -59,6 +59,136 @@ private:
 	float time;
 };
 
+class GameUpdateJob : public WorkerJob
+{
+public:
+	
+	GameUpdateJob()
+	{
+		instance = NULL;
+		time = 0.0f;
+	}
+	
+	void SetInstance( game::Interface * instance )
+	{
+		assert( instance );
+		this->instance = instance;
+	}
+	
+	float GetTime() const
+	{
+		return time;
+	}
+	
+private:
+	
+	virtual void Run()
+	{
+		platform::Timer timer;
+		instance->Update( DeltaTime );
+		time = timer.delta();
+	}
+	
+	game::Interface * instance;
+	float time;
+};
+
+// runs the game instance updates for each frame on worker threads
+//  + by default the updates are jobs on a persistent worker pool, threads stay parked between frames
+//  + define WORKER_SPAWN_PER_FRAME to create and join one thread per instance each frame instead (the old way)
+//  + frame times are measured and printed every few seconds, so the two can be compared
+
+class GameWorkers
+{
+public:
+	
+	enum { MaxInstances = MaxPlayers };
+	enum { ReportFrames = 600 };
+	
+	GameWorkers()
+		#ifndef WORKER_SPAWN_PER_FRAME
+		: pool( MaxInstances )
+		#endif
+	{
+		count = 0;
+		ResetStats();
+	}
+	
+	void Start( game::Interface * instance )
+	{
+		assert( count < MaxInstances );
+		platform::Timer timer;
+		#ifdef WORKER_SPAWN_PER_FRAME
+		threads[count].Start( instance );
+		#else
+		jobs[count].SetInstance( instance );
+		pool.Start( &jobs[count] );
+		#endif
+		count++;
+		startTime += timer.delta();
+	}
+	
+	void Join()
+	{
+		if ( count == 0 )
+			return;
+		platform::Timer timer;
+		#ifdef WORKER_SPAWN_PER_FRAME
+		for ( int i = 0; i < count; ++i )
+			threads[i].Join();
+		#else
+		pool.Join();
+		#endif
+		joinTime += timer.delta();
+		float slowest = 0.0f;
+		for ( int i = 0; i < count; ++i )
+		{
+			#ifdef WORKER_SPAWN_PER_FRAME
+			const float time = threads[i].GetTime();
+			#else
+			const float time = jobs[i].GetTime();
+			#endif
+			slowest = time > slowest ? time : slowest;
+		}
+		updateTime += slowest;
+		count = 0;
+		if ( ++frames == ReportFrames )
+		{
+			#ifdef WORKER_SPAWN_PER_FRAME
+			const char * mode = "spawn per frame";
+			#else
+			const char * mode = "worker pool";
+			#endif
+			printf( "game workers (%s): start %.3fms, join wait %.3fms, slowest update %.3fms (average per frame)\n", 
+				mode, startTime * 1000.0f / frames, joinTime * 1000.0f / frames, updateTime * 1000.0f / frames );
+			ResetStats();
+		}
+	}
+	
+private:
+	
+	void ResetStats()
+	{
+		frames = 0;
+		startTime = 0.0f;
+		joinTime = 0.0f;
+		updateTime = 0.0f;
+	}
+	
+	int count;
+	#ifdef WORKER_SPAWN_PER_FRAME
+	GameWorkerThread threads[MaxInstances];
+	#else
+	WorkerPool pool;
+	GameUpdateJob jobs[MaxInstances];
+	#endif
+	
+	int frames;
+	float startTime;				// time spent starting updates (thread creation when spawning per frame)
+	float joinTime;					// time spent blocked waiting for updates to finish
+	float updateTime;				// time taken by the slowest instance update
+};
+
 // ------------------------------------------------------
 
 class Demo
@@ -13,6 +13,7 @@
 #include "Simulation.h"
 
 #include <list>
+#include <deque>
 #include <algorithm>
 #include <vector>
 
@@ -30,94 +31,112 @@ namespace engine
 		float time;
 	};
 
+	/*
+		Authority manager.
+		
+		Tracks which player has authority over each object.
+		
+		Authority is looked up per object, per player each frame, 
+		so entries are indexed by an open addressing hash table 
+		from object id to entry. Entries themselves are kept packed 
+		so update can age and expire them all in one pass.
+	*/
+	
 	class AuthorityManager
 	{
 	public:
 
 		AuthorityManager()
 		{
+			Clear();
 		}
 	
 		void Clear()
 		{
 			entries.clear();
+			table.clear();
+			table.resize( MinTableSize, -1 );
 		}
 
 	 	bool SetAuthority( ObjectId id, int authority, bool force = false )
 		{
 			assert( authority >= 0 );
 			assert( authority < MaxPlayers );
-			const int count = entries.size();
-			for ( int i = 0; i < count; ++i )
+			const int slot = FindSlot( id );
+			if ( slot != -1 )
 			{
-				if ( entries[i].id == id )
+				AuthorityEntry & entry = entries[ table[slot] ];
+				if ( authority <= entry.authority && !entry.forced || force )
 				{
-					if ( authority <= entries[i].authority && !entries[i].forced || force )
-					{
-						entries[i].authority = authority;
-						entries[i].forced = force;
-						entries[i].time = 0.0f;
-						return true;
-					}
-					else
-						return false;
+					entry.authority = authority;
+					entry.forced = force;
+					entry.time = 0.0f;
+					return true;
 				}
+				else
+					return false;
 			}
 			// add new entry
+			const int count = entries.size();
 			entries.resize( count + 1 );
 			entries[count].id = id;
 			entries[count].time = 0.0f;
 			entries[count].forced = force;
 			entries[count].authority = authority;
+			if ( ( count + 1 ) * 2 > (int) table.size() )
+				RebuildTable( table.size() * 2 );
+			else
+				InsertSlot( id, count );
 			return true;
 		}
 	
-		int GetAuthority( ObjectId id )
+		int GetAuthority( ObjectId id ) const
 		{
-			const int count = entries.size();
-			for ( int i = 0; i < count; ++i )
+			const int slot = FindSlot( id );
+			if ( slot != -1 )
 			{
-				if ( entries[i].id == id )
-				{
-					assert( entries[i].authority >= 0 );
-					assert( entries[i].authority < MaxPlayers );
-					return entries[i].authority;
-				}
+				const AuthorityEntry & entry = entries[ table[slot] ];
+				assert( entry.authority >= 0 );
+				assert( entry.authority < MaxPlayers );
+				return entry.authority;
 			}
 			return MaxPlayers;		// note: this represents "default" authority, any other player can take authority in this case
 		}
 	
 		void RemoveAuthority( ObjectId id )
 		{
+			const int slot = FindSlot( id );
+			if ( slot == -1 )
+				return;
+			const int i = table[slot];
+			RemoveSlot( slot );
 			const int count = entries.size();
-			for ( int i = 0; i < count; ++i )
+			if ( i != count - 1 )
 			{
-				if ( entries[i].id == id )
-				{
-					if ( i != count - 1 )
-						entries[i] = entries[count-1];
-					entries.resize( count - 1 );
-					return;
-				}
+				entries[i] = entries[count-1];
+				table[ FindSlot( entries[i].id ) ] = i;
 			}
+			entries.resize( count - 1 );
 		}
 
 		void Update( float deltaTime, float authorityTimeout )
 		{
-			int count = entries.size();
-			for ( int i = 0; i < count; )
+			// age all entries and pack the survivors down, then reindex once if any expired
+			const int count = entries.size();
+			int alive = 0;
+			for ( int i = 0; i < count; ++i )
 			{
 				entries[i].time += deltaTime;
 				if ( entries[i].time >= authorityTimeout || entries[i].authority == MaxPlayers )
-				{
-					if ( i != count - 1 )
-						entries[i] = entries[count-1];
-					entries.resize( count - 1 );
-					count--;
-				}
-				else
-					++i;
+					continue;
+				if ( alive != i )
+					entries[alive] = entries[i];
+				alive++;
 			}
+			if ( alive == count )
+				return;
+			entries.resize( alive );
+			RebuildTable( table.size() );
 		}
 	
 		int GetEntryCount() const
@@ -126,12 +145,79 @@ namespace engine
 		}
 
 	private:
+		
+		enum { MinTableSize = 64 };			// must be a power of two
+		
+		static uint32_t Hash( ObjectId id )
+		{
+			return id * 2654435761U;
+		}
+		
+		int FindSlot( ObjectId id ) const
+		{
+			const int mask = table.size() - 1;
+			for ( int slot = Hash( id ) & mask; table[slot] != -1; slot = ( slot + 1 ) & mask )
+			{
+				if ( entries[ table[slot] ].id == id )
+					return slot;
+			}
+			return -1;
+		}
+		
+		void InsertSlot( ObjectId id, int entryIndex )
+		{
+			const int mask = table.size() - 1;
+			int slot = Hash( id ) & mask;
+			while ( table[slot] != -1 )
+				slot = ( slot + 1 ) & mask;
+			table[slot] = entryIndex;
+		}
+		
+		void RemoveSlot( int slot )
+		{
+			// backward shift deletion: pull following entries of the probe run into the hole
+			const int mask = table.size() - 1;
+			int hole = slot;
+			for ( int next = ( slot + 1 ) & mask; table[next] != -1; next = ( next + 1 ) & mask )
+			{
+				const int home = Hash( entries[ table[next] ].id ) & mask;
+				if ( ( ( next - home ) & mask ) >= ( ( next - hole ) & mask ) )
+				{
+					table[hole] = table[next];
+					hole = next;
+				}
+			}
+			table[hole] = -1;
+		}
+		
+		void RebuildTable( int size )
+		{
+			assert( ( size & ( size - 1 ) ) == 0 );
+			table.clear();
+			table.resize( size, -1 );
+			for ( int i = 0; i < (int) entries.size(); ++i )
+				InsertSlot( entries[i].id, i );
+		}
 	
 		std::vector<AuthorityEntry> entries;
+		std::vector<int> table;				// open addressing hash from object id to entry index, -1 is an empty slot
 	};
 
 	// --------------------------------------------------
 
+	/*
+		Interaction manager.
+		
+		Works out which objects are transitively interacting with
+		a set of starting objects, eg. the objects under a player's
+		authority, without passing through ignored objects.
+		
+		Interaction pairs are first joined into islands with union
+		find, in one pass over the pairs. Walking interactions from
+		an object then just marks its whole island as interacting.
+		There is no recursion, so tall stacks of cubes are fine.
+	*/
+
 	class InteractionManager
 	{
 	public:
@@ -143,46 +229,60 @@ namespace engine
 
 		void ClearInteractions()
 		{
+			parent.clear();
+			size.clear();
 			interacting.clear();
 		}
 		
 		void PrepInteractions( int maxActiveId )
 		{
+			parent.resize( maxActiveId + 1 );
+			size.resize( maxActiveId + 1 );
 			interacting.resize( maxActiveId + 1 );
 			for ( int i = 0; i <= maxActiveId; ++i )
+			{
+				parent[i] = i;
+				size[i] = 1;
 				interacting[i] = false;
+			}
 		}
 		
-		void WalkInteractions( int activeId, const InteractionPair * interactionPairs, int numInteractionPairs, std::vector<bool> & ignore )
+		void BuildIslands( const InteractionPair * interactionPairs, int numInteractionPairs, const std::vector<bool> & ignore )
+		{
+			// ignored objects break the chain, so pairs touching them join nothing
+			for ( int i = 0; i < numInteractionPairs; ++i )
+			{
+				const int a = interactionPairs[i].a;
+				const int b = interactionPairs[i].b;
+				assert( a >= 0 && a < (int) parent.size() );
+				assert( b >= 0 && b < (int) parent.size() );
+				if ( ignore[a] || ignore[b] )
+					continue;
+				Union( a, b );
+			}
+		}
+		
+		void WalkInteractions( int activeId, const std::vector<bool> & ignore )
 		{
 			assert( activeId >= 0 );
 			assert( activeId < (int) interacting.size() );
-			if ( interacting[activeId] )
-				return;
 			if ( ignore[activeId] )
 				return;
 			SetInteracting( activeId );
-			for ( int i = 0; i < numInteractionPairs; ++i )
-			{
-				if ( interactionPairs[i].a == activeId )
-					WalkInteractions( interactionPairs[i].b, interactionPairs, numInteractionPairs, ignore );
-				if ( interactionPairs[i].b == activeId )
-					WalkInteractions( interactionPairs[i].a, interactionPairs, numInteractionPairs, ignore );
-			}
 		}
 
 		void SetInteracting( int activeId )
 		{
 			assert( activeId >= 0 );
 			assert( activeId < (int) interacting.size() );
-			interacting[activeId] = true;
+			interacting[ Find( activeId ) ] = true;
 		}
 
 		bool IsInteracting( int activeId )
 		{
 			assert( activeId >= 0 );
 			assert( activeId < (int) interacting.size() );
-			return interacting[activeId];
+			return interacting[ Find( activeId ) ];
 		}
 		
 		int GetCount() const
@@ -191,8 +291,34 @@ namespace engine
 		}
 	
 	private:
+		
+		int Find( int activeId )
+		{
+			// path halving keeps the trees flat without recursing
+			while ( parent[activeId] != activeId )
+			{
+				parent[activeId] = parent[ parent[activeId] ];
+				activeId = parent[activeId];
+			}
+			return activeId;
+		}
+		
+		void Union( int a, int b )
+		{
+			a = Find( a );
+			b = Find( b );
+			if ( a == b )
+				return;
+			if ( size[a] < size[b] )
+				std::swap( a, b );
+			parent[b] = a;
+			size[a] += size[b];
+			interacting[a] = interacting[a] || interacting[b];
+		}
 	
-		std::vector<bool> interacting;
+		std::vector<int> parent;			// union find forest over active ids
+		std::vector<int> size;				// island size, valid for roots only
+		std::vector<bool> interacting;		// interacting flag, valid for roots only
 	};
 
 	// --------------------------------------------------
@@ -239,78 +365,353 @@ namespace engine
 
 	// --------------------------------------------------------------
 
-	class PacketQueue
+	/*
+		Network simulator.
+		Stands in for the network between nodes in one process, so
+		packets see latency, jitter, loss, duplication, reordering
+		and a bandwidth cap like they would on a real link.
+
+		Each direction between two nodes has its own link settings.
+		Bursty loss follows the Gilbert-Elliott model: the link flips
+		between a good and a bad state, each with its own loss rate.
+
+		Packet data lives in pooled slots that keep their buffers, and
+		are never moved, so a received packet's data stays put while
+		more packets are sent. Packets due no earlier than the last one
+		queued go on the end of a fifo, which is all of them unless
+		there is jitter, reordering or mixed latency. The rest sit in a
+		heap ordered by delivery time, and each receive takes whichever
+		of the two is due first. Once the pool has warmed up nothing is
+		allocated or shuffled per packet. All randomness comes from one
+		seeded generator: the same seed and the same sends give the
+		same deliveries.
+	*/
+
+	struct LinkSettings
+	{
+		LinkSettings()
+		{
+			latency = 0.0f;
+			jitter = 0.0f;
+			packetLoss = 0.0f;
+			burstEnter = 0.0f;
+			burstExit = 1.0f;
+			burstLoss = 1.0f;
+			duplicate = 0.0f;
+			reorder = 0.0f;
+			reorderDelay = 0.05f;
+			bandwidth = 0.0f;
+			queueTime = 0.25f;
+		}
+
+		float latency;				// one way latency in seconds
+		float jitter;				// latency varies by up to +/- jitter seconds, most often by little
+		float packetLoss;			// chance of losing a packet while the link is in the good state
+		float burstEnter;			// chance per packet of the link going from the good state to the bad state
+		float burstExit;			// chance per packet of the link going from the bad state back to the good state
+		float burstLoss;			// chance of losing a packet while the link is in the bad state
+		float duplicate;			// chance of delivering a packet twice
+		float reorder;				// chance of holding a packet back, so packets sent after it overtake it
+		float reorderDelay;			// how long a reordered packet is held back, in seconds
+		float bandwidth;			// bandwidth cap in kbps, zero for no cap
+		float queueTime;			// packets that would wait longer than this for bandwidth are dropped
+	};
+
+	class NetworkSimulator
 	{
 	public:
-	
+
 		struct Packet
 		{
-			float timeInQueue;
 			int sourceNodeId;
 			int destinationNodeId;
-			std::vector<unsigned char> data;
+			const unsigned char * data;
+			int size;
 		};
-	
-		PacketQueue()
+
+		NetworkSimulator( int maxNodes, unsigned int seed = 1 )
 		{
-			delay = 0.0f;
+			assert( maxNodes > 0 );
+			this->maxNodes = maxNodes;
+			links.resize( maxNodes * maxNodes );
+			received = -1;
+			Reset( seed );
 		}
 
-		~PacketQueue()
+		void Reset( unsigned int seed )
 		{
+			// note: settings are kept, everything else goes back to how it was at construction
+
 			Clear();
+			this->seed = seed ? seed : 1;
+			time = 0.0;
+			order = 0;
+			sent = 0;
+			delivered = 0;
+			lost = 0;
+			dropped = 0;
+			duplicated = 0;
+			reordered = 0;
+			for ( int i = 0; i < (int) links.size(); ++i )
+			{
+				links[i].bad = false;
+				links[i].freeTime = 0.0;
+				links[i].lastDelivery = 0.0;
+			}
 		}
-	
+
 		void Clear()
 		{
-			for ( int i = 0; i < (int) queue.size(); ++i )
-				delete queue[i];
-			queue.clear();
+			ReleaseReceived();
+			for ( int i = 0; i < (int) heap.size(); ++i )
+				freeSlots.push_back( heap[i].slot );
+			heap.clear();
+			for ( int i = 0; i < (int) fifo.size(); ++i )
+				freeSlots.push_back( fifo[i].slot );
+			fifo.clear();
 		}
-	
-		void QueuePacket( int sourceNodeId, int destinationNodeId, unsigned char * data, int bytes )
+
+		void SetLinkSettings( const LinkSettings & settings )
 		{
-			assert( bytes >= 0 );
-			Packet * packet = new Packet();
-			packet->timeInQueue = 0.0f;
-			packet->sourceNodeId = sourceNodeId;
-			packet->destinationNodeId = destinationNodeId;
-			packet->data.resize( bytes );
-			memcpy( &packet->data[0], data, bytes );
-			queue.push_back( packet );
+			for ( int i = 0; i < (int) links.size(); ++i )
+				links[i].settings = settings;
 		}
-	
-		void SetDelay( float delay )
+
+		void SetLinkSettings( int sourceNodeId, int destinationNodeId, const LinkSettings & settings )
 		{
-			this->delay = delay;
+			GetLink( sourceNodeId, destinationNodeId ).settings = settings;
 		}
 
-		void Update( float deltaTime )
+		const LinkSettings & GetLinkSettings( int sourceNodeId, int destinationNodeId )
 		{
-			for ( int i = 0; i < (int) queue.size(); ++i )
-				queue[i]->timeInQueue += deltaTime;
+			return GetLink( sourceNodeId, destinationNodeId ).settings;
 		}
-	
-		Packet * PacketReadyToSend()
+
+		void SendPacket( int sourceNodeId, int destinationNodeId, const unsigned char * data, int bytes )
 		{
-			while ( queue.size() > 0 )
+			assert( bytes >= 0 );
+			sent++;
+
+			Link & link = GetLink( sourceNodeId, destinationNodeId );
+			const LinkSettings & settings = link.settings;
+
+			if ( link.bad )
+			{
+				if ( Chance( settings.burstExit ) )
+					link.bad = false;
+			}
+			else if ( Chance( settings.burstEnter ) )
+				link.bad = true;
+
+			if ( Chance( link.bad ? settings.burstLoss : settings.packetLoss ) )
+			{
+				lost++;
+				return;
+			}
+
+			double departure = time;
+			if ( settings.bandwidth > 0.0f )
 			{
-				Packet * packet = queue[0];
-				if ( packet->timeInQueue >= delay )
+				const double start = std::max( time, link.freeTime );
+				if ( start - time > settings.queueTime )
 				{
-					queue.erase( queue.begin() );
-					return packet;			// important! it is your responsibility to delete the packet(!!!)
+					dropped++;
+					return;
 				}
-				else
-					break;
+				departure = start + bytes * 8 / ( settings.bandwidth * 1000.0 );
+				link.freeTime = departure;
+			}
+
+			double delivery = departure + std::max( settings.latency + Jitter( settings.jitter ), 0.0f );
+
+			// note: packets on a link arrive in the order sent, unless one is picked to be held back
+
+			if ( Chance( settings.reorder ) )
+			{
+				delivery += settings.reorderDelay;
+				reordered++;
+			}
+			else
+			{
+				delivery = std::max( delivery, link.lastDelivery );
+				link.lastDelivery = delivery;
+			}
+
+			QueuePacket( sourceNodeId, destinationNodeId, data, bytes, delivery );
+
+			if ( Chance( settings.duplicate ) )
+			{
+				QueuePacket( sourceNodeId, destinationNodeId, data, bytes, delivery + fabs( Jitter( settings.jitter ) ) );
+				duplicated++;
 			}
-			return NULL;
 		}
-	
+
+		void Update( float deltaTime )
+		{
+			ReleaseReceived();
+			time += deltaTime;
+		}
+
+		// returns the next packet due for delivery, or NULL. the packet is valid until the next call
+		// to receive packet, update or clear, sending packets in the meantime is fine
+
+		const Packet * ReceivePacket()
+		{
+			ReleaseReceived();
+			const bool fromFifo = !fifo.empty() && ( heap.empty() || DeliversLater( heap[0], fifo.front() ) );
+			if ( fromFifo )
+			{
+				if ( fifo.front().time > time )
+					return NULL;
+				received = fifo.front().slot;
+				fifo.pop_front();
+			}
+			else
+			{
+				if ( heap.empty() || heap[0].time > time )
+					return NULL;
+				std::pop_heap( heap.begin(), heap.end(), DeliversLater );
+				received = heap.back().slot;
+				heap.pop_back();
+			}
+			delivered++;
+			const Slot & slot = slots[received];
+			packet.sourceNodeId = slot.sourceNodeId;
+			packet.destinationNodeId = slot.destinationNodeId;
+			packet.data = slot.data.empty() ? NULL : &slot.data[0];
+			packet.size = slot.size;
+			return &packet;
+		}
+
+		double GetTime() const					{ return time; }
+		int GetPacketsInFlight() const			{ return (int) ( heap.size() + fifo.size() ); }
+		unsigned int GetPacketsSent() const		{ return sent; }
+		unsigned int GetPacketsDelivered() const	{ return delivered; }
+		unsigned int GetPacketsLost() const		{ return lost; }
+		unsigned int GetPacketsDropped() const	{ return dropped; }
+		unsigned int GetPacketsDuplicated() const	{ return duplicated; }
+		unsigned int GetPacketsReordered() const	{ return reordered; }
+
 	private:
-	
-		float delay;						// number of seconds to delay packet sends (hold in queue)
-		std::vector<Packet*> queue;
+
+		struct Link
+		{
+			LinkSettings settings;
+			bool bad;						// gilbert-elliott state
+			double freeTime;				// time the bandwidth cap is free to send the next packet
+			double lastDelivery;			// delivery time of the last packet sent in order
+		};
+
+		struct Slot
+		{
+			int sourceNodeId;
+			int destinationNodeId;
+			int size;
+			std::vector<unsigned char> data;	// note: never shrinks, so a reused slot doesn't allocate
+		};
+
+		struct Entry
+		{
+			double time;
+			unsigned int order;
+			int slot;
+		};
+
+		static bool DeliversLater( const Entry & a, const Entry & b )
+		{
+			// heap comparison: earliest time on top, ties go in send order
+			if ( a.time != b.time )
+				return a.time > b.time;
+			return a.order > b.order;
+		}
+
+		Link & GetLink( int sourceNodeId, int destinationNodeId )
+		{
+			assert( sourceNodeId >= 0 && sourceNodeId < maxNodes );
+			assert( destinationNodeId >= 0 && destinationNodeId < maxNodes );
+			return links[ sourceNodeId * maxNodes + destinationNodeId ];
+		}
+
+		void QueuePacket( int sourceNodeId, int destinationNodeId, const unsigned char * data, int bytes, double deliveryTime )
+		{
+			if ( freeSlots.empty() )
+			{
+				freeSlots.push_back( (int) slots.size() );
+				slots.push_back( Slot() );
+			}
+			const int index = freeSlots.back();
+			freeSlots.pop_back();
+			Slot & slot = slots[index];
+			slot.sourceNodeId = sourceNodeId;
+			slot.destinationNodeId = destinationNodeId;
+			slot.size = bytes;
+			if ( (int) slot.data.size() < bytes )
+				slot.data.resize( bytes );
+			if ( bytes > 0 )
+				memcpy( &slot.data[0], data, bytes );
+			Entry entry;
+			entry.time = deliveryTime;
+			entry.order = order++;
+			entry.slot = index;
+			if ( fifo.empty() || fifo.back().time <= deliveryTime )
+				fifo.push_back( entry );
+			else
+			{
+				heap.push_back( entry );
+				std::push_heap( heap.begin(), heap.end(), DeliversLater );
+			}
+		}
+
+		void ReleaseReceived()
+		{
+			if ( received != -1 )
+			{
+				freeSlots.push_back( received );
+				received = -1;
+			}
+		}
+
+		float Random()
+		{
+			// xorshift32: uniform in [0,1)
+			seed ^= seed << 13;
+			seed ^= seed >> 17;
+			seed ^= seed << 5;
+			return ( seed >> 8 ) * ( 1.0f / 16777216.0f );
+		}
+
+		bool Chance( float probability )
+		{
+			// note: no random number is drawn for settings that are off, so they cost nothing
+			return probability > 0.0f && Random() < probability;
+		}
+
+		float Jitter( float jitter )
+		{
+			// triangular distribution in [-jitter,+jitter]: small variations common, large ones rare
+			if ( jitter <= 0.0f )
+				return 0.0f;
+			return ( Random() + Random() - 1.0f ) * jitter;
+		}
+
+		int maxNodes;
+		unsigned int seed;
+		double time;
+		unsigned int order;
+		std::vector<Link> links;
+		std::deque<Slot> slots;				// note: a deque so growing the pool never moves a slot's buffer
+		std::vector<int> freeSlots;
+		std::deque<Entry> fifo;				// packets in flight in delivery order
+		std::vector<Entry> heap;			// packets in flight that went out of order, a min heap on delivery time
+		Packet packet;
+		int received;						// slot of the packet last returned by receive packet, or -1
+
+		unsigned int sent;
+		unsigned int delivered;
+		unsigned int lost;
+		unsigned int dropped;
+		unsigned int duplicated;
+		unsigned int reordered;
 	};
 
 	/*
@@ -318,6 +719,14 @@ namespace engine
 		Used to track n most important active objects to send,
 		so we know which objects to include in each packet while
 		distributing fairly according to priority and last time sent.
+		
+		Packets only ever take the first few objects, so sort can be
+		asked for just the top n: those end up at the front in priority
+		order and the rest are left unordered behind them.
+		
+		An object id to entry index table is cached so add, remove
+		and exists are constant time. Sorting moves entries around, 
+		so the table is rebuilt the next time it is needed.
 	*/
 
 	class PrioritySet
@@ -326,21 +735,19 @@ namespace engine
 		
 		PrioritySet()
 		{
+			indexDirty = false;
 		}
 		
 		void Clear()
 		{
 			entries.clear();
+			index.clear();
+			indexDirty = false;
 		}
 		
 		bool ObjectExists( ObjectId objectId ) const
 		{
-			for ( int i = 0; i < (int) entries.size(); ++i )
-			{
-				if ( entries[i].objectId == objectId )
-					return true;
-			}
-			return false;
+			return FindIndex( objectId ) != -1;
 		}
 
 		void AddObject( ObjectId objectId )
@@ -350,22 +757,26 @@ namespace engine
 			entries.resize( size + 1 );
 			entries[size].objectId = objectId;
 			entries[size].priority = 0.0f;
+			if ( objectId >= index.size() )
+				index.resize( objectId + 1, -1 );
+			index[objectId] = size;
 		}
 		
 		void RemoveObject( ObjectId objectId )
 		{
 			const int count = entries.size();
 			assert( count > 0 );
-			for ( int i = 0; i < count; ++i )
+			const int i = FindIndex( objectId );
+			if ( i == -1 )
+				return;
+			index[objectId] = -1;
+			if ( i != count - 1 )
 			{
-				if ( entries[i].objectId == objectId )
-				{
-					entries[i].objectId = entries[count-1].objectId;
-					entries[i].priority = entries[count-1].priority;
-					entries.resize( count - 1 );
-					return;
-				}
+				entries[i].objectId = entries[count-1].objectId;
+				entries[i].priority = entries[count-1].priority;
+				index[entries[i].objectId] = i;
 			}
+			entries.resize( count - 1 );
 		}
 
 		float GetPriorityAtIndex( int index ) const
@@ -385,6 +796,21 @@ namespace engine
 		void SortObjects()
 		{
 			std::sort( entries.begin(), entries.end() );
+			indexDirty = true;
+		}
+		
+		void SortObjects( int count )
+		{
+			// sort only the "count" highest priority objects, eg. as many as fit in a packet
+			assert( count >= 0 );
+			if ( count >= (int) entries.size() )
+			{
+				SortObjects();
+				return;
+			}
+			std::nth_element( entries.begin(), entries.begin() + count, entries.end() );
+			std::sort( entries.begin(), entries.begin() + count );
+			indexDirty = true;
 		}
 		
 		ObjectId GetPriorityObject( int index ) const
@@ -399,6 +825,19 @@ namespace engine
 		
 	private:
 		
+		int FindIndex( ObjectId objectId ) const
+		{
+			if ( indexDirty )
+			{
+				for ( int i = 0; i < (int) entries.size(); ++i )
+					index[entries[i].objectId] = i;
+				indexDirty = false;
+			}
+			if ( objectId >= index.size() )
+				return -1;
+			return index[objectId];
+		}
+		
 		struct ObjectEntry
 		{
 			// todo: we could probably crunch these guys down into 32 bits...
@@ -411,6 +850,8 @@ namespace engine
 		};
 
 		std::vector<ObjectEntry> entries;
+		mutable std::vector<int> index;		// object id to entry index, -1 if the object is not in the set
+		mutable bool indexDirty;			// entries have been sorted since the index was built
 	};
 	
 	// helper functions for compression
@@ -574,9 +1015,11 @@ namespace engine
 		const float normal_b = ( b - minimum ) / ( maximum - minimum );
 		const float normal_c = ( c - minimum ) / ( maximum - minimum );
 
- 		uint32_t integer_a = math::floor( normal_a * 1024.0f + 0.5f );
- 		uint32_t integer_b = math::floor( normal_b * 1024.0f + 0.5f );
- 		uint32_t integer_c = math::floor( normal_c * 1024.0f + 0.5f );
+		// note: clamp to 10 bits, otherwise a component at the maximum rounds to 1024 and spills into its neighbour
+
+ 		uint32_t integer_a = math::clamp( (unsigned int) math::floor( normal_a * 1024.0f + 0.5f ), 0u, 1023u );
+ 		uint32_t integer_b = math::clamp( (unsigned int) math::floor( normal_b * 1024.0f + 0.5f ), 0u, 1023u );
+ 		uint32_t integer_c = math::clamp( (unsigned int) math::floor( normal_c * 1024.0f + 0.5f ), 0u, 1023u );
 
 //		printf( "integer: a = %d, b = %d, c = %d, largest = %d\n", 
 //			integer_a, integer_b, integer_c, largest );
@@ -672,43 +1115,198 @@ namespace engine
 		orientation.normalize();
 	}
 
-/*
-	void CompressOrientation( const math::Quaternion & orientation, uint32_t & compressed_orientation )
+	/*
+		Quantized object state.
+		Snaps position, orientation and velocities to the integer grid set by
+		the bounds and resolutions in Config.h. The integer is the canonical
+		form of each value and the float is always integer * resolution, so a
+		value already on the grid quantizes back to the same integer. This is
+		what lets an instance that simulates from quantized state and an
+		instance that receives the same state over the network hold exactly
+		the same floats.
+
+		Orientation is sent as "smallest three": the largest component is
+		dropped and rebuilt from the other three, which always lie in
+		[-1/sqrt(2),+1/sqrt(2)]. The quaternion is flipped so the dropped
+		component is positive.
+
+		Each integer is within half a resolution step of the value, so a
+		vector is off by at most sqrt(3)/2 * resolution, plus float rounding
+		for values near the bound (one float epsilon of the bound). The dropped
+		component is at least 1/2, which keeps its error to sqrt(3) times
+		that of the other three, so an orientation is off by at most
+		2 * sqrt(3) * OrientationResolution radians (0.2 degrees with the
+		defaults in Config.h). With those defaults an absolute object
+		state is 203 bits: position 60, orientation 35 and 54 for each
+		velocity, against 416 bits as raw floats.
+	*/
+
+	struct QuantizedState
 	{
-		const float w = orientation.w;
-		const float x = orientation.x;
-		const float y = orientation.y;
-		const float z = orientation.z;
+		int32_t position[3];
+		uint32_t largest;					// index of the dropped orientation component: x,y,z,w = 0,1,2,3
+		int32_t orientation[3];				// the other three components, in x,y,z,w order
+		int32_t linearVelocity[3];
+		int32_t angularVelocity[3];
+
+		bool operator == ( const QuantizedState & other ) const
+		{
+			if ( largest != other.largest )
+				return false;
+			for ( int i = 0; i < 3; ++i )
+			{
+				if ( position[i] != other.position[i] || orientation[i] != other.orientation[i] ||
+					 linearVelocity[i] != other.linearVelocity[i] || angularVelocity[i] != other.angularVelocity[i] )
+					return false;
+			}
+			return true;
+		}
 
-		const float normal_w = ( w + 1 ) * 0.5f; 
-		const float normal_x = ( x + 1 ) * 0.5f;
-		const float normal_y = ( y + 1 ) * 0.5f;
-		const float normal_z = ( z + 1 ) * 0.5f;
+		bool operator != ( const QuantizedState & other ) const
+		{
+			return !( *this == other );
+		}
+	};
 
-		unsigned int integer_w = math::floor( normal_w * 255.0f + 0.5f );
-		unsigned int integer_x = math::floor( normal_x * 255.0f + 0.5f );
-		unsigned int integer_y = math::floor( normal_y * 255.0f + 0.5f );
-		unsigned int integer_z = math::floor( normal_z * 255.0f + 0.5f );
+	const float SmallestThreeBound = 0.7071068f;		// note: 1.0f / sqrt(2)
 
-		compressed_orientation = ( integer_w ) << 24 | ( integer_x << 16 ) | ( integer_y << 8 ) | integer_z;
+	inline int32_t GetQuantizedLimit( float bound, float resolution )
+	{
+		return (int32_t) math::floor( bound / resolution + 0.5f );
 	}
 
-	void DecompressOrientation( uint32_t compressed_orientation, math::Quaternion & orientation )
+	inline int32_t GetPositionLimit()			{ return GetQuantizedLimit( PositionBound, PositionResolution ); }
+	inline int32_t GetOrientationLimit()		{ return GetQuantizedLimit( SmallestThreeBound, OrientationResolution ); }
+	inline int32_t GetLinearVelocityLimit()		{ return GetQuantizedLimit( MaxLinearVelocity, LinearVelocityResolution ); }
+	inline int32_t GetAngularVelocityLimit()	{ return GetQuantizedLimit( MaxAngularVelocity, AngularVelocityResolution ); }
+
+	inline int32_t QuantizeFloat( float value, int32_t limit, float resolution )
 	{
-		const unsigned int integer_w = compressed_orientation >> 24;
-		const unsigned int integer_x = ( compressed_orientation >> 16 ) & 0xFF;
-		const unsigned int integer_y = ( compressed_orientation >> 8 ) & 0xFF;
-		const unsigned int integer_z = compressed_orientation & 0xFF;
+		const int32_t integer = (int32_t) math::floor( value / resolution + 0.5f );
+		return math::clamp( integer, -limit, limit );
+	}
 
-		const float w = integer_w * 2.0f / 255.0f - 1.0f;
-		const float x = integer_x * 2.0f / 255.0f - 1.0f;
-		const float y = integer_y * 2.0f / 255.0f - 1.0f;
-		const float z = integer_z * 2.0f / 255.0f - 1.0f;
+	inline float DequantizeFloat( int32_t integer, float resolution )
+	{
+		return integer * resolution;
+	}
 
-		orientation = math::Quaternion( w, x, y, z );
-		orientation.normalize();
+	inline void QuantizeVector( const math::Vector & vector, int32_t integer[], int32_t limit, float resolution )
+	{
+		integer[0] = QuantizeFloat( vector.x, limit, resolution );
+		integer[1] = QuantizeFloat( vector.y, limit, resolution );
+		integer[2] = QuantizeFloat( vector.z, limit, resolution );
+	}
+
+	inline void DequantizeVector( const int32_t integer[], math::Vector & vector, float resolution )
+	{
+		vector.x = DequantizeFloat( integer[0], resolution );
+		vector.y = DequantizeFloat( integer[1], resolution );
+		vector.z = DequantizeFloat( integer[2], resolution );
+	}
+
+	inline void RebuildOrientation( uint32_t largest, const int32_t integer[], float component[] )
+	{
+		assert( largest < 4 );
+		float sum_squares = 0.0f;
+		int j = 0;
+		for ( int i = 0; i < 4; ++i )
+		{
+			if ( i == (int) largest )
+				continue;
+			component[i] = DequantizeFloat( integer[j++], OrientationResolution );
+			sum_squares += component[i] * component[i];
+		}
+		component[largest] = math::sqrt( math::maximum( 0.0f, 1.0f - sum_squares ) );
+	}
+
+	inline void QuantizeOrientation( const math::Quaternion & orientation, uint32_t & largest, int32_t integer[] )
+	{
+		const float component[] = { orientation.x, orientation.y, orientation.z, orientation.w };
+
+		largest = 0;
+		float largest_value = math::abs( component[0] );
+		for ( int i = 1; i < 4; ++i )
+		{
+			const float value = math::abs( component[i] );
+			if ( value > largest_value )
+			{
+				largest = i;
+				largest_value = value;
+			}
+		}
+
+		const float sign = component[largest] >= 0.0f ? 1.0f : -1.0f;
+		const int32_t limit = GetOrientationLimit();
+
+		int j = 0;
+		for ( int i = 0; i < 4; ++i )
+		{
+			if ( i != (int) largest )
+				integer[j++] = QuantizeFloat( component[i] * sign, limit, OrientationResolution );
+		}
+
+		// note: near a tie, rounding can leave a small component bigger than the rebuilt largest one,
+		// and quantizing the rebuilt quaternion would then drop a different component. step the biggest 
+		// small component toward zero until the rebuilt component is strictly largest, so quantizing
+		// dequantized orientation always gives back the same integers
+
+		while ( true )
+		{
+			float rebuilt[4];
+			RebuildOrientation( largest, integer, rebuilt );
+			int biggest = -1;
+			for ( int k = 0; k < 3; ++k )
+			{
+				const int i = k + ( k >= (int) largest ? 1 : 0 );
+				if ( math::abs( rebuilt[i] ) >= rebuilt[largest] && ( biggest == -1 || math::abs( (float) integer[k] ) > math::abs( (float) integer[biggest] ) ) )
+					biggest = k;
+			}
+			if ( biggest == -1 )
+				break;
+			integer[biggest] += integer[biggest] > 0 ? -1 : 1;
+		}
+	}
+
+	inline void DequantizeOrientation( uint32_t largest, const int32_t integer[], math::Quaternion & orientation )
+	{
+		// note: no normalize here. the three small components stay exactly on the grid, 
+		// and the rebuilt component already makes the quaternion unit length
+
+		float component[4];
+		RebuildOrientation( largest, integer, component );
+		orientation.x = component[0];
+		orientation.y = component[1];
+		orientation.z = component[2];
+		orientation.w = component[3];
+	}
+
+	inline void QuantizeState( const math::Vector & position, const math::Quaternion & orientation, 
+	                           const math::Vector & linearVelocity, const math::Vector & angularVelocity,
+	                           QuantizedState & quantized )
+	{
+		QuantizeVector( position, quantized.position, GetPositionLimit(), PositionResolution );
+		QuantizeOrientation( orientation, quantized.largest, quantized.orientation );
+		QuantizeVector( linearVelocity, quantized.linearVelocity, GetLinearVelocityLimit(), LinearVelocityResolution );
+		QuantizeVector( angularVelocity, quantized.angularVelocity, GetAngularVelocityLimit(), AngularVelocityResolution );
+	}
+
+	inline void DequantizeState( const QuantizedState & quantized, 
+	                             math::Vector & position, math::Quaternion & orientation, 
+	                             math::Vector & linearVelocity, math::Vector & angularVelocity )
+	{
+		DequantizeVector( quantized.position, position, PositionResolution );
+		DequantizeOrientation( quantized.largest, quantized.orientation, orientation );
+		DequantizeVector( quantized.linearVelocity, linearVelocity, LinearVelocityResolution );
+		DequantizeVector( quantized.angularVelocity, angularVelocity, AngularVelocityResolution );
+	}
+
+	inline void QuantizeObjectState( SimulationObjectState & state )
+	{
+		QuantizedState quantized;
+		QuantizeState( state.position, state.orientation, state.linearVelocity, state.angularVelocity, quantized );
+		DequantizeState( quantized, state.position, state.orientation, state.linearVelocity, state.angularVelocity );
 	}
-	*/
 }
 
 #endif
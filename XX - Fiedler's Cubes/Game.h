@@ -89,6 +89,7 @@ namespace game
 		int maxObjects;
 		int initialObjectsPerCell;
 		int initialActiveObjects;
+		int maxPriorityObjects;				// only this many of the highest priority objects are sorted each frame (zero sorts them all)
 
 		Config()
 		{
@@ -101,6 +102,7 @@ namespace game
 			maxObjects = 1024;
 			initialObjectsPerCell = 32;
 			initialActiveObjects = 256;
+			maxPriorityObjects = 0;
 		}
 	};
 
@@ -121,6 +123,7 @@ namespace game
 		virtual void Update( float deltaTime ) = 0;
 		virtual void SetPlayerInput( int playerId, const Input & input ) = 0;
 		virtual void GetViewPacket( view::Packet & viewPacket ) = 0;
+		virtual const view::Packet & GetViewPacket() const = 0;
 		virtual void SetFlag( Flag flag ) = 0;
 		virtual void ClearFlag( Flag flag ) = 0;
 		virtual bool GetFlag( Flag flag ) const = 0;
@@ -158,6 +161,7 @@ namespace game
 			objectCount = 0;
 			localPlayerId = -1;
 			origin = math::Vector(0,0,0);
+			viewPacketIndex = 0;
 			for ( int i = 0; i < MaxPlayers; ++i )
 			{
 				joined[i] = false;
@@ -165,7 +169,7 @@ namespace game
 				frame[i] = 0;
 				playerFocus[i] = 0;
 			}
-			activeObjects.Allocate( config.initialActiveObjects );
+			activeObjects.Allocate( config.initialActiveObjects, config.maxObjects );
 		}
 		
 		~Instance()
@@ -370,7 +374,13 @@ namespace game
 
 		void GetViewPacket( view::Packet & viewPacket )
 		{
-			viewPacket = this->viewPacket;
+			view::CopyPacket( this->viewPacket[viewPacketIndex], viewPacket );
+		}
+
+		const view::Packet & GetViewPacket() const
+		{
+			// note: the packet stays valid until the update after next, so the renderer can read it while the next update runs
+			return viewPacket[viewPacketIndex];
 		}
 		
 		void GetActiveObjects( ActiveObject * objects, int & count )
@@ -785,7 +795,10 @@ namespace game
 
 					prioritySet[playerId].SetPriorityAtIndex( i, priority );
 				}
-				prioritySet[playerId].SortObjects();
+				if ( config.maxPriorityObjects > 0 )
+					prioritySet[playerId].SortObjects( config.maxPriorityObjects );
+				else
+					prioritySet[playerId].SortObjects();
 			}
 		}
 		
@@ -824,21 +837,13 @@ namespace game
 				const float bound_y = activationSystem->GetBoundY();
 				activeObject->Clamp( bound_x, bound_y );
 				
-				// todo: quantize state
-				
-				/*
-				// quantize state
+				// quantize state: every instance snaps to the same grid the network sends, so state matches bit for bit
 				if ( GetFlag( FLAG_Quantize ) )
 				{
-					uint64_t compressed_position;
-					uint32_t compressed_orientation;
-					CompressPosition( objectState.position, compressed_position );
-					CompressOrientation( objectState.orientation, compressed_orientation );
-					DecompressPosition( compressed_position, objectState.position );
-					DecompressOrientation( compressed_orientation, objectState.orientation );
-					// todo: quantize linear velocity, angular velocity...
+					activeObject->ActiveToSimulation( simObjectState );
+					engine::QuantizeObjectState( simObjectState );
+					activeObject->SimulationToActive( simObjectState );
 				}
-				*/
 				
 				float x,y;
 				activeObject->GetPositionXY( x, y );
@@ -848,6 +853,10 @@ namespace game
 		
 		void ConstructViewPacket()
 		{
+			// build into the back buffer, then flip. the front buffer may still be read by the renderer
+
+			view::Packet & viewPacket = this->viewPacket[1-viewPacketIndex];
+
 			ActiveObject * localPlayerActiveObject = activeObjects.FindObject( playerFocus[localPlayerId] );
 			if ( localPlayerActiveObject )
 			{
@@ -873,8 +882,10 @@ namespace game
 			}
 			else
 			{
-				viewPacket = view::Packet();
+				viewPacket.Clear();
 			}
+
+			viewPacketIndex = 1 - viewPacketIndex;
 		}
 		
 		void UpdateAuthority( float deltaTime )
@@ -985,15 +996,19 @@ namespace game
 							The basic algorithm is to walk starting at the set of
 							objects which have player authority, transmitting this
 							authority to other objects along the chain of interactions.
-							Ignore objects break the chain. See the "WalkInteractions"
-							function in Engine.h for details.
+							Ignore objects break the chain. The pairs are joined into
+							islands of interacting objects up front, so walking from an
+							object marks its whole island. See "InteractionManager"
+							in Engine.h for details.
 						*/
+						interactionManager.BuildIslands( interactionPairs, numInteractionPairs, ignores );
+
 						for ( int i = 0; i < activeObjects.GetCount(); ++i )
 						{
 							ActiveObject & activeObject = activeObjects.GetObject( i );
 							int authority = authorityManager.GetAuthority( activeObject.id );
 							if ( authority == playerId )
-								interactionManager.WalkInteractions( activeObject.activeId, interactionPairs, numInteractionPairs, ignores );
+								interactionManager.WalkInteractions( activeObject.activeId, ignores );
 						}
 
 						/*
@@ -1073,7 +1088,8 @@ namespace game
 		AuthorityManager authorityManager;
 		InteractionManager interactionManager;
 
-		view::Packet viewPacket;
+		view::Packet viewPacket[2];
+		int viewPacketIndex;
 
 		DatabaseObject * objects;
 	};
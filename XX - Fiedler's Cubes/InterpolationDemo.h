@@ -11,8 +11,8 @@ class InterpolationDemo : public Demo
 private:
 
 	game::Instance<cubes::DatabaseObject, cubes::ActiveObject> * gameInstance;
-	GameWorkerThread workerThread;
-	view::Packet viewPacket;
+	GameWorkers workers;
+	const view::Packet * viewPacket;
 	view::ObjectManager viewObjectManager[2];
 	render::Render * render;
 	Camera camera[2];
@@ -47,6 +47,7 @@ public:
 		config.simConfig.AngularDrag = 0.01f;
 		config.simConfig.Friction = 200.0f;
 		gameInstance = new game::Instance<cubes::DatabaseObject, cubes::ActiveObject> ( config );
+		viewPacket = &gameInstance->GetViewPacket();
 		origin[0] = math::Vector(0,0,0);
 		origin[1] = math::Vector(0,0,0);
 		render = new render::Render( displayWidth, displayHeight );
@@ -178,8 +179,8 @@ public:
 	void Update( float deltaTime )
 	{
 		// grab the view packet & start the worker thread...
-		gameInstance->GetViewPacket( viewPacket );
-		workerThread.Start( gameInstance );
+		viewPacket = &gameInstance->GetViewPacket();
+		workers.Start( gameInstance );
 		t += deltaTime;
 	}
 
@@ -187,11 +188,11 @@ public:
 	{
 		// update the scene to be rendered (left)
 
-		if ( viewPacket.objectCount >= 1 )
+		if ( viewPacket->objectCount >= 1 )
 		{
 			view::ObjectUpdate updates[MaxViewObjects];
-			getViewObjectUpdates( updates, viewPacket );
-			viewObjectManager[0].UpdateObjects( updates, viewPacket.objectCount );
+			getViewObjectUpdates( updates, *viewPacket );
+			viewObjectManager[0].UpdateObjects( updates, viewPacket->objectCount );
 		}
 		viewObjectManager[0].ExtrapolateObjects( deltaTime );
 		viewObjectManager[0].Update( deltaTime );
@@ -201,8 +202,8 @@ public:
 		if ( ++accumulator >= sendRate )
 		{
 			view::ObjectUpdate updates[MaxViewObjects];
-			getViewObjectUpdates( updates, viewPacket );
-			for ( int i = 0; i < (int) viewPacket.objectCount; ++i )
+			getViewObjectUpdates( updates, *viewPacket );
+			for ( int i = 0; i < (int) viewPacket->objectCount; ++i )
 			{
 				if ( updates[i].authority == 0 )
 				{
@@ -210,7 +211,7 @@ public:
 					getAuthorityColor( updates[i].authority, updates[i].r, updates[i].g, updates[i].b );
 				}
 			}	
-			viewObjectManager[1].UpdateObjects( updates, viewPacket.objectCount );
+			viewObjectManager[1].UpdateObjects( updates, viewPacket->objectCount );
 			accumulator = 0;
 			interpolation_t = 0.0f;
 		}
@@ -223,9 +224,9 @@ public:
 
 		// update cameras
 
-		view::Object * playerCube = viewObjectManager[0].GetObject( 1 );
-		if ( playerCube )
-			origin[0] = playerCube->position + playerCube->positionError;
+		view::Object playerCube;
+		if ( viewObjectManager[0].GetObject( 1, playerCube ) )
+			origin[0] = playerCube.position + playerCube.positionError;
 
 		math::Vector lookat = origin[0];
 		math::Vector position = lookat + math::Vector(0,-10,5);
@@ -240,9 +241,9 @@ public:
 
 		if ( !strobe )
 		{
-			view::Object * playerCube = viewObjectManager[1].GetObject( 1 );
-			if ( playerCube )
-				origin[1] = playerCube->interpolatedPosition;
+			view::Object playerCube;
+			if ( viewObjectManager[1].GetObject( 1, playerCube ) )
+				origin[1] = playerCube.interpolatedPosition;
 
 			math::Vector lookat = origin[1];
 			math::Vector position = lookat + math::Vector(0,-10,5);
@@ -302,6 +303,6 @@ public:
 	void PostRender()
 	{
 		// join worker threads
-		workerThread.Join();
+		workers.Join();
 	}
 };
@@ -13,6 +13,18 @@
 #include <float.h>
 #include <stdlib.h>
 
+// simd instruction set for batch operations, picked from the compiler flags
+
+#ifndef SCALAR_MATH
+	#if defined( __AVX__ )
+		#define MATH_AVX
+		#include <immintrin.h>
+	#elif defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+		#define MATH_SSE2
+		#include <emmintrin.h>
+	#endif
+#endif
+
 namespace math
 {
 	const float epsilon = 0.00001f;                         ///< floating point epsilon for single precision.
@@ -1979,6 +1991,361 @@ namespace math
 	   	output = h1*_p0 + h2*_p1 + h3*_t0 + h4*_t1;
 		output.normalize();
 	}
+
+	/*
+		Batch operations.
+		Normalize, slerp and transform whole arrays at once. With SSE2 or AVX
+		enabled at compile time the work is done Width elements at a time,
+		otherwise (or with SCALAR_MATH defined) each batch op is just a loop
+		over the scalar version. Leftover elements past the last full block
+		always go through the scalar version.
+		Slerp also takes component arrays, one float array per quaternion
+		component, which is how view::ObjectArrays stores orientations.
+		Arrays do not need to be aligned. Output may alias input.
+	*/
+
+	#if defined( MATH_SSE2 ) || defined( MATH_AVX )
+
+	namespace simd
+	{
+		#ifdef MATH_AVX
+
+		typedef __m256 vfloat;
+
+		const int Width = 8;
+
+		inline vfloat load( const float * p )							{ return _mm256_loadu_ps( p ); }
+		inline void store( float * p, vfloat a )						{ _mm256_storeu_ps( p, a ); }
+		inline vfloat set( float s )									{ return _mm256_set1_ps( s ); }
+		inline vfloat add( vfloat a, vfloat b )							{ return _mm256_add_ps( a, b ); }
+		inline vfloat sub( vfloat a, vfloat b )							{ return _mm256_sub_ps( a, b ); }
+		inline vfloat mul( vfloat a, vfloat b )							{ return _mm256_mul_ps( a, b ); }
+		inline vfloat div( vfloat a, vfloat b )							{ return _mm256_div_ps( a, b ); }
+		inline vfloat sqrt( vfloat a )									{ return _mm256_sqrt_ps( a ); }
+		inline vfloat less( vfloat a, vfloat b )						{ return _mm256_cmp_ps( a, b, _CMP_LT_OQ ); }
+		inline vfloat greater( vfloat a, vfloat b )						{ return _mm256_cmp_ps( a, b, _CMP_GT_OQ ); }
+		inline vfloat select( vfloat mask, vfloat a, vfloat b )			{ return _mm256_blendv_ps( b, a, mask ); }
+		inline bool all( vfloat mask )									{ return _mm256_movemask_ps( mask ) == 0xFF; }
+		inline vfloat unpacklo( vfloat a, vfloat b )					{ return _mm256_unpacklo_ps( a, b ); }
+		inline vfloat unpackhi( vfloat a, vfloat b )					{ return _mm256_unpackhi_ps( a, b ); }
+		inline vfloat lowhalves( vfloat a, vfloat b )					{ return _mm256_shuffle_ps( a, b, _MM_SHUFFLE(1,0,1,0) ); }
+		inline vfloat highhalves( vfloat a, vfloat b )					{ return _mm256_shuffle_ps( a, b, _MM_SHUFFLE(3,2,3,2) ); }
+
+		#else
+
+		typedef __m128 vfloat;
+
+		const int Width = 4;
+
+		inline vfloat load( const float * p )							{ return _mm_loadu_ps( p ); }
+		inline void store( float * p, vfloat a )						{ _mm_storeu_ps( p, a ); }
+		inline vfloat set( float s )									{ return _mm_set1_ps( s ); }
+		inline vfloat add( vfloat a, vfloat b )							{ return _mm_add_ps( a, b ); }
+		inline vfloat sub( vfloat a, vfloat b )							{ return _mm_sub_ps( a, b ); }
+		inline vfloat mul( vfloat a, vfloat b )							{ return _mm_mul_ps( a, b ); }
+		inline vfloat div( vfloat a, vfloat b )							{ return _mm_div_ps( a, b ); }
+		inline vfloat sqrt( vfloat a )									{ return _mm_sqrt_ps( a ); }
+		inline vfloat less( vfloat a, vfloat b )						{ return _mm_cmplt_ps( a, b ); }
+		inline vfloat greater( vfloat a, vfloat b )						{ return _mm_cmpgt_ps( a, b ); }
+		inline vfloat select( vfloat mask, vfloat a, vfloat b )			{ return _mm_or_ps( _mm_and_ps( mask, a ), _mm_andnot_ps( mask, b ) ); }
+		inline bool all( vfloat mask )									{ return _mm_movemask_ps( mask ) == 0xF; }
+		inline vfloat unpacklo( vfloat a, vfloat b )					{ return _mm_unpacklo_ps( a, b ); }
+		inline vfloat unpackhi( vfloat a, vfloat b )					{ return _mm_unpackhi_ps( a, b ); }
+		inline vfloat lowhalves( vfloat a, vfloat b )					{ return _mm_movelh_ps( a, b ); }
+		inline vfloat highhalves( vfloat a, vfloat b )					{ return _mm_movehl_ps( b, a ); }
+
+		#endif
+
+		// transpose each 4x4 block of floats, one block per 128 bit lane.
+		// four rows of quaternions in, w,x,y,z columns out. it is its own inverse.
+		// note: with AVX the lanes come out as quaternions 0,2,4,6,1,3,5,7 but the
+		// inverse puts them back where they came from, so per lane math doesn't care
+
+		inline void transpose( vfloat & r0, vfloat & r1, vfloat & r2, vfloat & r3 )
+		{
+			const vfloat t0 = unpacklo( r0, r1 );
+			const vfloat t1 = unpackhi( r0, r1 );
+			const vfloat t2 = unpacklo( r2, r3 );
+			const vfloat t3 = unpackhi( r2, r3 );
+			r0 = lowhalves( t0, t2 );
+			r1 = highhalves( t0, t2 );
+			r2 = lowhalves( t1, t3 );
+			r3 = highhalves( t1, t3 );
+		}
+
+		// the array of Quaternion and Vector entry points read and write them as packed floats
+
+		typedef char QuaternionIsFourFloats[ sizeof( Quaternion ) == 4 * sizeof( float ) ? 1 : -1 ];
+		typedef char VectorIsThreeFloats[ sizeof( Vector ) == 3 * sizeof( float ) ? 1 : -1 ];
+
+		inline void load( const Quaternion * q, vfloat & w, vfloat & x, vfloat & y, vfloat & z )
+		{
+			const int step = Width / 4;
+			w = load( &q[0].w );
+			x = load( &q[step].w );
+			y = load( &q[step*2].w );
+			z = load( &q[step*3].w );
+			transpose( w, x, y, z );
+		}
+
+		inline void store( Quaternion * q, vfloat w, vfloat x, vfloat y, vfloat z )
+		{
+			const int step = Width / 4;
+			transpose( w, x, y, z );
+			store( &q[0].w, w );
+			store( &q[step].w, x );
+			store( &q[step*2].w, y );
+			store( &q[step*3].w, z );
+		}
+
+		inline vfloat dot( vfloat aw, vfloat ax, vfloat ay, vfloat az, vfloat bw, vfloat bx, vfloat by, vfloat bz )
+		{
+			return add( add( add( mul( aw, bw ), mul( ax, bx ) ), mul( ay, by ) ), mul( az, bz ) );
+		}
+
+		// acos on [0,1], abramowitz and stegun 4.4.46 (error < 2e-8)
+
+		inline vfloat acos( vfloat x )
+		{
+			vfloat p = set( -0.0012624911f );
+			p = add( mul( p, x ), set( 0.0066700901f ) );
+			p = add( mul( p, x ), set( -0.0170881256f ) );
+			p = add( mul( p, x ), set( 0.0308918810f ) );
+			p = add( mul( p, x ), set( -0.0501743046f ) );
+			p = add( mul( p, x ), set( 0.0889789874f ) );
+			p = add( mul( p, x ), set( -0.2145988016f ) );
+			p = add( mul( p, x ), set( 1.5707963050f ) );
+			return mul( p, sqrt( sub( set( 1.0f ), x ) ) );
+		}
+
+		// sin on [0,pi/2], taylor series to x^11 (error < 6e-8)
+
+		inline vfloat sin( vfloat x )
+		{
+			const vfloat x2 = mul( x, x );
+			vfloat p = set( -1.0f / 39916800.0f );
+			p = add( mul( p, x2 ), set( 1.0f / 362880.0f ) );
+			p = add( mul( p, x2 ), set( -1.0f / 5040.0f ) );
+			p = add( mul( p, x2 ), set( 1.0f / 120.0f ) );
+			p = add( mul( p, x2 ), set( -1.0f / 6.0f ) );
+			p = add( mul( p, x2 ), set( 1.0f ) );
+			return mul( p, x );
+		}
+
+		// slerp Width quaternions a toward b, one register per component
+
+		inline void slerp( vfloat aw, vfloat ax, vfloat ay, vfloat az, 
+		                   vfloat bw, vfloat bx, vfloat by, vfloat bz, float t,
+		                   vfloat & w, vfloat & x, vfloat & y, vfloat & z )
+		{
+			const vfloat zero = set( 0.0f );
+			const vfloat one = set( 1.0f );
+			const vfloat vt = set( t );
+			const vfloat vs = set( 1.0f - t );
+
+			// take the short way around
+
+			vfloat cosine = dot( aw, ax, ay, az, bw, bx, by, bz );
+			const vfloat flip = select( less( cosine, zero ), set( -1.0f ), one );
+			cosine = mul( cosine, flip );
+
+			// nearly parallel falls back to linear, same as the scalar slerp. 
+			// note: acos/sin of those lanes may be garbage, the select throws it away.
+			// when every lane is nearly parallel, as for a visual orientation that has caught up, skip them entirely
+
+			const vfloat linear = less( sub( one, cosine ), set( epsilon ) );
+			vfloat beta = vs;
+			vfloat alpha = mul( vt, flip );
+			if ( !all( linear ) )
+			{
+				const vfloat theta = acos( cosine );
+				const vfloat inverseSine = div( one, sin( theta ) );
+				beta = select( linear, vs, mul( sin( mul( vs, theta ) ), inverseSine ) );
+				alpha = mul( select( linear, vt, mul( sin( mul( vt, theta ) ), inverseSine ) ), flip );
+			}
+
+			w = add( mul( aw, beta ), mul( bw, alpha ) );
+			x = add( mul( ax, beta ), mul( bx, alpha ) );
+			y = add( mul( ay, beta ), mul( by, alpha ) );
+			z = add( mul( az, beta ), mul( bz, alpha ) );
+		}
+
+		// transform four vectors: deinterleave x,y,z, multiply, interleave back
+
+		inline void transform4( const Matrix & m, const Vector * input, Vector * output, float translate )
+		{
+			const float * in = &input[0].x;
+			const __m128 a = _mm_loadu_ps( in );				// x0 y0 z0 x1
+			const __m128 b = _mm_loadu_ps( in + 4 );			// y1 z1 x2 y2
+			const __m128 c = _mm_loadu_ps( in + 8 );			// z2 x3 y3 z3
+
+			const __m128 x = _mm_shuffle_ps( a, _mm_shuffle_ps( b, c, _MM_SHUFFLE(1,1,2,2) ), _MM_SHUFFLE(2,0,3,0) );
+			const __m128 y = _mm_shuffle_ps( _mm_shuffle_ps( a, b, _MM_SHUFFLE(0,0,1,1) ), _mm_shuffle_ps( b, c, _MM_SHUFFLE(2,2,3,3) ), _MM_SHUFFLE(2,0,2,0) );
+			const __m128 z = _mm_shuffle_ps( _mm_shuffle_ps( a, b, _MM_SHUFFLE(1,1,2,2) ), c, _MM_SHUFFLE(3,0,2,0) );
+
+			#define MATH_TRANSFORM_ROW( r1, r2, r3, r4 )																\
+				_mm_add_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( x, _mm_set1_ps( r1 ) ), _mm_mul_ps( y, _mm_set1_ps( r2 ) ) ),		\
+				                        _mm_mul_ps( z, _mm_set1_ps( r3 ) ) ), _mm_set1_ps( r4 * translate ) )
+
+			const __m128 rx = MATH_TRANSFORM_ROW( m.m11, m.m12, m.m13, m.m14 );
+			const __m128 ry = MATH_TRANSFORM_ROW( m.m21, m.m22, m.m23, m.m24 );
+			const __m128 rz = MATH_TRANSFORM_ROW( m.m31, m.m32, m.m33, m.m34 );
+
+			#undef MATH_TRANSFORM_ROW
+
+			float * out = &output[0].x;
+			_mm_storeu_ps( out, _mm_shuffle_ps( _mm_shuffle_ps( rx, ry, _MM_SHUFFLE(0,0,0,0) ), _mm_shuffle_ps( rz, rx, _MM_SHUFFLE(1,1,0,0) ), _MM_SHUFFLE(2,0,2,0) ) );
+			_mm_storeu_ps( out + 4, _mm_shuffle_ps( _mm_shuffle_ps( ry, rz, _MM_SHUFFLE(1,1,1,1) ), _mm_shuffle_ps( rx, ry, _MM_SHUFFLE(2,2,2,2) ), _MM_SHUFFLE(2,0,2,0) ) );
+			_mm_storeu_ps( out + 8, _mm_shuffle_ps( _mm_shuffle_ps( rz, rx, _MM_SHUFFLE(3,3,2,2) ), _mm_shuffle_ps( ry, rz, _MM_SHUFFLE(3,3,3,3) ), _MM_SHUFFLE(2,0,2,0) ) );
+		}
+	}
+
+	#endif
+
+	/// normalize an array of quaternions. zero length quaternions become identity.
+
+	inline void normalize( Quaternion * quaternions, int count )
+	{
+		assert( count >= 0 );
+		int i = 0;
+		#if defined( MATH_SSE2 ) || defined( MATH_AVX )
+		using namespace simd;
+		const vfloat zero = set( 0.0f );
+		const vfloat one = set( 1.0f );
+		for ( ; i + Width <= count; i += Width )
+		{
+			vfloat w, x, y, z;
+			load( quaternions + i, w, x, y, z );
+			const vfloat squaredLength = dot( w, x, y, z, w, x, y, z );
+			const vfloat valid = greater( squaredLength, zero );
+			const vfloat inv = div( one, sqrt( squaredLength ) );
+			w = select( valid, mul( w, inv ), one );
+			x = select( valid, mul( x, inv ), zero );
+			y = select( valid, mul( y, inv ), zero );
+			z = select( valid, mul( z, inv ), zero );
+			store( quaternions + i, w, x, y, z );
+		}
+		#endif
+		for ( ; i < count; ++i )
+			quaternions[i].normalize();
+	}
+
+	/// slerp each pair a[i], b[i] by the same t, write results to output.
+	/// vector paths approximate acos and sin, results are within 1e-5 of the scalar slerp.
+
+	inline void slerp( const Quaternion * a, const Quaternion * b, Quaternion * output, int count, float t )
+	{
+		assert( count >= 0 );
+		assert( t >= 0 );
+		assert( t <= 1 );
+		int i = 0;
+		#if defined( MATH_SSE2 ) || defined( MATH_AVX )
+		using namespace simd;
+		for ( ; i + Width <= count; i += Width )
+		{
+			vfloat aw, ax, ay, az;
+			vfloat bw, bx, by, bz;
+			load( a + i, aw, ax, ay, az );
+			load( b + i, bw, bx, by, bz );
+			vfloat w, x, y, z;
+			simd::slerp( aw, ax, ay, az, bw, bx, by, bz, t, w, x, y, z );
+			store( output + i, w, x, y, z );
+		}
+		#endif
+		for ( ; i < count; ++i )
+			output[i] = slerp( a[i], b[i], t );
+	}
+
+	/// slerp component arrays: a and b are w,x,y,z float arrays, each count long, same for the output.
+	/// same results as the array of quaternions version, but with no transpose in and out.
+
+	inline void slerp( const float * aw, const float * ax, const float * ay, const float * az,
+	                   const float * bw, const float * bx, const float * by, const float * bz,
+	                   float * ow, float * ox, float * oy, float * oz, int count, float t )
+	{
+		assert( count >= 0 );
+		assert( t >= 0 );
+		assert( t <= 1 );
+		int i = 0;
+		#if defined( MATH_SSE2 ) || defined( MATH_AVX )
+		using namespace simd;
+		for ( ; i + Width <= count; i += Width )
+		{
+			vfloat w, x, y, z;
+			simd::slerp( load( aw + i ), load( ax + i ), load( ay + i ), load( az + i ), 
+			             load( bw + i ), load( bx + i ), load( by + i ), load( bz + i ), t, w, x, y, z );
+			store( ow + i, w );
+			store( ox + i, x );
+			store( oy + i, y );
+			store( oz + i, z );
+		}
+		#endif
+		for ( ; i < count; ++i )
+		{
+			const Quaternion q = slerp( Quaternion( aw[i], ax[i], ay[i], az[i] ), Quaternion( bw[i], bx[i], by[i], bz[i] ), t );
+			ow[i] = q.w;
+			ox[i] = q.x;
+			oy[i] = q.y;
+			oz[i] = q.z;
+		}
+	}
+
+	/// transform an array of points by a matrix, same as Matrix::transform.
+
+	inline void transform( const Matrix & matrix, const Vector * input, Vector * output, int count )
+	{
+		assert( count >= 0 );
+		int i = 0;
+		#if defined( MATH_SSE2 ) || defined( MATH_AVX )
+		for ( ; i + 4 <= count; i += 4 )
+			simd::transform4( matrix, input + i, output + i, 1.0f );
+		#endif
+		for ( ; i < count; ++i )
+			matrix.transform( input[i], output[i] );
+	}
+
+	/// transform an array of vectors by the 3x3 rotation part of a matrix, same as Matrix::transform3x3.
+
+	inline void transform3x3( const Matrix & matrix, const Vector * input, Vector * output, int count )
+	{
+		assert( count >= 0 );
+		int i = 0;
+		#if defined( MATH_SSE2 ) || defined( MATH_AVX )
+		for ( ; i + 4 <= count; i += 4 )
+			simd::transform4( matrix, input + i, output + i, 0.0f );
+		#endif
+		for ( ; i < count; ++i )
+			matrix.transform3x3( input[i], output[i] );
+	}
+
+	/// multiply two matrices, same as a * b.
+
+	inline void multiply( const Matrix & a, const Matrix & b, Matrix & output )
+	{
+		#if defined( MATH_SSE2 ) || defined( MATH_AVX )
+		const float * rows = &b.m11;
+		const __m128 b1 = _mm_loadu_ps( rows );
+		const __m128 b2 = _mm_loadu_ps( rows + 4 );
+		const __m128 b3 = _mm_loadu_ps( rows + 8 );
+		const __m128 b4 = _mm_loadu_ps( rows + 12 );
+		const float * in = &a.m11;
+		float * out = &output.m11;
+		__m128 result[4];
+		for ( int i = 0; i < 4; ++i )
+		{
+			const float * row = in + i * 4;
+			result[i] = _mm_add_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( _mm_set1_ps( row[0] ), b1 ), 
+			                                                _mm_mul_ps( _mm_set1_ps( row[1] ), b2 ) ),
+			                                    _mm_mul_ps( _mm_set1_ps( row[2] ), b3 ) ),
+			                        _mm_mul_ps( _mm_set1_ps( row[3] ), b4 ) );
+		}
+		// note: stores go last so output may be a or b
+		for ( int i = 0; i < 4; ++i )
+			_mm_storeu_ps( out + i * 4, result[i] );
+		#else
+		output = a * b;
+		#endif
+	}
 	
 	/// Plane class.
 	/// Represents a plane using a normal and a plane constant.
@@ -56,6 +56,14 @@
 #include <algorithm>
 #include <functional>
 
+// batched socket io via recvmmsg/sendmmsg (linux only)
+
+#if NET_PLATFORM == NET_PLATFORM_UNIX && defined(__linux__) && defined(MSG_WAITFORONE) && !defined(NET_NO_MMSG)
+#define NET_MMSG 1
+#else
+#define NET_MMSG 0
+#endif
+
 namespace net
 {
 	// internet address
@@ -158,6 +166,17 @@ namespace net
 		#endif
 	}
 
+	// one datagram in a batched send or receive
+	//  + on send: address is the destination, size is the number of bytes in data
+	//  + on receive: data must point to at least "maxSize" bytes, address and size are filled in
+
+	struct SocketPacket
+	{
+		Address address;
+		unsigned char * data;
+		int size;
+	};
+
 	class Socket
 	{
 	public:
@@ -167,6 +186,8 @@ namespace net
 			NonBlocking = 1,
 			Broadcast = 2
 		};
+
+		enum { MaxBatchSize = 64 };
 	
 		Socket( int options = NonBlocking )
 		{
@@ -325,6 +346,138 @@ namespace net
 
 			return received_bytes;
 		}
+
+		// send a batch of packets, returns the number of packets sent
+		//  + with recvmmsg/sendmmsg this is one syscall per "MaxBatchSize" packets, otherwise one per packet
+
+		int SendBatch( const SocketPacket packets[], int count )
+		{
+			assert( packets );
+			assert( count >= 0 );
+
+			if ( !IsOpen() )
+				return 0;
+
+			#if NET_MMSG
+
+				int sent = 0;
+				while ( sent < count )
+				{
+					const int batchSize = std::min( count - sent, (int) MaxBatchSize );
+					mmsghdr messages[MaxBatchSize];
+					iovec buffers[MaxBatchSize];
+					sockaddr_in addresses[MaxBatchSize];
+					for ( int i = 0; i < batchSize; ++i )
+					{
+						const SocketPacket & packet = packets[sent+i];
+						assert( packet.data );
+						assert( packet.size > 0 );
+						assert( packet.address.GetAddress() != 0 );
+						assert( packet.address.GetPort() != 0 );
+						addresses[i].sin_family = AF_INET;
+						addresses[i].sin_addr.s_addr = htonl( packet.address.GetAddress() );
+						addresses[i].sin_port = htons( packet.address.GetPort() );
+						buffers[i].iov_base = packet.data;
+						buffers[i].iov_len = packet.size;
+						memset( &messages[i], 0, sizeof( mmsghdr ) );
+						messages[i].msg_hdr.msg_name = &addresses[i];
+						messages[i].msg_hdr.msg_namelen = sizeof( sockaddr_in );
+						messages[i].msg_hdr.msg_iov = &buffers[i];
+						messages[i].msg_hdr.msg_iovlen = 1;
+					}
+					int result = sendmmsg( socket, messages, batchSize, 0 );
+					if ( result <= 0 )
+						break;
+					sent += result;
+					if ( result < batchSize )
+						break;
+				}
+				return sent;
+
+			#else
+
+				int sent = 0;
+				for ( int i = 0; i < count; ++i )
+				{
+					if ( Send( packets[i].address, packets[i].data, packets[i].size ) )
+						sent++;
+				}
+				return sent;
+
+			#endif
+		}
+
+		// receive up to "count" packets, each into a buffer of "maxSize" bytes
+		//  + returns the number of packets received, zero if there are none waiting
+		//  + if fewer than "count" packets are returned the socket has been drained
+
+		int ReceiveBatch( SocketPacket packets[], int count, int maxSize )
+		{
+			assert( packets );
+			assert( count >= 0 );
+			assert( maxSize > 0 );
+
+			if ( !IsOpen() )
+				return 0;
+
+			#if NET_MMSG
+
+				int received = 0;
+				while ( received < count )
+				{
+					const int batchSize = std::min( count - received, (int) MaxBatchSize );
+					mmsghdr messages[MaxBatchSize];
+					iovec buffers[MaxBatchSize];
+					sockaddr_in addresses[MaxBatchSize];
+					for ( int i = 0; i < batchSize; ++i )
+					{
+						assert( packets[received+i].data );
+						buffers[i].iov_base = packets[received+i].data;
+						buffers[i].iov_len = maxSize;
+						memset( &messages[i], 0, sizeof( mmsghdr ) );
+						messages[i].msg_hdr.msg_name = &addresses[i];
+						messages[i].msg_hdr.msg_namelen = sizeof( sockaddr_in );
+						messages[i].msg_hdr.msg_iov = &buffers[i];
+						messages[i].msg_hdr.msg_iovlen = 1;
+					}
+					const int flags = received > 0 ? MSG_DONTWAIT : MSG_WAITFORONE;
+					int result = recvmmsg( socket, messages, batchSize, flags, NULL );
+					if ( result <= 0 )
+						break;
+					int valid = 0;
+					for ( int i = 0; i < result; ++i )
+					{
+						if ( messages[i].msg_len == 0 )
+							continue;
+						SocketPacket & packet = packets[received+valid];
+						if ( valid != i )
+							memmove( packet.data, buffers[i].iov_base, messages[i].msg_len );
+						packet.address = Address( ntohl( addresses[i].sin_addr.s_addr ), ntohs( addresses[i].sin_port ) );
+						packet.size = (int) messages[i].msg_len;
+						valid++;
+					}
+					received += valid;
+					if ( result < batchSize )
+						break;
+				}
+				return received;
+
+			#else
+
+				int received = 0;
+				while ( received < count )
+				{
+					SocketPacket & packet = packets[received];
+					int size = Receive( packet.address, packet.data, maxSize );
+					if ( size == 0 )
+						break;
+					packet.size = size;
+					received++;
+				}
+				return received;
+
+			#endif
+		}
 		
 	private:
 	
@@ -455,8 +608,78 @@ namespace net
 		}
 	};
 
+	// round trip time estimates, updated with each rtt sample
+	//  + smoothed rtt and rtt variance as in RFC 6298
+	//  + jitter as in RFC 3550: smoothed difference between consecutive samples
+	//  + min rtt over a sliding window of two periods, so it recovers if the path gets longer
+
+	struct RoundTripStats
+	{
+		RoundTripStats()
+		{
+			Reset();
+		}
+
+		void Reset()
+		{
+			samples = 0;
+			srtt = 0.0f;
+			rttvar = 0.0f;
+			jitter = 0.0f;
+			last_rtt = 0.0f;
+			min_rtt = 0.0f;
+			previous_min_rtt = 0.0f;
+			min_rtt_time = 0.0;
+		}
+
+		void AddSample( float rtt, double time )
+		{
+			const float MinRttPeriod = 10.0f;
+
+			if ( samples == 0 )
+			{
+				srtt = rtt;
+				rttvar = rtt * 0.5f;
+				min_rtt = rtt;
+				previous_min_rtt = rtt;
+				min_rtt_time = time;
+			}
+			else
+			{
+				rttvar += ( fabs( srtt - rtt ) - rttvar ) * 0.25f;
+				srtt += ( rtt - srtt ) * 0.125f;
+				jitter += ( fabs( rtt - last_rtt ) - jitter ) * 0.0625f;
+				if ( time - min_rtt_time > MinRttPeriod )
+				{
+					previous_min_rtt = min_rtt;
+					min_rtt = rtt;
+					min_rtt_time = time;
+				}
+				else if ( rtt < min_rtt )
+					min_rtt = rtt;
+			}
+			last_rtt = rtt;
+			samples++;
+		}
+
+		float GetMinRtt() const
+		{
+			return std::min( min_rtt, previous_min_rtt );
+		}
+
+		unsigned int samples;			// number of rtt samples taken
+		float srtt;						// smoothed rtt
+		float rttvar;					// smoothed mean deviation of rtt samples from srtt
+		float jitter;					// smoothed difference between consecutive rtt samples
+		float last_rtt;					// most recent rtt sample
+		float min_rtt;					// lowest rtt sample in the current period
+		float previous_min_rtt;			// lowest rtt sample in the previous period
+		double min_rtt_time;			// time the current min rtt period started
+	};
+
 	// reliability system to support reliable connection
 	//  + manages sent, received, pending ack and acked packet queues
+	//  + each ack is an rtt sample for the round trip stats (the age of the acked packet)
 	//  + separated out from reliable connection because it is quite complex and i want to unit test it!
 	
 	class ReliabilitySystem
@@ -484,8 +707,9 @@ namespace net
 			acked_packets = 0;
 			sent_bandwidth = 0.0f;
 			acked_bandwidth = 0.0f;
-			rtt = 0.0f;
+			rtt_stats.Reset();
 			rtt_maximum = 1.0f;
+			time = 0.0;
 		}
 		
 		void PacketSent( int size )
@@ -531,12 +755,13 @@ namespace net
 		
 		void ProcessAck( unsigned int ack, unsigned int ack_bits )
 		{
-			process_ack( ack, ack_bits, pendingAckQueue, ackedQueue, acks, acked_packets, rtt, max_sequence );
+			process_ack( ack, ack_bits, pendingAckQueue, ackedQueue, acks, acked_packets, rtt_stats, time, max_sequence );
 		}
 				
 		void Update( float deltaTime )
 		{
 			acks.clear();
+			time += deltaTime;
 			AdvanceQueueTime( deltaTime );
 			UpdateQueues();
 			UpdateStats();
@@ -595,7 +820,7 @@ namespace net
 		static void process_ack( unsigned int ack, unsigned int ack_bits, 
 								 PacketQueue & pending_ack_queue, PacketQueue & acked_queue, 
 								 std::vector<unsigned int> & acks, unsigned int & acked_packets, 
-								 float & rtt, unsigned int max_sequence )
+								 RoundTripStats & rtt, double time, unsigned int max_sequence )
 		{
 			if ( pending_ack_queue.empty() )
 				return;
@@ -618,7 +843,7 @@ namespace net
 				
 				if ( acked )
 				{
-					rtt += ( itor->time - rtt ) * 0.1f;
+					rtt.AddSample( itor->time, time );
 
 					acked_queue.insert_sorted( *itor, max_sequence );
 					acks.push_back( itor->sequence );
@@ -649,7 +874,7 @@ namespace net
 				
  		void GetAcks( unsigned int ** acks, int & count )
 		{
-			*acks = &this->acks[0];
+			*acks = this->acks.empty() ? NULL : &this->acks[0];
 			count = (int) this->acks.size();
 		}
 		
@@ -685,7 +910,22 @@ namespace net
 
 		float GetRoundTripTime() const
 		{
-			return rtt;
+			return rtt_stats.srtt;
+		}
+
+		float GetRoundTripTimeVariance() const
+		{
+			return rtt_stats.rttvar;
+		}
+
+		float GetJitter() const
+		{
+			return rtt_stats.jitter;
+		}
+
+		float GetMinRoundTripTime() const
+		{
+			return rtt_stats.GetMinRtt();
 		}
 		
 		int GetHeaderSize() const
@@ -769,8 +1009,9 @@ namespace net
 
 		float sent_bandwidth;				// approximate sent bandwidth over the last second
 		float acked_bandwidth;				// approximate acked bandwidth over the last second
-		float rtt;							// estimated round trip time
+		RoundTripStats rtt_stats;			// smoothed rtt, rtt variance, jitter and min rtt
 		float rtt_maximum;					// maximum expected round trip time (hard coded to one second for the moment)
+		double time;						// reliability system clock, advanced each update
 
 		std::vector<unsigned int> acks;		// acked packets from last set of packet receives. cleared each update!
 
@@ -800,6 +1041,9 @@ namespace net
 			this->timeout = timeout;
 			mode = None;
 			running = false;
+			batchPacketSize = 0;
+			batchIndex = 0;
+			batchCount = 0;
 			ClearData();
 		}
 		
@@ -816,6 +1060,8 @@ namespace net
 			if ( !socket.Open( port ) )
 				return false;
 			running = true;
+			batchIndex = 0;
+			batchCount = 0;
 			OnStart();
 			return true;
 		}
@@ -827,6 +1073,8 @@ namespace net
 			bool connected = IsConnected();
 			ClearData();
 			socket.Close();
+			batchIndex = 0;
+			batchCount = 0;
 			running = false;
 			if ( connected )
 				OnDisconnect();
@@ -929,12 +1177,25 @@ namespace net
 		virtual int ReceivePacket( unsigned char data[], int size )
 		{
 			assert( running );
-//			unsigned char packet[size+4];
-			unsigned char* packet = reinterpret_cast<unsigned char*>(alloca(size+4));
-			Address sender;
-			int bytes_read = socket.Receive( sender, packet, size + 4 );
-			if ( bytes_read == 0 )
+			// drain the socket a batch at a time, then hand out packets from the batch
+			if ( batchIndex == batchCount )
+			{
+				if ( size + 4 > batchPacketSize )
+				{
+					batchPacketSize = size + 4;
+					batchBuffer.resize( ReceiveBatchSize * batchPacketSize );
+					for ( int i = 0; i < ReceiveBatchSize; ++i )
+						batch[i].data = &batchBuffer[i*batchPacketSize];
+				}
+				batchIndex = 0;
+				batchCount = socket.ReceiveBatch( batch, ReceiveBatchSize, batchPacketSize );
+			}
+			if ( batchIndex == batchCount )
 				return 0;
+			const SocketPacket & received = batch[batchIndex++];
+			const Address & sender = received.address;
+			const unsigned char * packet = received.data;
+			int bytes_read = std::min( received.size, size + 4 );
 			if ( bytes_read <= 4 )
 				return 0;
 			unsigned int packetProtocolId;
@@ -1006,6 +1267,13 @@ namespace net
 		Socket socket;
 		float timeoutAccumulator;
 		Address address;
+
+		enum { ReceiveBatchSize = 32 };
+		std::vector<unsigned char> batchBuffer;
+		SocketPacket batch[ReceiveBatchSize];
+		int batchPacketSize;
+		int batchIndex;
+		int batchCount;
 	};
 	
 	// connection with reliability (seq/ack)
@@ -1166,6 +1434,8 @@ namespace net
 			}
 		};
 		
+		enum { ReceiveBatchSize = 32 };
+
 		unsigned int protocolId;
 		float sendRate;
 		float timeout;
@@ -1267,14 +1537,18 @@ namespace net
 		
 		void ReceivePackets()
 		{
+			const int MaxPacketSize = 256;
+			unsigned char buffer[ReceiveBatchSize][MaxPacketSize];
+			SocketPacket packets[ReceiveBatchSize];
+			for ( int i = 0; i < ReceiveBatchSize; ++i )
+				packets[i].data = buffer[i];
 			while ( true )
 			{
-				Address sender;
-				unsigned char data[256];
-				int size = socket.Receive( sender, data, sizeof(data) );
-				if ( !size )
+				int count = socket.ReceiveBatch( packets, ReceiveBatchSize, MaxPacketSize );
+				for ( int i = 0; i < count; ++i )
+					ProcessPacket( packets[i].address, packets[i].data, packets[i].size );
+				if ( count < ReceiveBatchSize )
 					break;
-				ProcessPacket( sender, data, size );
 			}
 		}
 
@@ -1447,6 +1721,10 @@ namespace net
 		typedef std::stack<BufferedPacket*> PacketBuffer;
 		PacketBuffer receivedPackets;
 
+		enum { ReceiveBatchSize = 32 };
+		std::vector<unsigned char> receiveBuffer;
+		SocketPacket receiveBatch[ReceiveBatchSize];
+
 		unsigned int protocolId;
 		float sendRate;
 		float timeout;
@@ -1479,6 +1757,9 @@ namespace net
 			this->sendRate = sendRate;
 			this->timeout = timeout;
 			this->maxPacketSize = maxPacketSize;
+			receiveBuffer.resize( ReceiveBatchSize * maxPacketSize );
+			for ( int i = 0; i < ReceiveBatchSize; ++i )
+				receiveBatch[i].data = &receiveBuffer[i*maxPacketSize];
 			state = Disconnected;
 			running = false;
 			ClearData();
@@ -1624,13 +1905,11 @@ namespace net
 		{
 			while ( true )
 			{
-				Address sender;
-//				unsigned char data[maxPacketSize];
-				unsigned char* data = reinterpret_cast<unsigned char*>(alloca(maxPacketSize));
-				int size = socket.Receive( sender, data, maxPacketSize );
-				if ( !size )
+				int count = socket.ReceiveBatch( receiveBatch, ReceiveBatchSize, maxPacketSize );
+				for ( int i = 0; i < count; ++i )
+					ProcessPacket( receiveBatch[i].address, receiveBatch[i].data, receiveBatch[i].size );
+				if ( count < ReceiveBatchSize )
 					break;
-				ProcessPacket( sender, data, size );
 			}
 		}
 
@@ -46,6 +46,17 @@
 
 namespace platform
 {
+	// worker job run by a worker pool
+
+	class WorkerJob
+	{
+	public:
+	
+		virtual ~WorkerJob() {}
+	
+		virtual void Run() = 0;			// note: override this to implement your job
+	};
+
 #if PLATFORM == PLATFORM_MAC
 	
 	// worker thread 
@@ -120,6 +131,150 @@ namespace platform
 		#endif
 	};
 
+	// persistent pool of worker threads
+	//  + threads are created once with a large stack and park on a condition variable between frames
+	//  + start hands a job to the pool and returns straight away, join is the frame barrier
+	//  + without MULTITHREADED jobs run inline when they are started
+
+	class WorkerPool
+	{
+	public:
+	
+		enum { MaxThreads = 16, MaxJobs = 64 };
+	
+		WorkerPool( int threadCount )
+		{
+			assert( threadCount >= 1 );
+			assert( threadCount <= MaxThreads );
+			this->threadCount = 0;
+			jobCount = 0;
+			nextJob = 0;
+			pendingJobs = 0;
+			quit = false;
+			#ifdef MULTITHREADED
+			pthread_mutex_init( &mutex, NULL );
+			pthread_cond_init( &startCondition, NULL );
+			pthread_cond_init( &doneCondition, NULL );
+			pthread_attr_t attr;	
+			pthread_attr_init( &attr );
+			pthread_attr_setstacksize( &attr, 32 * 1024 * 1024 );
+			for ( int i = 0; i < threadCount; ++i )
+			{
+				if ( pthread_create( &threads[i], &attr, StaticRun, (void*)this ) != 0 )
+				{
+					printf( "error: pthread_create failed\n" );
+					break;
+				}
+				this->threadCount++;
+			}
+			pthread_attr_destroy( &attr );
+			#endif
+		}
+	
+		~WorkerPool()
+		{
+			#ifdef MULTITHREADED
+			Join();
+			pthread_mutex_lock( &mutex );
+			quit = true;
+			pthread_cond_broadcast( &startCondition );
+			pthread_mutex_unlock( &mutex );
+			for ( int i = 0; i < threadCount; ++i )
+				pthread_join( threads[i], NULL );
+			pthread_cond_destroy( &doneCondition );
+			pthread_cond_destroy( &startCondition );
+			pthread_mutex_destroy( &mutex );
+			#endif
+		}
+	
+		bool Start( WorkerJob * job )
+		{
+			assert( job );
+			#ifdef MULTITHREADED
+			
+				if ( threadCount == 0 )
+				{
+					job->Run();
+					return true;
+				}
+				pthread_mutex_lock( &mutex );
+				assert( jobCount < MaxJobs );
+				jobs[jobCount++] = job;
+				pendingJobs++;
+				pthread_cond_signal( &startCondition );
+				pthread_mutex_unlock( &mutex );
+			
+			#else
+			
+				job->Run();
+			
+			#endif
+			return true;
+		}
+	
+		bool Join()
+		{
+			#ifdef MULTITHREADED
+			pthread_mutex_lock( &mutex );
+			while ( pendingJobs > 0 )
+				pthread_cond_wait( &doneCondition, &mutex );
+			jobCount = 0;
+			nextJob = 0;
+			pthread_mutex_unlock( &mutex );
+			#endif
+			return true;
+		}
+	
+		int GetThreadCount() const
+		{
+			return threadCount;
+		}
+	
+	private:
+	
+		static void* StaticRun( void * data )
+		{
+			WorkerPool * self = (WorkerPool*) data;
+			self->Run();
+			return NULL;
+		}
+	
+		void Run()
+		{
+			#ifdef MULTITHREADED
+			pthread_mutex_lock( &mutex );
+			while ( true )
+			{
+				while ( !quit && nextJob == jobCount )
+					pthread_cond_wait( &startCondition, &mutex );
+				if ( quit )
+					break;
+				WorkerJob * job = jobs[nextJob++];
+				pthread_mutex_unlock( &mutex );
+				job->Run();
+				pthread_mutex_lock( &mutex );
+				if ( --pendingJobs == 0 )
+					pthread_cond_signal( &doneCondition );
+			}
+			pthread_mutex_unlock( &mutex );
+			#endif
+		}
+	
+		int threadCount;
+		WorkerJob * jobs[MaxJobs];
+		int jobCount;					// jobs started since the last join
+		int nextJob;					// next job to be picked up by a worker
+		int pendingJobs;				// jobs started but not yet finished
+		bool quit;
+	
+		#ifdef MULTITHREADED
+		pthread_t threads[MaxThreads];
+		pthread_mutex_t mutex;
+		pthread_cond_t startCondition;
+		pthread_cond_t doneCondition;
+		#endif
+	};
+
 #endif
 	
 #if PLATFORM == PLATFORM_WINDOWS
@@ -189,6 +344,146 @@ namespace platform
 		#endif
 	};
 
+	// persistent pool of worker threads
+	//  + threads are created once and park on a condition variable between frames
+	//  + start hands a job to the pool and returns straight away, join is the frame barrier
+	//  + without MULTITHREADED jobs run inline when they are started
+
+	class WorkerPool
+	{
+	public:
+	
+		enum { MaxThreads = 16, MaxJobs = 64 };
+	
+		WorkerPool( int threadCount )
+		{
+			assert( threadCount >= 1 );
+			assert( threadCount <= MaxThreads );
+			this->threadCount = 0;
+			jobCount = 0;
+			nextJob = 0;
+			pendingJobs = 0;
+			quit = false;
+			#ifdef MULTITHREADED
+			mutex = SDL_CreateMutex();
+			startCondition = SDL_CreateCond();
+			doneCondition = SDL_CreateCond();
+			for ( int i = 0; i < threadCount; ++i )
+			{
+				if ( NULL == ( threads[i] = SDL_CreateThread( StaticRun, (void*)this ) ) )
+				{
+					printf( "error: SDL_CreateThread failed\n" );
+					break;
+				}
+				this->threadCount++;
+			}
+			#endif
+		}
+	
+		~WorkerPool()
+		{
+			#ifdef MULTITHREADED
+			Join();
+			SDL_LockMutex( mutex );
+			quit = true;
+			SDL_CondBroadcast( startCondition );
+			SDL_UnlockMutex( mutex );
+			for ( int i = 0; i < threadCount; ++i )
+				SDL_WaitThread( threads[i], NULL );
+			SDL_DestroyCond( doneCondition );
+			SDL_DestroyCond( startCondition );
+			SDL_DestroyMutex( mutex );
+			#endif
+		}
+	
+		bool Start( WorkerJob * job )
+		{
+			assert( job );
+			#ifdef MULTITHREADED
+			
+				if ( threadCount == 0 )
+				{
+					job->Run();
+					return true;
+				}
+				SDL_LockMutex( mutex );
+				assert( jobCount < MaxJobs );
+				jobs[jobCount++] = job;
+				pendingJobs++;
+				SDL_CondSignal( startCondition );
+				SDL_UnlockMutex( mutex );
+			
+			#else
+			
+				job->Run();
+			
+			#endif
+			return true;
+		}
+	
+		bool Join()
+		{
+			#ifdef MULTITHREADED
+			SDL_LockMutex( mutex );
+			while ( pendingJobs > 0 )
+				SDL_CondWait( doneCondition, mutex );
+			jobCount = 0;
+			nextJob = 0;
+			SDL_UnlockMutex( mutex );
+			#endif
+			return true;
+		}
+	
+		int GetThreadCount() const
+		{
+			return threadCount;
+		}
+	
+	private:
+	
+		static int StaticRun( void * data )
+		{
+			WorkerPool * self = (WorkerPool*) data;
+			self->Run();
+			return 0;
+		}
+	
+		void Run()
+		{
+			#ifdef MULTITHREADED
+			SDL_LockMutex( mutex );
+			while ( true )
+			{
+				while ( !quit && nextJob == jobCount )
+					SDL_CondWait( startCondition, mutex );
+				if ( quit )
+					break;
+				WorkerJob * job = jobs[nextJob++];
+				SDL_UnlockMutex( mutex );
+				job->Run();
+				SDL_LockMutex( mutex );
+				if ( --pendingJobs == 0 )
+					SDL_CondSignal( doneCondition );
+			}
+			SDL_UnlockMutex( mutex );
+			#endif
+		}
+	
+		int threadCount;
+		WorkerJob * jobs[MaxJobs];
+		int jobCount;					// jobs started since the last join
+		int nextJob;					// next job to be picked up by a worker
+		int pendingJobs;				// jobs started but not yet finished
+		bool quit;
+	
+		#ifdef MULTITHREADED
+		SDL_Thread * threads[MaxThreads];
+		SDL_mutex * mutex;
+		SDL_cond * startCondition;
+		SDL_cond * doneCondition;
+		#endif
+	};
+
 #endif
 
 
@@ -305,6 +305,69 @@ namespace render
 			LeaveScreenSpace();
 		}
 
+		void RenderRoundTripTime( const float rtt[], const float rttVariance[], const float jitter[], const float minRtt[], int count, float maxRtt )
+		{
+			// one row per connection from the bottom of the screen: min rtt, smoothed rtt on top of it,
+			// then the rtt variance margin. jitter is the thin bar either side of the smoothed rtt
+
+			glDisable( GL_DEPTH_TEST );
+
+			glEnable( GL_BLEND );
+			glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+
+			const float w = 0.5f;
+			const float h = 0.01f;
+
+			glBegin( GL_QUADS );
+
+			float base = h;
+
+			for ( int i = 0; i < count; ++i )
+			{
+				const float lowest = math::clamp( minRtt[i] / maxRtt, 0.0f, 1.0f ) * w;
+				const float smoothed = math::clamp( rtt[i] / maxRtt, 0.0f, 1.0f ) * w;
+				const float variance = math::clamp( ( rtt[i] + 4 * rttVariance[i] ) / maxRtt, 0.0f, 1.0f ) * w;
+				const float jitterLow = math::clamp( ( rtt[i] - jitter[i] ) / maxRtt, 0.0f, 1.0f ) * w;
+				const float jitterHigh = math::clamp( ( rtt[i] + jitter[i] ) / maxRtt, 0.0f, 1.0f ) * w;
+
+				glColor4f( 0.0f, 1.0f/1.5, 0.0f, 0.75f );
+
+				glVertex2f( 0, base - h );
+				glVertex2f( 0, base );
+				glVertex2f( lowest, base );
+				glVertex2f( lowest, base - h );
+
+				glColor4f( 1.0f/1.5, 1.0f/1.5, 0.0f, 0.75f );
+
+				glVertex2f( lowest, base - h );
+				glVertex2f( lowest, base );
+				glVertex2f( smoothed, base );
+				glVertex2f( smoothed, base - h );
+
+				glColor4f( 1.0f/1.5, 0.15f/1.5, 0.15f/1.5, 0.5f );
+
+				glVertex2f( smoothed, base - h );
+				glVertex2f( smoothed, base );
+				glVertex2f( variance, base );
+				glVertex2f( variance, base - h );
+
+				glColor4f( 1.0f, 1.0f, 1.0f, 0.75f );
+
+				glVertex2f( jitterLow, base - h * 0.6f );
+				glVertex2f( jitterLow, base - h * 0.4f );
+				glVertex2f( jitterHigh, base - h * 0.4f );
+				glVertex2f( jitterHigh, base - h * 0.6f );
+
+				base += h;
+			}
+
+			glEnd();
+
+			glDisable( GL_BLEND );
+
+			LeaveScreenSpace();
+		}
+
 		void RenderDroppedFrames( int simDroppedFrames, int netDroppedFrames, int viewDroppedFrames )
 		{
 			glDisable( GL_DEPTH_TEST );
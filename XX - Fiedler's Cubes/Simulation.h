@@ -12,6 +12,7 @@
 #define dSINGLE
 #include <ode/ode.h>
 #include <vector>
+#include <algorithm>
 
 namespace engine
 {	
@@ -84,6 +85,83 @@ namespace engine
 		int a,b;
 	};
 
+	// set of unique interaction pairs, a->b is the same pair as b->a
+	//  + pairs are packed into a 64 bit (min,max) key in an open addressing table
+	//  + the table is cleared each step but keeps its storage, so it only grows
+
+	class InteractionPairSet
+	{
+	public:
+
+		InteractionPairSet()
+		{
+			count = 0;
+			keys.resize( MinSize, EmptyKey );
+		}
+
+		void Clear()
+		{
+			if ( count > 0 )
+				std::fill( keys.begin(), keys.end(), EmptyKey );
+			count = 0;
+		}
+
+		bool Insert( int a, int b )
+		{
+			// returns true if the pair was not in the set already
+			assert( a >= 0 );
+			assert( b >= 0 );
+			assert( a != b );
+			if ( ( count + 1 ) * 2 > (int) keys.size() )
+				Grow();
+			const uint64_t key = GetKey( a, b );
+			const int slot = FindSlot( key );
+			if ( keys[slot] == key )
+				return false;
+			keys[slot] = key;
+			count++;
+			return true;
+		}
+
+		int GetCount() const
+		{
+			return count;
+		}
+
+	private:
+
+		enum { EmptyKey = 0 };			// (0,0) can't be a key, objects don't interact with themselves
+		enum { MinSize = 256 };			// must be a power of two
+
+		static uint64_t GetKey( int a, int b )
+		{
+			return a < b ? ( uint64_t(a) << 32 ) | uint32_t(b) : ( uint64_t(b) << 32 ) | uint32_t(a);
+		}
+
+		int FindSlot( uint64_t key ) const
+		{
+			const int mask = keys.size() - 1;
+			int slot = int( ( key * 0x9E3779B97F4A7C15ULL ) >> 32 ) & mask;
+			while ( keys[slot] != EmptyKey && keys[slot] != key )
+				slot = ( slot + 1 ) & mask;
+			return slot;
+		}
+
+		void Grow()
+		{
+			std::vector<uint64_t> old( keys.size() * 2, EmptyKey );
+			old.swap( keys );
+			for ( int i = 0; i < (int) old.size(); ++i )
+			{
+				if ( old[i] != EmptyKey )
+					keys[ FindSlot( old[i] ) ] = old[i];
+			}
+		}
+
+		int count;
+		std::vector<uint64_t> keys;
+	};
+
 	// simulation class with dynamic object allocation
 
 	class Simulation
@@ -161,6 +239,7 @@ namespace engine
 		void Update( float deltaTime )
 		{		
 			interactionPairs.clear();
+			interactionPairSet.Clear();
 
 			dJointGroupEmpty( contacts );
 
@@ -406,6 +485,7 @@ namespace engine
 		std::vector<dGeomID> planes;
 		std::vector<ObjectData> objects;
 		std::vector<InteractionPair> interactionPairs;
+		InteractionPairSet interactionPairSet;
 
 	protected:
 
@@ -445,27 +525,17 @@ namespace engine
 						between the same object, so here we filter out
 						unique contacts only. We consider a->b the same
 						as b->a so we only want one of these pairs.
+						The pair set makes this check constant time,
+						and the pairs vector keeps its storage between
+						steps so this does not allocate once warmed up.
 					*/
 
-					bool unique = true;
-					for ( int i = 0; i < (int) simulation->interactionPairs.size(); ++i )
-					{
-						if ( simulation->interactionPairs[i].a == objectId1 &&
-							 simulation->interactionPairs[i].b == objectId2 ||
-							 simulation->interactionPairs[i].a == objectId2 &&
-						     simulation->interactionPairs[i].b == objectId1 )
-						{
-							unique = false;
-							break;
-						}
-					}
-
-					if ( unique )
+					if ( simulation->interactionPairSet.Insert( objectId1, objectId2 ) )
 					{
-						int size = simulation->interactionPairs.size();
-						simulation->interactionPairs.resize( size + 1 );
-						simulation->interactionPairs[size].a = objectId1;
-						simulation->interactionPairs[size].b = objectId2;
+						InteractionPair pair;
+						pair.a = objectId1;
+						pair.b = objectId2;
+						simulation->interactionPairs.push_back( pair );
 					}
 				}
 			}
@@ -11,8 +11,8 @@ class SingleplayerDemo : public Demo
 private:
 
 	game::Instance<hypercube::DatabaseObject, hypercube::ActiveObject> * gameInstance;
-	GameWorkerThread workerThread;
-	view::Packet viewPacket;
+	GameWorkers workers;
+	const view::Packet * viewPacket;
 	view::ObjectManager viewObjectManager;
 	render::Render * render;
 	float t;
@@ -43,6 +43,7 @@ public:
 		config.simConfig.Friction = 200.0f;
 
 		gameInstance = new game::Instance<hypercube::DatabaseObject, hypercube::ActiveObject> ( config );
+		viewPacket = &gameInstance->GetViewPacket();
 		render = new render::Render( displayWidth, displayHeight );
 		t = 0.0f;
 		origin = math::Vector(0,0,0);
@@ -110,16 +111,16 @@ public:
 	void Update( float deltaTime )
 	{
 		// update camera
-		view::Object * playerCube = viewObjectManager.GetObject( 1 );
-		if ( playerCube )
-			origin = playerCube->position + playerCube->positionError;
+		view::Object playerCube;
+		if ( viewObjectManager.GetObject( 1, playerCube ) )
+			origin = playerCube.position + playerCube.positionError;
 		math::Vector lookat = origin;
 		math::Vector position = lookat + math::Vector(0,-10,5);
 		camera.EaseIn( lookat, position ); 
 
 		// grab the view packet & start the worker thread...
-		gameInstance->GetViewPacket( viewPacket );
-		workerThread.Start( gameInstance );
+		viewPacket = &gameInstance->GetViewPacket();
+		workers.Start( gameInstance );
 		t += deltaTime;
 	}
 	
@@ -127,11 +128,11 @@ public:
 	{
 		// update the scene to be rendered
 		
-		if ( viewPacket.objectCount >= 1 )
+		if ( viewPacket->objectCount >= 1 )
 		{
 			view::ObjectUpdate updates[MaxViewObjects];
-			getViewObjectUpdates( updates, viewPacket );
-			viewObjectManager.UpdateObjects( updates, viewPacket.objectCount );
+			getViewObjectUpdates( updates, *viewPacket );
+			viewObjectManager.UpdateObjects( updates, viewPacket->objectCount );
 		}
 		viewObjectManager.ExtrapolateObjects( deltaTime );
 		viewObjectManager.Update( deltaTime );
@@ -163,6 +164,6 @@ public:
 	void PostRender()
 	{
 		// join worker thread
-		workerThread.Join();
+		workers.Join();
 	}
 };
@@ -0,0 +1,724 @@
+/*
+	Fiedler's Cubes
+	Copyright © 2008-2009 Glenn Fiedler
+	http://www.gafferongames.com/fiedlers-cubes
+*/
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "Config.h"
+
+#if PLATFORM == PLATFORM_WINDOWS
+	#include "stdint.h"
+#else
+	#include <stdint.h>
+#endif
+
+#include <limits.h>
+
+#include "Mathematics.h"
+#include "Activation.h"
+#include "Engine.h"
+#include "Network.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace engine
+{
+	using activation::ObjectId;
+
+	/*
+		Snapshot object.
+		The state of one object as sent in a snapshot packet.
+		Authority is in [0,MaxPlayers] where MaxPlayers means
+		default authority (nobody owns the object).
+	*/
+
+	struct SnapshotObject
+	{
+		ObjectId id;
+		bool enabled;
+		int authority;
+		math::Vector position;
+		math::Quaternion orientation;
+		math::Vector linearVelocity;
+		math::Vector angularVelocity;
+	};
+
+	/*
+		Quantized snapshot object.
+		Object state on the integer grid from Engine.h. Deltas are taken
+		between these integers, so sender and receiver reconstruct exactly
+		the same baseline, and state that game::Instance already snapped
+		with FLAG_Quantize goes over the network without any further loss.
+	*/
+
+	struct QuantizedSnapshotObject
+	{
+		ObjectId id;
+		uint32_t enabled;
+		uint32_t authority;
+		QuantizedState state;
+
+		bool operator < ( const QuantizedSnapshotObject & other ) const
+		{
+			return id < other.id;
+		}
+
+		bool SameState( const QuantizedSnapshotObject & other ) const
+		{
+			return enabled == other.enabled && authority == other.authority && state == other.state;
+		}
+	};
+
+	inline void QuantizeSnapshotObject( const SnapshotObject & object, QuantizedSnapshotObject & quantized )
+	{
+		assert( object.authority >= 0 );
+		assert( object.authority <= MaxPlayers );
+		quantized.id = object.id;
+		quantized.enabled = object.enabled ? 1 : 0;
+		quantized.authority = object.authority;
+		QuantizeState( object.position, object.orientation, object.linearVelocity, object.angularVelocity, quantized.state );
+	}
+
+	inline void DequantizeSnapshotObject( const QuantizedSnapshotObject & quantized, SnapshotObject & object )
+	{
+		object.id = quantized.id;
+		object.enabled = quantized.enabled != 0;
+		object.authority = quantized.authority;
+		DequantizeState( quantized.state, object.position, object.orientation, object.linearVelocity, object.angularVelocity );
+	}
+
+	/*
+		Small value codes.
+		Most deltas between snapshots are zero or small, so they are sent
+		with a prefix code: "0" for zero, "10" plus 4 bits, "110" plus 10 bits,
+		and "111" followed by the value at full width. Signed values are
+		zig-zag mapped first so small negative values stay small.
+	*/
+
+	inline bool SerializeSmallUnsigned( net::Stream & stream, uint32_t & value, int fullBits )
+	{
+		const uint32_t SmallLimit = 1 + 16;
+		const uint32_t MediumLimit = SmallLimit + 1024;
+
+		unsigned int zero = value == 0;
+		if ( !stream.SerializeBits( zero, 1 ) )
+			return false;
+		if ( zero )
+		{
+			value = 0;
+			return true;
+		}
+
+		unsigned int small = value < SmallLimit;
+		if ( !stream.SerializeBits( small, 1 ) )
+			return false;
+		if ( small )
+		{
+			unsigned int bits = value - 1;
+			if ( !stream.SerializeBits( bits, 4 ) )
+				return false;
+			value = bits + 1;
+			return true;
+		}
+
+		unsigned int medium = value < MediumLimit;
+		if ( !stream.SerializeBits( medium, 1 ) )
+			return false;
+		if ( medium )
+		{
+			unsigned int bits = value - SmallLimit;
+			if ( !stream.SerializeBits( bits, 10 ) )
+				return false;
+			value = bits + SmallLimit;
+			return true;
+		}
+
+		unsigned int bits = value;
+		if ( !stream.SerializeBits( bits, fullBits ) )
+			return false;
+		value = bits;
+		return true;
+	}
+
+	inline bool SerializeSmallSigned( net::Stream & stream, int32_t & value, int fullBits )
+	{
+		uint32_t zigzag = (uint32_t) ( ( value << 1 ) ^ ( value >> 31 ) );
+		if ( !SerializeSmallUnsigned( stream, zigzag, fullBits ) )
+			return false;
+		value = (int32_t) ( zigzag >> 1 ) ^ -(int32_t) ( zigzag & 1 );
+		return true;
+	}
+
+	/*
+		Snapshot history.
+		Ring buffer of the last few snapshots sent to, or received from,
+		one remote player, indexed by packet sequence number. Objects in
+		each snapshot are sorted by id so finding an object is a binary search.
+	*/
+
+	class SnapshotHistory
+	{
+	public:
+
+		enum { Size = 32 };
+
+		SnapshotHistory()
+		{
+			entries.resize( Size );
+			Reset();
+		}
+
+		void Reset()
+		{
+			for ( int i = 0; i < Size; ++i )
+			{
+				entries[i].valid = false;
+				entries[i].sequence = 0;
+				entries[i].objects.clear();
+			}
+		}
+
+		void Store( unsigned int sequence, const QuantizedSnapshotObject * objects, int count )
+		{
+			Entry & entry = entries[sequence % Size];
+			if ( entry.valid && (int) ( sequence - entry.sequence ) < 0 )
+				return;			// late packet: the slot already holds a newer snapshot
+			entry.valid = true;
+			entry.sequence = sequence;
+			if ( count > 0 )
+				entry.objects.assign( objects, objects + count );
+			else
+				entry.objects.clear();
+		}
+
+		bool Exists( unsigned int sequence ) const
+		{
+			const Entry & entry = entries[sequence % Size];
+			return entry.valid && entry.sequence == sequence;
+		}
+
+		int GetObjectCount( unsigned int sequence ) const
+		{
+			assert( Exists( sequence ) );
+			return (int) entries[sequence % Size].objects.size();
+		}
+
+		const QuantizedSnapshotObject & GetObject( unsigned int sequence, int index ) const
+		{
+			assert( Exists( sequence ) );
+			return entries[sequence % Size].objects[index];
+		}
+
+		const QuantizedSnapshotObject * FindObject( unsigned int sequence, ObjectId id ) const
+		{
+			if ( !Exists( sequence ) )
+				return NULL;
+			const std::vector<QuantizedSnapshotObject> & objects = entries[sequence % Size].objects;
+			QuantizedSnapshotObject key;
+			key.id = id;
+			std::vector<QuantizedSnapshotObject>::const_iterator itor = std::lower_bound( objects.begin(), objects.end(), key );
+			if ( itor == objects.end() || itor->id != id )
+				return NULL;
+			return &(*itor);
+		}
+
+	private:
+
+		struct Entry
+		{
+			bool valid;
+			unsigned int sequence;
+			std::vector<QuantizedSnapshotObject> objects;
+		};
+
+		std::vector<Entry> entries;
+	};
+
+	/*
+		Snapshot stats.
+		Counters for the bandwidth report. Bytes are what actually goes
+		over the wire, uncompressed bytes are what the same packets cost
+		as raw object state. Errors are received packets that failed to
+		decode, which are dropped without being acked.
+	*/
+
+	struct SnapshotStats
+	{
+		int packets;
+		int bytes;
+		int uncompressedBytes;
+		int objects;
+		int unchanged;
+		int deltas;
+		int absolute;
+		int errors;
+
+		SnapshotStats()
+		{
+			Clear();
+		}
+
+		void Clear()
+		{
+			packets = 0;
+			bytes = 0;
+			uncompressedBytes = 0;
+			objects = 0;
+			unchanged = 0;
+			deltas = 0;
+			absolute = 0;
+			errors = 0;
+		}
+
+		void Add( const SnapshotStats & other )
+		{
+			packets += other.packets;
+			bytes += other.bytes;
+			uncompressedBytes += other.uncompressedBytes;
+			objects += other.objects;
+			unchanged += other.unchanged;
+			deltas += other.deltas;
+			absolute += other.absolute;
+			errors += other.errors;
+		}
+	};
+
+	inline void PrintSnapshotStats( const char * mode, const SnapshotStats & stats, float seconds )
+	{
+		if ( stats.packets == 0 || seconds <= 0.0f )
+			return;
+		const int objects = stats.objects > 0 ? stats.objects : 1;
+		printf( "snapshots (%s): %.1f kbps, %.1f kbps uncompressed, %d bytes per packet, %.1f objects per packet: %d%% unchanged, %d%% delta, %d%% absolute, %d errors\n",
+			mode, stats.bytes * 8.0f / 1000.0f / seconds, stats.uncompressedBytes * 8.0f / 1000.0f / seconds, stats.bytes / stats.packets, stats.objects / (float) stats.packets, 
+			stats.unchanged * 100 / objects, stats.deltas * 100 / objects, stats.absolute * 100 / objects, stats.errors );
+	}
+
+	/*
+		Snapshot connection.
+		Sends and receives snapshot packets with one remote player.
+
+		Each packet carries a reliability header (sequence, ack, ack bits),
+		so the sender learns which snapshots arrived. Each object is encoded
+		relative to the most recent acked snapshot that contained it:
+		a single bit if nothing changed, small delta codes if it moved a
+		little, or absolute quantized state if there is no acked baseline
+		less than the history size back. Baselines are only ever snapshots
+		the receiver acked, so packet loss never breaks decoding.
+
+		Both ends of a link need a connection: A's connection to B sends
+		A's snapshots to B and reads B's packets, which carry B's acks.
+	*/
+
+	class SnapshotConnection
+	{
+	public:
+
+		enum { MaxObjects = 1024 };
+
+		SnapshotConnection()
+		{
+			Reset();
+		}
+
+		void Reset()
+		{
+			reliabilitySystem.Reset();
+			sent.Reset();
+			received.Reset();
+			acked.clear();
+			stats.Clear();
+			receivedPacket = false;
+		}
+
+		bool WriteSnapshot( net::Stream & stream, const SnapshotObject objects[], int count )
+		{
+			assert( stream.IsWriting() );
+			assert( count >= 0 );
+			assert( count <= MaxObjects );
+
+			unsigned int sequence = reliabilitySystem.GetLocalSequence();
+			unsigned int hasAck = receivedPacket;
+			unsigned int ack = reliabilitySystem.GetRemoteSequence();
+			unsigned int ackBits = reliabilitySystem.GenerateAckBits();
+			if ( !SerializeHeader( stream, sequence, hasAck, ack, ackBits ) )
+				return false;
+
+			quantized.resize( count );
+			for ( int i = 0; i < count; ++i )
+				QuantizeSnapshotObject( objects[i], quantized[i] );
+			std::sort( quantized.begin(), quantized.end() );
+
+			unsigned int objectCount = count;
+			if ( !stream.SerializeInteger( objectCount, 0, MaxObjects ) )
+				return false;
+
+			ObjectId previousId = 0;
+			unsigned int previousOffset = 0;
+			for ( int i = 0; i < count; ++i )
+			{
+				QuantizedSnapshotObject & object = quantized[i];
+				assert( i == 0 || object.id > previousId );
+
+				uint32_t idGap = object.id - previousId - 1;
+				if ( !SerializeSmallUnsigned( stream, idGap, 32 ) )
+					return false;
+				previousId = object.id;
+
+				// find the most recent acked snapshot that holds this object
+
+				const QuantizedSnapshotObject * baseline = NULL;
+				unsigned int baselineOffset = 0;
+				if ( object.id < acked.size() && acked[object.id].valid )
+				{
+					const unsigned int baselineSequence = acked[object.id].sequence;
+					baselineOffset = sequence - baselineSequence;
+					if ( baselineOffset >= 1 && baselineOffset < SnapshotHistory::Size )
+						baseline = sent.FindObject( baselineSequence, object.id );
+				}
+
+				unsigned int hasBaseline = baseline != NULL;
+				if ( !stream.SerializeBits( hasBaseline, 1 ) )
+					return false;
+				if ( hasBaseline && !SerializeBaselineOffset( stream, baselineOffset, previousOffset ) )
+					return false;
+
+				if ( !SerializeObject( stream, object, baseline ) )
+					return false;
+			}
+
+			sent.Store( sequence, quantized.empty() ? NULL : &quantized[0], count );
+
+			stats.packets++;
+			stats.uncompressedBytes += 12 + 4 + count * (int) sizeof( SnapshotObject );
+			stats.objects += count;
+
+			return true;
+		}
+
+		void PacketSent( int bytes )
+		{
+			// call once per packet written, with the size of the whole packet
+			reliabilitySystem.PacketSent( bytes );
+			stats.bytes += bytes;
+		}
+
+		bool ReadSnapshot( net::Stream & stream, SnapshotObject objects[], int & count, int maxCount )
+		{
+			// note: a packet that fails to decode is counted and dropped unacked, so the sender keeps using older baselines
+			assert( stream.IsReading() );
+			count = 0;
+			if ( ReadSnapshotPacket( stream, objects, count, maxCount ) )
+				return true;
+			stats.errors++;
+			return false;
+		}
+
+		void Update( float deltaTime )
+		{
+			// acks from packets received this frame: these snapshots are now baselines
+
+			unsigned int * acks = NULL;
+			int ackCount = 0;
+			reliabilitySystem.GetAcks( &acks, ackCount );
+			for ( int i = 0; i < ackCount; ++i )
+				ProcessAck( acks[i] );
+
+			reliabilitySystem.Update( deltaTime );
+		}
+
+		const SnapshotStats & GetStats() const
+		{
+			return stats;
+		}
+
+		void ClearStats()
+		{
+			stats.Clear();
+		}
+
+		net::ReliabilitySystem & GetReliabilitySystem()
+		{
+			return reliabilitySystem;
+		}
+
+	private:
+
+		enum { BaselineOffsetBits = 5 };			// baseline is [1,SnapshotHistory::Size-1] snapshots back
+
+		typedef char BaselineOffsetFits[ ( 1 << BaselineOffsetBits ) >= SnapshotHistory::Size - 1 ? 1 : -1 ];
+
+		struct AckedObject
+		{
+			bool valid;
+			unsigned int sequence;
+		};
+
+		bool ReadSnapshotPacket( net::Stream & stream, SnapshotObject objects[], int & count, int maxCount )
+		{
+
+			unsigned int sequence = 0;
+			unsigned int hasAck = 0;
+			unsigned int ack = 0;
+			unsigned int ackBits = 0;
+			if ( !SerializeHeader( stream, sequence, hasAck, ack, ackBits ) )
+				return false;
+
+			unsigned int objectCount = 0;
+			if ( !stream.SerializeInteger( objectCount, 0, MaxObjects ) )
+				return false;
+			if ( (int) objectCount > maxCount )
+				return false;
+
+			quantized.resize( objectCount );
+
+			ObjectId previousId = 0;
+			unsigned int previousOffset = 0;
+			for ( int i = 0; i < (int) objectCount; ++i )
+			{
+				QuantizedSnapshotObject & object = quantized[i];
+
+				uint32_t idGap = 0;
+				if ( !SerializeSmallUnsigned( stream, idGap, 32 ) )
+					return false;
+				object.id = previousId + idGap + 1;
+				previousId = object.id;
+
+				unsigned int hasBaseline = 0;
+				if ( !stream.SerializeBits( hasBaseline, 1 ) )
+					return false;
+
+				const QuantizedSnapshotObject * baseline = NULL;
+				if ( hasBaseline )
+				{
+					unsigned int baselineOffset = 0;
+					if ( !SerializeBaselineOffset( stream, baselineOffset, previousOffset ) )
+						return false;
+					if ( baselineOffset >= SnapshotHistory::Size )
+						return false;
+					baseline = received.FindObject( sequence - baselineOffset, object.id );
+					if ( !baseline )
+						return false;
+				}
+
+				if ( !SerializeObject( stream, object, baseline ) )
+					return false;
+			}
+
+			// only a packet that decodes completely is acked, and so used as a baseline
+
+			received.Store( sequence, quantized.empty() ? NULL : &quantized[0], objectCount );
+
+			reliabilitySystem.PacketReceived( sequence, stream.GetDataBytes() );
+			if ( hasAck )
+				reliabilitySystem.ProcessAck( ack, ackBits );
+			receivedPacket = true;
+
+			for ( int i = 0; i < (int) objectCount; ++i )
+				DequantizeSnapshotObject( quantized[i], objects[i] );
+			count = objectCount;
+
+			return true;
+		}
+
+		void ProcessAck( unsigned int sequence )
+		{
+			if ( !sent.Exists( sequence ) )
+				return;
+			const int count = sent.GetObjectCount( sequence );
+			for ( int i = 0; i < count; ++i )
+			{
+				const ObjectId id = sent.GetObject( sequence, i ).id;
+				if ( id >= acked.size() )
+				{
+					AckedObject empty;
+					empty.valid = false;
+					empty.sequence = 0;
+					acked.resize( id + 1, empty );
+				}
+				AckedObject & object = acked[id];
+				if ( !object.valid || (int) ( sequence - object.sequence ) > 0 )
+				{
+					object.valid = true;
+					object.sequence = sequence;
+				}
+			}
+		}
+
+		static bool SerializeBaselineOffset( net::Stream & stream, unsigned int & offset, unsigned int & previousOffset )
+		{
+			// note: objects in a packet mostly share a baseline, so repeating the previous object's offset is one bit
+			unsigned int same = offset == previousOffset;
+			if ( !stream.SerializeBits( same, 1 ) )
+				return false;
+			if ( same )
+			{
+				offset = previousOffset;
+				return true;
+			}
+			unsigned int offsetBits = offset - 1;
+			if ( !stream.SerializeBits( offsetBits, BaselineOffsetBits ) )
+				return false;
+			offset = offsetBits + 1;
+			previousOffset = offset;
+			return true;
+		}
+
+		static bool SerializeHeader( net::Stream & stream, unsigned int & sequence, unsigned int & hasAck, unsigned int & ack, unsigned int & ackBits )
+		{
+			// note: until the first packet arrives there is nothing to ack, and an ack of zero would ack a packet never received
+			if ( !stream.SerializeBits( sequence, 32 ) )
+				return false;
+			if ( !stream.SerializeBits( hasAck, 1 ) )
+				return false;
+			if ( !hasAck )
+				return true;
+			if ( !stream.SerializeBits( ack, 32 ) )
+				return false;
+			if ( !stream.SerializeBits( ackBits, 32 ) )
+				return false;
+			return true;
+		}
+
+		bool SerializeObject( net::Stream & stream, QuantizedSnapshotObject & object, const QuantizedSnapshotObject * baseline )
+		{
+			const int AuthorityBits = net::Stream::BitsRequired( 0, MaxPlayers );
+
+			if ( baseline )
+			{
+				// resting objects: one bit
+
+				unsigned int unchanged = stream.IsWriting() && object.SameState( *baseline );
+				if ( !stream.SerializeBits( unchanged, 1 ) )
+					return false;
+				if ( unchanged )
+				{
+					if ( stream.IsReading() )
+					{
+						const ObjectId id = object.id;
+						object = *baseline;
+						object.id = id;
+					}
+					stats.unchanged += stream.IsWriting();
+					return true;
+				}
+
+				if ( !stream.SerializeBits( object.enabled, 1 ) )
+					return false;
+				if ( !stream.SerializeBits( object.authority, AuthorityBits ) )
+					return false;
+
+				QuantizedState & state = object.state;
+				const QuantizedState & base = baseline->state;
+
+				if ( !SerializeDeltas( stream, state.position, base.position, GetPositionLimit() ) )
+					return false;
+
+				// orientation: unchanged, delta per smallest three component, or absolute if the largest component changed
+
+				unsigned int orientationChanged = state.largest != base.largest || 
+												  state.orientation[0] != base.orientation[0] ||
+												  state.orientation[1] != base.orientation[1] || 
+												  state.orientation[2] != base.orientation[2];
+				if ( !stream.SerializeBits( orientationChanged, 1 ) )
+					return false;
+				if ( !orientationChanged )
+				{
+					state.largest = base.largest;
+					state.orientation[0] = base.orientation[0];
+					state.orientation[1] = base.orientation[1];
+					state.orientation[2] = base.orientation[2];
+				}
+				else
+				{
+					unsigned int sameLargest = state.largest == base.largest;
+					if ( !stream.SerializeBits( sameLargest, 1 ) )
+						return false;
+					if ( sameLargest )
+					{
+						state.largest = base.largest;
+						if ( !SerializeDeltas( stream, state.orientation, base.orientation, GetOrientationLimit() ) )
+							return false;
+					}
+					else if ( !SerializeOrientation( stream, state ) )
+						return false;
+				}
+
+				if ( !SerializeDeltas( stream, state.linearVelocity, base.linearVelocity, GetLinearVelocityLimit() ) )
+					return false;
+				if ( !SerializeDeltas( stream, state.angularVelocity, base.angularVelocity, GetAngularVelocityLimit() ) )
+					return false;
+
+				stats.deltas += stream.IsWriting();
+				return true;
+			}
+
+			// no baseline: absolute quantized state
+
+			if ( !stream.SerializeBits( object.enabled, 1 ) )
+				return false;
+			if ( !stream.SerializeBits( object.authority, AuthorityBits ) )
+				return false;
+			if ( !SerializeIntegers( stream, object.state.position, GetPositionLimit() ) )
+				return false;
+			if ( !SerializeOrientation( stream, object.state ) )
+				return false;
+			if ( !SerializeIntegers( stream, object.state.linearVelocity, GetLinearVelocityLimit() ) )
+				return false;
+			if ( !SerializeIntegers( stream, object.state.angularVelocity, GetAngularVelocityLimit() ) )
+				return false;
+
+			stats.absolute += stream.IsWriting();
+			return true;
+		}
+
+		static bool SerializeIntegers( net::Stream & stream, int32_t integer[], int32_t limit )
+		{
+			for ( int j = 0; j < 3; ++j )
+			{
+				int value = integer[j];
+				if ( !stream.SerializeInteger( value, -limit, limit ) )
+					return false;
+				integer[j] = value;
+			}
+			return true;
+		}
+
+		static bool SerializeDeltas( net::Stream & stream, int32_t integer[], const int32_t base[], int32_t limit )
+		{
+			// note: a delta between two values in [-limit,limit] needs one bit more than the values themselves
+			const int fullBits = net::Stream::BitsRequired( 0, 4 * limit + 1 );
+			for ( int j = 0; j < 3; ++j )
+			{
+				int32_t delta = integer[j] - base[j];
+				if ( !SerializeSmallSigned( stream, delta, fullBits ) )
+					return false;
+				const int32_t value = base[j] + delta;
+				if ( value < -limit || value > limit )
+					return false;
+				integer[j] = value;
+			}
+			return true;
+		}
+
+		static bool SerializeOrientation( net::Stream & stream, QuantizedState & state )
+		{
+			if ( !stream.SerializeBits( state.largest, 2 ) )
+				return false;
+			return SerializeIntegers( stream, state.orientation, GetOrientationLimit() );
+		}
+
+		net::ReliabilitySystem reliabilitySystem;
+		SnapshotHistory sent;
+		SnapshotHistory received;
+		std::vector<AckedObject> acked;						// object id -> most recent acked snapshot holding that object
+		std::vector<QuantizedSnapshotObject> quantized;
+		SnapshotStats stats;
+		bool receivedPacket;
+	};
+}
+
+#endif
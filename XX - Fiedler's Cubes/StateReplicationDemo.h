@@ -5,6 +5,7 @@
 */
 
 #include "Cubes.h"
+#include "Snapshot.h"
 
 class StateReplicationDemo : public Demo
 {
@@ -21,8 +22,8 @@ private:
 	};
 
 	game::Instance<cubes::DatabaseObject, cubes::ActiveObject> * gameInstance[MaxPlayers];
-	GameWorkerThread workerThread[MaxPlayers];
-	view::Packet viewPacket[MaxPlayers];
+	GameWorkers workers;
+	const view::Packet * viewPacket[MaxPlayers];
 	view::ObjectManager viewObjectManager[MaxPlayers];
 	render::Render * render;
 	Camera camera[MaxPlayers];
@@ -35,6 +36,8 @@ private:
 	bool strobe;
 	bool tildeDownLastFrame;
 	SyncMode syncMode;
+	engine::SnapshotConnection connection[MaxPlayers];
+	float reportTime;
 
 public:
 
@@ -49,6 +52,7 @@ public:
 		follow = true;
 		tildeDownLastFrame = false;
 		syncMode = SYNC_Nothing;
+		reportTime = 0.0f;
 	}
 
 	~StateReplicationDemo()
@@ -64,6 +68,7 @@ public:
 		{
 			game::Config config;
 			config.deactivationTime = 0.5f;
+			config.maxPriorityObjects = MaxObjectsInPacket;
 			config.cellSize = 4.0f;
 			config.cellWidth = 16;
 			config.cellHeight = 16;
@@ -79,6 +84,7 @@ public:
 			config.simConfig.Friction = 200.0f;
 			
 			gameInstance[i] = new game::Instance<cubes::DatabaseObject, cubes::ActiveObject> ( config );
+			viewPacket[i] = &gameInstance[i]->GetViewPacket();
 			
 			gameInstance[i]->InitializeBegin();
 			
@@ -104,6 +110,7 @@ public:
 			
 			gameInstance[i]->SetFlag( game::FLAG_Hover );
 			gameInstance[i]->SetFlag( game::FLAG_Katamari );
+			gameInstance[i]->SetFlag( game::FLAG_Quantize );
 
 			origin[i] = math::Vector(0,0,0);
 		}
@@ -188,104 +195,140 @@ public:
 	{
 		// fake some networking
 
-		struct TempObject
-		{
-			ObjectId id;
-			uint32_t authority : 1;
-			uint32_t enabled : 1;
-			uint32_t framesAtRest : 7;
-			math::Vector position;
-			math::Quaternion orientation;
-			math::Vector linearVelocity;
-			math::Vector angularVelocity;
-		};
-
-		struct TempPacket
-		{
-			uint32_t frame;
-			game::Input input;
-			int objectCount;
-			TempObject object[MaxObjectsInPacket];
-			bool authority[MaxObjectsInPacket];
-		};
+		/*
+			Instance 0 sends snapshots to instance 1, which sends back
+			empty snapshots so the acks get through. Objects are delta
+			encoded against the last snapshot instance 1 acked.
+		*/
+
+		enum { MaxPacketSize = MaxObjectsInPacket * 64 + 256 };
 
-		static engine::PacketQueue packetQueue;
-		packetQueue.SetDelay( lag );
+		static engine::NetworkSimulator networkSimulator( MaxPlayers );
+		engine::LinkSettings linkSettings;
+		linkSettings.latency = lag;
+		networkSimulator.SetLinkSettings( linkSettings );
 
 		static int accumulator = 0;
 		accumulator++;
-		TempPacket packet;
-		packet.frame = gameInstance[0]->GetPlayerFrame( 0 );
-		gameInstance[0]->GetPlayerInput( 0, packet.input );
-		if ( sendRate > 0 && accumulator >= sendRate )
+		
+		const int from = 0;
+		const int to = 1;
+
+		unsigned char buffer[MaxPacketSize];
+		engine::SnapshotObject objects[MaxObjectsInPacket];
+
 		{
-			packet.objectCount = MaxObjectsInPacket;
-			if ( packet.objectCount > gameInstance[0]->GetActiveObjectCount() )
-				packet.objectCount = gameInstance[0]->GetActiveObjectCount();
-			for ( int i = 0; i < packet.objectCount; ++i )
+			int objectCount = 0;
+			if ( sendRate > 0 && accumulator >= sendRate )
 			{
-				const cubes::ActiveObject & activeObject = gameInstance[0]->GetPriorityObject( 0, i );
-				gameInstance[0]->ResetObjectPriority( 0, i );
-				packet.object[i].id = activeObject.id;
-				packet.object[i].authority = gameInstance[0]->GetObjectAuthority( packet.object[i].id ) == 0;
-				packet.object[i].enabled = activeObject.enabled;
-				packet.object[i].framesAtRest = 0;
-				packet.object[i].position = activeObject.position;
-				packet.object[i].orientation = activeObject.orientation;
-				packet.object[i].linearVelocity = activeObject.linearVelocity;
-				packet.object[i].angularVelocity = activeObject.angularVelocity;
+				objectCount = MaxObjectsInPacket;
+				if ( objectCount > gameInstance[from]->GetActiveObjectCount() )
+					objectCount = gameInstance[from]->GetActiveObjectCount();
+				for ( int i = 0; i < objectCount; ++i )
+				{
+					const cubes::ActiveObject & activeObject = gameInstance[from]->GetPriorityObject( 0, i );
+					gameInstance[from]->ResetObjectPriority( 0, i );
+					objects[i].id = activeObject.id;
+					objects[i].authority = gameInstance[from]->GetObjectAuthority( activeObject.id ) == 0 ? 0 : ::MaxPlayers;
+					objects[i].enabled = activeObject.enabled;
+					objects[i].position = activeObject.position;
+					objects[i].orientation = activeObject.orientation;
+					objects[i].linearVelocity = activeObject.linearVelocity;
+					objects[i].angularVelocity = activeObject.angularVelocity;
+				}
+				accumulator = 0;
 			}
-			accumulator = 0;
+
+			net::Stream stream( net::Stream::Write, buffer, MaxPacketSize );
+			unsigned int frame = gameInstance[from]->GetPlayerFrame( 0 );
+			game::Input input;
+			gameInstance[from]->GetPlayerInput( 0, input );
+			stream.SerializeInteger( frame );
+			input.Serialize( stream );
+			bool result = connection[from].WriteSnapshot( stream, objects, objectCount );
+			assert( result );
+			(void) result;
+			const int bytes = stream.GetDataBytes();
+			networkSimulator.SendPacket( from, to, buffer, bytes );
+			connection[from].PacketSent( bytes );
 		}
-		else
+
 		{
-			packet.objectCount = 0;
+			net::Stream stream( net::Stream::Write, buffer, MaxPacketSize );
+			connection[to].WriteSnapshot( stream, NULL, 0 );
+			const int bytes = stream.GetDataBytes();
+			networkSimulator.SendPacket( to, from, buffer, bytes );
+			connection[to].PacketSent( bytes );
 		}
-		
-		const int from = 0;
-		const int to = 1;
-		
-		packetQueue.QueuePacket( from, to, (unsigned char*)&packet, sizeof(TempPacket) );
 
-		packetQueue.Update( deltaTime );
+		networkSimulator.Update( deltaTime );
 
-		while ( engine::PacketQueue::Packet * pkt = packetQueue.PacketReadyToSend() )
+		while ( const engine::NetworkSimulator::Packet * pkt = networkSimulator.ReceivePacket() )
 		{
-			TempPacket * packet = (TempPacket*) &pkt->data[0];
+			const int receiver = pkt->destinationNodeId;
+			net::Stream stream( net::Stream::Read, (unsigned char*) pkt->data, pkt->size );
+			if ( receiver == from )
+			{
+				int objectCount = 0;
+				connection[from].ReadSnapshot( stream, objects, objectCount, MaxObjectsInPacket );
+				continue;
+			}
+
+			// note: always decode, even when not syncing, so the snapshot history stays in step with the sender
+			unsigned int frame = 0;
+			game::Input input;
+			int objectCount = 0;
+			stream.SerializeInteger( frame );
+			input.Serialize( stream );
+			if ( !connection[to].ReadSnapshot( stream, objects, objectCount, MaxObjectsInPacket ) )
+				continue;
+
 			if ( syncMode != SYNC_Nothing )
 			{
-				gameInstance[1]->SetPlayerInput( 0, packet->input );
+				gameInstance[to]->SetPlayerInput( 0, input );
 				if ( syncMode == SYNC_InputAndState )
 				{
-					gameInstance[1]->SetPlayerFrame( 0, packet->frame );
-					if ( packet->objectCount > 0 )
+					gameInstance[to]->SetPlayerFrame( 0, frame );
+					for ( int i = 0; i < objectCount; ++i )
 					{
-						for ( int i = 0; i < packet->objectCount; ++i )
-						{
-							cubes::ActiveObject activeObject;
-							gameInstance[1]->GetObjectState( packet->object[i].id, activeObject );
-							activeObject.enabled = packet->object[i].enabled;
-							activeObject.position = packet->object[i].position;
-							activeObject.orientation = packet->object[i].orientation;
-							activeObject.linearVelocity = packet->object[i].linearVelocity;
-							activeObject.angularVelocity = packet->object[i].angularVelocity;
-							gameInstance[1]->SetObjectState( activeObject.id, activeObject );
-							if ( packet->object[i].authority )
-								gameInstance[1]->SetObjectAuthority( packet->object[i].id, 0 );
-							else
-								gameInstance[1]->SetObjectAuthority( packet->object[i].id, ::MaxPlayers, true );
-						}
+						cubes::ActiveObject activeObject;
+						gameInstance[to]->GetObjectState( objects[i].id, activeObject );
+						activeObject.enabled = objects[i].enabled;
+						activeObject.position = objects[i].position;
+						activeObject.orientation = objects[i].orientation;
+						activeObject.linearVelocity = objects[i].linearVelocity;
+						activeObject.angularVelocity = objects[i].angularVelocity;
+						gameInstance[to]->SetObjectState( activeObject.id, activeObject );
+						if ( objects[i].authority == 0 )
+							gameInstance[to]->SetObjectAuthority( objects[i].id, 0 );
+						else
+							gameInstance[to]->SetObjectAuthority( objects[i].id, ::MaxPlayers, true );
 					}
 				}
 			}
-			delete pkt;
+		}
+
+		for ( int i = 0; i < MaxPlayers; ++i )
+			connection[i].Update( deltaTime );
+
+		// bandwidth report
+
+		reportTime += deltaTime;
+		if ( reportTime >= 1.0f )
+		{
+			#ifdef PRINT_SNAPSHOT_STATS
+			const char * syncModeNames[] = { "nothing", "input only", "input and state" };
+			engine::PrintSnapshotStats( syncModeNames[syncMode], connection[from].GetStats(), reportTime );
+			#endif
+			connection[from].ClearStats();
+			reportTime = 0.0f;
 		}
 
 		// grab the view packet & start the worker thread...
 		for ( int i = 0; i < MaxPlayers; ++i )
 		{
-			gameInstance[i]->GetViewPacket( viewPacket[i] );
-			workerThread[i].Start( gameInstance[i] );
+			viewPacket[i] = &gameInstance[i]->GetViewPacket();
+			workers.Start( gameInstance[i] );
 		}
 
 		// advance time
@@ -298,13 +341,13 @@ public:
 
 		for ( int i = 0; i < MaxPlayers; ++i )
 		{
-			if ( viewPacket[i].objectCount >= 1 )
+			if ( viewPacket[i]->objectCount >= 1 )
 			{
 				view::ObjectUpdate updates[MaxViewObjects];
-				getViewObjectUpdates( updates, viewPacket[i] );
-				for ( int j = 0; j < viewPacket[i].objectCount; ++j )
+				getViewObjectUpdates( updates, *viewPacket[i] );
+				for ( int j = 0; j < viewPacket[i]->objectCount; ++j )
 					getAuthorityColor( updates[j].authority, updates[j].r, updates[j].g, updates[j].b );
-				viewObjectManager[i].UpdateObjects( updates, viewPacket[i].objectCount );
+				viewObjectManager[i].UpdateObjects( updates, viewPacket[i]->objectCount );
 			}
 			viewObjectManager[i].ExtrapolateObjects( deltaTime );
 			viewObjectManager[i].Update( deltaTime );
@@ -314,9 +357,9 @@ public:
 
 		for ( int i = 0; i < MaxPlayers; ++i )
 		{
-			view::Object * playerCube = viewObjectManager[i].GetObject( 1 );
-			if ( playerCube )
-				origin[i] = playerCube->position + playerCube->positionError;
+			view::Object playerCube;
+			if ( viewObjectManager[i].GetObject( 1, playerCube ) )
+				origin[i] = playerCube.position + playerCube.positionError;
 
 			math::Vector lookat = origin[i];
 			math::Vector position = lookat + math::Vector(0,-10,5);
@@ -367,7 +410,6 @@ public:
 	void PostRender()
 	{
 		// join worker threads
-		for ( int i = 0; i < MaxPlayers; ++i )
-			workerThread[i].Join();
+		workers.Join();
 	}
 };
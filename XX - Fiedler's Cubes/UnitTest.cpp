@@ -0,0 +1,373 @@
+/*
+	Fiedler's Cubes
+	Copyright © 2008-2009 Glenn Fiedler
+	http://www.gafferongames.com/fiedlers-cubes
+*/
+
+#include <assert.h>
+#include <float.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "Config.h"
+
+#if PLATFORM != PLATFORM_WINDOWS
+	#include <unistd.h>
+#endif
+
+#include "UnitTest++/UnitTest++.h"
+
+#include "Platform.h"
+#include "Activation.h"
+#include "Engine.h"
+#include "Snapshot.h"
+
+using activation::ObjectId;
+using engine::SnapshotObject;
+using engine::SnapshotConnection;
+using engine::SnapshotHistory;
+using engine::SnapshotStats;
+using engine::SimulationObjectState;
+
+const float DeltaTime = 1.0f / 60.0f;
+
+// ------------------------------------------------------------------------------------
+// snapshots
+// ------------------------------------------------------------------------------------
+
+/*
+	One direction of a snapshot link. The sender writes a packet, which
+	is either delivered to the receiver or dropped, and the receiver
+	acks with an empty snapshot going back the other way.
+*/
+
+struct SnapshotLink
+{
+	enum { BufferSize = 4096 };
+
+	SnapshotConnection sender;
+	SnapshotConnection receiver;
+	unsigned char buffer[BufferSize];
+	int bytes;
+
+	SnapshotLink()
+	{
+		bytes = 0;
+	}
+
+	void Send( const SnapshotObject objects[], int count )
+	{
+		net::Stream stream( net::Stream::Write, buffer, BufferSize );
+		bool result = sender.WriteSnapshot( stream, objects, count );
+		assert( result );
+		(void) result;
+		bytes = stream.GetDataBytes();
+		sender.PacketSent( bytes );
+	}
+
+	bool Deliver( SnapshotConnection & to, SnapshotObject objects[], int & count, int maxCount, int size = -1 )
+	{
+		net::Stream stream( net::Stream::Read, buffer, size >= 0 ? size : bytes );
+		return to.ReadSnapshot( stream, objects, count, maxCount );
+	}
+
+	void Ack()
+	{
+		unsigned char ackBuffer[256];
+		net::Stream writeStream( net::Stream::Write, ackBuffer, sizeof( ackBuffer ) );
+		bool result = receiver.WriteSnapshot( writeStream, NULL, 0 );
+		assert( result );
+		receiver.PacketSent( writeStream.GetDataBytes() );
+		net::Stream readStream( net::Stream::Read, ackBuffer, writeStream.GetDataBytes() );
+		int count = 0;
+		result = sender.ReadSnapshot( readStream, NULL, count, 0 );
+		assert( result );
+		(void) result;
+		sender.Update( DeltaTime );
+		receiver.Update( DeltaTime );
+	}
+};
+
+SnapshotObject MakeSnapshotObject( ObjectId id )
+{
+	SnapshotObject object;
+	object.id = id;
+	object.enabled = true;
+	object.authority = 0;
+	object.position = math::Vector( id * 1.5f, -2.0f, 0.5f );
+	object.orientation = math::Quaternion( 1, 0, 0, 0 );
+	object.linearVelocity = math::Vector( 1, 0, 0 );
+	object.angularVelocity = math::Vector( 0, 0, 2 );
+	return object;
+}
+
+TEST( SnapshotBaselineOffset )
+{
+	// the only acked snapshot is "offset" packets back: within the history it is a baseline, at the history size or past it the object goes absolute
+
+	const int offsets[] = { 1, SnapshotHistory::Size - 1, SnapshotHistory::Size, SnapshotHistory::Size + 1 };
+
+	for ( int i = 0; i < (int) ( sizeof( offsets ) / sizeof( offsets[0] ) ); ++i )
+	{
+		const int offset = offsets[i];
+
+		SnapshotLink link;
+		SnapshotObject object = MakeSnapshotObject( 1 );
+		SnapshotObject received;
+		int count = 0;
+
+		link.Send( &object, 1 );
+		CHECK( link.Deliver( link.receiver, &received, count, 1 ) );
+		link.Ack();
+
+		for ( int j = 1; j < offset; ++j )
+			link.Send( &object, 1 );
+
+		link.sender.ClearStats();
+		link.Send( &object, 1 );
+		count = 0;
+		CHECK( link.Deliver( link.receiver, &received, count, 1 ) );
+		CHECK_EQUAL( 1, count );
+		CHECK_EQUAL( object.id, received.id );
+		CHECK_CLOSE( object.position.x, received.position.x, PositionResolution );
+
+		const SnapshotStats & stats = link.sender.GetStats();
+		CHECK_EQUAL( offset < SnapshotHistory::Size ? 1 : 0, stats.unchanged );
+		CHECK_EQUAL( offset < SnapshotHistory::Size ? 0 : 1, stats.absolute );
+		CHECK_EQUAL( 0, link.receiver.GetStats().errors );
+	}
+}
+
+TEST( SnapshotDecodeErrors )
+{
+	// packets that fail to decode are counted in the stats, not printed, and nothing in them is acked
+
+	SnapshotObject objects[4];
+	for ( int i = 0; i < 4; ++i )
+		objects[i] = MakeSnapshotObject( i + 1 );
+	SnapshotObject received[4];
+	int count = 0;
+
+	SnapshotLink link;
+
+	// truncated packet
+
+	link.Send( objects, 4 );
+	CHECK( !link.Deliver( link.receiver, received, count, 4, link.bytes / 2 ) );
+	CHECK_EQUAL( 0, count );
+	CHECK_EQUAL( 1, link.receiver.GetStats().errors );
+
+	// more objects than the receiver has room for
+
+	link.Send( objects, 4 );
+	CHECK( !link.Deliver( link.receiver, received, count, 2 ) );
+	CHECK_EQUAL( 2, link.receiver.GetStats().errors );
+
+	// baseline the receiver never decoded
+
+	link.Send( objects, 4 );
+	CHECK( link.Deliver( link.receiver, received, count, 4 ) );
+	CHECK_EQUAL( 4, count );
+	link.Ack();
+	link.Send( objects, 4 );
+	SnapshotConnection stranger;
+	CHECK( !link.Deliver( stranger, received, count, 4 ) );
+	CHECK_EQUAL( 1, stranger.GetStats().errors );
+
+	// the receiver that has the baseline still decodes it
+
+	CHECK( link.Deliver( link.receiver, received, count, 4 ) );
+	CHECK_EQUAL( 4, count );
+	CHECK_EQUAL( 2, link.receiver.GetStats().errors );
+}
+
+// ------------------------------------------------------------------------------------
+// quantization
+// ------------------------------------------------------------------------------------
+
+float QuaternionAngle( const math::Quaternion & a, const math::Quaternion & b )
+{
+	const float dot = math::abs( a.w*b.w + a.x*b.x + a.y*b.y + a.z*b.z );
+	return 2.0f * acosf( dot < 1.0f ? dot : 1.0f );
+}
+
+TEST( QuantizationBitsPerObject )
+{
+	const int PositionBits = 3 * net::Stream::BitsRequired( 0, 2 * engine::GetPositionLimit() );
+	const int OrientationBits = 2 + 3 * net::Stream::BitsRequired( 0, 2 * engine::GetOrientationLimit() );
+	const int LinearVelocityBits = 3 * net::Stream::BitsRequired( 0, 2 * engine::GetLinearVelocityLimit() );
+	const int AngularVelocityBits = 3 * net::Stream::BitsRequired( 0, 2 * engine::GetAngularVelocityLimit() );
+
+	CHECK_EQUAL( 60, PositionBits );
+	CHECK_EQUAL( 35, OrientationBits );
+	CHECK_EQUAL( 54, LinearVelocityBits );
+	CHECK_EQUAL( 54, AngularVelocityBits );
+	CHECK_EQUAL( 203, PositionBits + OrientationBits + LinearVelocityBits + AngularVelocityBits );
+
+	// on the wire, each absolute object also has an id gap, a baseline bit, an enabled bit and its authority
+
+	const int ObjectBits = 1 + 1 + 1 + net::Stream::BitsRequired( 0, MaxPlayers ) + 203;
+
+	SnapshotObject objects[2];
+	objects[0] = MakeSnapshotObject( 1 );
+	objects[1] = MakeSnapshotObject( 2 );
+
+	int bits[2];
+	for ( int count = 1; count <= 2; ++count )
+	{
+		unsigned char buffer[256];
+		SnapshotConnection connection;
+		net::Stream stream( net::Stream::Write, buffer, sizeof( buffer ) );
+		CHECK( connection.WriteSnapshot( stream, objects, count ) );
+		CHECK_EQUAL( count, connection.GetStats().absolute );
+		bits[count-1] = stream.GetBitsProcessed();
+	}
+
+	CHECK_EQUAL( ObjectBits, bits[1] - bits[0] );
+}
+
+TEST( QuantizationError )
+{
+	// random states over the full range, plus orientations close to a tie between the two largest components
+
+	const int StateCount = 100000;
+
+	// note: half a step per component, plus float rounding at the bound, see QuantizedState in Engine.h
+
+	const float PositionErrorBound = sqrtf( 3.0f ) * ( 0.5f * PositionResolution + PositionBound * FLT_EPSILON );
+	const float OrientationErrorBound = 2.0f * sqrtf( 3.0f ) * OrientationResolution;
+	const float LinearVelocityErrorBound = sqrtf( 3.0f ) * ( 0.5f * LinearVelocityResolution + MaxLinearVelocity * FLT_EPSILON );
+	const float AngularVelocityErrorBound = sqrtf( 3.0f ) * ( 0.5f * AngularVelocityResolution + MaxAngularVelocity * FLT_EPSILON );
+
+	float positionError = 0.0f;
+	float orientationError = 0.0f;
+	float linearVelocityError = 0.0f;
+	float angularVelocityError = 0.0f;
+	int notFixed = 0;
+
+	srand( 0 );
+	for ( int i = 0; i < StateCount; ++i )
+	{
+		SimulationObjectState a;
+		const float bound = PositionBound - 1.0f;
+		a.position = math::Vector( math::random_float( -bound, bound ), math::random_float( -bound, bound ), math::random_float( -bound, bound ) );
+		if ( i % 4 == 0 )
+		{
+			const float epsilon = math::random_float( -OrientationResolution, OrientationResolution );
+			a.orientation = math::Quaternion( engine::SmallestThreeBound + epsilon, 0, 0, ( i & 4 ) ? engine::SmallestThreeBound : -engine::SmallestThreeBound );
+		}
+		else
+			a.orientation = math::Quaternion( math::random_float( -1, 1 ), math::random_float( -1, 1 ), math::random_float( -1, 1 ), math::random_float( -1, 1 ) );
+		a.orientation.normalize();
+		a.linearVelocity = math::Vector( math::random_float( -MaxLinearVelocity, MaxLinearVelocity ), math::random_float( -MaxLinearVelocity, MaxLinearVelocity ), math::random_float( -MaxLinearVelocity, MaxLinearVelocity ) );
+		a.angularVelocity = math::Vector( math::random_float( -MaxAngularVelocity, MaxAngularVelocity ), math::random_float( -MaxAngularVelocity, MaxAngularVelocity ), math::random_float( -MaxAngularVelocity, MaxAngularVelocity ) );
+
+		SimulationObjectState b = a;
+		engine::QuantizeObjectState( b );
+
+		positionError = math::maximum( positionError, ( a.position - b.position ).length() );
+		orientationError = math::maximum( orientationError, QuaternionAngle( a.orientation, b.orientation ) );
+		linearVelocityError = math::maximum( linearVelocityError, ( a.linearVelocity - b.linearVelocity ).length() );
+		angularVelocityError = math::maximum( angularVelocityError, ( a.angularVelocity - b.angularVelocity ).length() );
+
+		// snapped state is a fixed point, so the network carries it bit for bit
+
+		SimulationObjectState c = b;
+		engine::QuantizeObjectState( c );
+		if ( memcmp( &b.position, &c.position, sizeof( math::Vector ) ) != 0 ||
+			 memcmp( &b.orientation, &c.orientation, sizeof( math::Quaternion ) ) != 0 ||
+			 memcmp( &b.linearVelocity, &c.linearVelocity, sizeof( math::Vector ) ) != 0 ||
+			 memcmp( &b.angularVelocity, &c.angularVelocity, sizeof( math::Vector ) ) != 0 )
+			notFixed++;
+	}
+
+	CHECK( positionError <= PositionErrorBound );
+	CHECK( orientationError <= OrientationErrorBound );
+	CHECK( linearVelocityError <= LinearVelocityErrorBound );
+	CHECK( angularVelocityError <= AngularVelocityErrorBound );
+	CHECK_EQUAL( 0, notFixed );
+}
+
+// ------------------------------------------------------------------------------------
+// network simulator
+// ------------------------------------------------------------------------------------
+
+TEST( NetworkSimulatorReceivedPacketSurvivesSends )
+{
+	// sending while holding a received packet grows the slot pool, which must not move the packet's data
+
+	engine::NetworkSimulator networkSimulator( 2 );
+
+	unsigned char data[256];
+	memset( data, 0xAB, sizeof( data ) );
+	networkSimulator.SendPacket( 0, 1, data, sizeof( data ) );
+	networkSimulator.Update( DeltaTime );
+
+	const engine::NetworkSimulator::Packet * packet = networkSimulator.ReceivePacket();
+	CHECK( packet != NULL );
+	if ( !packet )
+		return;
+
+	unsigned char other[256];
+	memset( other, 0xCD, sizeof( other ) );
+	for ( int i = 0; i < 1000; ++i )
+		networkSimulator.SendPacket( 1, 0, other, sizeof( other ) );
+
+	CHECK_EQUAL( 0, packet->sourceNodeId );
+	CHECK_EQUAL( 256, packet->size );
+	CHECK( memcmp( packet->data, data, sizeof( data ) ) == 0 );
+}
+
+TEST( NetworkSimulatorDeliveryOrder )
+{
+	// in order and held back packets are delivered together by time, ties in send order
+
+	engine::NetworkSimulator networkSimulator( 3 );
+	engine::LinkSettings fast;
+	fast.latency = 0.05f;
+	engine::LinkSettings slow;
+	slow.latency = 0.2f;
+	networkSimulator.SetLinkSettings( fast );
+	networkSimulator.SetLinkSettings( 0, 1, slow );
+
+	const int Packets = 30;
+	for ( int i = 0; i < Packets; ++i )
+	{
+		unsigned char value = (unsigned char) i;
+		networkSimulator.SendPacket( i % 2 == 0 ? 0 : 2, 1, &value, 1 );
+		networkSimulator.Update( 0.01f );
+	}
+	CHECK_EQUAL( Packets, networkSimulator.GetPacketsInFlight() );
+
+	double lastTime = 0.0;
+	int delivered = 0;
+	int lastFrom0 = -1;
+	int lastFrom2 = -1;
+	for ( int frame = 0; frame < 100; ++frame )
+	{
+		while ( const engine::NetworkSimulator::Packet * packet = networkSimulator.ReceivePacket() )
+		{
+			const int value = packet->data[0];
+			const double sentTime = value * 0.01;
+			const double deliveryTime = sentTime + ( packet->sourceNodeId == 0 ? 0.2 : 0.05 );
+			CHECK( deliveryTime >= lastTime - 0.00001 );
+			CHECK( networkSimulator.GetTime() >= deliveryTime - 0.00001 );
+			lastTime = deliveryTime;
+			int & last = packet->sourceNodeId == 0 ? lastFrom0 : lastFrom2;
+			CHECK( value > last );
+			last = value;
+			delivered++;
+		}
+		networkSimulator.Update( 0.01f );
+	}
+
+	CHECK_EQUAL( Packets, delivered );
+	CHECK_EQUAL( 0, networkSimulator.GetPacketsInFlight() );
+}
+
+// ------------------------------------------------------------------------------------
+
+int main()
+{
+	return UnitTest::RunAllTests();
+}
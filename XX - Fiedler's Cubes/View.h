@@ -10,6 +10,7 @@
 #include "Config.h"
 #include "Render.h"
 #include "ViewObject.h"
+#include "ViewArrays.h"
 
 namespace view
 {
@@ -31,44 +32,6 @@ namespace view
 		bool visible;
 	};
 
-	struct Object
-	{
-		Object()
-		{
-			id = 0;
-			remove = false;
-			visible = false;
-			blending = false;
-			positionError = math::Vector(0,0,0);
-	 		visualOrientation = math::Quaternion(1,0,0,0);
-			framesSinceFlash = -1;
-		}
-
-		unsigned int id;
-		math::Vector position;
-		math::Quaternion orientation;
-		math::Vector linearVelocity;
-		math::Vector angularVelocity;
-		math::Vector positionError;
-		math::Quaternion visualOrientation;
-		math::Vector previousPosition;
-		math::Vector previousLinearVelocity;
-		math::Vector previousAngularVelocity;
-		math::Quaternion previousOrientation;
-		math::Vector interpolatedPosition;
-		math::Quaternion interpolatedOrientation;
-		float scale;
-		float r,g,b,a;
-		float t;
-		bool remove;
-		bool visible;
-		bool blending;
-		float blend_time;
-		float blend_start;
-		float blend_finish;
-		int framesSinceFlash;
-	};
-
 	enum InterpolationMode
 	{
 		INTERPOLATE_Linear,
@@ -95,13 +58,7 @@ namespace view
 
 		void Reset()
 		{
-			for ( object_map::iterator itor = objects.begin(); itor != objects.end(); ++itor )
-			{
-				Object * object = itor->second;
-				assert( object );
-				delete object;
-			}
-			objects.clear();
+			objects.Clear();
 		}
 
 		void UpdateObjects( ObjectUpdate updates[], int updateCount, bool updateState = true, bool showFlash = false )
@@ -111,12 +68,8 @@ namespace view
 			// 1. mark all objects as pending removal
 			//  - allows us to detect deleted objects in O(n) instead of O(n^2)
 
-			for ( object_map::iterator itor = objects.begin(); itor != objects.end(); ++itor )
-			{
-	 			Object * object = itor->second;
-				assert( object );
-				object->remove = true;
-			}
+			for ( int i = 0; i < objects.GetCount(); ++i )
+				objects.display[i].remove = true;
 
 			// 2. pass over all cubes in new render state
 			//  - add cube if does not exist, update if exists
@@ -124,281 +77,229 @@ namespace view
 
 			for ( int i = 0; i < (int) updateCount; ++i )
 			{
-				object_map::iterator itor = objects.find( updates[i].id );
+				int index = objects.Find( updates[i].id );
 
-				if ( itor == objects.end() )
+				if ( index == -1 )
 				{
 					// add new view object
 
-					Object * object = new Object();
-
-					object->id = updates[i].id;
-					object->position = updates[i].position;
-					object->orientation = updates[i].orientation;
-					object->previousPosition = updates[i].position;
-					object->previousLinearVelocity = updates[i].linearVelocity;
-					object->previousAngularVelocity = updates[i].angularVelocity;
-					object->previousOrientation = updates[i].orientation;
-					object->positionError = math::Vector(0,0,0);
-					object->visualOrientation = updates[i].orientation;
-					object->linearVelocity = updates[i].linearVelocity;
-					object->angularVelocity = updates[i].angularVelocity;
-					object->scale = updates[i].scale;
-					object->r = updates[i].r;
-					object->g = updates[i].g;
-					object->b = updates[i].b;
-					object->a = 0.0f;
-					object->visible = false;
+					Object object;
+
+					object.id = updates[i].id;
+					object.position = updates[i].position;
+					object.orientation = updates[i].orientation;
+					object.previousPosition = updates[i].position;
+					object.previousLinearVelocity = updates[i].linearVelocity;
+					object.previousAngularVelocity = updates[i].angularVelocity;
+					object.previousOrientation = updates[i].orientation;
+					object.positionError = math::Vector(0,0,0);
+					object.visualOrientation = updates[i].orientation;
+					object.linearVelocity = updates[i].linearVelocity;
+					object.angularVelocity = updates[i].angularVelocity;
+					object.interpolatedPosition = updates[i].position;
+					object.interpolatedOrientation = updates[i].orientation;
+					object.scale = updates[i].scale;
+					object.r = updates[i].r;
+					object.g = updates[i].g;
+					object.b = updates[i].b;
+					object.a = 0.0f;
+					object.visible = false;
+					object.blend_time = 0.0f;
+					object.blend_start = 0.0f;
+					object.blend_finish = 0.0f;
 					
 					if ( updates[i].flash )
-						object->framesSinceFlash = 0;
+						object.framesSinceFlash = 0;
 
-					objects.insert( std::make_pair( updates[i].id, object ) );
+					objects.Set( objects.Add( object.id ), object );
 				}
 				else
 				{
 					// update existing
+					//  - write just the fields that change straight into their arrays
 
-					Object * object = itor->second;
-
-					assert( object );
+					ObjectDisplay & object = objects.display[index];
 					
 					if ( !showFlash )
 					{
-						object->r += ( updates[i].r - object->r ) * ColorChangeTightness;
-						object->g += ( updates[i].g - object->g ) * ColorChangeTightness;
-						object->b += ( updates[i].b - object->b ) * ColorChangeTightness;
+						object.r += ( updates[i].r - object.r ) * ColorChangeTightness;
+						object.g += ( updates[i].g - object.g ) * ColorChangeTightness;
+						object.b += ( updates[i].b - object.b ) * ColorChangeTightness;
 					}
 					else
 					{
 						if ( updates[i].flash )
 						{
-							object->r = 0.3f;
-							object->g = 0.3f;
-							object->b = 1.0f;
-							object->framesSinceFlash = 0;
+							object.r = 0.3f;
+							object.g = 0.3f;
+							object.b = 1.0f;
+							object.framesSinceFlash = 0;
 						}
 						else
 						{
-							if ( object->framesSinceFlash == FlashFrames )
+							if ( object.framesSinceFlash == FlashFrames )
 							{
-								object->r = 0.8f;
-								object->g = 0.8f;
-								object->b = 0.85f;
+								object.r = 0.8f;
+								object.g = 0.8f;
+								object.b = 0.85f;
 							}
-							else if ( object->framesSinceFlash > FlashFrames )
+							else if ( object.framesSinceFlash > FlashFrames )
 							{
-								object->r += ( 0.8f - object->r ) * ColorChangeTightness;
-								object->g += ( 0.8f - object->g ) * ColorChangeTightness;
-								object->b += ( 0.85f - object->b ) * ColorChangeTightness;
+								object.r += ( 0.8f - object.r ) * ColorChangeTightness;
+								object.g += ( 0.8f - object.g ) * ColorChangeTightness;
+								object.b += ( 0.85f - object.b ) * ColorChangeTightness;
 							}
-							object->framesSinceFlash++;
+							object.framesSinceFlash++;
 						}
 					}
 					
 					if ( updateState )
 					{
-						object->positionError = ( object->position + object->positionError ) - updates[i].position;
-						if ( object->positionError.lengthSquared() > 50.0f )
+						const math::Vector position = objects.position.Get( index );
+						math::Vector positionError = ( position + objects.positionError.Get( index ) ) - updates[i].position;
+						if ( positionError.lengthSquared() > 50.0f )
 						{
-							object->positionError = math::Vector(0,0,0);
-							object->visualOrientation = updates[i].orientation;
+							positionError = math::Vector(0,0,0);
+							objects.visualOrientation.Set( index, updates[i].orientation );
 						}
-
-						object->previousPosition = object->position;
-						object->previousLinearVelocity = object->linearVelocity;
-						object->previousAngularVelocity = object->angularVelocity;
-						object->previousOrientation = object->orientation;
-						object->position = updates[i].position;
-						object->orientation = updates[i].orientation;
-						object->linearVelocity = updates[i].linearVelocity;
-						object->angularVelocity = updates[i].angularVelocity;
-						object->scale = updates[i].scale;
+						objects.positionError.Set( index, positionError );
+
+						objects.previousPosition.Set( index, position );
+						objects.previousLinearVelocity.Set( index, objects.linearVelocity.Get( index ) );
+						objects.previousAngularVelocity.Set( index, objects.angularVelocity.Get( index ) );
+						objects.previousOrientation.Set( index, objects.orientation.Get( index ) );
+						objects.position.Set( index, updates[i].position );
+						objects.orientation.Set( index, updates[i].orientation );
+						objects.linearVelocity.Set( index, updates[i].linearVelocity );
+						objects.angularVelocity.Set( index, updates[i].angularVelocity );
+						object.scale = updates[i].scale;
 					}
 					
-					object->remove = false;
+					object.remove = false;
 
-					if ( !object->blending )
+					if ( !object.blending )
 					{
-						if ( object->visible && !updates[i].visible )
+						if ( object.visible && !updates[i].visible )
 						{
 							// start fade out
-							object->blending = true;
-							object->blend_start = 1.0f;
-							object->blend_finish = 0.0f;
-							object->blend_time = 0.0f;
+							object.blending = true;
+							object.blend_start = 1.0f;
+							object.blend_finish = 0.0f;
+							object.blend_time = 0.0f;
 						}
-						else if ( !object->visible && updates[i].visible )
+						else if ( !object.visible && updates[i].visible )
 						{
 							// start fade in
-							object->blending = true;
-							object->blend_start = 0.0f;
-							object->blend_finish = 1.0f;
-							object->blend_time = 0.0f;
+							object.blending = true;
+							object.blend_start = 0.0f;
+							object.blend_finish = 1.0f;
+							object.blend_time = 0.0f;
 						}
 					}
 				}
 			}
 
 			// delete objects that do not exist in update
+			//  - walk backwards, removal moves the last object into the hole
 
-			object_map::iterator itor = objects.begin();
-			while ( itor != objects.end() )
+			for ( int i = objects.GetCount() - 1; i >= 0; --i )
 			{
-				Object * object = itor->second;
-				assert( object );
-				if ( object->remove )
-				{
-					delete object;
-					objects.erase( itor++ );
-				}
-				else
-				{
-					++itor;
-				}
+				if ( objects.display[i].remove )
+					objects.Remove( i );
 			}
 		}
 		
 		void InterpolateObjects( float t, float stepSize, InterpolationMode interpolationMode )
 		{
-			for ( object_map::iterator itor = objects.begin(); itor != objects.end(); ++itor )
-			{
-	 			Object * object = itor->second;
-
-				assert( object );
-		
-				if ( interpolationMode == INTERPOLATE_Linear )
-				{
-					object->interpolatedPosition = object->previousPosition + ( object->position - object->previousPosition ) * t;
-					object->interpolatedOrientation = math::slerp( object->previousOrientation, object->orientation, t );
-				}
-				else if ( interpolationMode == INTERPOLATE_Hermite )
-				{
-					math::hermite_spline( t, object->previousPosition, object->position, object->previousLinearVelocity * stepSize, object->linearVelocity * stepSize, object->interpolatedPosition );
-					math::Quaternion spin0 = 0.5f * math::Quaternion( 0, object->previousAngularVelocity.x, object->previousAngularVelocity.y, object->previousAngularVelocity.z ) * object->previousOrientation;
-					math::Quaternion spin1 = 0.5f * math::Quaternion( 0, object->angularVelocity.x, object->angularVelocity.y, object->angularVelocity.z ) * object->orientation;
-					math::hermite_spline( t, object->previousOrientation, object->orientation, spin0 * stepSize, spin1 * stepSize, object->interpolatedOrientation );
-				}
-				else if ( interpolationMode == INTERPOLATE_Extrapolate )
-				{
-					math::Vector p0 = object->previousPosition + object->previousLinearVelocity * stepSize;
-					math::Vector p1 = object->position + object->linearVelocity * stepSize;
-					math::Vector t0 = object->previousLinearVelocity * stepSize;
-					math::Vector t1 = object->linearVelocity * stepSize;
-					math::hermite_spline( t, p0, p1, t0, t1, object->interpolatedPosition );
-
-					math::Quaternion q0 = object->previousOrientation;
-					math::Quaternion q1 = object->orientation;
-					math::Quaternion s0 = 0.5f * math::Quaternion( 0, object->previousAngularVelocity.x, object->previousAngularVelocity.y, object->previousAngularVelocity.z ) * object->previousOrientation * stepSize;
-					math::Quaternion s1 = 0.5f * math::Quaternion( 0, object->angularVelocity.x, object->angularVelocity.y, object->angularVelocity.z ) * object->orientation * stepSize;
-					math::hermite_spline( t, q0, q1, s0, s1, object->interpolatedOrientation );
-				}
-			}
+			if ( interpolationMode == INTERPOLATE_Linear )
+				objects.InterpolateLinear( t );
+			else if ( interpolationMode == INTERPOLATE_Hermite )
+				objects.InterpolateHermite( t, stepSize, false );
+			else if ( interpolationMode == INTERPOLATE_Extrapolate )
+				objects.InterpolateHermite( t, stepSize, true );
 		}
 
 		void ExtrapolateObjects( float deltaTime )
 		{
-			for ( object_map::iterator itor = objects.begin(); itor != objects.end(); ++itor )
-			{
-	 			Object * object = itor->second;
-
-				assert( object );
-
-				object->position += object->linearVelocity * deltaTime;
-
-				math::Quaternion orientationSpin = 0.5f * math::Quaternion( 0, object->angularVelocity.x, object->angularVelocity.y, object->angularVelocity.z ) * object->orientation;
-				object->orientation += orientationSpin * deltaTime;
-				object->orientation.normalize();
-
-				math::Quaternion visualOrientationSpin = 0.5f * math::Quaternion( 0, object->angularVelocity.x, object->angularVelocity.y, object->angularVelocity.z ) * object->visualOrientation;
-				object->visualOrientation += visualOrientationSpin * deltaTime;
-				object->visualOrientation.normalize();
-			}
+			objects.Extrapolate( deltaTime );
 		}
 
 		void Update( float deltaTime )
 		{
-			for ( object_map::iterator itor = objects.begin(); itor != objects.end(); ++itor )
-			{
-	 			Object * object = itor->second;
+			// update error smoothing
 
-				assert( object );
+			objects.SmoothErrors( PositionSmoothingTightness, OrientationSmoothingTightness );
 
-				// update error smoothing
-				
-				object->positionError *= ( 1.0f - PositionSmoothingTightness );
-				object->visualOrientation = math::slerp( object->visualOrientation, object->orientation, OrientationSmoothingTightness );
+			// update alpha blend
 
-				// update alpha blend
+			for ( int i = 0; i < objects.GetCount(); ++i )
+			{
+				ObjectDisplay & object = objects.display[i];
 
-				if ( object->blending )
+				if ( object.blending )
 				{
-					object->blend_time += deltaTime * 4.0f;
+					object.blend_time += deltaTime * 4.0f;
 
-					if ( object->blend_time > 1.0f )
+					if ( object.blend_time > 1.0f )
 					{
-						object->a = object->blend_finish;
-						object->visible = object->blend_finish != 0.0f;
-						object->blending = false;
+						object.a = object.blend_finish;
+						object.visible = object.blend_finish != 0.0f;
+						object.blending = false;
 					}
 					else
 					{
-						const float t = object->blend_time;
+						const float t = object.blend_time;
 						const float t2 = t*t;
 						const float t3 = t2*t;
-						object->a = 3*t2 - 2*t3;
-						if ( object->visible )
-						 	object->a = 1.0f - object->a;
+						object.a = 3*t2 - 2*t3;
+						if ( object.visible )
+						 	object.a = 1.0f - object.a;
 					}
 				}
 			}
 		}
 
-		Object * GetObject( unsigned int id )
+		bool GetObject( unsigned int id, Object & object ) const
 		{
-			object_map::iterator itor = objects.find( id );
-			if ( itor != objects.end() )
-				return itor->second;
-			else
-				return NULL;
+			const int index = objects.Find( id );
+			if ( index == -1 )
+				return false;
+			objects.Get( index, object );
+			return true;
 		}
 
 		void GetRenderState( render::Cubes & renderState, bool interpolation = false, bool smoothing = true )
 		{
-			renderState.numCubes = objects.size();
+			renderState.numCubes = objects.GetCount();
 
 			assert( renderState.numCubes <= MaxObjectsToRender );
 
-			unsigned int i = 0;
-
-			for ( object_map::iterator itor = objects.begin(); itor != objects.end(); ++itor )
+			for ( int i = 0; i < objects.GetCount(); ++i )
 			{
-				Object * object = itor->second;
-				assert( object );
 				if ( !interpolation )
 				{
 					if ( smoothing )
 					{
-						renderState.cube[i].position = object->position + object->positionError;
-						renderState.cube[i].orientation = object->visualOrientation;
+						renderState.cube[i].position = objects.position.Get( i ) + objects.positionError.Get( i );
+						renderState.cube[i].orientation = objects.visualOrientation.Get( i );
 					}
 					else
 					{
-						renderState.cube[i].position = object->position;
-						renderState.cube[i].orientation = object->orientation;
+						renderState.cube[i].position = objects.position.Get( i );
+						renderState.cube[i].orientation = objects.orientation.Get( i );
 					}
 				}
 				else
 				{
-					renderState.cube[i].position = object->interpolatedPosition;
-					renderState.cube[i].orientation = object->interpolatedOrientation;
+					renderState.cube[i].position = objects.interpolatedPosition.Get( i );
+					renderState.cube[i].orientation = objects.interpolatedOrientation.Get( i );
 				}
-				renderState.cube[i].scale = object->scale;
-				renderState.cube[i].r = object->r;
-				renderState.cube[i].g = object->g;
-				renderState.cube[i].b = object->b;
-				renderState.cube[i].a = object->a;
-				i++;
+				const ObjectDisplay & display = objects.display[i];
+				renderState.cube[i].scale = display.scale;
+				renderState.cube[i].r = display.r;
+				renderState.cube[i].g = display.g;
+				renderState.cube[i].b = display.b;
+				renderState.cube[i].a = display.a;
 			}
 
 			// sort back to front
@@ -407,83 +308,58 @@ namespace view
 
 	private:
 
-		typedef std::map<unsigned int, Object*> object_map;
-
-		object_map objects;
+		ObjectArrays objects;
 	
-		friend void MergeViewObjectSets( ObjectManager * gameObjects[], int maxPlayers, ObjectManager & output, int primaryPlayer, bool blendColors );
+		friend void MergeViewObjects( const ObjectManager & source, ObjectManager & output, bool blendColors );
 	};
 	
 	// helper function to merge multiple sets of game objects into a single one that can be used for rendering
 	//  - useful for combining the view from multiple nodes into a single set of game objects
 
-	inline void MergeViewObjectSets( ObjectManager * gameObjects[], int maxPlayers, ObjectManager & output, int primaryPlayer, bool blendColors )
+	inline void MergeViewObjects( const ObjectManager & source, ObjectManager & output, bool blendColors )
 	{
-		for ( int i = maxPlayers - 1; i >= 0; --i )
-		{
-			if ( i == primaryPlayer )
-				continue;
-			
-			for ( ObjectManager::object_map::iterator itor = gameObjects[i]->objects.begin(); itor != gameObjects[i]->objects.end(); ++itor )
-			{
-				int key = itor->first;
-	 			Object * srcObject = itor->second;
-				Object * dstObject = output.objects[key];
-				if ( !dstObject )
-				{
-					dstObject = new Object();
-					*dstObject = *srcObject;
-					output.objects[key] = dstObject;
-				}
-				else
-				{
-					float currentAlpha = dstObject->a;
-					float newAlpha = srcObject->a;
-					float newR = ( srcObject->r + dstObject->r ) * 0.5f;
-					float newG = ( srcObject->g + dstObject->g ) * 0.5f;
-					float newB = ( srcObject->b + dstObject->b ) * 0.5f;
-					*dstObject = *srcObject;
-					dstObject->a = std::max( currentAlpha, newAlpha );
-					if ( blendColors )
-					{
-						dstObject->r = newR;
-						dstObject->g = newG;
-						dstObject->b = newB;
-					}
-				}
-			}
-		}
-
-		int i = primaryPlayer;
-		for ( ObjectManager::object_map::iterator itor = gameObjects[i]->objects.begin(); itor != gameObjects[i]->objects.end(); ++itor )
+		for ( int i = 0; i < source.objects.GetCount(); ++i )
 		{
-			int key = itor->first;
-			Object * srcObject = itor->second;
-			Object * dstObject = output.objects[key];
-			if ( !dstObject )
+			Object srcObject;
+			source.objects.Get( i, srcObject );
+			const int index = output.objects.Find( srcObject.id );
+			if ( index == -1 )
 			{
-				dstObject = new Object();
-				*dstObject = *srcObject;
-				output.objects[key] = dstObject;
+				output.objects.Set( output.objects.Add( srcObject.id ), srcObject );
 			}
 			else
 			{
-				float currentAlpha = dstObject->a;
-				float newAlpha = srcObject->a;
-				float newR = ( srcObject->r + dstObject->r ) * 0.5f;
-				float newG = ( srcObject->g + dstObject->g ) * 0.5f;
-				float newB = ( srcObject->b + dstObject->b ) * 0.5f;
-				*dstObject = *srcObject;
-				dstObject->a = std::max( currentAlpha, newAlpha );
+				Object dstObject;
+				output.objects.Get( index, dstObject );
+				float currentAlpha = dstObject.a;
+				float newAlpha = srcObject.a;
+				float newR = ( srcObject.r + dstObject.r ) * 0.5f;
+				float newG = ( srcObject.g + dstObject.g ) * 0.5f;
+				float newB = ( srcObject.b + dstObject.b ) * 0.5f;
+				dstObject = srcObject;
+				dstObject.a = std::max( currentAlpha, newAlpha );
 				if ( blendColors )
 				{
-					dstObject->r = newR;
-					dstObject->g = newG;
-					dstObject->b = newB;
+					dstObject.r = newR;
+					dstObject.g = newG;
+					dstObject.b = newB;
 				}
+				output.objects.Set( index, dstObject );
 			}
 		}
 	}
+
+	inline void MergeViewObjectSets( ObjectManager * gameObjects[], int maxPlayers, ObjectManager & output, int primaryPlayer, bool blendColors )
+	{
+		for ( int i = maxPlayers - 1; i >= 0; --i )
+		{
+			if ( i == primaryPlayer )
+				continue;
+			MergeViewObjects( *gameObjects[i], output, blendColors );
+		}
+
+		MergeViewObjects( *gameObjects[primaryPlayer], output, blendColors );
+	}
 	
 	// ---------------------------------------------------------
 
@@ -0,0 +1,603 @@
+/*
+	Fiedler's Cubes
+	Copyright © 2008-2009 Glenn Fiedler
+	http://www.gafferongames.com/fiedlers-cubes
+*/
+
+#ifndef VIEW_ARRAYS_H
+#define VIEW_ARRAYS_H
+
+#include "Config.h"
+
+#if PLATFORM == PLATFORM_WINDOWS
+	#include "stdint.h"
+#else
+	#include <stdint.h>
+#endif
+
+#include <assert.h>
+#include <vector>
+
+#include "Mathematics.h"
+
+namespace view
+{
+	struct Object
+	{
+		Object()
+		{
+			id = 0;
+			remove = false;
+			visible = false;
+			blending = false;
+			positionError = math::Vector(0,0,0);
+	 		visualOrientation = math::Quaternion(1,0,0,0);
+			framesSinceFlash = -1;
+		}
+
+		unsigned int id;
+		math::Vector position;
+		math::Quaternion orientation;
+		math::Vector linearVelocity;
+		math::Vector angularVelocity;
+		math::Vector positionError;
+		math::Quaternion visualOrientation;
+		math::Vector previousPosition;
+		math::Vector previousLinearVelocity;
+		math::Vector previousAngularVelocity;
+		math::Quaternion previousOrientation;
+		math::Vector interpolatedPosition;
+		math::Quaternion interpolatedOrientation;
+		float scale;
+		float r,g,b,a;
+		bool remove;
+		bool visible;
+		bool blending;
+		float blend_time;
+		float blend_start;
+		float blend_finish;
+		int framesSinceFlash;
+	};
+
+	/*
+		Component arrays.
+		One contiguous float array per component, so a loop over
+		objects reads each component linearly and vectorizes.
+	*/
+
+	struct VectorArray
+	{
+		std::vector<float> x, y, z;
+
+		void Resize( int size )
+		{
+			x.resize( size );
+			y.resize( size );
+			z.resize( size );
+		}
+
+		void Move( int to, int from )
+		{
+			x[to] = x[from];
+			y[to] = y[from];
+			z[to] = z[from];
+		}
+
+		math::Vector Get( int i ) const
+		{
+			return math::Vector( x[i], y[i], z[i] );
+		}
+
+		void Set( int i, const math::Vector & vector )
+		{
+			x[i] = vector.x;
+			y[i] = vector.y;
+			z[i] = vector.z;
+		}
+	};
+
+	struct QuaternionArray
+	{
+		std::vector<float> w, x, y, z;
+
+		void Resize( int size )
+		{
+			w.resize( size );
+			x.resize( size );
+			y.resize( size );
+			z.resize( size );
+		}
+
+		void Move( int to, int from )
+		{
+			w[to] = w[from];
+			x[to] = x[from];
+			y[to] = y[from];
+			z[to] = z[from];
+		}
+
+		math::Quaternion Get( int i ) const
+		{
+			return math::Quaternion( w[i], x[i], y[i], z[i] );
+		}
+
+		void Set( int i, const math::Quaternion & quaternion )
+		{
+			w[i] = quaternion.w;
+			x[i] = quaternion.x;
+			y[i] = quaternion.y;
+			z[i] = quaternion.z;
+		}
+	};
+
+	// per object state the kernels never touch: color, fade and flags
+
+	struct ObjectDisplay
+	{
+		float scale;
+		float r,g,b,a;
+		bool remove;
+		bool visible;
+		bool blending;
+		float blend_time;
+		float blend_start;
+		float blend_finish;
+		int framesSinceFlash;
+	};
+
+	// quaternion helpers for the kernels, written out per component so the loops stay branch free
+
+	inline void spin_quaternion( float ax, float ay, float az,
+	                             float qw, float qx, float qy, float qz,
+	                             float & sw, float & sx, float & sy, float & sz )
+	{
+		// note: same as 0.5f * math::Quaternion( 0, ax, ay, az ) * q
+		ax *= 0.5f;
+		ay *= 0.5f;
+		az *= 0.5f;
+		sw = - ax*qx - ay*qy - az*qz;
+		sx =   ax*qw + ay*qz - az*qy;
+		sy = - ax*qz + ay*qw + az*qx;
+		sz =   ax*qy - ay*qx + az*qw;
+	}
+
+	inline void normalize_quaternion( float & w, float & x, float & y, float & z )
+	{
+		const float length = math::sqrt( w*w + x*x + y*y + z*z );
+		const float inverse = length > 0.0f ? 1.0f / length : 0.0f;
+		w = length > 0.0f ? w * inverse : 1.0f;
+		x *= inverse;
+		y *= inverse;
+		z *= inverse;
+	}
+
+	/*
+		Object arrays.
+		View objects stored as a structure of arrays. Extrapolation,
+		interpolation and error smoothing run as kernels over the dense
+		arrays instead of visiting one heap allocated object per map node.
+		Objects are found by id through an open addressing hash, and
+		removing an object moves the last object into its place, so the
+		arrays never have holes.
+	*/
+
+	class ObjectArrays
+	{
+	public:
+
+		ObjectArrays()
+		{
+			Clear();
+		}
+
+		void Clear()
+		{
+			count = 0;
+			Resize( 0 );
+			table.clear();
+			table.resize( MinTableSize, -1 );
+		}
+
+		int GetCount() const
+		{
+			return count;
+		}
+
+		int Find( unsigned int objectId ) const
+		{
+			const int slot = FindSlot( objectId );
+			return slot != -1 ? table[slot] : -1;
+		}
+
+		int Add( unsigned int objectId )
+		{
+			assert( Find( objectId ) == -1 );
+			const int index = count++;
+			Resize( count );
+			id[index] = objectId;
+			if ( count * 2 > (int) table.size() )
+				RebuildTable( table.size() * 2 );
+			else
+				InsertSlot( objectId, index );
+			return index;
+		}
+
+		void Remove( int index )
+		{
+			assert( index >= 0 );
+			assert( index < count );
+			RemoveSlot( FindSlot( id[index] ) );
+			const int last = count - 1;
+			if ( index != last )
+			{
+				Move( index, last );
+				table[ FindSlot( id[index] ) ] = index;
+			}
+			count--;
+			Resize( count );
+		}
+
+		void Get( int index, Object & object ) const
+		{
+			assert( index >= 0 );
+			assert( index < count );
+			object.id = id[index];
+			object.position = position.Get( index );
+			object.orientation = orientation.Get( index );
+			object.linearVelocity = linearVelocity.Get( index );
+			object.angularVelocity = angularVelocity.Get( index );
+			object.positionError = positionError.Get( index );
+			object.visualOrientation = visualOrientation.Get( index );
+			object.previousPosition = previousPosition.Get( index );
+			object.previousLinearVelocity = previousLinearVelocity.Get( index );
+			object.previousAngularVelocity = previousAngularVelocity.Get( index );
+			object.previousOrientation = previousOrientation.Get( index );
+			object.interpolatedPosition = interpolatedPosition.Get( index );
+			object.interpolatedOrientation = interpolatedOrientation.Get( index );
+			const ObjectDisplay & d = display[index];
+			object.scale = d.scale;
+			object.r = d.r;
+			object.g = d.g;
+			object.b = d.b;
+			object.a = d.a;
+			object.remove = d.remove;
+			object.visible = d.visible;
+			object.blending = d.blending;
+			object.blend_time = d.blend_time;
+			object.blend_start = d.blend_start;
+			object.blend_finish = d.blend_finish;
+			object.framesSinceFlash = d.framesSinceFlash;
+		}
+
+		void Set( int index, const Object & object )
+		{
+			assert( index >= 0 );
+			assert( index < count );
+			assert( object.id == id[index] );
+			position.Set( index, object.position );
+			orientation.Set( index, object.orientation );
+			linearVelocity.Set( index, object.linearVelocity );
+			angularVelocity.Set( index, object.angularVelocity );
+			positionError.Set( index, object.positionError );
+			visualOrientation.Set( index, object.visualOrientation );
+			previousPosition.Set( index, object.previousPosition );
+			previousLinearVelocity.Set( index, object.previousLinearVelocity );
+			previousAngularVelocity.Set( index, object.previousAngularVelocity );
+			previousOrientation.Set( index, object.previousOrientation );
+			interpolatedPosition.Set( index, object.interpolatedPosition );
+			interpolatedOrientation.Set( index, object.interpolatedOrientation );
+			ObjectDisplay & d = display[index];
+			d.scale = object.scale;
+			d.r = object.r;
+			d.g = object.g;
+			d.b = object.b;
+			d.a = object.a;
+			d.remove = object.remove;
+			d.visible = object.visible;
+			d.blending = object.blending;
+			d.blend_time = object.blend_time;
+			d.blend_start = object.blend_start;
+			d.blend_finish = object.blend_finish;
+			d.framesSinceFlash = object.framesSinceFlash;
+		}
+
+		// move objects forward along their velocity
+
+		void Extrapolate( float deltaTime )
+		{
+			if ( count == 0 )
+				return;
+
+			AddScaled( count, &position.x[0], &linearVelocity.x[0], deltaTime );
+			AddScaled( count, &position.y[0], &linearVelocity.y[0], deltaTime );
+			AddScaled( count, &position.z[0], &linearVelocity.z[0], deltaTime );
+
+			IntegrateOrientation( count, &orientation.w[0], &orientation.x[0], &orientation.y[0], &orientation.z[0], 
+			                      &angularVelocity.x[0], &angularVelocity.y[0], &angularVelocity.z[0], deltaTime );
+
+			IntegrateOrientation( count, &visualOrientation.w[0], &visualOrientation.x[0], &visualOrientation.y[0], &visualOrientation.z[0], 
+			                      &angularVelocity.x[0], &angularVelocity.y[0], &angularVelocity.z[0], deltaTime );
+		}
+
+		// decay position error, and ease the visual orientation toward the actual orientation
+
+		void SmoothErrors( float positionTightness, float orientationTightness )
+		{
+			if ( count == 0 )
+				return;
+
+			const float decay = 1.0f - positionTightness;
+			Scale( count, &positionError.x[0], decay );
+			Scale( count, &positionError.y[0], decay );
+			Scale( count, &positionError.z[0], decay );
+
+			math::slerp( &visualOrientation.w[0], &visualOrientation.x[0], &visualOrientation.y[0], &visualOrientation.z[0],
+			             &orientation.w[0], &orientation.x[0], &orientation.y[0], &orientation.z[0],
+			             &visualOrientation.w[0], &visualOrientation.x[0], &visualOrientation.y[0], &visualOrientation.z[0],
+			             count, orientationTightness );
+		}
+
+		// interpolate from the previous state to the current state, t in [0,1]
+
+		void InterpolateLinear( float t )
+		{
+			if ( count == 0 )
+				return;
+
+			Lerp( count, &previousPosition.x[0], &position.x[0], &interpolatedPosition.x[0], t );
+			Lerp( count, &previousPosition.y[0], &position.y[0], &interpolatedPosition.y[0], t );
+			Lerp( count, &previousPosition.z[0], &position.z[0], &interpolatedPosition.z[0], t );
+
+			math::slerp( &previousOrientation.w[0], &previousOrientation.x[0], &previousOrientation.y[0], &previousOrientation.z[0],
+			             &orientation.w[0], &orientation.x[0], &orientation.y[0], &orientation.z[0],
+			             &interpolatedOrientation.w[0], &interpolatedOrientation.x[0], &interpolatedOrientation.y[0], &interpolatedOrientation.z[0],
+			             count, t );
+		}
+
+		// hermite spline from the previous state to the current state, velocities as tangents.
+		// extrapolate shifts both end points one step forward along their velocity
+
+		void InterpolateHermite( float t, float stepSize, bool extrapolate )
+		{
+			if ( count == 0 )
+				return;
+
+			// note: t is the same for every object, so the basis functions are evaluated once
+
+			Basis basis;
+			const float t2 = t*t;
+			const float t3 = t2*t;
+			basis.h1 =  2*t3 - 3*t2 + 1;
+			basis.h2 = -2*t3 + 3*t2;
+			basis.h3 =    t3 - 2*t2 + t;
+			basis.h4 =    t3 - t2;
+
+			const float shift = extrapolate ? stepSize : 0.0f;
+
+			Hermite( count, &previousPosition.x[0], &position.x[0], &previousLinearVelocity.x[0], &linearVelocity.x[0], &interpolatedPosition.x[0], basis, stepSize, shift );
+			Hermite( count, &previousPosition.y[0], &position.y[0], &previousLinearVelocity.y[0], &linearVelocity.y[0], &interpolatedPosition.y[0], basis, stepSize, shift );
+			Hermite( count, &previousPosition.z[0], &position.z[0], &previousLinearVelocity.z[0], &linearVelocity.z[0], &interpolatedPosition.z[0], basis, stepSize, shift );
+
+			HermiteOrientation( count, 
+			                    &previousOrientation.w[0], &previousOrientation.x[0], &previousOrientation.y[0], &previousOrientation.z[0],
+			                    &orientation.w[0], &orientation.x[0], &orientation.y[0], &orientation.z[0],
+			                    &previousAngularVelocity.x[0], &previousAngularVelocity.y[0], &previousAngularVelocity.z[0],
+			                    &angularVelocity.x[0], &angularVelocity.y[0], &angularVelocity.z[0],
+			                    &interpolatedOrientation.w[0], &interpolatedOrientation.x[0], &interpolatedOrientation.y[0], &interpolatedOrientation.z[0],
+			                    basis, stepSize );
+		}
+
+		std::vector<unsigned int> id;
+		VectorArray position;
+		QuaternionArray orientation;
+		VectorArray linearVelocity;
+		VectorArray angularVelocity;
+		VectorArray positionError;
+		QuaternionArray visualOrientation;
+		VectorArray previousPosition;
+		VectorArray previousLinearVelocity;
+		VectorArray previousAngularVelocity;
+		QuaternionArray previousOrientation;
+		VectorArray interpolatedPosition;
+		QuaternionArray interpolatedOrientation;
+		std::vector<ObjectDisplay> display;
+
+	private:
+
+		enum { MinTableSize = 64 };			// must be a power of two
+
+		void Resize( int size )
+		{
+			id.resize( size );
+			position.Resize( size );
+			orientation.Resize( size );
+			linearVelocity.Resize( size );
+			angularVelocity.Resize( size );
+			positionError.Resize( size );
+			visualOrientation.Resize( size );
+			previousPosition.Resize( size );
+			previousLinearVelocity.Resize( size );
+			previousAngularVelocity.Resize( size );
+			previousOrientation.Resize( size );
+			interpolatedPosition.Resize( size );
+			interpolatedOrientation.Resize( size );
+			display.resize( size );
+		}
+
+		void Move( int to, int from )
+		{
+			id[to] = id[from];
+			position.Move( to, from );
+			orientation.Move( to, from );
+			linearVelocity.Move( to, from );
+			angularVelocity.Move( to, from );
+			positionError.Move( to, from );
+			visualOrientation.Move( to, from );
+			previousPosition.Move( to, from );
+			previousLinearVelocity.Move( to, from );
+			previousAngularVelocity.Move( to, from );
+			previousOrientation.Move( to, from );
+			interpolatedPosition.Move( to, from );
+			interpolatedOrientation.Move( to, from );
+			display[to] = display[from];
+		}
+
+		/*
+			Kernels.
+			Each kernel is a flat loop over n objects with no branches, and
+			the arrays it touches never overlap, which __restrict tells the
+			compiler. Without that, it has to check every pair of arrays for
+			overlap and gives up on vectorizing loops with this many streams.
+			Quaternion normalization only vectorizes with -ffast-math, which
+			the demos are built with.
+		*/
+
+		struct Basis
+		{
+			float h1, h2, h3, h4;
+		};
+
+		static void AddScaled( int n, float * __restrict output, const float * __restrict input, float scale )
+		{
+			for ( int i = 0; i < n; ++i )
+				output[i] += input[i] * scale;
+		}
+
+		static void Scale( int n, float * __restrict output, float scale )
+		{
+			for ( int i = 0; i < n; ++i )
+				output[i] *= scale;
+		}
+
+		static void Lerp( int n, const float * __restrict a, const float * __restrict b, float * __restrict output, float t )
+		{
+			for ( int i = 0; i < n; ++i )
+				output[i] = a[i] + ( b[i] - a[i] ) * t;
+		}
+
+		static void Hermite( int n, const float * __restrict p0, const float * __restrict p1, 
+		                     const float * __restrict v0, const float * __restrict v1, float * __restrict output,
+		                     const Basis & basis, float stepSize, float shift )
+		{
+			for ( int i = 0; i < n; ++i )
+			{
+				const float a = p0[i] + v0[i] * shift;
+				const float b = p1[i] + v1[i] * shift;
+				output[i] = basis.h1 * a + basis.h2 * b + basis.h3 * ( v0[i] * stepSize ) + basis.h4 * ( v1[i] * stepSize );
+			}
+		}
+
+		static void IntegrateOrientation( int n, float * __restrict qw, float * __restrict qx, float * __restrict qy, float * __restrict qz,
+		                                  const float * __restrict ax, const float * __restrict ay, const float * __restrict az, float deltaTime )
+		{
+			for ( int i = 0; i < n; ++i )
+			{
+				float sw, sx, sy, sz;
+				spin_quaternion( ax[i], ay[i], az[i], qw[i], qx[i], qy[i], qz[i], sw, sx, sy, sz );
+				float w = qw[i] + sw * deltaTime;
+				float x = qx[i] + sx * deltaTime;
+				float y = qy[i] + sy * deltaTime;
+				float z = qz[i] + sz * deltaTime;
+				normalize_quaternion( w, x, y, z );
+				qw[i] = w;
+				qx[i] = x;
+				qy[i] = y;
+				qz[i] = z;
+			}
+		}
+
+		static void HermiteOrientation( int n, 
+		                                const float * __restrict aw, const float * __restrict ax, const float * __restrict ay, const float * __restrict az,
+		                                const float * __restrict bw, const float * __restrict bx, const float * __restrict by, const float * __restrict bz,
+		                                const float * __restrict ux, const float * __restrict uy, const float * __restrict uz,
+		                                const float * __restrict vx, const float * __restrict vy, const float * __restrict vz,
+		                                float * __restrict ow, float * __restrict ox, float * __restrict oy, float * __restrict oz,
+		                                const Basis & basis, float stepSize )
+		{
+			for ( int i = 0; i < n; ++i )
+			{
+				float s0w, s0x, s0y, s0z;
+				float s1w, s1x, s1y, s1z;
+				spin_quaternion( ux[i], uy[i], uz[i], aw[i], ax[i], ay[i], az[i], s0w, s0x, s0y, s0z );
+				spin_quaternion( vx[i], vy[i], vz[i], bw[i], bx[i], by[i], bz[i], s1w, s1x, s1y, s1z );
+
+				// take the short way around: flip the start point and its tangent if the end points are in opposite hemispheres
+
+				const float dot = aw[i]*bw[i] + ax[i]*bx[i] + ay[i]*by[i] + az[i]*bz[i];
+				const float flip = dot < 0.0f ? -1.0f : 1.0f;
+				const float k1 = basis.h1 * flip;
+				const float k2 = basis.h2;
+				const float k3 = basis.h3 * flip * stepSize;
+				const float k4 = basis.h4 * stepSize;
+
+				float w = k1 * aw[i] + k2 * bw[i] + k3 * s0w + k4 * s1w;
+				float x = k1 * ax[i] + k2 * bx[i] + k3 * s0x + k4 * s1x;
+				float y = k1 * ay[i] + k2 * by[i] + k3 * s0y + k4 * s1y;
+				float z = k1 * az[i] + k2 * bz[i] + k3 * s0z + k4 * s1z;
+				normalize_quaternion( w, x, y, z );
+
+				ow[i] = w;
+				ox[i] = x;
+				oy[i] = y;
+				oz[i] = z;
+			}
+		}
+
+		static uint32_t Hash( unsigned int objectId )
+		{
+			return objectId * 2654435761U;
+		}
+
+		int FindSlot( unsigned int objectId ) const
+		{
+			const int mask = table.size() - 1;
+			for ( int slot = Hash( objectId ) & mask; table[slot] != -1; slot = ( slot + 1 ) & mask )
+			{
+				if ( id[ table[slot] ] == objectId )
+					return slot;
+			}
+			return -1;
+		}
+
+		void InsertSlot( unsigned int objectId, int index )
+		{
+			const int mask = table.size() - 1;
+			int slot = Hash( objectId ) & mask;
+			while ( table[slot] != -1 )
+				slot = ( slot + 1 ) & mask;
+			table[slot] = index;
+		}
+
+		void RemoveSlot( int slot )
+		{
+			// backward shift deletion: pull following entries of the probe run into the hole
+			assert( slot != -1 );
+			const int mask = table.size() - 1;
+			int hole = slot;
+			for ( int next = ( slot + 1 ) & mask; table[next] != -1; next = ( next + 1 ) & mask )
+			{
+				const int home = Hash( id[ table[next] ] ) & mask;
+				if ( ( ( next - home ) & mask ) >= ( ( next - hole ) & mask ) )
+				{
+					table[hole] = table[next];
+					hole = next;
+				}
+			}
+			table[hole] = -1;
+		}
+
+		void RebuildTable( int size )
+		{
+			assert( ( size & ( size - 1 ) ) == 0 );
+			table.clear();
+			table.resize( size, -1 );
+			for ( int i = 0; i < count; ++i )
+				InsertSlot( id[i], i );
+		}
+
+		int count;
+		std::vector<int> table;				// open addressing hash from object id to index, -1 is an empty slot
+	};
+}
+
+#endif
@@ -51,6 +51,11 @@ namespace view
 		ObjectState object[MaxViewObjects];
 	
 		Packet()
+		{
+			Clear();
+		}
+
+		void Clear()
 		{
 			droppedFrames = 0;
 			netTime = 0.0f;
@@ -59,6 +64,20 @@ namespace view
 			objectCount = 0;
 		}
 	};
+
+	inline void CopyPacket( const Packet & source, Packet & destination )
+	{
+		// note: only the objects in use are copied, not all MaxViewObjects
+		assert( source.objectCount >= 0 );
+		assert( source.objectCount <= MaxViewObjects );
+		destination.droppedFrames = source.droppedFrames;
+		destination.netTime = source.netTime;
+		destination.simTime = source.simTime;
+		destination.origin = source.origin;
+		destination.objectCount = source.objectCount;
+		for ( int i = 0; i < source.objectCount; ++i )
+			destination.object[i] = source.object[i];
+	}
 }
 
 #endif